@@ -84,6 +84,41 @@ class BuildLSTData(object):
         # Setup the logger to use
         self.logger = logging.getLogger(__name__)
 
+    @staticmethod
+    def band_scaling(band):
+        '''
+        Description:
+            Returns the scale factor and offset of a band written compactly
+            as scaled integers, or None for a band written as floats.
+            Only the integer bands are decoded, whatever scaling a float
+            band records.
+        '''
+
+        if band.data_type != 'INT16' or band.scale_factor is None:
+            return None
+
+        add_offset = 0.0
+        if getattr(band, 'add_offset', None) is not None:
+            add_offset = float(band.add_offset)
+
+        return (float(band.scale_factor), add_offset)
+
+    def decode_band(self, data, scaling):
+        '''
+        Description:
+            Converts a band written compactly as scaled integers back to
+            floats, keeping the no data locations.
+        '''
+
+        if scaling is None:
+            return data
+
+        (scale_factor, add_offset) = scaling
+        decoded = data.astype(np.float32) * scale_factor + add_offset
+        decoded[data == self.no_data_value] = self.no_data_value
+
+        return decoded
+
     def retrieve_metadata_information(self):
         '''
         Description:
@@ -103,23 +138,32 @@ class BuildLSTData(object):
         self.downwelled_name = ''
         self.emissivity_name = ''
 
+        self.thermal_scaling = None
+        self.transmittance_scaling = None
+        self.upwelled_scaling = None
+        self.downwelled_scaling = None
+
         # Find the TOA bands to extract information from
         for band in bands.band:
             if (band.product == 'lst_temp' and
                     band.name == 'lst_thermal_radiance'):
                 self.thermal_name = band.get_file_name()
+                self.thermal_scaling = self.band_scaling(band)
 
             if (band.product == 'lst_temp' and
                     band.name == 'lst_atmospheric_transmittance'):
                 self.transmittance_name = band.get_file_name()
+                self.transmittance_scaling = self.band_scaling(band)
 
             if (band.product == 'lst_temp' and
                     band.name == 'lst_upwelled_radiance'):
                 self.upwelled_name = band.get_file_name()
+                self.upwelled_scaling = self.band_scaling(band)
 
             if (band.product == 'lst_temp' and
                     band.name == 'lst_downwelled_radiance'):
                 self.downwelled_name = band.get_file_name()
+                self.downwelled_scaling = self.band_scaling(band)
 
             if (band.product == 'lst_temp' and
                     band.name == 'landsat_emis'):
@@ -175,18 +219,22 @@ class BuildLSTData(object):
         x_dim = ds.RasterXSize  # They are all the same size
         y_dim = ds.RasterYSize
         thermal_data = ds.GetRasterBand(1).ReadAsArray(0, 0, x_dim, y_dim)
+        thermal_data = self.decode_band(thermal_data, self.thermal_scaling)
 
         # Atmospheric transmittance
         self.logger.info('Loading intermediate transmittance band data [{0}]'
                          .format(self.transmittance_name))
         ds = gdal.Open(self.transmittance_name)
         trans_data = ds.GetRasterBand(1).ReadAsArray(0, 0, x_dim, y_dim)
+        trans_data = self.decode_band(trans_data, self.transmittance_scaling)
 
         # Atmospheric path radiance - upwelled radiance
         self.logger.info('Loading intermediate upwelled band data [{0}]'
                          .format(self.upwelled_name))
         ds = gdal.Open(self.upwelled_name)
         upwelled_data = ds.GetRasterBand(1).ReadAsArray(0, 0, x_dim, y_dim)
+        upwelled_data = self.decode_band(upwelled_data,
+                                         self.upwelled_scaling)
 
         self.logger.info('Calculating surface radiance')
         # Surface radiance
@@ -213,6 +261,8 @@ class BuildLSTData(object):
                          .format(self.downwelled_name))
         ds = gdal.Open(self.downwelled_name)
         downwelled_data = ds.GetRasterBand(1).ReadAsArray(0, 0, x_dim, y_dim)
+        downwelled_data = self.decode_band(downwelled_data,
+                                           self.downwelled_scaling)
 
         # Landsat emissivity estimated from ASTER GED data
         self.logger.info('Loading intermediate emissivity band data [{0}]'
@@ -0,0 +1,408 @@
+#! /usr/bin/env python
+
+'''
+    FILE: convert_narr_to_cube.py
+
+    PURPOSE: Converts the archived NARR GRIB data of each 3hr increment into
+             a binary cube, which the LST processing maps into memory instead
+             of unpacking and parsing the GRIB data for every scene.  The
+             geometric height and relative humidity are derived here, once
+             for each 3hr increment, instead of for every scene.
+
+    PROJECT: Land Satellites Data Systems Science Research and Development
+             (LSRD) at the USGS EROS
+
+    LICENSE: NASA Open Source Agreement 1.3
+'''
+
+import os
+import sys
+import zlib
+import struct
+import shutil
+import logging
+import tempfile
+from argparse import ArgumentParser
+from datetime import datetime, timedelta
+
+import numpy as np
+
+# Import local modules
+import lst_utilities as util
+from lst_environment import Environment
+from extract_auxiliary_narr_data import AuxNARRGribProcessor
+
+
+# Layout of the cube files, which must match narr_cube.h
+NARR_CUBE_MAGIC = 'LSTNARR'
+NARR_CUBE_VERSION = 2
+NARR_CUBE_MAX_PARAMETERS = 4
+NARR_CUBE_MAX_LAYERS = 32
+NARR_CUBE_HEADER_FORMAT = '<8s6I{0}s{1}i'.format(NARR_CUBE_MAX_PARAMETERS * 8,
+                                                 NARR_CUBE_MAX_LAYERS)
+
+NARR_ROWS = 277
+NARR_COLS = 349
+
+# Rows of each checksummed chunk, a window of the grid only reads the chunks
+# holding its rows
+NARR_CUBE_CHUNK_ROWS = 8
+
+# The pressure layers used by the MODTRAN input generation, in millibars
+NARR_LAYERS = [1000, 975, 950, 925, 900,
+               875, 850, 825, 800, 775,
+               750, 725, 700, 650, 600,
+               550, 500, 450, 400, 350,
+               300, 275, 250, 225, 200,
+               175, 150, 125, 100]
+
+# The parameters held by the cubes, the geometric height and relative
+# humidity are derived from the HGT and SPFH parameters
+NARR_CUBE_PARAMETERS = ['HEIGHT', 'RH', 'TMP']
+
+# Constants of the conversions, which must match build_modtran_input.c
+STANDARD_GRAVITY_IN_M_PER_SEC_SQRD = 9.80665
+EQUATORIAL_RADIUS_IN_KM = 6378137.0 / 1000.0
+POLAR_RADIUS_IN_KM = 6356752.3142 / 1000.0
+MH20 = 18.01534
+MDRY = 28.9644
+
+
+def convert_geopotential_geometric(lat, geo_potential):
+    '''
+    Description:
+        Converts the geopotential height of each layer to the geometric
+        height in kilometers, given the latitude of each grid point, the
+        same as convert_geopotential_geometric in build_modtran_input.c.
+    '''
+
+    inv_r_min_sqrd = 1.0 / (POLAR_RADIUS_IN_KM * POLAR_RADIUS_IN_KM)
+    inv_r_max_sqrd = 1.0 / (EQUATORIAL_RADIUS_IN_KM * EQUATORIAL_RADIUS_IN_KM)
+    inv_std_gravity = 1.0 / STANDARD_GRAVITY_IN_M_PER_SEC_SQRD
+
+    radlat = lat * (np.pi / 180.0)
+    sin_lat = np.sin(radlat)
+    cos_lat = np.cos(radlat)
+    cos_2lat = np.cos(2.0 * radlat)
+
+    radius = 1000.0 * np.sqrt(1.0 / (((cos_lat * cos_lat) * inv_r_max_sqrd) +
+                                     ((sin_lat * sin_lat) * inv_r_min_sqrd)))
+
+    gravity_ratio = ((9.80616 * (1.0 - (0.002637 * cos_2lat) +
+                                 (0.0000059 * (cos_2lat * cos_2lat)))) *
+                     inv_std_gravity)
+
+    return ((geo_potential * radius) /
+            (1000.0 * (gravity_ratio * radius - geo_potential)))
+
+
+def convert_sh_rh(spec_hum, temp_k, layers):
+    '''
+    Description:
+        Converts the specific humidity of each layer to the relative
+        humidity, given the temperature and the pressure of each layer, the
+        same as convert_sh_rh in build_modtran_input.c.
+    '''
+
+    pressure = np.array(layers, dtype=np.float64).reshape((-1, 1))
+
+    # Vapor pressure at the temperature - hPa
+    goff = (-7.90298 * (373.16 / temp_k - 1.0) +
+            5.02808 * np.log10(373.16 / temp_k) -
+            1.3816e-7 * (np.power(10.0, (11.344 * (1.0 - (temp_k / 373.16)))) -
+                         1.0) +
+            8.1328e-3 * (np.power(10.0, (-3.49149 * (373.16 / temp_k - 1.0))) -
+                         1.0) +
+            np.log10(1013.246))
+
+    # Partial pressure
+    ph20 = ((spec_hum * pressure * MDRY) /
+            (MH20 - spec_hum * MH20 + spec_hum * MDRY))
+
+    return (ph20 / np.power(10.0, goff)) * 100.0
+
+
+def write_narr_cube(cube_path, parameters, layers, values):
+    '''
+    Description:
+        Writes a cube holding the values of each parameter at each layer.
+        The file is written under a temporary name and renamed, so a
+        partial cube is never found in the archive.
+    '''
+
+    values = np.ascontiguousarray(values, dtype='<f4')
+    planes = values.reshape((-1, NARR_ROWS, NARR_COLS))
+
+    checksums = []
+    for plane in planes:
+        for row in range(0, NARR_ROWS, NARR_CUBE_CHUNK_ROWS):
+            chunk = plane[row:row + NARR_CUBE_CHUNK_ROWS].tobytes()
+            checksums.append(zlib.crc32(chunk) & 0xffffffff)
+
+    names = b''.join([parm.encode('ascii').ljust(8, b'\0')
+                      for parm in parameters])
+    header = struct.pack(NARR_CUBE_HEADER_FORMAT,
+                         NARR_CUBE_MAGIC.encode('ascii'),
+                         NARR_CUBE_VERSION,
+                         NARR_ROWS, NARR_COLS,
+                         len(parameters), len(layers),
+                         NARR_CUBE_CHUNK_ROWS,
+                         names,
+                         *(list(layers) +
+                           [0] * (NARR_CUBE_MAX_LAYERS - len(layers))))
+
+    temp_path = '.'.join([cube_path, 'tmp'])
+    with open(temp_path, 'wb') as cube_fd:
+        cube_fd.write(header)
+        cube_fd.write(np.array(checksums, dtype='<u4').tobytes())
+        cube_fd.write(values.tobytes())
+
+    os.rename(temp_path, cube_path)
+
+
+class NARRCubeConverter(AuxNARRGribProcessor):
+    '''
+    Description:
+        Converts the archived GRIB data of a 3hr increment into a cube next
+        to it in the archive.
+    '''
+
+    def __init__(self):
+        super(NARRCubeConverter, self).__init__(xml_filename=None)
+
+        environment = Environment()
+        self.lst_data_dir = environment.get_lst_data_directory()
+        self.lat = None
+
+    def read_latitudes(self):
+        '''
+        Description:
+            Reads the latitude of each grid point, in the order of the grid,
+            for deriving the geometric height.
+        '''
+
+        if self.lat is None:
+            coord_path = os.path.join(self.lst_data_dir,
+                                      'narr_coordinates.txt')
+            self.lat = np.loadtxt(coord_path, dtype=np.float64, usecols=(2,))
+
+            if self.lat.size != NARR_ROWS * NARR_COLS:
+                raise Exception('{0} does not contain NARR_ROWS * NARR_COLS'
+                                ' coordinates'.format(coord_path))
+
+        return self.lat
+
+    def needs_conversion(self, date):
+        '''
+        Description:
+            Determines if the cube of a 3hr increment is missing, of an
+            older layout, without the derived parameters, or older than the
+            GRIB data it was converted from.
+        '''
+
+        cube_path = self.archive_cube_path(date)
+        if not os.path.exists(cube_path):
+            return True
+
+        header_size = struct.calcsize(NARR_CUBE_HEADER_FORMAT)
+        with open(cube_path, 'rb') as cube_fd:
+            header = struct.unpack(NARR_CUBE_HEADER_FORMAT,
+                                   cube_fd.read(header_size))
+        if header[1] != NARR_CUBE_VERSION:
+            return True
+
+        # The names of the parameters, after the magic and six counts
+        names = [header[7][index:index + 8].rstrip(b'\0').decode('ascii')
+                 for index in range(0, header[4] * 8, 8)]
+        if names != NARR_CUBE_PARAMETERS:
+            return True
+
+        cube_time = os.path.getmtime(cube_path)
+        for parm in self.parms_to_extract:
+            if os.path.getmtime(self.archive_path(parm, date, 'grb')) > \
+                    cube_time:
+                return True
+
+        return False
+
+    def read_grib_text(self, path):
+        '''
+        Description:
+            Reads the values of a layer as extracted by wgrib.
+        '''
+
+        with open(path, 'r') as text_fd:
+            (cols, rows) = [int(x) for x in text_fd.readline().split()]
+            if rows != NARR_ROWS or cols != NARR_COLS:
+                raise Exception('{0} contains an invalid number of rows and'
+                                ' columns'.format(path))
+
+            values = np.loadtxt(text_fd, dtype=np.float64)
+
+        if values.size != NARR_ROWS * NARR_COLS:
+            raise Exception('{0} does not contain NARR_ROWS * NARR_COLS'
+                            ' values'.format(path))
+
+        return values
+
+    def convert(self, date):
+        '''
+        Description:
+            Extracts the parameters of a 3hr increment with wgrib, derives
+            the geometric height and relative humidity, and writes them to
+            the cube.
+        '''
+
+        values = np.empty((len(self.parms_to_extract), len(NARR_LAYERS),
+                           NARR_ROWS * NARR_COLS), dtype=np.float64)
+
+        temp_dir = tempfile.mkdtemp(prefix='narr_cube_')
+        try:
+            for (parm_index, parm) in enumerate(self.parms_to_extract):
+                hdr_path = self.archive_path(parm, date, 'hdr')
+                grb_path = self.archive_path(parm, date, 'grb')
+
+                output_dir = os.path.join(temp_dir, parm)
+                self.extract_grib_data(hdr_path, grb_path, output_dir)
+
+                for (layer_index, layer) in enumerate(NARR_LAYERS):
+                    path = os.path.join(output_dir,
+                                        '.'.join([str(layer), 'txt']))
+                    values[parm_index, layer_index] = \
+                        self.read_grib_text(path)
+        finally:
+            shutil.rmtree(temp_dir, ignore_errors=True)
+
+        # The undefined points of the grid overflow, as they do when the
+        # parameters are derived for a scene
+        (hgt, spfh, tmp) = values
+        with np.errstate(all='ignore'):
+            height = convert_geopotential_geometric(self.read_latitudes(),
+                                                    hgt)
+            rh = convert_sh_rh(spfh, tmp, NARR_LAYERS)
+
+        cube_path = self.archive_cube_path(date)
+        write_narr_cube(cube_path, NARR_CUBE_PARAMETERS, NARR_LAYERS,
+                        np.array([height, rh, tmp]))
+        self.logger.info('Wrote {0}'.format(cube_path))
+
+    def convert_dates(self, start_date, end_date):
+        '''
+        Description:
+            Converts each 3hr increment from the start date through the end
+            date which is in the archive and not already converted.
+        '''
+
+        date = start_date
+        while date <= end_date:
+            hdr_path = self.archive_path(self.parms_to_extract[0], date,
+                                         'hdr')
+
+            if not os.path.exists(hdr_path):
+                self.logger.warning('No NARR data for {0}'.format(str(date)))
+            elif self.needs_conversion(date):
+                self.convert(date)
+
+            date += timedelta(hours=3)
+
+
+def main():
+    '''
+    Description:
+        Gathers input parameters and converts the archived NARR data.
+    '''
+
+    # Create a command line arugment parser
+    description = ('Converts the archived NARR GRIB data into the binary'
+                   ' cubes used by the LST processing')
+    parser = ArgumentParser(description=description)
+
+    # ---- Add parameters ----
+    parser.add_argument('--start-date',
+                        action='store', dest='start_date',
+                        required=False, default=None,
+                        help='The first date to convert (YYYYMMDD)')
+
+    parser.add_argument('--end-date',
+                        action='store', dest='end_date',
+                        required=False, default=None,
+                        help='The last date to convert (YYYYMMDD), defaults'
+                             ' to the first date')
+
+    parser.add_argument('--debug',
+                        action='store_true', dest='debug',
+                        required=False, default=False,
+                        help='Keep any debugging data')
+
+    parser.add_argument('--version',
+                        action='store_true', dest='version',
+                        required=False, default=False,
+                        help='Reports the version of the software')
+
+    # Parse the command line parameters
+    args = parser.parse_args()
+
+    # Command line arguments are required so print the help if none were
+    # provided
+    if len(sys.argv) == 1:
+        parser.print_help()
+        sys.exit(1)  # EXIT FAILURE
+
+    # Report the version and exit
+    if args.version:
+        print(util.Version.version_text())
+        sys.exit(0)  # EXIT SUCCESS
+
+    # Verify that the --start-date parameter was specified
+    if args.start_date is None:
+        raise Exception('--start-date must be specified on the command line')
+
+    start_date = datetime.strptime(args.start_date, '%Y%m%d')
+    end_date = start_date
+    if args.end_date is not None:
+        end_date = datetime.strptime(args.end_date, '%Y%m%d')
+
+    # Include every 3hr increment of the last date
+    end_date += timedelta(hours=21)
+
+    # Setup the logging level
+    log_level = logging.INFO
+    if args.debug:
+        log_level = logging.DEBUG
+
+    # Setup the default logger format and level.  Log to STDOUT.
+    logging.basicConfig(format=('%(asctime)s.%(msecs)03d %(process)d'
+                                ' %(levelname)-8s'
+                                ' %(filename)s:%(lineno)d:'
+                                '%(funcName)s -- %(message)s'),
+                        datefmt='%Y-%m-%d %H:%M:%S',
+                        level=log_level,
+                        stream=sys.stdout)
+
+    # Get the logger
+    logger = logging.getLogger(__name__)
+
+    try:
+        logger.info('Converting NARR data')
+        converter = NARRCubeConverter()
+        converter.convert_dates(start_date, end_date)
+
+    except Exception:
+        logger.exception('Failed converting NARR data')
+        raise
+
+    logger.info('Completed conversion of NARR data')
+
+
+if __name__ == '__main__':
+    '''
+    Description:
+        Simply call the main routine for stand alone processing.
+    '''
+
+    try:
+        main()
+    except Exception:
+        sys.exit(1)  # EXIT FAILURE
+
+    sys.exit(0)  # EXIT SUCCESS
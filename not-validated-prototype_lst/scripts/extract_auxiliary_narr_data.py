@@ -29,19 +29,25 @@ from lst_environment import Environment
 class AuxNARRGribProcessor(object):
     '''
     Description:
-        Extracts parameters from the auxillary NARR data in grib format and
-        places them into 'parameter' named directories.
+        Provides the parameters from the auxillary NARR data in grib format.
+        The grib files are linked into the working directory, where
+        lst_intermediate_data decodes them, or are extracted with wgrib into
+        'parameter' named directories when dump_text is specified.
     '''
 
-    def __init__(self, xml_filename):
+    def __init__(self, xml_filename, dump_text=False):
         super(AuxNARRGribProcessor, self).__init__()
 
         # Keep local copies of these
         self.xml_filename = xml_filename
+        self.dump_text = dump_text
 
         self.parms_to_extract = ['HGT', 'SPFH', 'TMP']
         self.aux_path_template = '{0:0>4}/{1:0>2}/{2:0>2}'
         self.aux_name_template = 'NARR_3D.{0}.{1:04}{2:02}{3:02}.{4:04}.{5}'
+        self.aux_cube_template = 'NARR_3D.{0:04}{1:02}{2:02}.{3:04}.cube'
+        self.cube_template = 'NARR_{0}.cube'
+        self.grib_template = 'NARR_{0}.{1}.{2}'
 
         self.date_template = '{0:0>4}{1:0>2}{2:0>2}'
 
@@ -134,59 +140,87 @@ class AuxNARRGribProcessor(object):
         self.logger.debug('Date 1 = {0}'.format(str(date_1)))
         self.logger.debug('Date 2 = {0}'.format(str(date_2)))
 
-        for parm in self.parms_to_extract:
-            # Build the source filenames for date 1
-            filename = self.aux_name_template.format(parm,
-                                                     date_1.year,
-                                                     date_1.month,
-                                                     date_1.day,
-                                                     date_1.hour * 100,
-                                                     'hdr')
-
-            aux_path = (self.aux_path_template.format(date_1.year,
-                                                      date_1.month,
-                                                      date_1.day))
-
-            hdr_1_path = self.dir_template.format(aux_path, filename)
+        for (timestep, date) in [(1, date_1), (2, date_2)]:
+            # Use the binary cube of the timestep when one was converted at
+            # ingest, so the GRIB data does not have to be unpacked
+            cube_path = self.archive_cube_path(date)
+            if os.path.exists(cube_path):
+                self.logger.info('Using {0}'.format(cube_path))
+                self.link_file(cube_path,
+                               self.cube_template.format(timestep))
+                continue
+
+            for parm in self.parms_to_extract:
+                hdr_path = self.archive_path(parm, date, 'hdr')
+                grb_path = self.archive_path(parm, date, 'grb')
+
+                self.logger.info('Using {0}'.format(hdr_path))
+                self.logger.info('Using {0}'.format(grb_path))
+
+                # Verify that the files we need exist
+                if (not os.path.exists(hdr_path) or
+                        not os.path.exists(grb_path)):
+                    raise Exception('Required LST AUX files are missing')
+
+                if self.dump_text:
+                    output_dir = '{0}_{1}'.format(parm, timestep)
+                    self.extract_grib_data(hdr_path, grb_path, output_dir)
+                else:
+                    self.link_file(hdr_path, self.grib_template
+                                   .format(timestep, parm, 'hdr'))
+                    self.link_file(grb_path, self.grib_template
+                                   .format(timestep, parm, 'grb'))
+
+    def archive_path(self, parm, date, extension):
+        '''
+        Description:
+            Builds the path of a parameter's file in the archive for the
+            specified 3hr increment.
+        '''
 
-            grb_1_path = hdr_1_path.replace('.hdr', '.grb')
+        filename = self.aux_name_template.format(parm,
+                                                 date.year,
+                                                 date.month,
+                                                 date.day,
+                                                 date.hour * 100,
+                                                 extension)
 
-            self.logger.info('Using {0}'.format(hdr_1_path))
-            self.logger.info('Using {0}'.format(grb_1_path))
+        aux_path = self.aux_path_template.format(date.year,
+                                                 date.month,
+                                                 date.day)
 
-            # Build the source filenames for date 2
-            filename = self.aux_name_template.format(parm,
-                                                     date_2.year,
-                                                     date_2.month,
-                                                     date_2.day,
-                                                     date_2.hour * 100,
-                                                     'hdr')
+        return self.dir_template.format(aux_path, filename)
 
-            aux_path = (self.aux_path_template.format(date_2.year,
-                                                      date_2.month,
-                                                      date_2.day))
+    def archive_cube_path(self, date):
+        '''
+        Description:
+            Builds the path of the binary cube in the archive for the
+            specified 3hr increment.
+        '''
 
-            hdr_2_path = self.dir_template.format(aux_path, filename)
+        filename = self.aux_cube_template.format(date.year,
+                                                 date.month,
+                                                 date.day,
+                                                 date.hour * 100)
 
-            grb_2_path = hdr_2_path.replace('.hdr', '.grb')
+        aux_path = self.aux_path_template.format(date.year,
+                                                 date.month,
+                                                 date.day)
 
-            self.logger.info('Using {0}'.format(hdr_2_path))
-            self.logger.info('Using {0}'.format(grb_2_path))
+        return self.dir_template.format(aux_path, filename)
 
-            # Verify that the files we need exist
-            if (not os.path.exists(hdr_1_path) or
-                    not os.path.exists(hdr_2_path) or
-                    not os.path.exists(grb_1_path) or
-                    not os.path.exists(grb_2_path)):
-                raise Exception('Required LST AUX files are missing')
+    def link_file(self, source_path, link_path):
+        '''
+        Description:
+            Places an archive file where the MODTRAN input generation looks
+            for it.  It is linked rather than copied, since only the parts
+            used are read from it.
+        '''
 
-            # Date 1
-            output_dir = '{0}_1'.format(parm)
-            self.extract_grib_data(hdr_1_path, grb_1_path, output_dir)
+        if os.path.lexists(link_path):
+            os.unlink(link_path)
 
-            # Date 2
-            output_dir = '{0}_2'.format(parm)
-            self.extract_grib_data(hdr_2_path, grb_2_path, output_dir)
+        os.symlink(os.path.abspath(source_path), link_path)
 
 
 def main():
@@ -208,6 +242,12 @@ def main():
                         required=False, default=None,
                         help='The XML metadata file to use')
 
+    parser.add_argument('--dump-text',
+                        action='store_true', dest='dump_text',
+                        required=False, default=False,
+                        help='Extract the parameters to text files with'
+                             ' wgrib')
+
     parser.add_argument('--debug',
                         action='store_true', dest='debug',
                         required=False, default=False,
@@ -259,7 +299,8 @@ def main():
 
     try:
         logger.info('Extracting LST AUX data')
-        current_processor = AuxNARRGribProcessor(args.xml_filename)
+        current_processor = AuxNARRGribProcessor(args.xml_filename,
+                                                 args.dump_text)
         current_processor.extract_aux_data()
 
     except Exception:
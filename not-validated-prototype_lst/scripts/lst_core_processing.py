@@ -26,14 +26,50 @@ import estimate_landsat_emissivity
 import build_lst_data
 
 
+def generate_emissivity(xml_filename, keep_intermediate_data):
+    '''
+    Description:
+        Generates the Estimated Landsat Emissivity band.
+    '''
+
+    # Get the logger
+    logger = logging.getLogger(__name__)
+
+    try:
+        current_processor = (
+            estimate_landsat_emissivity.EstimateLandsatEmissivity(
+                xml_filename, keep_intermediate_data))
+        current_processor.generate_product()
+    except Exception:
+        logger.error('Failed creating Estimated Landsat Emissivity data')
+        raise
+
+
 def generate_lst(xml_filename,
                  only_extract_aux_data=False,
                  keep_lst_temp_data=False,
                  keep_intermediate_data=False,
-                 debug=False):
+                 debug=False,
+                 lst_in_process=False,
+                 roi_map=None,
+                 roi_pixels=None,
+                 compact_intermediate=False):
     '''
     Description:
         Provides the glue code for generating LST products.
+
+        With lst_in_process, the emissivity is estimated first so that
+        lst_intermediate_data can generate the LST band itself, and the
+        intermediate bands are only written when they are being kept.
+
+        With roi_map, "ulx,uly,lrx,lry" in map coordinates, or roi_pixels,
+        "uls,ull,lrs,lrl" in pixel coordinates, only that window of the
+        scene is processed.  The LST band is then always
+        generated in process, since building it from the intermediate data
+        expects the whole scene.
+
+        With compact_intermediate, the intermediate bands are written as
+        scaled 16 bit integers, with the scale factors recorded in the XML.
     '''
 
     # Get the logger
@@ -53,11 +89,30 @@ def generate_lst(xml_filename,
                     ' LST AUX data')
         return
 
+    use_roi = roi_map is not None or roi_pixels is not None
+    if use_roi and not lst_in_process:
+        logger.info('Generating the LST in process for the region of'
+                    ' interest')
+        lst_in_process = True
+
+    if lst_in_process:
+        generate_emissivity(xml_filename, keep_intermediate_data)
+
     # Generate the thermal, upwelled, and downwelled radiance bands as well as
     # the atmospheric transmittance band
     cmd = ['lst_intermediate_data',
            '--xml', xml_filename,
            '--verbose']
+    if lst_in_process:
+        cmd.append('--lst')
+        if keep_lst_temp_data:
+            cmd.append('--write-intermediate')
+    if roi_map is not None:
+        cmd.append('--roi-map={0}'.format(roi_map))
+    if roi_pixels is not None:
+        cmd.append('--roi-pixels={0}'.format(roi_pixels))
+    if compact_intermediate:
+        cmd.append('--compact-intermediate')
     if debug:
         cmd.append('--debug')
 
@@ -73,23 +128,16 @@ def generate_lst(xml_filename,
         if len(output) > 0:
             logger.info(output)
 
-    # Generate Estimated Landsat Emissivity band
-    try:
-        current_processor = (
-            estimate_landsat_emissivity.EstimateLandsatEmissivity(
-                xml_filename, keep_intermediate_data))
-        current_processor.generate_product()
-    except Exception:
-        logger.error('Failed creating Estimated Landsat Emissivity data')
-        raise
+    if not lst_in_process:
+        generate_emissivity(xml_filename, keep_intermediate_data)
 
-    # Generate Land Surface Temperature band
-    try:
-        current_processor = build_lst_data.BuildLSTData(xml_filename)
-        current_processor.generate_data()
-    except Exception:
-        logger.error('Failed processing Land Surface Temperature')
-        raise
+        # Generate Land Surface Temperature band
+        try:
+            current_processor = build_lst_data.BuildLSTData(xml_filename)
+            current_processor.generate_data()
+        except Exception:
+            logger.error('Failed processing Land Surface Temperature')
+            raise
 
     # Cleanup
     if not keep_intermediate_data:
@@ -102,6 +150,18 @@ def generate_lst(xml_filename,
         shutil.rmtree('TMP_1', ignore_errors=True)
         shutil.rmtree('TMP_2', ignore_errors=True)
 
+        # Remove the links to the binary NARR cubes and GRIB data
+        link_names = ['NARR_1.cube', 'NARR_2.cube']
+        for timestep in [1, 2]:
+            for parm in ['HGT', 'SPFH', 'TMP']:
+                for extension in ['hdr', 'grb']:
+                    link_names.append('NARR_{0}.{1}.{2}'
+                                      .format(timestep, parm, extension))
+
+        for link_name in link_names:
+            if os.path.lexists(link_name):
+                os.unlink(link_name)
+
         # Remove the point directories generated during the core processing
         remove_dirs = set()
         point_filename = 'point_list.txt'
@@ -154,6 +214,35 @@ if __name__ == '__main__':
                         required=False, default=False,
                         help='Keep any intermediate data generated')
 
+    parser.add_argument('--lst-in-process',
+                        action='store_true', dest='lst_in_process',
+                        required=False, default=False,
+                        help=('Generate the LST band within'
+                              ' lst_intermediate_data instead of from the'
+                              ' intermediate data'))
+
+    roi_group = parser.add_mutually_exclusive_group()
+
+    roi_group.add_argument('--roi-map',
+                           action='store', dest='roi_map',
+                           required=False, default=None,
+                           help=('Only process the region of interest'
+                                 ' "ulx,uly,lrx,lry", given in map'
+                                 ' coordinates'))
+
+    roi_group.add_argument('--roi-pixels',
+                           action='store', dest='roi_pixels',
+                           required=False, default=None,
+                           help=('Only process the region of interest'
+                                 ' "uls,ull,lrs,lrl", given in pixel'
+                                 ' coordinates'))
+
+    parser.add_argument('--compact-intermediate',
+                        action='store_true', dest='compact_intermediate',
+                        required=False, default=False,
+                        help=('Write the intermediate bands as scaled 16 bit'
+                              ' integers instead of floats'))
+
     parser.add_argument('--debug',
                         action='store_true', dest='debug',
                         required=False, default=False,
@@ -212,7 +301,11 @@ if __name__ == '__main__':
                      args.only_extract_aux_data,
                      args.keep_lst_temp_data,
                      args.keep_intermediate_data,
-                     args.debug)
+                     args.debug,
+                     args.lst_in_process,
+                     args.roi_map,
+                     args.roi_pixels,
+                     args.compact_intermediate)
 
     except Exception:
         logger.exception('Error processing LST.  Processing will terminate.')
@@ -21,6 +21,8 @@ import sys
 import shutil
 import glob
 import filecmp
+import tempfile
+import subprocess
 import unittest
 
 # Add the parent directory where the modules to test are located
@@ -79,7 +81,8 @@ class AuxNARRGribProcessor_TestCase(LSRD_ValidationFramework):
                                       'LT50420342011119PAC01.xml')
 
         # Specify the XML metadata file defining the data to process
-        self.processor = AuxNARRGribProcessor(self.input_xml)
+        self.processor = AuxNARRGribProcessor(self.input_xml,
+                                              dump_text=True)
 
         # Process the associated AUX data
         self.processor.extract_aux_data()
@@ -119,6 +122,75 @@ class AuxNARRGribProcessor_TestCase(LSRD_ValidationFramework):
                 self.assertFilesEqual(validation_file, local_file)
 
 
+class GeoTIFF_Georeference_TestCase(LSRD_ValidationFramework):
+    '''Tests the GeoTIFF bands are located the same as the ENVI bands.'''
+
+    def __init__(self, *args, **kwargs):
+        self.name = 'GeoTIFF_Georeference_TestCase'
+        super(GeoTIFF_Georeference_TestCase, self).__init__(*args, **kwargs)
+
+        # Validation data is presummed to be available if the directory exists
+        self.validation_path = os.path.join(self.lsrd_validation_dir,
+                                            self.name)
+        if not os.path.isdir(self.validation_path):
+            raise Exception('Missing validation data for [{0}]'
+                            .format(self.name))
+
+        # The intermediate bands produced in each format
+        self.bands = ['lst_thermal_radiance',
+                      'lst_upwelled_radiance',
+                      'lst_downwelled_radiance',
+                      'lst_atmospheric_transmittance']
+
+    def setUp(self):
+        '''setup'''
+
+        # The scene is processed in a copy for each format, since the
+        # bands are appended to its XML
+        self.work_dir = tempfile.mkdtemp()
+        self.envi_dir = os.path.join(self.work_dir, 'envi')
+        self.geotiff_dir = os.path.join(self.work_dir, 'geotiff')
+        shutil.copytree(self.validation_path, self.envi_dir)
+        shutil.copytree(self.validation_path, self.geotiff_dir)
+
+        self.input_xml = os.path.basename(
+            glob.glob(os.path.join(self.validation_path, '*.xml'))[0])
+
+        subprocess.check_call(['lst_intermediate_data',
+                               '--xml', self.input_xml],
+                              cwd=self.envi_dir)
+        subprocess.check_call(['lst_intermediate_data',
+                               '--xml', self.input_xml, '--geotiff'],
+                              cwd=self.geotiff_dir)
+
+    def tearDown(self):
+        '''Cleanup'''
+
+        shutil.rmtree(self.work_dir)
+
+    def test_corner_coordinates(self):
+        '''Test the corners of the GeoTIFF and ENVI bands agree.'''
+
+        from osgeo import gdal
+
+        product_id = os.path.splitext(self.input_xml)[0]
+
+        for band in self.bands:
+            envi_file = os.path.join(self.envi_dir, '{0}_{1}.img'
+                                     .format(product_id, band))
+            geotiff_file = os.path.join(self.geotiff_dir, '{0}_{1}.tif'
+                                        .format(product_id, band))
+
+            # GDAL applies the reference pixel of the ENVI map info, and the
+            # raster type of the GeoTIFF, so both give the outer corner
+            envi_transform = gdal.Open(envi_file).GetGeoTransform()
+            geotiff_transform = gdal.Open(geotiff_file).GetGeoTransform()
+
+            for (envi_value, geotiff_value) in zip(envi_transform,
+                                                   geotiff_transform):
+                self.assertAlmostEqual(envi_value, geotiff_value, places=6)
+
+
 class Environment_TestCase(LSRD_ValidationFramework):
     '''Tests Environment Class'''
 
@@ -22,9 +22,9 @@ typedef struct ias_2d_array
     unsigned int signature; /* Signature used to make sure the pointer
                                math from a row_array_ptr actually gets back to
                                the expected structure (helps detect errors). */
-    int rows;               /* Rows in the 2D array */
-    int columns;            /* Columns in the 2D array */
-    int member_size;        /* Size of each entry in the array */
+    size_t rows;            /* Rows in the 2D array */
+    size_t columns;         /* Columns in the 2D array */
+    size_t member_size;     /* Size of each entry in the array */
     void *data_ptr;         /* Pointer to the data storage for the array */
     void **row_array_ptr;   /* Pointer to an array of pointers to each row in
                                the 2D array */
@@ -62,15 +62,15 @@ typedef struct ias_2d_array
 **************************************************************************/
 void **allocate_2d_array
 (
-    int rows,          /* I: Number of rows for the 2D array */
-    int columns,       /* I: Number of columns for the 2D array */
+    size_t rows,       /* I: Number of rows for the 2D array */
+    size_t columns,    /* I: Number of columns for the 2D array */
     size_t member_size /* I: Size of the 2D array element */
 )
 {
-    int row;
+    size_t row;
     IAS_2D_ARRAY *array;
     size_t size;
-    int data_start_index;
+    size_t data_start_index;
 
     /* Calculate the size needed for the array memory. The size includes the
        size of the base structure, an array of pointers to the rows in the
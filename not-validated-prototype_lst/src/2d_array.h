@@ -14,8 +14,8 @@
 
 void **allocate_2d_array
 (
-    int rows,          /* I: Number of rows for the 2D array */
-    int columns,       /* I: Number of columns for the 2D array */
+    size_t rows,       /* I: Number of rows for the 2D array */
+    size_t columns,    /* I: Number of columns for the 2D array */
     size_t member_size /* I: Size of the 2D array element */
 );
 
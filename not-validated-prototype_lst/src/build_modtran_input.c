@@ -5,6 +5,7 @@
 #include <math.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 
 
 #include "const.h"
@@ -13,6 +14,10 @@
 #include "input.h"
 #include "lst_types.h"
 #include "build_points.h"
+#include "build_modtran_input.h"
+#include "narr_cube.h"
+#include "narr_cache.h"
+#include "grib1.h"
 
 
 #define STANRDARD_GRAVITY_IN_M_PER_SEC_SQRD 9.80665
@@ -20,7 +25,6 @@
 #define POLAR_RADIUS_IN_KM (UTM_POLAR_RADIUS / 1000.0)
 
 
-#define P_LAYER 29
 #define STANDARD_LAYERS 30
 #define MAX_MODTRAN_LAYER 150
 
@@ -31,6 +35,8 @@ MODULE:  convert_geopotential_geometric
 PURPOSE: Convert array of geopotential heights to array of geometric heights
          given latitude
 
+NOTE: The geometric heights may be written over the geopotential heights.
+
 RETURN: SUCCESS
         FAILURE
 
@@ -138,8 +144,10 @@ int convert_geopotential_geometric
 /*****************************************************************************
 MODULE:  convert_sh_rh
 
-PURPOSE: Given array of specific humidities, temperature, and pressure,
-         generate array of relative humidities
+PURPOSE: Given array of specific humidities, temperature, and the pressure of
+         each layer, generate array of relative humidities
+
+NOTE: The relative humidity may be written over the specific humidity.
 
 RETURN: SUCCESS
         FAILURE
@@ -152,80 +160,51 @@ Date        Programmer       Reason
 int convert_sh_rh
 (
     int num_points,   /* I: number of points */
-    double *lat,       /* I: latitude in degrees */
     double **spec_hum,
     double **temp_k,
-    double **pressure,
+    int *layers,       /* I: pressure of each layer in millibars */
     double **rh        /* O: relative humidity */
 )
 {
-    char FUNC_NAME[] = "convert_sh_rh";
     int layer;
     int point;
     double mh20 = 18.01534;
     double mdry = 28.9644;
 
-    double **goff;
-    double **ph20;
-
-    /* Allocate memory */
-    goff = (double **) allocate_2d_array (P_LAYER, num_points, sizeof (double));
-    if (goff == NULL)
-    {
-        RETURN_ERROR ("Allocating goff memory", FUNC_NAME, FAILURE);
-    }
-
-    ph20 = (double **) allocate_2d_array (P_LAYER, num_points, sizeof (double));
-    if (ph20 == NULL)
-    {
-        RETURN_ERROR ("Allocating  memory", FUNC_NAME, FAILURE);
-    }
+    double goff;
+    double ph20;
+    double pressure;
 
     for (layer = 0; layer < P_LAYER; layer++)
     {
+        pressure = layers[layer];
+
         for (point = 0; point < num_points; point++)
         {
             /* calculate vapor pressure at given temperature - hpa */
-            goff[layer][point] = -7.90298 * (373.16 / temp_k[layer][point]
-                                             - 1.0)
-                                 + 5.02808 * log10 (373.16
-                                                    / temp_k[layer][point])
-                                 - 1.3816e-7
-                                 * (pow (10.0, (11.344
-                                                * (1.0 - (temp_k[layer][point]
-                                                          / 373.16))))
-                                    - 1.0)
-                                 + 8.1328e-3
-                                 * (pow (10.0, (-3.49149
-                                               * (373.16 / temp_k[layer][point]
-                                                  - 1.0)))
-                                        - 1.0)
-                                 + log10 (1013.246); /* hPa */
+            goff = -7.90298 * (373.16 / temp_k[layer][point] - 1.0)
+                   + 5.02808 * log10 (373.16 / temp_k[layer][point])
+                   - 1.3816e-7
+                   * (pow (10.0, (11.344 * (1.0 - (temp_k[layer][point]
+                                                   / 373.16))))
+                      - 1.0)
+                   + 8.1328e-3
+                   * (pow (10.0, (-3.49149 * (373.16 / temp_k[layer][point]
+                                              - 1.0)))
+                      - 1.0)
+                   + log10 (1013.246); /* hPa */
 
             /* calculate partial pressure */
-            ph20[layer][point] = (spec_hum[layer][point]
-                                  * pressure[layer][point] * mdry)
-                                 / (mh20
-                                    - spec_hum[layer][point] * mh20
-                                    + spec_hum[layer][point] * mdry);
+            ph20 = (spec_hum[layer][point] * pressure * mdry)
+                   / (mh20
+                      - spec_hum[layer][point] * mh20
+                      + spec_hum[layer][point] * mdry);
 
             /* calculate relative humidity */
-            rh[layer][point] = (ph20[layer][point]
-                                / pow (10.0, goff[layer][point])) * 100.0;
+            rh[layer][point] = (ph20 / pow (10.0, goff)) * 100.0;
         }
     }
 
-    /* Free allocated memory */
-    if (free_2d_array ((void **) goff) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: goff\n", FUNC_NAME, FAILURE);
-    }
-
-    if (free_2d_array ((void **) ph20) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: ph20\n", FUNC_NAME, FAILURE);
-    }
-
     return SUCCESS;
 }
 
@@ -294,7 +273,8 @@ int read_std_mid_lat_summer_atmos
 /******************************************************************************
 MODULE:  read_narr_parameter_values
 
-PURPOSE: Reads the NARR parameter values into memory
+PURPOSE: Reads the NARR parameter values within the rows and columns of the
+         coordinate points into memory
 
 RETURN: SUCCESS
         FAILURE
@@ -303,6 +283,7 @@ int read_narr_parameter_values
 (
     int *layers,
     char *parameter,
+    REANALYSIS_POINTS *points, /* I: the coordinate points */
     double **output_2d_array
 )
 {
@@ -310,10 +291,12 @@ int read_narr_parameter_values
     char msg_str[MAX_STR_LEN];
     char parm_filename[PATH_MAX];
     int layer;
-    int point;
+    int row;
+    int col;
     int count;
     int file_rows;
     int file_cols;
+    double value;
     FILE *fd = NULL;
 
     /* Read each layers parameter file into memory */
@@ -353,14 +336,27 @@ int read_narr_parameter_values
                           " columns", FUNC_NAME, FAILURE);
         }
 
-        /* Read the values into memory */
-        for (point = 0; point < NARR_ROWS * NARR_COLS; point++)
+        /* Read the values up to the last row of the points, keeping the
+           ones within their columns */
+        for (row = 0; row <= points->max_row; row++)
         {
-            if (fscanf (fd, "%lf", &output_2d_array[layer][point]) == EOF)
+            for (col = 0; col < NARR_COLS; col++)
             {
-                RETURN_ERROR ("End of file (EOF) is met before "
-                              "NARR_ROWS * NARR_COLS lines",
-                               FUNC_NAME, FAILURE);
+                if (fscanf (fd, "%lf", &value) == EOF)
+                {
+                    RETURN_ERROR ("End of file (EOF) is met before "
+                                  "NARR_ROWS * NARR_COLS lines",
+                                   FUNC_NAME, FAILURE);
+                }
+
+                if (row >= points->min_row
+                    && col >= points->min_col && col <= points->max_col)
+                {
+                    output_2d_array[layer][(row - points->min_row)
+                                           * points->num_cols
+                                           + (col - points->min_col)] =
+                        value;
+                }
             }
         }
 
@@ -377,6 +373,330 @@ int read_narr_parameter_values
 }
 
 
+/******************************************************************************
+MODULE:  read_narr_grib_records
+
+PURPOSE: Decodes the records of the NARR parameters of one timestep, within
+         a window of the grid, from the GRIB files linked as
+         NARR_<timestep>.<parameter>.grb.  The records are located
+         with the wgrib inventories linked next to them, and are decoded in
+         parallel.
+
+RETURN: SUCCESS
+        FAILURE
+******************************************************************************/
+int read_narr_grib_records
+(
+    int *layers,        /* I: pressure of each layer in millibars */
+    int timestep,       /* I: 1 before the acquisition, 2 after */
+    int min_row,        /* I: first row of the window */
+    int max_row,        /* I: last row of the window */
+    int min_col,        /* I: first column of the window */
+    int max_col,        /* I: last column of the window */
+    char **parameters,  /* I: name of each parameter */
+    double ***outputs   /* O: values of each parameter at each layer */
+)
+{
+    char FUNC_NAME[] = "read_narr_grib_records";
+    char msg_str[MAX_STR_LEN];
+    char filename[PATH_MAX];
+    int parm;
+    int layer;
+    int record;
+    int fds[NARR_PARAMETERS];
+    off_t offsets[NARR_PARAMETERS][P_LAYER];
+    bool abort_records = false;
+
+    for (parm = 0; parm < NARR_PARAMETERS; parm++)
+    {
+        snprintf (filename, sizeof (filename), "NARR_%d.%s.hdr", timestep,
+                  parameters[parm]);
+        if (read_grib1_inventory (filename, P_LAYER, layers, offsets[parm])
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Failed locating the NARR records", FUNC_NAME,
+                          FAILURE);
+        }
+
+        snprintf (filename, sizeof (filename), "NARR_%d.%s.grb", timestep,
+                  parameters[parm]);
+        fds[parm] = open (filename, O_RDONLY);
+        if (fds[parm] < 0)
+        {
+            snprintf (msg_str, sizeof (msg_str), "Opening %s", filename);
+            RETURN_ERROR (msg_str, FUNC_NAME, FAILURE);
+        }
+    }
+
+    /* The records are independent of each other, so they are distributed
+       across the threads */
+#ifdef _OPENMP
+    #pragma omp parallel for private(parm, layer) shared(abort_records) \
+                             schedule(dynamic)
+#endif
+    for (record = 0; record < NARR_PARAMETERS * P_LAYER; record++)
+    {
+#ifdef _OPENMP
+        #pragma omp flush (abort_records)
+#endif
+        if (abort_records)
+            continue;
+
+        parm = record / P_LAYER;
+        layer = record % P_LAYER;
+        if (decode_grib1_window (fds[parm], offsets[parm][layer],
+                                 min_row, max_row, min_col, max_col,
+                                 outputs[parm][layer]) != SUCCESS)
+        {
+            abort_records = true;
+#ifdef _OPENMP
+            #pragma omp flush (abort_records)
+#endif
+        }
+    }
+
+    for (parm = 0; parm < NARR_PARAMETERS; parm++)
+        close (fds[parm]);
+
+    if (abort_records)
+    {
+        RETURN_ERROR ("Failed decoding the NARR records", FUNC_NAME,
+                      FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE:  read_narr_cube_timestep
+
+PURPOSE: Reads the parameters of one timestep from a cube, within the rows
+         and columns of the coordinate points.  Only the rows of the points
+         are read.
+
+RETURN: SUCCESS
+        FAILURE
+******************************************************************************/
+int read_narr_cube_timestep
+(
+    NARR_CUBE *cube,    /* I: the mapped cube */
+    int *layers,        /* I: pressure of each layer in millibars */
+    REANALYSIS_POINTS *points, /* I: the coordinate points */
+    char **parameters,  /* I: name of each parameter */
+    double ***outputs   /* O: values of each parameter at each layer */
+)
+{
+    char FUNC_NAME[] = "read_narr_cube_timestep";
+    char msg_str[MAX_STR_LEN];
+    int parm;
+    int layer;
+
+    for (parm = 0; parm < NARR_PARAMETERS; parm++)
+    {
+        for (layer = 0; layer < P_LAYER; layer++)
+        {
+            if (read_narr_cube_window (cube, parameters[parm],
+                                       layers[layer],
+                                       points->min_row, points->max_row,
+                                       points->min_col, points->max_col,
+                                       outputs[parm][layer]) != SUCCESS)
+            {
+                snprintf (msg_str, sizeof (msg_str),
+                          "Failed reading %s at %d millibars from %s",
+                          parameters[parm], layers[layer], cube->filename);
+                RETURN_ERROR (msg_str, FUNC_NAME, FAILURE);
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE:  read_narr_timestep
+
+PURPOSE: Reads the NARR geometric height, relative humidity, and temperature
+         of one timestep, within the rows and columns of the coordinate
+         points, into memory.  They come from the NARR_<timestep>.cube
+         binary cube when the auxiliary data provided one, otherwise from
+         the GRIB files when they were linked, and otherwise from the text
+         files of the <parameter>_<timestep> directories.  The GRIB data is
+         decoded into the node's cache, and the cube there used, when
+         LST_NARR_CACHE_DIR is set.
+
+         The cubes hold the geometric height and relative humidity derived
+         when they were written, so they are only read.  Otherwise they are
+         derived here from the geopotential height and specific humidity.
+
+RETURN: SUCCESS
+        FAILURE
+******************************************************************************/
+int read_narr_timestep
+(
+    int *layers,        /* I: pressure of each layer in millibars */
+    int timestep,       /* I: 1 before the acquisition, 2 after */
+    REANALYSIS_POINTS *points, /* I: the coordinate points */
+    double **height,    /* O: geometric height of each layer */
+    double **rh,        /* O: relative humidity of each layer */
+    double **tmp        /* O: temperature of each layer */
+)
+{
+    char FUNC_NAME[] = "read_narr_timestep";
+    char msg_str[MAX_STR_LEN];
+    char cube_filename[PATH_MAX];
+    char grb_filename[PATH_MAX];
+    char parm_dir[PATH_MAX];
+    char *cache_dir;
+    char *parameters[NARR_PARAMETERS] = { "HGT", "SPFH", "TMP" };
+    char *derived_parameters[NARR_PARAMETERS] = { NARR_HEIGHT_PARAMETER,
+                                                  NARR_RH_PARAMETER, "TMP" };
+    double **derived_outputs[NARR_PARAMETERS];
+    double **outputs[NARR_PARAMETERS];
+    double **hgt;
+    double **spfh;
+    int parm;
+    int status;
+    bool have_cube = false;
+    NARR_CUBE cube;
+
+    derived_outputs[0] = height;
+    derived_outputs[1] = rh;
+    derived_outputs[2] = tmp;
+
+    snprintf (cube_filename, sizeof (cube_filename), "NARR_%d.cube",
+              timestep);
+    snprintf (grb_filename, sizeof (grb_filename), "NARR_%d.%s.grb",
+              timestep, parameters[0]);
+
+    cache_dir = getenv ("LST_NARR_CACHE_DIR");
+
+    if (access (cube_filename, F_OK) == 0)
+    {
+        if (open_narr_cube (cube_filename, &cube) != SUCCESS)
+        {
+            RETURN_ERROR ("Failed opening the NARR cube", FUNC_NAME,
+                          FAILURE);
+        }
+        have_cube = true;
+    }
+    else if (access (grb_filename, F_OK) == 0 && cache_dir != NULL)
+    {
+        /* Share the decoded GRIB data with the other processes */
+        if (open_cached_narr_timestep (cache_dir, layers, timestep,
+                                       parameters, &cube) != SUCCESS)
+        {
+            RETURN_ERROR ("Failed opening the cached NARR timestep",
+                          FUNC_NAME, FAILURE);
+        }
+        have_cube = true;
+    }
+
+    if (have_cube && narr_cube_holds (&cube, NARR_HEIGHT_PARAMETER)
+        && narr_cube_holds (&cube, NARR_RH_PARAMETER))
+    {
+        status = read_narr_cube_timestep (&cube, layers, points,
+                                          derived_parameters,
+                                          derived_outputs);
+        close_narr_cube (&cube);
+        if (status != SUCCESS)
+        {
+            RETURN_ERROR ("Failed reading the NARR cube", FUNC_NAME,
+                          FAILURE);
+        }
+
+        return SUCCESS;
+    }
+
+    /* Read the parameters the derived ones are determined from */
+    hgt = (double **) allocate_2d_array (P_LAYER, points->num_points,
+                                         sizeof (double));
+    if (hgt == NULL)
+    {
+        RETURN_ERROR ("Allocating hgt memory", FUNC_NAME, FAILURE);
+    }
+
+    spfh = (double **) allocate_2d_array (P_LAYER, points->num_points,
+                                          sizeof (double));
+    if (spfh == NULL)
+    {
+        RETURN_ERROR ("Allocating spfh memory", FUNC_NAME, FAILURE);
+    }
+
+    outputs[0] = hgt;
+    outputs[1] = spfh;
+    outputs[2] = tmp;
+
+    if (have_cube)
+    {
+        /* A cube written before the derived parameters were added */
+        status = read_narr_cube_timestep (&cube, layers, points, parameters,
+                                          outputs);
+        close_narr_cube (&cube);
+        if (status != SUCCESS)
+        {
+            RETURN_ERROR ("Failed reading the NARR cube", FUNC_NAME,
+                          FAILURE);
+        }
+    }
+    else if (access (grb_filename, F_OK) == 0)
+    {
+        /* Decode the records directly from the GRIB data */
+        if (read_narr_grib_records (layers, timestep,
+                                    points->min_row, points->max_row,
+                                    points->min_col, points->max_col,
+                                    parameters, outputs) != SUCCESS)
+        {
+            RETURN_ERROR ("Failed decoding the NARR GRIB data", FUNC_NAME,
+                          FAILURE);
+        }
+    }
+    else
+    {
+        /* Parse the text files extracted from the GRIB data */
+        for (parm = 0; parm < NARR_PARAMETERS; parm++)
+        {
+            snprintf (parm_dir, sizeof (parm_dir), "%s_%d",
+                      parameters[parm], timestep);
+            if (read_narr_parameter_values (layers, parm_dir, points,
+                                            outputs[parm]) != SUCCESS)
+            {
+                snprintf (msg_str, sizeof (msg_str),
+                          "Failed loading %s parameters", parm_dir);
+                RETURN_ERROR (msg_str, FUNC_NAME, FAILURE);
+            }
+        }
+    }
+
+    /* convert grib data to variables to be input to MODTRAN */
+    if (convert_geopotential_geometric (points->num_points, points->lat,
+                                        hgt, height) != SUCCESS)
+    {
+        RETURN_ERROR ("Calling convert_geopotential_geometric", FUNC_NAME,
+                      FAILURE);
+    }
+
+    if (convert_sh_rh (points->num_points, spfh, tmp, layers, rh)
+        != SUCCESS)
+    {
+        RETURN_ERROR ("Calling convert_sh_rh", FUNC_NAME, FAILURE);
+    }
+
+    if (free_2d_array ((void **) hgt) != SUCCESS)
+    {
+        RETURN_ERROR ("Freeing memory: hgt\n", FUNC_NAME, FAILURE);
+    }
+
+    if (free_2d_array ((void **) spfh) != SUCCESS)
+    {
+        RETURN_ERROR ("Freeing memory: spfh\n", FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
 /******************************************************************************
 MODULE:  build_modtran_input
 
@@ -402,17 +722,7 @@ int build_modtran_input
 {
     char FUNC_NAME[] = "build_modtran_input";
 
-    double **hgt1;
-    double **spfh1;
-    double **tmp1;
-    double **hgt2;
-    double **spfh2;
-    double **tmp2;
-    double **narr_hgt1;
-    double **narr_spfh1;
     double **narr_tmp1;
-    double **narr_hgt2;
-    double **narr_spfh2;
     double **narr_tmp2;
     double **narr_height;
     double **narr_height1;
@@ -421,10 +731,9 @@ int build_modtran_input
     double **narr_rh1;
     double **narr_rh2;
     double **narr_tmp;
-    int row;
-    int col;
     int layer;
     int point;
+    int index;
     int elevation;
     int temperature;
     int layers[P_LAYER] = { 1000, 975, 950, 925, 900,
@@ -481,11 +790,6 @@ int build_modtran_input
 
 
     /* Use local variables for cleaner code */
-    int min_row = points->min_row;
-    int max_row = points->max_row;
-    int min_col = points->min_col;
-    int max_col = points->max_col;
-    int num_cols = points->num_cols;
     int num_points = points->num_points;
 
     /* Grab the environment path to the LST_DATA_DIR */
@@ -498,115 +802,32 @@ int build_modtran_input
 
     /* ==================================================================== */
 
-    /* Dynamic allocate the 2d memory for time before Landsat Acq. */
-    hgt1 = (double **) allocate_2d_array (P_LAYER, NARR_ROWS * NARR_COLS,
-                                         sizeof (double));
-    if (hgt1 == NULL)
-    {
-        RETURN_ERROR ("Allocating HGT_1 memory", FUNC_NAME, FAILURE);
-    }
-
-    spfh1 = (double **) allocate_2d_array (P_LAYER, NARR_ROWS * NARR_COLS,
-                                          sizeof (double));
-    if (spfh1 == NULL)
-    {
-        RETURN_ERROR ("Allocating SPFH_1 memory", FUNC_NAME, FAILURE);
-    }
-
-    tmp1 = (double **) allocate_2d_array (P_LAYER, NARR_ROWS * NARR_COLS,
-                                         sizeof (double));
-    if (tmp1 == NULL)
-    {
-        RETURN_ERROR ("Allocating TMP_1 memory", FUNC_NAME, FAILURE);
-    }
-
-    /* Dynamic allocate the 2d memory for time after Landsat Acq. */
-    hgt2 = (double **) allocate_2d_array (P_LAYER, NARR_ROWS * NARR_COLS,
-                                         sizeof (double));
-    if (hgt2 == NULL)
-    {
-        RETURN_ERROR ("Allocating HGT_2 memory", FUNC_NAME, FAILURE);
-    }
-
-    spfh2 = (double **) allocate_2d_array (P_LAYER, NARR_ROWS * NARR_COLS,
-                                          sizeof (double));
-    if (spfh2 == NULL)
-    {
-        RETURN_ERROR ("Allocating SPFH_2 memory", FUNC_NAME, FAILURE);
-    }
-
-    tmp2 = (double **) allocate_2d_array (P_LAYER, NARR_ROWS * NARR_COLS,
-                                         sizeof (double));
-    if (tmp2 == NULL)
-    {
-        RETURN_ERROR ("Allocating TMP_2 memory", FUNC_NAME, FAILURE);
-    }
-
-    /* Read in NARR height for time before Landsat acqusition */
-    if (read_narr_parameter_values (layers, "HGT_1", hgt1) != SUCCESS)
-    {
-        RETURN_ERROR ("Failed loading HGT_1 parameters", FUNC_NAME, FAILURE);
-    }
-
-    /* Read in NARR specific humidity for time before Landsat acqusition */
-    if (read_narr_parameter_values (layers, "SPFH_1", spfh1) != SUCCESS)
-    {
-        RETURN_ERROR ("Failed loading SPFH_1 parameters", FUNC_NAME, FAILURE);
-    }
-
-    /* Read in NARR temperature for time before Landsat acqusition */
-    if (read_narr_parameter_values (layers, "TMP_1", tmp1) != SUCCESS)
-    {
-        RETURN_ERROR ("Failed loading TMP_1 parameters", FUNC_NAME, FAILURE);
-    }
-
-    /* Read in NARR height for time after Landsat acqusition */
-    if (read_narr_parameter_values (layers, "HGT_2", hgt2) != SUCCESS)
-    {
-        RETURN_ERROR ("Failed loading HGT_2 parameters", FUNC_NAME, FAILURE);
-    }
-
-    /* Read in NARR specific humidity for time after Landsat acqusition */
-    if (read_narr_parameter_values (layers, "SPFH_2", spfh2) != SUCCESS)
-    {
-        RETURN_ERROR ("Failed loading SPFH_2 parameters", FUNC_NAME, FAILURE);
-    }
-
-    /* Read in NARR temperature for time after Landsat acqusition */
-    if (read_narr_parameter_values (layers, "TMP_2", tmp2) != SUCCESS)
-    {
-        RETURN_ERROR ("Failed loading TMP_2 parameters", FUNC_NAME, FAILURE);
-    }
-
-    /* ==================================================================== */
-
-    narr_hgt1 = (double **) allocate_2d_array (P_LAYER, num_points,
-                                              sizeof (double));
-    if (narr_hgt1 == NULL)
+    narr_height1 = (double **) allocate_2d_array (P_LAYER, num_points,
+                                                 sizeof (double));
+    if (narr_height1 == NULL)
     {
-        RETURN_ERROR ("Allocating narr_hgt1 memory", FUNC_NAME, FAILURE);
+        RETURN_ERROR ("Allocating narr_height1 memory", FUNC_NAME, FAILURE);
     }
 
-    narr_hgt2 = (double **) allocate_2d_array (P_LAYER, num_points,
-                                              sizeof (double));
-    if (narr_hgt2 == NULL)
+    narr_height2 = (double **) allocate_2d_array (P_LAYER, num_points,
+                                                 sizeof (double));
+    if (narr_height2 == NULL)
     {
-        RETURN_ERROR ("Allocating narr_hgt2 memory", FUNC_NAME, FAILURE);
+        RETURN_ERROR ("Allocating narr_height2 memory", FUNC_NAME, FAILURE);
     }
 
-    /* Allocate memory for humidity of NARR points within the rectangular */
-    narr_spfh1 = (double **) allocate_2d_array (P_LAYER, num_points,
-                                               sizeof (double));
-    if (narr_spfh1 == NULL)
+    narr_rh1 = (double **) allocate_2d_array (P_LAYER, num_points,
+                                             sizeof (double));
+    if (narr_rh1 == NULL)
     {
-        RETURN_ERROR ("Allocating narr_spfh1 memory", FUNC_NAME, FAILURE);
+        RETURN_ERROR ("Allocating narr_rh1 memory", FUNC_NAME, FAILURE);
     }
 
-    narr_spfh2 = (double **) allocate_2d_array (P_LAYER, num_points,
-                                               sizeof (double));
-    if (narr_spfh2 == NULL)
+    narr_rh2 = (double **) allocate_2d_array (P_LAYER, num_points,
+                                             sizeof (double));
+    if (narr_rh2 == NULL)
     {
-        RETURN_ERROR ("Allocating narr_spfh2 memory", FUNC_NAME, FAILURE);
+        RETURN_ERROR ("Allocating narr_rh2 memory", FUNC_NAME, FAILURE);
     }
 
     /* Allocate memory for temperature of NARR points within the rectangular */
@@ -626,63 +847,23 @@ int build_modtran_input
 
     /* ==================================================================== */
 
-    int index;
-    for (layer = 0; layer < P_LAYER; layer++)
+    /* Read in NARR height, relative humidity, and temperature for time
+       before Landsat acqusition */
+    if (read_narr_timestep (layers, 1, points, narr_height1, narr_rh1,
+                            narr_tmp1) != SUCCESS)
     {
-        for (row = min_row; row <= max_row; row++)
-        {
-            for (col = min_col; col <= max_col; col++)
-            {
-                index = (row - min_row) * num_cols + (col - min_col);
-
-                narr_hgt1[layer][index] = hgt1[layer][row * NARR_COLS + col];
-                narr_spfh1[layer][index] = spfh1[layer][row * NARR_COLS + col];
-                narr_tmp1[layer][index] = tmp1[layer][row * NARR_COLS + col];
-                narr_hgt2[layer][index] = hgt2[layer][row * NARR_COLS + col];
-                narr_spfh2[layer][index] = spfh2[layer][row * NARR_COLS + col];
-                narr_tmp2[layer][index] = tmp2[layer][row * NARR_COLS + col];
-            }
-        }
+        RETURN_ERROR ("Failed loading NARR parameters for time before"
+                      " Landsat acqusition", FUNC_NAME, FAILURE);
     }
 
-    /* ==================================================================== */
-
-    /* Release memory */
-    if (free_2d_array ((void **) hgt1) != SUCCESS)
+    /* Read in NARR height, relative humidity, and temperature for time
+       after Landsat acqusition */
+    if (read_narr_timestep (layers, 2, points, narr_height2, narr_rh2,
+                            narr_tmp2) != SUCCESS)
     {
-        RETURN_ERROR ("Freeing memory: hgt1\n", FUNC_NAME, FAILURE);
+        RETURN_ERROR ("Failed loading NARR parameters for time after"
+                      " Landsat acqusition", FUNC_NAME, FAILURE);
     }
-    hgt1 = NULL;
-
-    if (free_2d_array ((void **) spfh1) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: spfh1\n", FUNC_NAME, FAILURE);
-    }
-    spfh1 = NULL;
-
-    if (free_2d_array ((void **) tmp1) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: tmp1\n", FUNC_NAME, FAILURE);
-    }
-    tmp1 = NULL;
-
-    if (free_2d_array ((void **) hgt2) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: ght2\n", FUNC_NAME, FAILURE);
-    }
-    hgt2 = NULL;
-
-    if (free_2d_array ((void **) spfh2) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: spfh2\n", FUNC_NAME, FAILURE);
-    }
-    spfh2 = NULL;
-
-    if (free_2d_array ((void **) tmp2) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: tmp2\n", FUNC_NAME, FAILURE);
-    }
-    tmp2 = NULL;
 
     /* ==================================================================== */
 
@@ -704,94 +885,6 @@ int build_modtran_input
 
     /* ==================================================================== */
 
-    narr_height1 = (double **) allocate_2d_array (P_LAYER, num_points,
-                                                 sizeof (double));
-    if (narr_height1 == NULL)
-    {
-        RETURN_ERROR ("Allocating narr_height1 memory", FUNC_NAME, FAILURE);
-    }
-
-    narr_height2 = (double **) allocate_2d_array (P_LAYER, num_points,
-                                                 sizeof (double));
-    if (narr_height2 == NULL)
-    {
-        RETURN_ERROR ("Allocating narr_height2 memory", FUNC_NAME, FAILURE);
-    }
-
-    narr_rh1 = (double **) allocate_2d_array (P_LAYER, num_points,
-                                             sizeof (double));
-    if (narr_rh1 == NULL)
-    {
-        RETURN_ERROR ("Allocating narr_rh1 memory", FUNC_NAME, FAILURE);
-    }
-
-    narr_rh2 = (double **) allocate_2d_array (P_LAYER, num_points,
-                                             sizeof (double));
-    if (narr_rh2 == NULL)
-    {
-        RETURN_ERROR ("Allocating narr_rh2 memory", FUNC_NAME, FAILURE);
-    }
-
-    /* ==================================================================== */
-
-    /* convert grib data to variables to be input to MODTRAN */
-    if (convert_geopotential_geometric (num_points, points->lat,
-                                        narr_hgt1, narr_height1) != SUCCESS)
-    {
-        RETURN_ERROR ("Calling convert_geopotential_geometric for height 1",
-                      FUNC_NAME, FAILURE);
-    }
-
-    if (convert_geopotential_geometric (num_points, points->lat,
-                                        narr_hgt2, narr_height2) != SUCCESS)
-    {
-        RETURN_ERROR ("Calling convert_geopotential_geometric for height 2",
-                      FUNC_NAME, FAILURE);
-    }
-
-    if (convert_sh_rh (num_points, points->lat, narr_spfh1, narr_tmp1,
-                       pressure, narr_rh1) != SUCCESS)
-    {
-        RETURN_ERROR ("Calling convert_sh_rh for temp 1", FUNC_NAME,
-                      FAILURE);
-    }
-
-    if (convert_sh_rh (num_points, points->lat, narr_spfh2, narr_tmp2,
-                       pressure, narr_rh2) != SUCCESS)
-    {
-        RETURN_ERROR ("Calling convert_sh_rh for temp 2", FUNC_NAME,
-                      FAILURE);
-    }
-
-    /* ==================================================================== */
-
-    /* free allocated memory */
-    if (free_2d_array ((void **) narr_hgt1) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: narr_hgt1\n", FUNC_NAME, FAILURE);
-    }
-    narr_hgt1 = NULL;
-
-    if (free_2d_array ((void **) narr_hgt2) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: narr_hgt2\n", FUNC_NAME, FAILURE);
-    }
-    narr_hgt2 = NULL;
-
-    if (free_2d_array ((void **) narr_spfh1) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: narr_spfh1\n", FUNC_NAME, FAILURE);
-    }
-    narr_spfh1 = NULL;
-
-    if (free_2d_array ((void **) narr_spfh2) != SUCCESS)
-    {
-        RETURN_ERROR ("Freeing memory: narr_spfh2\n", FUNC_NAME, FAILURE);
-    }
-    narr_spfh2 = NULL;
-
-    /* ==================================================================== */
-
     /* determine three hour-increment before and after scene center scan time */
     /* TODO TODO TODO - Does not take into consideration day traversal..... */
     /* TODO TODO TODO - Does not take into consideration day traversal..... */
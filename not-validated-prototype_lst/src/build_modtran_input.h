@@ -10,6 +10,47 @@
 #include "input.h"
 
 
+#define P_LAYER 29
+#define NARR_PARAMETERS 3 /* Height, specific humidity, and temperature */
+
+/* The parameters derived from the height and specific humidity, which the
+   cubes hold in their place */
+#define NARR_HEIGHT_PARAMETER "HEIGHT"
+#define NARR_RH_PARAMETER "RH"
+
+
+int convert_geopotential_geometric
+(
+    int num_points,         /* I: number of points */
+    double *lat,            /* I: latitude in degrees */
+    double **geo_potential, /* I: geo_potential height */
+    double **geo_metric     /* O: geo_metric height */
+);
+
+
+int convert_sh_rh
+(
+    int num_points,   /* I: number of points */
+    double **spec_hum,
+    double **temp_k,
+    int *layers,       /* I: pressure of each layer in millibars */
+    double **rh        /* O: relative humidity */
+);
+
+
+int read_narr_grib_records
+(
+    int *layers,        /* I: pressure of each layer in millibars */
+    int timestep,       /* I: 1 before the acquisition, 2 after */
+    int min_row,        /* I: first row of the window */
+    int max_row,        /* I: last row of the window */
+    int min_col,        /* I: first column of the window */
+    int max_col,        /* I: last column of the window */
+    char **parameters,  /* I: name of each parameter */
+    double ***outputs   /* O: values of each parameter at each layer */
+);
+
+
 int build_modtran_input
 (
     Input_Data_t *input,       /* I: input structure */
@@ -2,28 +2,30 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 
 #include "const.h"
 #include "utilities.h"
-#include "2d_array.h"
 #include "lst_types.h"
 #include "input.h"
+#include "narr_grid.h"
 
 
 /******************************************************************************
 MODULE:  read_narr_coordinates
 
-PURPOSE: Creates directories and writes tape5 file, caseList, and commandList
+PURPOSE: Reads the NARR coordinates text into the row major latitude and
+         longitude arrays, when the coordinate grid is not available.
 
 RETURN: SUCCESS
         FAILURE
 ******************************************************************************/
 int read_narr_coordinates
 (
-    char *lst_data_dir,
-    double **lat,
-    double **lon
+    char *lst_data_dir, /* I: directory holding the coordinates */
+    double *lat,        /* O: latitude of each grid point */
+    double *lon         /* O: longitude of each grid point */
 )
 {
     char FUNC_NAME[] = "read_narr_coordinates";
@@ -66,12 +68,13 @@ int read_narr_coordinates
                         &grid_col, &grid_row, &grid_lat, &grid_lon)
                 == EOF)
             {
+                fclose (fd);
                 RETURN_ERROR ("End of file (EOF) is met before"
                               " NARR_ROWS * NARR_COLS lines",
                               FUNC_NAME, FAILURE);
             }
 
-            lat[row][col] = grid_lat;
+            lat[row * NARR_COLS + col] = grid_lat;
 
             /* TODO - Should think about fixing the input file, so that this
                       confusing conversion is not needed.
@@ -85,9 +88,9 @@ int read_narr_coordinates
                NOTE - If this is changed here, then else-where in the code
                       will break. */
             if (grid_lon > 180.0)
-                lon[row][col] = 360.0 - grid_lon;
+                lon[row * NARR_COLS + col] = 360.0 - grid_lon;
             else
-                lon[row][col] = -grid_lon;
+                lon[row * NARR_COLS + col] = -grid_lon;
         }
     }
 
@@ -213,6 +216,96 @@ void convert_ll_to_utm
 }
 
 
+/*****************************************************************************
+MODULE:  select_window_points
+
+PURPOSE: Keep only the rows and columns of points within ROI_POINT_BUFFER of
+         the window of the scene being processed, so MODTRAN is only run for
+         the points the window needs.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int select_window_points
+(
+    Input_Data_t *input,      /* I: input structure */
+    REANALYSIS_POINTS *points /* I/O: The coordinate points to be used */
+)
+{
+    char FUNC_NAME[] = "select_window_points";
+
+    int row;
+    int col;
+    int index;
+    int window_index;
+    int min_row = points->num_rows;
+    int max_row = -1;
+    int min_col = points->num_cols;
+    int max_col = -1;
+    int num_cols;
+
+    double west = input->meta.ul_map_corner.x - ROI_POINT_BUFFER;
+    double east = input->meta.lr_map_corner.x + ROI_POINT_BUFFER;
+    double north = input->meta.ul_map_corner.y + ROI_POINT_BUFFER;
+    double south = input->meta.lr_map_corner.y - ROI_POINT_BUFFER;
+
+    for (row = 0; row < points->num_rows; row++)
+    {
+        for (col = 0; col < points->num_cols; col++)
+        {
+            index = row * points->num_cols + col;
+
+            if (points->utm_easting[index] > west
+                && points->utm_easting[index] < east
+                && points->utm_northing[index] > south
+                && points->utm_northing[index] < north)
+            {
+                min_row = min (min_row, row);
+                max_row = max (max_row, row);
+                min_col = min (min_col, col);
+                max_col = max (max_col, col);
+            }
+        }
+    }
+
+    if (max_row < min_row + 1 || max_col < min_col + 1)
+    {
+        RETURN_ERROR ("Not enough NARR points around the region of interest",
+                      FUNC_NAME, FAILURE);
+    }
+
+    /* Move the points kept to the front, each point moves towards the
+       front so it can be done in place */
+    num_cols = max_col - min_col + 1;
+    for (row = min_row; row <= max_row; row++)
+    {
+        for (col = min_col; col <= max_col; col++)
+        {
+            index = row * points->num_cols + col;
+            window_index = (row - min_row) * num_cols + (col - min_col);
+
+            points->row[window_index] = points->row[index];
+            points->col[window_index] = points->col[index];
+            points->lat[window_index] = points->lat[index];
+            points->lon[window_index] = points->lon[index];
+            points->utm_easting[window_index] = points->utm_easting[index];
+            points->utm_northing[window_index] = points->utm_northing[index];
+        }
+    }
+
+    points->max_row = points->min_row + max_row;
+    points->min_row += min_row;
+    points->max_col = points->min_col + max_col;
+    points->min_col += min_col;
+    points->num_rows = max_row - min_row + 1;
+    points->num_cols = num_cols;
+    points->num_points = points->num_rows * points->num_cols;
+
+    return SUCCESS;
+}
+
+
 int build_points
 (
     Input_Data_t *input,      /* I: input structure */
@@ -222,9 +315,12 @@ int build_points
     char FUNC_NAME[] = "build_points";
 
     char *lst_data_dir = NULL;
+    char grid_file[PATH_MAX];
 
-    double **lat;
-    double **lon;
+    NARR_GRID grid;
+
+    double *lat = NULL;
+    double *lon = NULL;
 
     int row;
     int col;
@@ -235,6 +331,8 @@ int build_points
 
     int num_bytes;
     int index;
+    int count;
+    int use_grid;
 
     double buffered_north_lat;
     double buffered_south_lat;
@@ -249,23 +347,48 @@ int build_points
                       FUNC_NAME, FAILURE);
     }
 
-    /* Allocate 2d memory to hold the coordinates */
-    lat = (double **) allocate_2d_array (NARR_ROWS, NARR_COLS, sizeof (double));
-    if (lat == NULL)
+    /* Use the coordinate grid and its index when it has been built,
+       otherwise the coordinates text is read and every point tested */
+    count = snprintf (grid_file, sizeof (grid_file),
+                      "%s/%s", lst_data_dir, "narr_coordinates.bin");
+    if (count < 0 || count >= sizeof (grid_file))
     {
-        RETURN_ERROR ("Allocating lat memory", FUNC_NAME, FAILURE);
+        RETURN_ERROR ("Failed initializing grid_file variable for"
+                      " narr_coordinates.bin", FUNC_NAME, FAILURE);
     }
+    use_grid = (access (grid_file, F_OK) == 0);
 
-    lon = (double **) allocate_2d_array (NARR_ROWS, NARR_COLS, sizeof (double));
-    if (lon == NULL)
+    if (use_grid)
     {
-        RETURN_ERROR ("Allocating lon memory", FUNC_NAME, FAILURE);
+        if (open_narr_grid (grid_file, &grid) != SUCCESS)
+        {
+            RETURN_ERROR ("Failed opening the NARR coordinate grid",
+                          FUNC_NAME, FAILURE);
+        }
+        lat = grid.lat;
+        lon = grid.lon;
     }
-
-    /* Read the coordinates into memory */
-    if (read_narr_coordinates (lst_data_dir, lat, lon) != SUCCESS)
+    else
     {
-        RETURN_ERROR ("Failed reading NARR coordinates", FUNC_NAME, FAILURE);
+        /* Allocate memory to hold the coordinates */
+        lat = (double *) malloc (NARR_ROWS * NARR_COLS * sizeof (double));
+        if (lat == NULL)
+        {
+            RETURN_ERROR ("Allocating lat memory", FUNC_NAME, FAILURE);
+        }
+
+        lon = (double *) malloc (NARR_ROWS * NARR_COLS * sizeof (double));
+        if (lon == NULL)
+        {
+            RETURN_ERROR ("Allocating lon memory", FUNC_NAME, FAILURE);
+        }
+
+        /* Read the coordinates into memory */
+        if (read_narr_coordinates (lst_data_dir, lat, lon) != SUCCESS)
+        {
+            RETURN_ERROR ("Failed reading NARR coordinates", FUNC_NAME,
+                          FAILURE);
+        }
     }
 
     /* expand range to include NARR points outside image for edge pixels */
@@ -291,19 +414,30 @@ int build_points
     max_row = 0;
     min_col = 1000;
     max_col = 0;
-    for (row = 0; row < NARR_ROWS; row++)
+    if (use_grid)
     {
-        for (col = 0; col < NARR_COLS; col++)
+        find_narr_grid_window (&grid, buffered_north_lat, buffered_south_lat,
+                               buffered_east_lon, buffered_west_lon,
+                               &min_row, &max_row, &min_col, &max_col);
+    }
+    else
+    {
+        for (row = 0; row < NARR_ROWS; row++)
         {
-            if ((buffered_north_lat > lat[row][col])
-                && (buffered_south_lat < lat[row][col])
-                && (buffered_west_lon < lon[row][col])
-                && (buffered_east_lon > lon[row][col]))
+            for (col = 0; col < NARR_COLS; col++)
             {
-                min_row = min (min_row, row);
-                max_row = max (max_row, row);
-                min_col = min (min_col, col);
-                max_col = max (max_col, col);
+                index = row * NARR_COLS + col;
+
+                if ((buffered_north_lat > lat[index])
+                    && (buffered_south_lat < lat[index])
+                    && (buffered_west_lon < lon[index])
+                    && (buffered_east_lon > lon[index]))
+                {
+                    min_row = min (min_row, row);
+                    max_row = max (max_row, row);
+                    min_col = min (min_col, col);
+                    max_col = max (max_col, col);
+                }
             }
         }
     }
@@ -407,8 +541,8 @@ int build_points
             points->row[index] = row;
             points->col[index] = col;
 
-            points->lat[index] = lat[row][col];
-            points->lon[index] = lon[row][col];
+            points->lat[index] = lat[row * NARR_COLS + col];
+            points->lon[index] = lon[row * NARR_COLS + col];
 
             points->utm_easting[index] = 0.0;
             points->utm_northing[index] = 0.0;
@@ -418,17 +552,28 @@ int build_points
     /* Convert lat/lon to UTM northing/easting */
     convert_ll_to_utm (input, points);
 
-    /* Free memory only used locally */
-    if (free_2d_array ((void **) lat) != SUCCESS)
+    /* Only a window of the scene may be processed */
+    if (input->lines != input->band_lines
+        || input->samples != input->band_samples)
     {
-        RETURN_ERROR ("Freeing memory: lat\n", FUNC_NAME, FAILURE);
+        if (select_window_points (input, points) != SUCCESS)
+        {
+            RETURN_ERROR ("Selecting the points for the region of interest",
+                          FUNC_NAME, FAILURE);
+        }
     }
-    lat = NULL;
 
-    if (free_2d_array ((void **) lon) != SUCCESS)
+    /* Free memory only used locally */
+    if (use_grid)
+    {
+        close_narr_grid (&grid);
+    }
+    else
     {
-        RETURN_ERROR ("Freeing memory: lon\n", FUNC_NAME, FAILURE);
+        free (lat);
+        free (lon);
     }
+    lat = NULL;
     lon = NULL;
 
     return SUCCESS;
@@ -7,6 +7,14 @@
 #include "input.h"
 
 
+int read_narr_coordinates
+(
+    char *lst_data_dir, /* I: directory holding the coordinates */
+    double *lat,        /* O: latitude of each grid point */
+    double *lon         /* O: longitude of each grid point */
+);
+
+
 int build_points
 (
     Input_Data_t *input,      /* I: input structure */
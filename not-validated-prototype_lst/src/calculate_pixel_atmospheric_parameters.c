@@ -3,6 +3,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <float.h>
+#include <limits.h>
 #include <math.h>
 
 
@@ -14,6 +15,10 @@
 #include "intermediate_data.h"
 #include "lst_types.h"
 #include "build_points.h"
+#include "pixel_interpolation.h"
+#include "surface_temperature.h"
+#include "strip_io.h"
+#include "geometry_cache.h"
 
 
 /* Defines the index for the intermediate bands which are generated for the
@@ -39,26 +44,80 @@ typedef struct
 } GRID_ITEM;
 
 
-/* Defines index locations in the vertices array for the current cell to be
-   used for interpolation of the pixel */
-typedef enum
+/* Carries the cell designation forward along a line, so that the distances,
+   sort, and quadrant averages are only re-evaluated when the current sample
+   may have crossed into a different cell */
+typedef struct
 {
-    LL_POINT,
-    UL_POINT,
-    UR_POINT,
-    LR_POINT,
-    NUM_CELL_POINTS
-} CELL_POINTS;
+    int center_point; /* Center grid point of the current designation */
+    int ll_vertex;    /* Lower left vertex of the current cell */
+    int valid_until;  /* First sample the designation is not known to hold
+                         for */
+} CELL_WALKER;
 
 
-/* Defines index locations for the parameters in the at_height array */
-typedef enum
+/* Upper bound on how fast a distance_in_utm result changes with the easting
+   of the pixel.  The scale factor correction stays well below 1.02 for any
+   easting within 1000km of the central meridian, so this is conservative. */
+#define CELL_DISTANCE_RATE (1.1)
+
+/* Margin in meters held back to cover floating point rounding in the
+   distances */
+#define CELL_MARGIN_TOLERANCE (1.0e-3)
+
+/* While processing in single precision or from a lattice, every
+   SINGLE_PRECISION_CHECK_INTERVAL lines are also processed exactly in double
+   precision, to report how far the results deviate */
+#define SINGLE_PRECISION_CHECK_INTERVAL 16
+
+/* When the whole scene is requested as a single strip but holds more pixels
+   than this, it is processed in strips of at most this many pixels, so the
+   strip buffers of very large rasters stay a manageable size */
+#define MAX_STRIP_PIXELS ((size_t) 1 << 28)
+
+
+/* Results of the checks made while processing the pixels */
+typedef struct
+{
+    double max_deviation[AHP_NUM_PARAMETERS]; /* Largest deviation found */
+    int lines_checked;             /* Number of lines checked */
+    long cache_fallbacks;          /* Number of samples the geometry cache
+                                      did not hold a cell for */
+    long verify_mismatches;        /* Number of differing designations */
+} PIXEL_CHECKS;
+
+
+/* The interpolation weights evaluated on a coarse lattice of pixels, for the
+   lines of a strip.  The nodes are every step lines and samples, with the
+   last row and column of nodes on the last line and sample of the scene. */
+typedef struct
+{
+    int step;            /* Lines and samples between the nodes */
+    int lattice_lines;   /* Number of rows of nodes in the scene */
+    int lattice_samples; /* Number of nodes in a row */
+    int max_rows;        /* Number of rows the memory holds */
+    int first_row;       /* First row of nodes held for the strip */
+    int rows;            /* Number of rows of nodes held for the strip */
+    bool *needed;        /* Whether a valid pixel of the strip uses each
+                            node */
+    POINT_WEIGHTS *nodes; /* Weights of the cell vertices at each node */
+} WEIGHT_LATTICE;
+
+
+/* Scratch memory used while processing a line.  Each thread has its own. */
+typedef struct
 {
-    AHP_TRANSMISSION,
-    AHP_UPWELLED_RADIANCE,
-    AHP_DOWNWELLED_RADIANCE,
-    AHP_NUM_PARAMETERS
-} AT_HEIGHT_PARAMETERS;
+    GRID_ITEM *grid_points;        /* Grid points for the cell walker */
+    int *cells;                    /* Lower left vertex of the cell for each
+                                      sample, -1 for fill samples */
+    POINT_WEIGHTS *line_weights;   /* Lattice node weights interpolated to
+                                      the line, NULL without a lattice */
+    float *check[AHP_NUM_PARAMETERS]; /* Exact double precision results for
+                                         a check line */
+    PIXEL_CHECKS checks;           /* Checks made by the thread */
+    GRID_ITEM *verify_grid_points; /* Grid points for the verification,
+                                      NULL when not verifying */
+} LINE_SCRATCH;
 
 
 /* A qsort routine that can be used with the GRID_ITEM items to sort by
@@ -142,167 +201,6 @@ double distance_in_utm
 }
 
 
-/******************************************************************************
-METHOD:  interpolate_to_height
-
-PURPOSE: Interpolate to height of current pixel
-
-******************************************************************************/
-void interpolate_to_height
-(
-    double **modtran_results, /* I: results from MODTRAN runs for a point */
-    double interpolate_to,    /* I: current landsat pixel height */
-    double *at_height         /* O: interpolated height for point */
-)
-{
-    int parameter;
-    int elevation;
-    int below = 0;
-    int above = 0;
-
-    double below_parameters[AHP_NUM_PARAMETERS];
-    double above_parameters[AHP_NUM_PARAMETERS];
-
-    double slope;
-    double intercept;
-
-    double above_height;
-    double inv_height_diff; /* To remove the multiple divisions */
-
-    /* Find the height to use that is below the interpolate_to height */
-    for (elevation = 0; elevation < NUM_ELEVATIONS; elevation++)
-    {
-        if (modtran_results[elevation][MGPE_HEIGHT] < interpolate_to)
-        {
-            below = elevation; /* Last match will always be the one we want */
-        }
-    }
-
-    /* Find the height to use that is equal to or above the interpolate_to
-       height
-
-       It will always be the same or the next height */
-    above = below; /* Start with the same */
-    if (above != (NUM_ELEVATIONS - 1))
-    {
-        /* Not the last height */
-
-        /* Check to make sure that we are not less that the below height,
-           indicating that our interpolate_to height is below the first
-           height */
-        if (! (interpolate_to < modtran_results[above][MGPE_HEIGHT]))
-        {
-            /* Use the next height, since it will be equal to or above our
-               interpolate_to height */
-            above++;
-        }
-        /* Else - We are at the first height, so use that for both above and
-                  below */
-    }
-    /* Else - We are at the last height, so use that for both above and
-              below */
-
-    below_parameters[AHP_TRANSMISSION] =
-        modtran_results[below][MGPE_TRANSMISSION];
-    below_parameters[AHP_UPWELLED_RADIANCE] =
-        modtran_results[below][MGPE_UPWELLED_RADIANCE];
-    below_parameters[AHP_DOWNWELLED_RADIANCE] =
-        modtran_results[below][MGPE_DOWNWELLED_RADIANCE];
-
-    if (above == below)
-    {
-        /* Use the below parameters since the same */
-        at_height[AHP_TRANSMISSION] =
-            below_parameters[AHP_TRANSMISSION];
-        at_height[AHP_UPWELLED_RADIANCE] =
-            below_parameters[AHP_UPWELLED_RADIANCE];
-        at_height[AHP_DOWNWELLED_RADIANCE] =
-            below_parameters[AHP_DOWNWELLED_RADIANCE];
-    }
-    else
-    {
-        /* Interpolate between the heights for each parameter */
-        above_height = modtran_results[above][MGPE_HEIGHT];
-        inv_height_diff = 1.0 / (above_height
-                                 - modtran_results[below][MGPE_HEIGHT]);
-
-        above_parameters[AHP_TRANSMISSION] =
-            modtran_results[above][MGPE_TRANSMISSION];
-        above_parameters[AHP_UPWELLED_RADIANCE] =
-            modtran_results[above][MGPE_UPWELLED_RADIANCE];
-        above_parameters[AHP_DOWNWELLED_RADIANCE] =
-            modtran_results[above][MGPE_DOWNWELLED_RADIANCE];
-
-        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
-        {
-            slope = (above_parameters[parameter] - below_parameters[parameter])
-                    * inv_height_diff;
-
-            intercept = above_parameters[parameter] - slope * above_height;
-
-            at_height[parameter] = slope * interpolate_to + intercept;
-        }
-    }
-}
-
-
-/******************************************************************************
-METHOD:  interpolate_to_location
-
-PURPOSE: Interpolate to location of current pixel
-
-******************************************************************************/
-void interpolate_to_location
-(
-    REANALYSIS_POINTS *points,   /* I: The coordinate points */
-    int *vertices,               /* I: The vertices for the points to use */
-    double **at_height,          /* I: current height atmospheric results */
-    double interpolate_easting,  /* I: interpolate to easting */
-    double interpolate_northing, /* I: interpolate to northing */
-    double *parameters     /*O: interpolated pixel atmospheric parameters */
-)
-{
-    int point;
-    int parameter;
-
-    double inv_h[NUM_CELL_POINTS];
-    double w[NUM_CELL_POINTS];
-    double total = 0.0;
-
-    /* shepard's method */
-    for (point = 0; point < NUM_CELL_POINTS; point++)
-    {
-        inv_h[point] = 1.0 / sqrt (((points->utm_easting[vertices[point]]
-                                     - interpolate_easting)
-                                    * (points->utm_easting[vertices[point]]
-                                       - interpolate_easting))
-                                   +
-                                   ((points->utm_northing[vertices[point]]
-                                     - interpolate_northing)
-                                    * (points->utm_northing[vertices[point]]
-                                       - interpolate_northing)));
-
-        total += inv_h[point];
-    }
-
-    /* Determine the weights for each vertex */
-    for (point = 0; point < NUM_CELL_POINTS; point++)
-    {
-        w[point] = inv_h[point] / total;
-    }
-
-    /* For each parameter apply each vertex's weighted value */
-    for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
-    {
-        parameters[parameter] = 0.0;
-        for (point = 0; point < NUM_CELL_POINTS; point++)
-        {
-            parameters[parameter] += (w[point] * at_height[point][parameter]);
-        }
-    }
-}
-
-
 /*****************************************************************************
 METHOD:  point_is_left_of_line
 
@@ -430,380 +328,1781 @@ int determine_first_center_grid_point
 
 
 /*****************************************************************************
-METHOD:  calculate_pixel_atmospheric_parameters
+METHOD:  determine_cell_vertex
 
-PURPOSE: Generate transmission, upwelled radiance, and downwelled radiance at
-         each Landsat pixel
+PURPOSE: Determines the center point for the current line/sample and which of
+         the four cells around it the line/sample belongs to.
 
-RETURN: SUCCESS
-        FAILURE
+NOTE: The margins returned are the amounts the distances are allowed to change
+      before either the center point or the cell selection could change.
 
+RETURN: type = int
+    Value  Description
+    -----  -------------------------------------------------------------------
+    index  The index of the lower left vertex of the cell.
 *****************************************************************************/
-int calculate_pixel_atmospheric_parameters
+int determine_cell_vertex
 (
-    Input_Data_t *input,       /* I: input structure */
-    REANALYSIS_POINTS *points, /* I: The coordinate points */
-    char *xml_filename,        /* I: XML filename */
-    double **modtran_results,  /* I: results from MODTRAN runs */
-    bool verbose               /* I: value to indicate if intermediate
-                                     messages be printed */
+    REANALYSIS_POINTS *points, /* I: All the available points */
+    double easting,            /* I: Easting of the current line/sample */
+    double northing,           /* I: Northing of the current line/sample */
+    bool first_sample,         /* I: Is this the first valid sample for the
+                                     line */
+    GRID_ITEM *grid_points,    /* I/O: The grid points around the center
+                                       point */
+    int *center_point,         /* O: The center point determined */
+    double *margin             /* O: Smallest of the center point and cell
+                                     selection margins */
 )
 {
-    char FUNC_NAME[] = "calculate_pixel_atmospheric_parameters";
-
-    int line;
-    int sample;
-    int status;
-
-    bool first_sample;
-
-    double easting;
-    double northing;
-
-    GRID_ITEM *grid_points = NULL;
-
-    int vertex;
-    int current_index;
-    int center_point;
-    int cell_vertices[NUM_CELL_POINTS];
-
-    double **at_height = NULL;
-    double parameters[AHP_NUM_PARAMETERS];
-    double avg_distance_ll;
-    double avg_distance_ul;
-    double avg_distance_ur;
-    double avg_distance_lr;
-
-    Intermediate_Data_t inter;
-
-    int16_t *elevation_data = NULL; /* input elevation data in meters */
-
-    double current_height;
-    char msg[MAX_STR_LEN];
-    char *lst_data_dir = NULL;
-
-    /* Use local variables for cleaner code */
+    int point;
     int num_cols = points->num_cols;
-    int num_points = points->num_points;
+    int center;
 
-    int pixel_count = input->lines * input->samples;
-    int pixel_line_loc;
-    int pixel_loc;
+    double avg_distance[NUM_CELL_POINTS];
+    double center_margin;
+    double cell_margin;
+    double closest;
+    double next_closest;
 
-    /* Grab the environment path to the LST_DATA_DIR */
-    lst_data_dir = getenv ("LST_DATA_DIR");
-    if (lst_data_dir == NULL)
+    if (first_sample)
     {
-        RETURN_ERROR ("LST_DATA_DIR environment variable is not set",
-                      FUNC_NAME, FAILURE);
+        /* Determine the first center point from all of the available
+           points */
+        center = determine_first_center_grid_point (points, easting,
+                                                    northing, grid_points);
     }
-
-    /* Open the intermedate data files */
-    if (open_intermediate(input, &inter) != SUCCESS)
+    else
     {
-        RETURN_ERROR("Opening intermediate data files", FUNC_NAME, FAILURE);
+        /* Determine the center point from the current 9 grid points for
+           the current line/sample */
+        center = determine_center_grid_point (points, easting, northing,
+                                              NUM_GRID_POINTS, grid_points);
     }
 
-    /* Allocate memory for the intermedate data */
-    if (allocate_intermediate(&inter, pixel_count) != SUCCESS)
+    /* Fix the index values, since the points are from a new line or were
+       messed up during determining the center point */
+    grid_points[CC_GRID_POINT].index = center;
+    grid_points[LL_GRID_POINT].index = center - 1 - num_cols;
+    grid_points[LC_GRID_POINT].index = center - 1;
+    grid_points[UL_GRID_POINT].index = center - 1 + num_cols;
+    grid_points[UC_GRID_POINT].index = center + num_cols;
+    grid_points[UR_GRID_POINT].index = center + 1 + num_cols;
+    grid_points[RC_GRID_POINT].index = center + 1;
+    grid_points[LR_GRID_POINT].index = center + 1 - num_cols;
+    grid_points[DC_GRID_POINT].index = center - num_cols;
+
+    /* Fix the distances, since the points are from a new line or were messed
+       up during determining the center point */
+    determine_grid_point_distances (points, easting, northing,
+                                    NUM_GRID_POINTS, grid_points);
+
+    /* Determine the average distances for each quadrant around the center
+       point
+       We only need to use the three outer grid points */
+    avg_distance[LL_POINT] = (grid_points[DC_GRID_POINT].distance
+                              + grid_points[LL_GRID_POINT].distance
+                              + grid_points[LC_GRID_POINT].distance)
+                             / 3.0;
+
+    avg_distance[UL_POINT] = (grid_points[LC_GRID_POINT].distance
+                              + grid_points[UL_GRID_POINT].distance
+                              + grid_points[UC_GRID_POINT].distance)
+                             / 3.0;
+
+    avg_distance[UR_POINT] = (grid_points[UC_GRID_POINT].distance
+                              + grid_points[UR_GRID_POINT].distance
+                              + grid_points[RC_GRID_POINT].distance)
+                             / 3.0;
+
+    avg_distance[LR_POINT] = (grid_points[RC_GRID_POINT].distance
+                              + grid_points[LR_GRID_POINT].distance
+                              + grid_points[DC_GRID_POINT].distance)
+                             / 3.0;
+
+    /* How much closer the center point is than the other eight */
+    center_margin = DBL_MAX;
+    for (point = 0; point < NUM_GRID_POINTS; point++)
     {
-        RETURN_ERROR("Allocating memory for intermediate data",
-                     FUNC_NAME, FAILURE);
+        if (point != CC_GRID_POINT)
+        {
+            center_margin = min (center_margin,
+                                 grid_points[point].distance
+                                 - grid_points[CC_GRID_POINT].distance);
+        }
     }
 
-    /* Allocate memory for elevation */
-    elevation_data = calloc(pixel_count, sizeof(int16_t));
-    if (elevation_data == NULL)
+    /* How much closer the selected quadrant is than the other three */
+    closest = DBL_MAX;
+    next_closest = DBL_MAX;
+    for (point = 0; point < NUM_CELL_POINTS; point++)
     {
-        RETURN_ERROR("Allocating elevation_data memory", FUNC_NAME, FAILURE);
+        if (avg_distance[point] < closest)
+        {
+            next_closest = closest;
+            closest = avg_distance[point];
+        }
+        else if (avg_distance[point] < next_closest)
+        {
+            next_closest = avg_distance[point];
+        }
     }
-
-    /* Allocate memory for at_height */
-    at_height = (double **) allocate_2d_array (NUM_CELL_POINTS,
-                                               AHP_NUM_PARAMETERS,
-                                               sizeof (double));
-    if (at_height == NULL)
-    {
-        RETURN_ERROR ("Allocating at_height memory", FUNC_NAME, FAILURE);
+    cell_margin = next_closest - closest;
+
+    *center_point = center;
+    *margin = min (center_margin, cell_margin);
+
+    /* Determine which quadrant is closer and return the cell vertex based on
+       that */
+    if (avg_distance[LL_POINT] < avg_distance[UL_POINT]
+        && avg_distance[LL_POINT] < avg_distance[UR_POINT]
+        && avg_distance[LL_POINT] < avg_distance[LR_POINT])
+    { /* LL Cell */
+        return center - 1 - num_cols;
     }
-
-    /* Allocate memory to hold the grid_points to the first sample of data for
-       the current line */
-    grid_points = malloc (num_points * sizeof (GRID_ITEM));
-    if (grid_points == NULL)
-    {
-        RETURN_ERROR ("Allocating grid_points memory", FUNC_NAME, FAILURE);
+    else if (avg_distance[UL_POINT] < avg_distance[LL_POINT]
+        && avg_distance[UL_POINT] < avg_distance[UR_POINT]
+        && avg_distance[UL_POINT] < avg_distance[LR_POINT])
+    { /* UL Cell */
+        return center - 1;
     }
-
-    /* Read thermal and elevation data into memory */
-    if (read_input(input, inter.band_thermal, elevation_data, pixel_count)
-        != SUCCESS)
-    {
-        RETURN_ERROR ("Reading thermal and elevation bands", FUNC_NAME,
-                      FAILURE);
+    else if (avg_distance[UR_POINT] < avg_distance[LL_POINT]
+        && avg_distance[UR_POINT] < avg_distance[UL_POINT]
+        && avg_distance[UR_POINT] < avg_distance[LR_POINT])
+    { /* UR Cell */
+        return center;
     }
 
-    if (verbose)
-    {
-        LOG_MESSAGE("Iterate through all pixels in Landsat scene",
-                    FUNC_NAME);
-        snprintf(msg, sizeof(msg), "Pixel Count = %d", pixel_count);
-        LOG_MESSAGE(msg, FUNC_NAME);
-        snprintf(msg,  sizeof(msg),"Lines = %d, Samples = %d",
-                 input->lines, input->samples);
-        LOG_MESSAGE(msg, FUNC_NAME);
-    }
+    /* LR Cell */
+    return center - num_cols;
+}
 
-    /* Loop through each line in the image */
-    for (line = 0; line < input->lines; line++)
-    {
-        /* Print status on every 1000 lines */
-        if (!(line % 1000))
-        {
-            if (verbose)
-            {
-                printf ("Processing line %d\r", line);
-                fflush (stdout);
-            }
-        }
 
-        pixel_line_loc = line * input->samples;
+/*****************************************************************************
+METHOD:  walk_to_sample
 
-        /* Set first_sample to be true */
-        first_sample = true;
-        for (sample = 0; sample < input->samples; sample++)
-        {
-            pixel_loc = pixel_line_loc + sample;
+PURPOSE: Provides the lower left vertex of the cell for the current
+         line/sample, only re-evaluating the cell when the sample may have
+         crossed into a different one.
 
-            if (inter.band_thermal[pixel_loc] != LST_NO_DATA_VALUE)
-            {
-                /* Determine UTM coordinates for current line/sample */
-                easting = input->meta.ul_map_corner.x
-                    + (sample * input->x_pixel_size);
-                northing = input->meta.ul_map_corner.y
-                    - (line * input->y_pixel_size);
+NOTE: Along a line only the easting changes.  Each distance_in_utm result
+      changes by no more than CELL_DISTANCE_RATE times the change in
+      easting, so any difference between two distances changes by no more
+      than twice that.  While the samples stepped over can not consume the
+      margin from the last evaluation, the center point and cell selection
+      are the same as they would be if re-evaluated.
 
-                if (first_sample)
-                {
-                    /* Determine the first center point from all of the
-                       available points */
-                    center_point = determine_first_center_grid_point(
-                                       points, easting, northing,
-                                       grid_points);
+RETURN: type = int
+    Value  Description
+    -----  -------------------------------------------------------------------
+    index  The index of the lower left vertex of the cell.
+*****************************************************************************/
+int walk_to_sample
+(
+    REANALYSIS_POINTS *points, /* I: All the available points */
+    double easting,            /* I: Easting of the current line/sample */
+    double northing,           /* I: Northing of the current line/sample */
+    int sample,                /* I: The current sample */
+    double x_pixel_size,       /* I: Easting change for each sample */
+    bool first_sample,         /* I: Is this the first valid sample for the
+                                     line */
+    GRID_ITEM *grid_points,    /* I/O: The grid points around the center
+                                       point */
+    CELL_WALKER *walker        /* I/O: The current cell for the line */
+)
+{
+    double margin;
+    double samples_in_margin;
 
-                    /* Set first_sample to be false */
-                    first_sample = false;
-                }
-                else
-                {
-                    /* Determine the center point from the current 9 grid
-                       points for the current line/sample */
-                    center_point = determine_center_grid_point(
-                                       points, easting, northing,
-                                       NUM_GRID_POINTS, grid_points);
-                }
+    if (first_sample || sample >= walker->valid_until)
+    {
+        walker->ll_vertex = determine_cell_vertex (points, easting, northing,
+                                                   first_sample, grid_points,
+                                                   &walker->center_point,
+                                                   &margin);
+
+        /* Determine how many samples can be stepped over before the margin
+           could be used up */
+        margin -= CELL_MARGIN_TOLERANCE;
+        samples_in_margin = margin
+                            / (2.0 * CELL_DISTANCE_RATE * x_pixel_size);
+
+        if (samples_in_margin < 1.0)
+            walker->valid_until = sample + 1;
+        else if (samples_in_margin > INT_MAX - sample - 1)
+            walker->valid_until = INT_MAX;
+        else
+            walker->valid_until = sample + (int) samples_in_margin + 1;
+    }
 
-                /* Fix the index values, since the points are from a new line
-                   or were messed up during determining the center point */
-                grid_points[CC_GRID_POINT].index = center_point;
-                grid_points[LL_GRID_POINT].index =
-                    center_point - 1 - num_cols;
-                grid_points[LC_GRID_POINT].index = center_point - 1;
-                grid_points[UL_GRID_POINT].index =
-                    center_point - 1 + num_cols;
-                grid_points[UC_GRID_POINT].index =
-                    center_point + num_cols;
-                grid_points[UR_GRID_POINT].index =
-                    center_point + 1 + num_cols;
-                grid_points[RC_GRID_POINT].index = center_point + 1;
-                grid_points[LR_GRID_POINT].index =
-                    center_point + 1 - num_cols;
-                grid_points[DC_GRID_POINT].index =
-                    center_point - num_cols;
-
-                /* Fix the distances, since the points are from a new line or
-                   were messed up during determining the center point */
-                determine_grid_point_distances (points, easting, northing,
-                                                NUM_GRID_POINTS, grid_points);
-
-                /* Determine the average distances for each quadrant around
-                   the center point
-                   We only need to use the three outer grid points */
-                avg_distance_ll = (grid_points[DC_GRID_POINT].distance
-                                   + grid_points[LL_GRID_POINT].distance
-                                   + grid_points[LC_GRID_POINT].distance)
-                                  / 3.0;
-
-                avg_distance_ul = (grid_points[LC_GRID_POINT].distance
-                                   + grid_points[UL_GRID_POINT].distance
-                                   + grid_points[UC_GRID_POINT].distance)
-                                  / 3.0;
-
-                avg_distance_ur = (grid_points[UC_GRID_POINT].distance
-                                   + grid_points[UR_GRID_POINT].distance
-                                   + grid_points[RC_GRID_POINT].distance)
-                                  / 3.0;
-
-                avg_distance_lr = (grid_points[RC_GRID_POINT].distance
-                                   + grid_points[LR_GRID_POINT].distance
-                                   + grid_points[DC_GRID_POINT].distance)
-                                  / 3.0;
-
-                /* Determine which quadrant is closer and setup the cell
-                   vertices to interpolate over based on that */
-                if (avg_distance_ll < avg_distance_ul
-                    && avg_distance_ll < avg_distance_ur
-                    && avg_distance_ll < avg_distance_lr)
-                { /* LL Cell */
-                    cell_vertices[LL_POINT] = center_point - 1 - num_cols;
-                }
-                else if (avg_distance_ul < avg_distance_ll
-                    && avg_distance_ul < avg_distance_ur
-                    && avg_distance_ul < avg_distance_lr)
-                { /* UL Cell */
-                    cell_vertices[LL_POINT] = center_point - 1;
-                }
-                else if (avg_distance_ur < avg_distance_ll
-                    && avg_distance_ur < avg_distance_ul
-                    && avg_distance_ur < avg_distance_lr)
-                { /* UR Cell */
-                    cell_vertices[LL_POINT] = center_point;
-                }
-                else
-                { /* LR Cell */
-                    cell_vertices[LL_POINT] = center_point - num_cols;
-                }
+    return walker->ll_vertex;
+}
 
-                /* UL Point */
-                cell_vertices[UL_POINT] = cell_vertices[LL_POINT] + num_cols;
-                /* UR Point */
-                cell_vertices[UR_POINT] = cell_vertices[UL_POINT] + 1;
-                /* LR Point */
-                cell_vertices[LR_POINT] = cell_vertices[LL_POINT] + 1;
 
-#if OUTPUT_CELL_DESIGNATION_BAND
-                inter.band_cell[pixel_loc] = cell_vertices[LL_POINT];
-#endif
+/*****************************************************************************
+METHOD:  initialize_pixel_checks
 
-                /* convert height from m to km -- Same as 1.0 / 1000.0 */
-                current_height = (double) elevation_data[pixel_loc] * 0.001;
+PURPOSE: Clears the results of the checks made while processing pixels.
 
-                /* interpolate three parameters to that height at each of the
-                   four closest points */
-                for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
-                {
-                    current_index = cell_vertices[vertex] * NUM_ELEVATIONS;
+*****************************************************************************/
+void initialize_pixel_checks
+(
+    PIXEL_CHECKS *checks /* O: the checks to clear */
+)
+{
+    int parameter;
 
-                    /* interpolate three atmospheric parameters to current
-                       height */
-                    interpolate_to_height(&modtran_results[current_index],
-                                          current_height,
-                                          at_height[vertex]);
-                }
+    for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+    {
+        checks->max_deviation[parameter] = 0.0;
+    }
+    checks->lines_checked = 0;
+    checks->cache_fallbacks = 0;
+    checks->verify_mismatches = 0;
+}
 
-                /* interpolate parameters at appropriate height to location of
-                   current pixel */
-                interpolate_to_location(points, cell_vertices, at_height,
-                                        easting, northing, &parameters[0]);
-
-                /* convert radiances to W*m^(-2)*sr(-1) */
-                inter.band_upwelled[pixel_loc] =
-                    parameters[AHP_UPWELLED_RADIANCE] * 10000.0;
-                inter.band_downwelled[pixel_loc] =
-                    parameters[AHP_DOWNWELLED_RADIANCE] * 10000.0;
-                inter.band_transmittance[pixel_loc] =
-                    parameters[AHP_TRANSMISSION];
-            } /* END - if not FILL */
-            else
-            {
-                inter.band_upwelled[pixel_loc] = LST_NO_DATA_VALUE;
-                inter.band_downwelled[pixel_loc] = LST_NO_DATA_VALUE;
-                inter.band_transmittance[pixel_loc] = LST_NO_DATA_VALUE;
 
-#if OUTPUT_CELL_DESIGNATION_BAND
-                inter.band_cell[pixel_loc] = 0;
-#endif
-            }
-        } /* END - for sample */
+/*****************************************************************************
+METHOD:  merge_pixel_checks
 
-    } /* END - for line */
+PURPOSE: Combines the results of checks made by a thread with the totals.
 
-    /* Write out the temporary intermediate output files */
-    if (write_intermediate(&inter, pixel_count) != SUCCESS)
+*****************************************************************************/
+void merge_pixel_checks
+(
+    PIXEL_CHECKS *checks, /* I: checks made by a thread */
+    PIXEL_CHECKS *totals  /* I/O: the combined checks */
+)
+{
+    int parameter;
+
+    for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
     {
-        sprintf (msg, "Writing to intermediate data files");
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        if (checks->max_deviation[parameter] > totals->max_deviation[parameter])
+        {
+            totals->max_deviation[parameter] =
+                checks->max_deviation[parameter];
+        }
     }
+    totals->lines_checked += checks->lines_checked;
+    totals->cache_fallbacks += checks->cache_fallbacks;
+    totals->verify_mismatches += checks->verify_mismatches;
+}
 
-    /* Free allocated memory */
-    free(grid_points);
-    free(elevation_data);
 
-    status = free_2d_array((void **)at_height);
-    if (status != SUCCESS)
-    {
-        ERROR_MESSAGE("Freeing memory: at_height\n", FUNC_NAME);
-    }
+/*****************************************************************************
+METHOD:  allocate_line_scratch
+
+PURPOSE: Allocates the scratch memory needed to process a line.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int allocate_line_scratch
+(
+    int num_points,       /* I: number of points */
+    int samples,          /* I: number of samples in a line */
+    int lattice_samples,  /* I: number of lattice nodes in a line, 0 without
+                                a lattice */
+    bool verify_cells,    /* I: also search for the cell of every sample */
+    LINE_SCRATCH *scratch /* O: the scratch memory */
+)
+{
+    char FUNC_NAME[] = "allocate_line_scratch";
 
-    free_intermediate(&inter);
+    int parameter;
 
-    /* Close the intermediate binary files */
-    if (close_intermediate(&inter) != SUCCESS)
+    scratch->grid_points = NULL;
+    scratch->cells = NULL;
+    scratch->line_weights = NULL;
+    for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
     {
-        sprintf (msg, "Closing file intermediate data files");
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        scratch->check[parameter] = NULL;
     }
+    initialize_pixel_checks (&scratch->checks);
+    scratch->verify_grid_points = NULL;
 
-    if (add_lst_band_product(xml_filename,
-                             input->reference_band_name,
-                             inter.thermal_filename,
-                             LST_THERMAL_RADIANCE_PRODUCT_NAME,
-                             LST_THERMAL_RADIANCE_BAND_NAME,
-                             LST_THERMAL_RADIANCE_SHORT_NAME,
-                             LST_THERMAL_RADIANCE_LONG_NAME,
-                             LST_RADIANCE_UNITS,
-                             0.0, 0.0) != SUCCESS)
+    /* Allocate memory to hold the grid_points to the first sample of data for
+       the current line */
+    scratch->grid_points = malloc (num_points * sizeof (GRID_ITEM));
+    if (scratch->grid_points == NULL)
     {
-        ERROR_MESSAGE ("Failed adding LST band product", FUNC_NAME);
+        RETURN_ERROR ("Allocating grid_points memory", FUNC_NAME, FAILURE);
     }
 
-    if (add_lst_band_product(xml_filename,
-                             input->reference_band_name,
-                             inter.transmittance_filename,
-                             LST_ATMOS_TRANS_PRODUCT_NAME,
-                             LST_ATMOS_TRANS_BAND_NAME,
-                             LST_ATMOS_TRANS_SHORT_NAME,
-                             LST_ATMOS_TRANS_LONG_NAME,
-                             LST_RADIANCE_UNITS,
-                             0.0, 0.0) != SUCCESS)
+    scratch->cells = malloc (samples * sizeof (int));
+    if (scratch->cells == NULL)
     {
-        ERROR_MESSAGE ("Failed adding LST band product", FUNC_NAME);
+        RETURN_ERROR ("Allocating cells memory", FUNC_NAME, FAILURE);
     }
 
-    if (add_lst_band_product(xml_filename,
-                             input->reference_band_name,
-                             inter.upwelled_filename,
-                             LST_UPWELLED_RADIANCE_PRODUCT_NAME,
-                             LST_UPWELLED_RADIANCE_BAND_NAME,
-                             LST_UPWELLED_RADIANCE_SHORT_NAME,
-                             LST_UPWELLED_RADIANCE_LONG_NAME,
-                             LST_RADIANCE_UNITS,
-                             0.0, 0.0) != SUCCESS)
+    if (lattice_samples > 0)
     {
-        ERROR_MESSAGE ("Failed adding LST band product", FUNC_NAME);
+        scratch->line_weights =
+            malloc (lattice_samples * sizeof (POINT_WEIGHTS));
+        if (scratch->line_weights == NULL)
+        {
+            RETURN_ERROR ("Allocating line weights memory", FUNC_NAME,
+                          FAILURE);
+        }
     }
 
-    if (add_lst_band_product(xml_filename,
-                             input->reference_band_name,
-                             inter.downwelled_filename,
-                             LST_DOWNWELLED_RADIANCE_PRODUCT_NAME,
-                             LST_DOWNWELLED_RADIANCE_BAND_NAME,
-                             LST_DOWNWELLED_RADIANCE_SHORT_NAME,
-                             LST_DOWNWELLED_RADIANCE_LONG_NAME,
-                             LST_RADIANCE_UNITS,
-                             0.0, 0.0) != SUCCESS)
+    for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
     {
-        ERROR_MESSAGE ("Failed adding LST band product", FUNC_NAME);
+        scratch->check[parameter] = malloc (samples * sizeof (float));
+        if (scratch->check[parameter] == NULL)
+        {
+            RETURN_ERROR ("Allocating check memory", FUNC_NAME, FAILURE);
+        }
+    }
+
+    if (verify_cells)
+    {
+        scratch->verify_grid_points =
+            malloc (num_points * sizeof (GRID_ITEM));
+        if (scratch->verify_grid_points == NULL)
+        {
+            RETURN_ERROR ("Allocating verify_grid_points memory", FUNC_NAME,
+                          FAILURE);
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  free_line_scratch
+
+PURPOSE: Frees the scratch memory used to process a line.
+
+*****************************************************************************/
+void free_line_scratch
+(
+    LINE_SCRATCH *scratch /* I/O: the scratch memory */
+)
+{
+    int parameter;
+
+    free (scratch->grid_points);
+    scratch->grid_points = NULL;
+
+    free (scratch->cells);
+    scratch->cells = NULL;
+
+    free (scratch->line_weights);
+    scratch->line_weights = NULL;
+
+    for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+    {
+        free (scratch->check[parameter]);
+        scratch->check[parameter] = NULL;
+    }
+
+    free (scratch->verify_grid_points);
+    scratch->verify_grid_points = NULL;
+}
+
+
+/*****************************************************************************
+METHOD:  allocate_weight_lattice
+
+PURPOSE: Allocates the lattice of weights for the rows of nodes used by a
+         strip of lines.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int allocate_weight_lattice
+(
+    int step,                 /* I: lines and samples between the nodes */
+    int lines,                /* I: number of lines in the scene */
+    int samples,              /* I: number of samples in a line */
+    int strip_lines,          /* I: number of lines in a strip */
+    WEIGHT_LATTICE *lattice  /* O: the lattice */
+)
+{
+    char FUNC_NAME[] = "allocate_weight_lattice";
+
+    int node_count;
+
+    lattice->step = step;
+    lattice->lattice_lines = (lines - 1 + step - 1) / step + 1;
+    lattice->lattice_samples = (samples - 1 + step - 1) / step + 1;
+
+    /* The lines of a strip are between at most this many rows of nodes */
+    lattice->max_rows = min ((strip_lines - 1) / step + 3,
+                             lattice->lattice_lines);
+    lattice->first_row = 0;
+    lattice->rows = 0;
+
+    node_count = lattice->max_rows * lattice->lattice_samples;
+
+    lattice->needed = malloc (node_count * sizeof (bool));
+    if (lattice->needed == NULL)
+    {
+        RETURN_ERROR ("Allocating lattice memory", FUNC_NAME, FAILURE);
+    }
+
+    lattice->nodes = malloc (node_count * sizeof (POINT_WEIGHTS));
+    if (lattice->nodes == NULL)
+    {
+        RETURN_ERROR ("Allocating lattice weights memory", FUNC_NAME,
+                      FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  free_weight_lattice
+
+PURPOSE: Frees the lattice of weights.
+
+*****************************************************************************/
+void free_weight_lattice
+(
+    WEIGHT_LATTICE *lattice  /* I/O: the lattice */
+)
+{
+    free (lattice->needed);
+    lattice->needed = NULL;
+
+    free (lattice->nodes);
+    lattice->nodes = NULL;
+}
+
+
+/*****************************************************************************
+METHOD:  build_strip_lattice
+
+PURPOSE: Evaluates the weights of the lattice nodes used by the valid pixels
+         of a strip.  Each node determines its cell and the weights of the
+         cell's vertices at its location the same way a pixel does in exact
+         mode.
+
+NOTE: Nodes no valid pixel uses are not evaluated, so they are never
+      located further out than the pixels processed in exact mode.
+
+NOTE: With a geometry cache, the cells of the nodes are taken from the cache
+      when it holds them, otherwise the cells found are recorded in it.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int build_strip_lattice
+(
+    Input_Data_t *input,       /* I: input structure */
+    REANALYSIS_POINTS *points, /* I: The coordinate points */
+    int first_line,            /* I: first line of the strip */
+    int strip_lines,           /* I: number of lines in the strip */
+    Valid_Spans_t *spans,      /* I: valid spans of the strip */
+    GEOMETRY_CACHE *cache,     /* I/O: the geometry cache, NULL for none */
+    WEIGHT_LATTICE *lattice   /* I/O: the lattice */
+)
+{
+    char FUNC_NAME[] = "build_strip_lattice";
+
+    int strip_line;
+    int span;
+    int row;
+    int line;
+    int node;
+    int sample;
+    int first_node;
+    int end_node;
+    int index;
+    int scene_node;
+    int vertex;
+    int cached_cell;
+    int cell_vertices[NUM_CELL_POINTS];
+
+    bool first_sample;
+    bool abort_lattice = false;
+
+    double easting;
+    double northing;
+    double vertex_easting[NUM_CELL_POINTS];
+    double vertex_northing[NUM_CELL_POINTS];
+
+    GRID_ITEM *grid_points;
+    CELL_WALKER walker;
+
+    /* Use local variables for cleaner code */
+    int step = lattice->step;
+    int lattice_samples = lattice->lattice_samples;
+    int num_cols = points->num_cols;
+    bool *needed = lattice->needed;
+
+    lattice->first_row = first_line / step;
+    lattice->rows = min ((first_line + strip_lines - 1) / step + 1,
+                         lattice->lattice_lines - 1)
+                    - lattice->first_row + 1;
+
+    /* Each valid sample uses the nodes at the corners of the lattice cell
+       it is in */
+    memset (needed, 0,
+            (size_t) lattice->rows * lattice_samples * sizeof (bool));
+    for (strip_line = 0; strip_line < strip_lines; strip_line++)
+    {
+        row = (first_line + strip_line) / step - lattice->first_row;
+
+        for (span = spans->line_first_span[strip_line];
+             span < spans->line_first_span[strip_line + 1]; span++)
+        {
+            first_node = spans->span_start[span] / step;
+            end_node = min ((spans->span_end[span] - 1) / step + 1,
+                            lattice_samples - 1);
+
+            for (node = first_node; node <= end_node; node++)
+            {
+                needed[row * lattice_samples + node] = true;
+                if (row + 1 < lattice->rows)
+                    needed[(row + 1) * lattice_samples + node] = true;
+            }
+        }
+    }
+
+    /* The rows of nodes are independent of each other, so they are
+       distributed across the threads */
+#ifdef _OPENMP
+    #pragma omp parallel private(row, line, node, sample, index, \
+                                 scene_node, vertex, cached_cell, \
+                                 cell_vertices, first_sample, easting, \
+                                 northing, vertex_easting, vertex_northing, \
+                                 grid_points, walker) \
+                         shared(abort_lattice)
+#endif
+    {
+        grid_points = malloc (points->num_points * sizeof (GRID_ITEM));
+        if (grid_points == NULL)
+        {
+            abort_lattice = true;
+#ifdef _OPENMP
+            #pragma omp flush (abort_lattice)
+#endif
+        }
+
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for (row = 0; row < lattice->rows; row++)
+        {
+#ifdef _OPENMP
+            #pragma omp flush (abort_lattice)
+#endif
+            if (abort_lattice)
+                continue;
+
+            line = min ((lattice->first_row + row) * step, input->lines - 1);
+            northing = input->meta.ul_map_corner.y
+                       - (line * input->y_pixel_size);
+
+            first_sample = true;
+            for (node = 0; node < lattice_samples; node++)
+            {
+                index = row * lattice_samples + node;
+
+                /* Start the cell search over after any nodes skipped */
+                if (!needed[index])
+                {
+                    first_sample = true;
+                    continue;
+                }
+
+                sample = min (node * step, input->samples - 1);
+                easting = input->meta.ul_map_corner.x
+                          + (sample * input->x_pixel_size);
+
+                /* Use the cell from the geometry cache when it holds
+                   one */
+                scene_node = (lattice->first_row + row) * lattice_samples
+                             + node;
+                cached_cell = -1;
+                if (cache != NULL && cache->hit)
+                    cached_cell = cache->node_cells[scene_node];
+
+                if (cached_cell >= 0)
+                {
+                    cell_vertices[LL_POINT] = cached_cell;
+
+                    /* The cell search starts over at the next node not
+                       cached */
+                    first_sample = true;
+                }
+                else
+                {
+                    cell_vertices[LL_POINT] = walk_to_sample (
+                                                  points, easting, northing,
+                                                  sample,
+                                                  input->x_pixel_size,
+                                                  first_sample, grid_points,
+                                                  &walker);
+                    first_sample = false;
+                }
+
+                if (cache != NULL && !cache->hit)
+                    cache->node_cells[scene_node] = cell_vertices[LL_POINT];
+
+                cell_vertices[UL_POINT] = cell_vertices[LL_POINT] + num_cols;
+                cell_vertices[UR_POINT] = cell_vertices[UL_POINT] + 1;
+                cell_vertices[LR_POINT] = cell_vertices[LL_POINT] + 1;
+
+                for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+                {
+                    vertex_easting[vertex] =
+                        points->utm_easting[cell_vertices[vertex]];
+                    vertex_northing[vertex] =
+                        points->utm_northing[cell_vertices[vertex]];
+                }
+
+                shepard_point_weights (cell_vertices, vertex_easting,
+                                       vertex_northing, easting, northing,
+                                       &lattice->nodes[index]);
+            }
+        } /* END - for row */
+
+        free (grid_points);
+    }
+
+    if (abort_lattice)
+    {
+        RETURN_ERROR ("Allocating grid_points memory", FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  interpolate_line_from_lattice
+
+PURPOSE: Generate transmission, upwelled radiance, and downwelled radiance for
+         the valid spans of a line from the lattice.  The weights of the rows
+         of nodes above and below the line are interpolated to the line, then
+         to each sample from the nodes to either side of it, and applied to
+         the height tables at the sample's elevation.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int interpolate_line_from_lattice
+(
+    Input_Data_t *input,         /* I: input structure */
+    POINT_RESULTS *results,      /* I: results from MODTRAN runs */
+    HEIGHT_TABLES *heights,      /* I/O: the height tables */
+    WEIGHT_LATTICE *lattice,     /* I: the lattice for the strip */
+    int line,                    /* I: the line to process */
+    int strip_line,              /* I: line of the strip to process */
+    Valid_Spans_t *spans,        /* I: valid spans of the strip */
+    int16_t *elevation_line,     /* I: elevation for the line in meters */
+    POINT_WEIGHTS *line_weights, /* O: the node weights along the line */
+    float **outputs              /* O: the parameters for the line */
+)
+{
+    char FUNC_NAME[] = "interpolate_line_from_lattice";
+
+    int span;
+    int node;
+    int first_node;
+    int end_node;
+    int node_sample;
+    int node_span;
+    int index;
+
+    double fraction = 0.0;
+
+    LATTICE_INTERVAL interval;
+
+    /* Use local variables for cleaner code */
+    int step = lattice->step;
+    int row = line / step;
+    int row_line = row * step;
+    int lattice_samples = lattice->lattice_samples;
+    POINT_WEIGHTS *nodes =
+        &lattice->nodes[(row - lattice->first_row) * lattice_samples];
+    POINT_WEIGHTS *next_nodes = nodes;
+
+    /* Lines on a row of nodes only use that row */
+    if (line > row_line)
+    {
+        fraction = (double) (line - row_line)
+                   / (min (row_line + step, input->lines - 1) - row_line);
+        next_nodes = nodes + lattice_samples;
+    }
+
+    for (span = spans->line_first_span[strip_line];
+         span < spans->line_first_span[strip_line + 1]; span++)
+    {
+        first_node = spans->span_start[span] / step;
+        end_node = min ((spans->span_end[span] - 1) / step + 1,
+                        lattice_samples - 1);
+
+        for (node = first_node; node <= end_node; node++)
+        {
+            blend_point_weights (&nodes[node], &next_nodes[node], fraction,
+                                 &line_weights[node]);
+        }
+
+        /* Interpolate the samples between each pair of nodes, a node on
+           the last sample has no next node */
+        for (node = first_node; node <= end_node; node++)
+        {
+            node_sample = node * step;
+            if (node_sample >= spans->span_end[span])
+                break;
+
+            node_span = min (node_sample + step, input->samples - 1)
+                        - node_sample;
+            merge_lattice_interval (&line_weights[node],
+                                    &line_weights[min (node + 1, end_node)],
+                                    &interval);
+
+            for (index = 0; index < interval.count; index++)
+            {
+                interval.table[index] = height_table (
+                                            results, interval.point[index],
+                                            heights);
+                if (interval.table[index] == NULL)
+                {
+                    RETURN_ERROR ("Allocating height table memory",
+                                  FUNC_NAME, FAILURE);
+                }
+            }
+
+            interpolate_lattice_run (&interval, heights->min_height,
+                                     node_sample, node_span,
+                                     max (node_sample,
+                                          spans->span_start[span]),
+                                     min (node_sample + step,
+                                          spans->span_end[span]),
+                                     elevation_line,
+                                     outputs[AHP_TRANSMISSION],
+                                     outputs[AHP_UPWELLED_RADIANCE],
+                                     outputs[AHP_DOWNWELLED_RADIANCE]);
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  calculate_line_atmospheric_parameters
+
+PURPOSE: Generate transmission, upwelled radiance, and downwelled radiance for
+         each pixel of a single line.
+
+NOTE: Only the valid spans of the line are processed, the samples outside
+      of them are set to fill together.  The cell for every valid sample is
+      determined first, then each run of samples within a span sharing a
+      cell is interpolated together, so the interpolation can be performed on
+      several samples at a time.
+
+NOTE: With a lattice, the samples are interpolated from the lattice
+      instead, and the cells are only determined for check lines.
+
+NOTE: In single precision or with a lattice, check lines are also
+      interpolated exactly in double precision and the largest deviation is
+      kept in the scratch memory.
+
+NOTE: With a geometry cache, the cells of the samples are taken from the
+      cache when it holds them, otherwise the cells found are recorded in
+      it.
+
+NOTE: Lines are independent of each other, only the scratch memory must not
+      be shared while processing them.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int calculate_line_atmospheric_parameters
+(
+    Input_Data_t *input,         /* I: input structure */
+    REANALYSIS_POINTS *points,   /* I: The coordinate points */
+    POINT_RESULTS *results,      /* I: results from MODTRAN runs */
+    HEIGHT_TABLES *heights,      /* I/O: the height tables */
+    int line,                    /* I: the line to process */
+    int strip_line,              /* I: line of the strip to process */
+    int16_t *elevation_data,     /* I: input elevation data in meters, with
+                                       the lines band_samples apart */
+    bool single_precision,       /* I: interpolate in single precision */
+    WEIGHT_LATTICE *lattice,    /* I: the lattice for the strip, NULL to
+                                       interpolate at every pixel */
+    GEOMETRY_CACHE *cache,       /* I/O: the geometry cache, NULL for
+                                         none */
+    Intermediate_Data_t *inter,  /* I/O: thermal input and outputs */
+    LINE_SCRATCH *scratch        /* I/O: scratch memory for the line */
+)
+{
+    char FUNC_NAME[] = "calculate_line_atmospheric_parameters";
+
+    int sample;
+    int span;
+    int span_end;
+    int run_start;
+    int cached_run;
+    int check_sample;
+    int vertex;
+    int parameter;
+    int cell_vertices[NUM_CELL_POINTS];
+
+    bool first_sample;
+    bool check_line;
+
+    double easting;
+    double northing;
+    double deviation;
+
+    float *outputs[AHP_NUM_PARAMETERS];
+
+    RUN_CELL cell;
+    CELL_WALKER walker;
+
+    int center_point;
+    int verify_vertex;
+    double verify_margin;
+
+    /* Use local variables for cleaner code */
+    int num_cols = points->num_cols;
+    int samples = input->samples;
+    int *cells = scratch->cells;
+    size_t pixel_line_loc = (size_t) strip_line * samples;
+    int16_t *elevation_line =
+        &elevation_data[(size_t) strip_line * input->band_samples];
+    Valid_Spans_t *spans = &inter->spans;
+    int first_span = spans->line_first_span[strip_line];
+    int end_span = spans->line_first_span[strip_line + 1];
+    float no_data = LST_NO_DATA_VALUE;
+
+    outputs[AHP_TRANSMISSION] = &inter->band_transmittance[pixel_line_loc];
+    outputs[AHP_UPWELLED_RADIANCE] = &inter->band_upwelled[pixel_line_loc];
+    outputs[AHP_DOWNWELLED_RADIANCE] =
+        &inter->band_downwelled[pixel_line_loc];
+
+    check_line = (single_precision || lattice != NULL)
+                 && (line % SINGLE_PRECISION_CHECK_INTERVAL) == 0;
+
+    /* Determine UTM northing for current line */
+    northing = input->meta.ul_map_corner.y - (line * input->y_pixel_size);
+
+    /* Set the samples outside of the valid spans to fill */
+    for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+    {
+        fill_invalid_samples (spans, strip_line, samples, outputs[parameter],
+                              &no_data, sizeof (float));
+    }
+
+#if OUTPUT_CELL_DESIGNATION_BAND
+    memset (&inter->band_cell[pixel_line_loc], 0, samples);
+#endif
+
+    if (lattice != NULL)
+    {
+        if (interpolate_line_from_lattice (input, results, heights, lattice,
+                                           line, strip_line, spans,
+                                           elevation_line,
+                                           scratch->line_weights, outputs)
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Interpolating from the lattice", FUNC_NAME,
+                          FAILURE);
+        }
+
+        /* Only check lines need the cells */
+        if (!check_line)
+            return SUCCESS;
+    }
+
+    /* Set first_sample to be true */
+    first_sample = true;
+    cached_run = 0;
+    for (span = first_span; span < end_span; span++)
+    {
+        for (sample = spans->span_start[span];
+             sample < spans->span_end[span]; sample++)
+        {
+            /* Use the cell from the geometry cache when it holds one */
+            if (cache != NULL && cache->hit)
+            {
+                cells[sample] = cached_sample_cell (&cache->line_runs[line],
+                                                    sample, &cached_run);
+                if (cells[sample] >= 0)
+                {
+                    /* The cell search starts over at the next sample not
+                       cached */
+                    first_sample = true;
+#if OUTPUT_CELL_DESIGNATION_BAND
+                    inter->band_cell[pixel_line_loc + sample] = cells[sample];
+#endif
+                    continue;
+                }
+
+                scratch->checks.cache_fallbacks++;
+            }
+
+            /* Determine UTM easting for current line/sample */
+            easting = input->meta.ul_map_corner.x
+                + (sample * input->x_pixel_size);
+
+            /* Determine the cell to use, carrying the cell from the previous
+               sample forward when it is known to still hold */
+            cells[sample] = walk_to_sample (points, easting, northing,
+                                            sample, input->x_pixel_size,
+                                            first_sample,
+                                            scratch->grid_points, &walker);
+
+            /* Determine the cell without carrying it forward */
+            if (scratch->verify_grid_points != NULL)
+            {
+                verify_vertex = determine_cell_vertex (
+                                    points, easting, northing, first_sample,
+                                    scratch->verify_grid_points,
+                                    &center_point, &verify_margin);
+                if (verify_vertex != cells[sample])
+                {
+                    scratch->checks.verify_mismatches++;
+                }
+            }
+
+            /* Set first_sample to be false */
+            first_sample = false;
+
+#if OUTPUT_CELL_DESIGNATION_BAND
+            inter->band_cell[pixel_line_loc + sample] = cells[sample];
+#endif
+        } /* END - for sample */
+    } /* END - for span */
+
+    /* Record the cells for the later acquisitions */
+    if (cache != NULL && !cache->hit)
+    {
+        if (record_cell_runs (cache, line, spans, strip_line, cells)
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Recording the cells in the geometry cache",
+                          FUNC_NAME, FAILURE);
+        }
+    }
+
+    /* Interpolate each run of samples within a span which share a cell */
+    span = first_span;
+    sample = 0;
+    while (span < end_span)
+    {
+        span_end = spans->span_end[span];
+        if (sample < spans->span_start[span])
+            sample = spans->span_start[span];
+
+        if (sample >= span_end)
+        {
+            /* Move on to the next span */
+            span++;
+            continue;
+        }
+
+        run_start = sample;
+        while (sample < span_end && cells[sample] == cells[run_start])
+        {
+            sample++;
+        }
+
+        /* LL Point */
+        cell_vertices[LL_POINT] = cells[run_start];
+        /* UL Point */
+        cell_vertices[UL_POINT] = cell_vertices[LL_POINT] + num_cols;
+        /* UR Point */
+        cell_vertices[UR_POINT] = cell_vertices[UL_POINT] + 1;
+        /* LR Point */
+        cell_vertices[LR_POINT] = cell_vertices[LL_POINT] + 1;
+
+        /* retrieve the location of each vertex and its parameters at each
+           elevation */
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            cell.easting[vertex] = points->utm_easting[cell_vertices[vertex]];
+            cell.northing[vertex] =
+                points->utm_northing[cell_vertices[vertex]];
+
+            if (!single_precision || check_line)
+            {
+                cell.table[vertex] = height_table (
+                                         results, cell_vertices[vertex],
+                                         heights);
+                if (cell.table[vertex] == NULL)
+                {
+                    RETURN_ERROR ("Allocating height table memory",
+                                  FUNC_NAME, FAILURE);
+                }
+            }
+
+            if (single_precision)
+            {
+                cell.float_table[vertex] = height_table_float (
+                                               results, cell_vertices[vertex],
+                                               heights);
+                if (cell.float_table[vertex] == NULL)
+                {
+                    RETURN_ERROR ("Allocating float height table memory",
+                                  FUNC_NAME, FAILURE);
+                }
+            }
+        }
+
+        /* interpolate parameters at appropriate height to location of
+           each pixel of the run, unless already interpolated from the
+           lattice */
+        if (lattice == NULL && single_precision)
+        {
+            interpolate_run_float (&cell, heights->min_height,
+                                   input->meta.ul_map_corner.x,
+                                   input->x_pixel_size, northing,
+                                   run_start, sample,
+                                   elevation_line,
+                                   outputs[AHP_TRANSMISSION],
+                                   outputs[AHP_UPWELLED_RADIANCE],
+                                   outputs[AHP_DOWNWELLED_RADIANCE]);
+        }
+        else if (lattice == NULL)
+        {
+            interpolate_run (&cell, heights->min_height,
+                             input->meta.ul_map_corner.x,
+                             input->x_pixel_size, northing,
+                             run_start, sample,
+                             elevation_line,
+                             outputs[AHP_TRANSMISSION],
+                             outputs[AHP_UPWELLED_RADIANCE],
+                             outputs[AHP_DOWNWELLED_RADIANCE]);
+        }
+
+        if (check_line)
+        {
+            /* Compare with the exact double precision results */
+            interpolate_run (&cell, heights->min_height,
+                             input->meta.ul_map_corner.x,
+                             input->x_pixel_size, northing,
+                             run_start, sample,
+                             elevation_line,
+                             scratch->check[AHP_TRANSMISSION],
+                             scratch->check[AHP_UPWELLED_RADIANCE],
+                             scratch->check[AHP_DOWNWELLED_RADIANCE]);
+
+            for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+            {
+                for (check_sample = run_start; check_sample < sample;
+                     check_sample++)
+                {
+                    deviation = fabs (
+                        (double) outputs[parameter][check_sample]
+                        - scratch->check[parameter][check_sample]);
+                    if (deviation > scratch->checks.max_deviation[parameter])
+                        scratch->checks.max_deviation[parameter] = deviation;
+                }
+            }
+        }
+    }
+
+    if (check_line)
+        scratch->checks.lines_checked++;
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  calculate_strip_atmospheric_parameters
+
+PURPOSE: Generate transmission, upwelled radiance, and downwelled radiance for
+         each pixel of a strip of lines held in the intermediate bands, and
+         optionally the land surface temperature from them.  With a lattice,
+         the lattice nodes the strip uses are evaluated first.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int calculate_strip_atmospheric_parameters
+(
+    Input_Data_t *input,         /* I: input structure */
+    REANALYSIS_POINTS *points,   /* I: The coordinate points */
+    POINT_RESULTS *results,      /* I: results from MODTRAN runs */
+    HEIGHT_TABLES *heights,      /* I/O: the height tables */
+    int first_line,              /* I: first line of the strip */
+    int strip_lines,             /* I: number of lines in the strip */
+    int16_t *elevation_data,     /* I: elevation data for the strip, with
+                                       the lines band_samples apart */
+    bool single_precision,       /* I: interpolate in single precision */
+    bool verify_cells,           /* I: check the cells carried forward
+                                       against a search at every sample */
+    bool verbose,                /* I: value to indicate if intermediate
+                                       messages be printed */
+    WEIGHT_LATTICE *lattice,    /* I/O: the lattice, NULL to interpolate at
+                                         every pixel */
+    GEOMETRY_CACHE *cache,       /* I/O: the geometry cache, NULL for
+                                         none */
+    Intermediate_Data_t *inter,  /* I/O: thermal input and outputs for the
+                                         strip */
+    Surface_Temperature_t *lst,  /* I/O: emissivity input and LST output for
+                                         the strip, NULL to not generate
+                                         the LST */
+    PIXEL_CHECKS *checks         /* I/O: checks made while processing */
+)
+{
+    char FUNC_NAME[] = "calculate_strip_atmospheric_parameters";
+
+    int line;
+
+    bool abort_pixels = false;
+
+    LINE_SCRATCH scratch;
+
+    /* Use local variables for cleaner code */
+    int num_points = points->num_points;
+    int lattice_samples = 0;
+
+    if (lattice != NULL)
+    {
+        if (build_strip_lattice (input, points, first_line,
+                                 strip_lines, &inter->spans, cache,
+                                 lattice)
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Building the lattice", FUNC_NAME, FAILURE);
+        }
+
+        lattice_samples = lattice->lattice_samples;
+    }
+
+    /* Loop through each line in the strip
+
+       The lines are independent of each other, so they are distributed
+       across the threads.  They are handed out round robin, a line at a
+       time, which is the way allocate_scene_buffer first touched them, so
+       each thread works on lines held on its own NUMA node.  Lines that are
+       mostly fill take much less time than lines that are not, but they
+       run across the scene together, so they are spread evenly across the
+       threads. */
+#ifdef _OPENMP
+    #pragma omp parallel private(line, scratch) shared(abort_pixels)
+#endif
+    {
+        if (allocate_line_scratch (num_points, input->samples,
+                                   lattice_samples, verify_cells, &scratch)
+            != SUCCESS)
+        {
+            abort_pixels = true;
+#ifdef _OPENMP
+            #pragma omp flush (abort_pixels)
+#endif
+        }
+
+#ifdef _OPENMP
+        #pragma omp for schedule(static, 1)
+#endif
+        for (line = first_line; line < first_line + strip_lines; line++)
+        {
+#ifdef _OPENMP
+            #pragma omp flush (abort_pixels)
+#endif
+            if (!abort_pixels)
+            {
+                /* Print status on every 1000 lines */
+                if (!(line % 1000))
+                {
+                    if (verbose)
+                    {
+                        printf ("Processing line %d\r", line);
+                        fflush (stdout);
+                    }
+                }
+
+                if (calculate_line_atmospheric_parameters (
+                        input, points, results, heights, line,
+                        line - first_line, elevation_data, single_precision,
+                        lattice, cache, inter, &scratch)
+                    != SUCCESS)
+                {
+                    abort_pixels = true;
+#ifdef _OPENMP
+                    #pragma omp flush (abort_pixels)
+#endif
+                }
+                else if (lst != NULL)
+                {
+                    calculate_line_surface_temperature (
+                        lst, inter, line - first_line, input->samples);
+                }
+            }
+        } /* END - for line */
+
+#ifdef _OPENMP
+        #pragma omp critical (pixel_checks)
+#endif
+        merge_pixel_checks (&scratch.checks, checks);
+
+        free_line_scratch (&scratch);
+    }
+
+    /* If we aborted processing of a line for some reason, then error */
+    if (abort_pixels)
+    {
+        RETURN_ERROR ("Processing pixel lines", FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  calculate_pixel_atmospheric_parameters
+
+PURPOSE: Generate transmission, upwelled radiance, and downwelled radiance at
+         each Landsat pixel
+
+NOTE: The scene is read, processed, and written a strip of lines at a time,
+      so only a strip of each band is held in memory.  The bands are read an
+      extra time beforehand to find the elevation range of the scene.
+
+NOTE: With more than one strip, two sets of strip buffers are used, so the
+      previous strip can be written and the next strip read in the
+      background while the current strip is processed.
+
+NOTE: When the land surface temperature is generated here, the intermediate
+      bands do not need to be written for build_lst_data, so they are only
+      written when requested.
+
+NOTE: With a geometry cache directory, the cells found for the samples and
+      lattice nodes are kept for each path/row, and used instead of
+      searching for the cells when the scene has the same geometry.
+
+NOTE: With a lattice step, the weights of the cell vertices are only
+      determined at the lattice nodes, and each pixel is interpolated at its
+      own height with the weights blended between the nodes.  Check lines
+      are also interpolated exactly, to report how far the lattice deviates.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int calculate_pixel_atmospheric_parameters
+(
+    Input_Data_t *input,       /* I: input structure */
+    REANALYSIS_POINTS *points, /* I: The coordinate points */
+    char *xml_filename,        /* I: XML filename */
+    double **modtran_results,  /* I: results from MODTRAN runs */
+    int strip_lines,           /* I: number of lines to process at a time,
+                                     0 for the whole scene */
+    int lattice_step,          /* I: pixels between the lattice nodes, 0 to
+                                     interpolate at every pixel */
+    char *geometry_cache_dir,  /* I: directory of the geometry cache, empty
+                                     for none */
+    bool single_precision,     /* I: interpolate in single precision */
+    bool verify_cells,         /* I: check the cells carried forward along
+                                     each line against a search at every
+                                     sample */
+    bool generate_lst,         /* I: generate the land surface temperature
+                                     from the emissivity band */
+    bool write_intermediate_bands, /* I: write the intermediate bands */
+    bool compact_intermediate, /* I: write the intermediate bands as scaled
+                                     16 bit integers */
+    bool geotiff,              /* I: write the bands as GeoTIFFs */
+    bool verbose               /* I: value to indicate if intermediate
+                                     messages be printed */
+)
+{
+    char FUNC_NAME[] = "calculate_pixel_atmospheric_parameters";
+
+    int first_line;
+    int lines_in_strip;
+    int next_lines;
+    int current;
+    size_t previous_pixel_count;
+    int min_height = INT16_MAX;
+    int max_height = INT16_MIN;
+    int status;
+
+    bool multiple_strips;
+
+    Espa_data_type_t inter_data_type = ESPA_FLOAT32;
+    float radiance_scale = ESPA_FLOAT_META_FILL;
+    float trans_scale = ESPA_FLOAT_META_FILL;
+    float inter_offset = ESPA_FLOAT_META_FILL;
+
+    PIXEL_CHECKS checks;
+
+    WEIGHT_LATTICE lattice;
+
+    GEOMETRY_CACHE cache;
+    bool use_cache = (geometry_cache_dir[0] != '\0');
+
+    POINT_RESULTS results;
+    HEIGHT_TABLES heights;
+
+    STRIP_IO strip_io;
+
+    /* Two sets of strip buffers, the second is only used with more than one
+       strip */
+    Intermediate_Data_t inter[2];
+    Surface_Temperature_t lst[2];
+
+    int16_t *elevation_data[2] = {NULL, NULL}; /* input elevation data in
+                                                  meters for the strip,
+                                                  within the band mapping */
+
+    char msg[MAX_STR_LEN];
+    char *lst_data_dir = NULL;
+
+    /* Use local variables for cleaner code */
+    int num_points = points->num_points;
+
+    size_t pixel_count = (size_t) input->lines * input->samples;
+    size_t strip_pixel_count;
+
+    /* Grab the environment path to the LST_DATA_DIR */
+    lst_data_dir = getenv ("LST_DATA_DIR");
+    if (lst_data_dir == NULL)
+    {
+        RETURN_ERROR ("LST_DATA_DIR environment variable is not set",
+                      FUNC_NAME, FAILURE);
+    }
+
+    /* Determine the size of the strips */
+    if (strip_lines <= 0 || strip_lines > input->lines)
+    {
+        strip_lines = input->lines;
+        if (pixel_count > MAX_STRIP_PIXELS)
+        {
+            strip_lines = max (1, (int) (MAX_STRIP_PIXELS / input->samples));
+            snprintf (msg, sizeof (msg), "The scene is too large to process"
+                      " at once, using strips of %d lines", strip_lines);
+            LOG_MESSAGE (msg, FUNC_NAME);
+        }
+    }
+    multiple_strips = (strip_lines < input->lines);
+    strip_pixel_count = (size_t) strip_lines * input->samples;
+
+    if (lattice_step > 0)
+    {
+        /* The lattice interpolation is always in double precision */
+        if (single_precision)
+        {
+            WARNING_MESSAGE ("Single precision is not used with a lattice",
+                             FUNC_NAME);
+            single_precision = false;
+        }
+
+        if (allocate_weight_lattice (lattice_step, input->lines,
+                                      input->samples, strip_lines, &lattice)
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Allocating the lattice", FUNC_NAME, FAILURE);
+        }
+    }
+
+    if (use_cache)
+    {
+        /* Use the cells found for an earlier acquisition of the path/row */
+        if (open_geometry_cache (geometry_cache_dir, input, points,
+                                 lattice_step,
+                                 lattice_step > 0
+                                     ? lattice.lattice_lines
+                                       * lattice.lattice_samples
+                                     : 0,
+                                 &cache)
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Opening the geometry cache", FUNC_NAME, FAILURE);
+        }
+
+        snprintf (msg, sizeof (msg), "Geometry cache %s: %s",
+                  cache.hit ? "used" : "will be written", cache.filename);
+        LOG_MESSAGE (msg, FUNC_NAME);
+    }
+
+    if (write_intermediate_bands)
+    {
+        /* Open the intermedate data files */
+        if (open_intermediate(input, geotiff, compact_intermediate,
+                              &inter[0]) != SUCCESS)
+        {
+            RETURN_ERROR("Opening intermediate data files", FUNC_NAME,
+                         FAILURE);
+        }
+    }
+    else
+    {
+        /* Only the memory for the intermediate data is used */
+        memset (&inter[0], 0, sizeof (inter[0]));
+    }
+
+    /* Allocate memory for the intermedate data */
+    if (allocate_intermediate(&inter[0], strip_lines,
+                              input->samples) != SUCCESS)
+    {
+        RETURN_ERROR("Allocating memory for intermediate data",
+                     FUNC_NAME, FAILURE);
+    }
+
+    if (multiple_strips)
+    {
+        /* The second set of buffers writes to the same files */
+        inter[1] = inter[0];
+        if (allocate_intermediate(&inter[1], strip_lines,
+                                  input->samples) != SUCCESS)
+        {
+            RETURN_ERROR("Allocating memory for intermediate data",
+                         FUNC_NAME, FAILURE);
+        }
+    }
+
+    if (generate_lst)
+    {
+        if (input->band_map[I_BAND_EMISSIVITY] == NULL)
+        {
+            RETURN_ERROR ("The emissivity band is required to generate the"
+                          " land surface temperature", FUNC_NAME, FAILURE);
+        }
+
+        /* Open the land surface temperature file and read the brightness
+           temperature LUT */
+        if (open_surface_temperature (input, lst_data_dir, geotiff,
+                                      &lst[0])
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Opening land surface temperature data",
+                          FUNC_NAME, FAILURE);
+        }
+
+        /* Allocate memory for the emissivity and land surface
+           temperature */
+        if (allocate_surface_temperature (&lst[0], strip_lines,
+                                          input->samples)
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Allocating memory for land surface temperature"
+                          " data", FUNC_NAME, FAILURE);
+        }
+
+        if (multiple_strips)
+        {
+            /* The second set of buffers writes to the same file and uses
+               the same LUT */
+            lst[1] = lst[0];
+            if (allocate_surface_temperature (&lst[1], strip_lines,
+                                              input->samples)
+                != SUCCESS)
+            {
+                RETURN_ERROR ("Allocating memory for land surface"
+                              " temperature data", FUNC_NAME, FAILURE);
+            }
+        }
+    }
+
+    /* Determine the elevation range of the scene */
+    if (find_elevation_range (input, &min_height, &max_height) != SUCCESS)
+    {
+        RETURN_ERROR ("Finding the elevation range", FUNC_NAME, FAILURE);
+    }
+
+    /* Rearrange the MODTRAN results for the interpolation */
+    if (allocate_point_results (modtran_results, num_points, &results)
+        != SUCCESS)
+    {
+        RETURN_ERROR ("Allocating point results", FUNC_NAME, FAILURE);
+    }
+
+    /* Setup the tables of parameters interpolated to each elevation */
+    if (allocate_height_tables (num_points, min_height, max_height, &heights)
+        != SUCCESS)
+    {
+        RETURN_ERROR ("Allocating height tables", FUNC_NAME, FAILURE);
+    }
+
+    if (verbose)
+    {
+        LOG_MESSAGE("Iterate through all pixels in Landsat scene",
+                    FUNC_NAME);
+        snprintf(msg, sizeof(msg), "Pixel Count = %zu", pixel_count);
+        LOG_MESSAGE(msg, FUNC_NAME);
+        snprintf(msg,  sizeof(msg),"Lines = %d, Samples = %d",
+                 input->lines, input->samples);
+        LOG_MESSAGE(msg, FUNC_NAME);
+        snprintf(msg,  sizeof(msg),"Lines per strip = %d", strip_lines);
+        LOG_MESSAGE(msg, FUNC_NAME);
+        if (lattice_step > 0)
+        {
+            snprintf(msg, sizeof(msg), "Pixels between lattice nodes = %d",
+                     lattice_step);
+            LOG_MESSAGE(msg, FUNC_NAME);
+        }
+    }
+
+    initialize_pixel_checks (&checks);
+
+    initialize_strip_io (input, generate_lst, write_intermediate_bands,
+                         &strip_io);
+
+    /* Read the first strip */
+    strip_io.read_inter = &inter[0];
+    strip_io.read_lst = &lst[0];
+    strip_io.read_elevation = &elevation_data[0];
+    strip_io.read_pixel_count = strip_pixel_count;
+    if (perform_strip_io (&strip_io) != SUCCESS)
+    {
+        RETURN_ERROR ("Reading the first strip", FUNC_NAME, FAILURE);
+    }
+
+    /* Loop through each strip in the image */
+    current = 0;
+    previous_pixel_count = 0;
+    for (first_line = 0; first_line < input->lines; first_line += strip_lines)
+    {
+        lines_in_strip = min (strip_lines, input->lines - first_line);
+        next_lines = min (strip_lines,
+                          input->lines - (first_line + lines_in_strip));
+
+        /* In the background, write the previous strip and then read the
+           next strip into the same buffers */
+        strip_io.write_inter = NULL;
+        if (previous_pixel_count > 0)
+        {
+            strip_io.write_inter = &inter[1 - current];
+            strip_io.write_lst = &lst[1 - current];
+            strip_io.write_pixel_count = previous_pixel_count;
+        }
+
+        strip_io.read_inter = NULL;
+        if (next_lines > 0)
+        {
+            strip_io.read_inter = &inter[1 - current];
+            strip_io.read_lst = &lst[1 - current];
+            strip_io.read_elevation = &elevation_data[1 - current];
+            strip_io.read_pixel_count = (size_t) next_lines * input->samples;
+        }
+
+        if (start_strip_io (&strip_io) != SUCCESS)
+        {
+            RETURN_ERROR ("Starting the strip reads and writes", FUNC_NAME,
+                          FAILURE);
+        }
+
+        status = calculate_strip_atmospheric_parameters (
+                     input, points, &results, &heights, first_line,
+                     lines_in_strip, elevation_data[current],
+                     single_precision, verify_cells, verbose,
+                     lattice_step > 0 ? &lattice : NULL,
+                     use_cache ? &cache : NULL, &inter[current],
+                     generate_lst ? &lst[current] : NULL, &checks);
+
+        /* Always wait, so the buffers are not released while in use */
+        if (wait_strip_io (&strip_io) != SUCCESS)
+        {
+            RETURN_ERROR ("Reading and writing the strips", FUNC_NAME,
+                          FAILURE);
+        }
+
+        if (status != SUCCESS)
+        {
+            RETURN_ERROR ("Processing pixel strip", FUNC_NAME, FAILURE);
+        }
+
+        previous_pixel_count = (size_t) lines_in_strip * input->samples;
+        current = 1 - current;
+    } /* END - for strip */
+
+    /* Write the last strip */
+    strip_io.write_inter = &inter[1 - current];
+    strip_io.write_lst = &lst[1 - current];
+    strip_io.write_pixel_count = previous_pixel_count;
+    strip_io.read_inter = NULL;
+    if (perform_strip_io (&strip_io) != SUCCESS)
+    {
+        RETURN_ERROR ("Writing the last strip", FUNC_NAME, FAILURE);
+    }
+
+    if (verbose)
+    {
+        snprintf (msg, sizeof (msg),
+                  "Strip I/O seconds: read %.3f, write %.3f, waited %.3f,"
+                  " hidden %.3f", strip_io.read_seconds,
+                  strip_io.write_seconds, strip_io.wait_seconds,
+                  max (0.0, strip_io.read_seconds + strip_io.write_seconds
+                            - strip_io.wait_seconds));
+        LOG_MESSAGE (msg, FUNC_NAME);
+    }
+
+    if (verify_cells)
+    {
+        snprintf (msg, sizeof (msg), "Cell designation mismatches = %ld",
+                  checks.verify_mismatches);
+        if (checks.verify_mismatches != 0)
+        {
+            WARNING_MESSAGE (msg, FUNC_NAME);
+        }
+        else
+        {
+            LOG_MESSAGE (msg, FUNC_NAME);
+        }
+    }
+
+    if (single_precision)
+    {
+        snprintf (msg, sizeof (msg),
+                  "Single precision maximum absolute deviation from double"
+                  " precision over %d lines: transmittance %g,"
+                  " upwelled radiance %g, downwelled radiance %g",
+                  checks.lines_checked,
+                  checks.max_deviation[AHP_TRANSMISSION],
+                  checks.max_deviation[AHP_UPWELLED_RADIANCE],
+                  checks.max_deviation[AHP_DOWNWELLED_RADIANCE]);
+        LOG_MESSAGE (msg, FUNC_NAME);
+    }
+
+    if (lattice_step > 0)
+    {
+        snprintf (msg, sizeof (msg),
+                  "Lattice maximum absolute deviation from exact"
+                  " interpolation over %d lines: transmittance %g,"
+                  " upwelled radiance %g, downwelled radiance %g",
+                  checks.lines_checked,
+                  checks.max_deviation[AHP_TRANSMISSION],
+                  checks.max_deviation[AHP_UPWELLED_RADIANCE],
+                  checks.max_deviation[AHP_DOWNWELLED_RADIANCE]);
+        LOG_MESSAGE (msg, FUNC_NAME);
+
+        free_weight_lattice (&lattice);
+    }
+
+    if (use_cache)
+    {
+        if (cache.hit)
+        {
+            snprintf (msg, sizeof (msg), "Samples not held in the geometry"
+                      " cache = %ld", checks.cache_fallbacks);
+            LOG_MESSAGE (msg, FUNC_NAME);
+        }
+
+        /* Only the cells found for this acquisition are written */
+        close_geometry_cache (&cache, !cache.hit);
+    }
+
+    /* Free allocated memory */
+    free_height_tables(num_points, &heights);
+
+    free_point_results(&results);
+
+    free_intermediate(&inter[0]);
+    if (multiple_strips)
+        free_intermediate(&inter[1]);
+
+    if (generate_lst)
+    {
+        free_surface_temperature (&lst[0]);
+        if (multiple_strips)
+            free_surface_temperature (&lst[1]);
+
+        /* Close the land surface temperature file */
+        if (close_surface_temperature (&lst[0]) != SUCCESS)
+        {
+            RETURN_ERROR ("Closing land surface temperature file",
+                          FUNC_NAME, FAILURE);
+        }
+
+        if (add_lst_band_product(xml_filename, input,
+                                 lst[0].lst_filename,
+                                 LST_PRODUCT_NAME,
+                                 LST_BAND_NAME,
+                                 LST_SHORT_NAME,
+                                 LST_LONG_NAME,
+                                 LST_TEMPERATURE_UNITS,
+                                 LST_VALID_MIN, LST_VALID_MAX,
+                                 ESPA_INT16, LST_SCALE_FACTOR, 0.0)
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Failed adding LST band product", FUNC_NAME,
+                          FAILURE);
+        }
+    }
+
+    if (write_intermediate_bands)
+    {
+        /* Close the intermediate binary files */
+        if (close_intermediate(&inter[0]) != SUCCESS)
+        {
+            sprintf (msg, "Closing file intermediate data files");
+            RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        }
+
+        /* The compact bands record how to decode them */
+        if (compact_intermediate)
+        {
+            inter_data_type = ESPA_INT16;
+            radiance_scale = LST_COMPACT_RADIANCE_SCALE_FACTOR;
+            trans_scale = LST_COMPACT_TRANS_SCALE_FACTOR;
+            inter_offset = LST_COMPACT_ADD_OFFSET;
+        }
+
+        if (add_lst_band_product(xml_filename, input,
+                                 inter[0].thermal_filename,
+                                 LST_THERMAL_RADIANCE_PRODUCT_NAME,
+                                 LST_THERMAL_RADIANCE_BAND_NAME,
+                                 LST_THERMAL_RADIANCE_SHORT_NAME,
+                                 LST_THERMAL_RADIANCE_LONG_NAME,
+                                 LST_RADIANCE_UNITS,
+                                 0.0, 0.0,
+                                 inter_data_type, radiance_scale, inter_offset)
+            != SUCCESS)
+        {
+            ERROR_MESSAGE ("Failed adding LST band product", FUNC_NAME);
+        }
+
+        if (add_lst_band_product(xml_filename, input,
+                                 inter[0].transmittance_filename,
+                                 LST_ATMOS_TRANS_PRODUCT_NAME,
+                                 LST_ATMOS_TRANS_BAND_NAME,
+                                 LST_ATMOS_TRANS_SHORT_NAME,
+                                 LST_ATMOS_TRANS_LONG_NAME,
+                                 LST_RADIANCE_UNITS,
+                                 0.0, 0.0,
+                                 inter_data_type, trans_scale, inter_offset)
+            != SUCCESS)
+        {
+            ERROR_MESSAGE ("Failed adding LST band product", FUNC_NAME);
+        }
+
+        if (add_lst_band_product(xml_filename, input,
+                                 inter[0].upwelled_filename,
+                                 LST_UPWELLED_RADIANCE_PRODUCT_NAME,
+                                 LST_UPWELLED_RADIANCE_BAND_NAME,
+                                 LST_UPWELLED_RADIANCE_SHORT_NAME,
+                                 LST_UPWELLED_RADIANCE_LONG_NAME,
+                                 LST_RADIANCE_UNITS,
+                                 0.0, 0.0,
+                                 inter_data_type, radiance_scale, inter_offset)
+            != SUCCESS)
+        {
+            ERROR_MESSAGE ("Failed adding LST band product", FUNC_NAME);
+        }
+
+        if (add_lst_band_product(xml_filename, input,
+                                 inter[0].downwelled_filename,
+                                 LST_DOWNWELLED_RADIANCE_PRODUCT_NAME,
+                                 LST_DOWNWELLED_RADIANCE_BAND_NAME,
+                                 LST_DOWNWELLED_RADIANCE_SHORT_NAME,
+                                 LST_DOWNWELLED_RADIANCE_LONG_NAME,
+                                 LST_RADIANCE_UNITS,
+                                 0.0, 0.0,
+                                 inter_data_type, radiance_scale, inter_offset)
+            != SUCCESS)
+        {
+            ERROR_MESSAGE ("Failed adding LST band product", FUNC_NAME);
+        }
     }
 
     return SUCCESS;
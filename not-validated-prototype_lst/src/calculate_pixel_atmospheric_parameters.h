@@ -16,6 +16,22 @@ int calculate_pixel_atmospheric_parameters
     REANALYSIS_POINTS *points, /* I: The coordinate points */
     char *xml_filename,        /* I: XML filename */
     double **modtran_results,  /* I: atmospheric parameter for MODTRAN run */
+    int strip_lines,           /* I: number of lines to process at a time,
+                                     0 for the whole scene */
+    int lattice_step,          /* I: pixels between the lattice nodes, 0 to
+                                     interpolate at every pixel */
+    char *geometry_cache_dir,  /* I: directory of the geometry cache, empty
+                                     for none */
+    bool single_precision,     /* I: interpolate in single precision */
+    bool verify_cells,         /* I: check the cells carried forward along
+                                     each line against a search at every
+                                     sample */
+    bool generate_lst,         /* I: generate the land surface temperature
+                                     from the emissivity band */
+    bool write_intermediate_bands, /* I: write the intermediate bands */
+    bool compact_intermediate, /* I: write the intermediate bands as scaled
+                                     16 bit integers */
+    bool geotiff,              /* I: write the bands as GeoTIFFs */
     bool verbose               /* I: value to indicate if intermediate
                                      messages will be printed */
 );
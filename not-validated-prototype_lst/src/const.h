@@ -31,6 +31,25 @@
 #define LST_DOWNWELLED_RADIANCE_SHORT_NAME "LST_DOWNWELLED_RADIANCE"
 #define LST_DOWNWELLED_RADIANCE_LONG_NAME "downwelled radiance"
 
+/* Scale factors and offset of the intermediate bands when they are written
+   compactly, as scaled 16 bit integers */
+#define LST_COMPACT_RADIANCE_SCALE_FACTOR (0.001)
+#define LST_COMPACT_TRANS_SCALE_FACTOR (0.0001)
+#define LST_COMPACT_ADD_OFFSET (0.0)
+
+#define LST_EMISSIVITY_PRODUCT_NAME "lst_temp"
+#define LST_EMISSIVITY_BAND_NAME "landsat_emis"
+
+#define LST_PRODUCT_NAME "lst"
+#define LST_BAND_NAME "land_surface_temperature"
+#define LST_SHORT_NAME "LST"
+#define LST_LONG_NAME "Land Surface Temperature"
+#define LST_TEMPERATURE_UNITS "temperature (kelvin)"
+#define LST_MULT_FACTOR (10.0)
+#define LST_SCALE_FACTOR (0.1)
+#define LST_VALID_MIN (1500)
+#define LST_VALID_MAX (3730)
+
 
 #define TWO_PI (2.0 * PI)
 #define HALF_PI (PI / 2.0)
@@ -61,6 +80,16 @@
 #define MAX_STR_LEN 512
 
 
+/* How far a region of interest corner may be from a pixel edge, in pixels,
+   and still be taken as on it */
+#define ROI_PIXEL_TOLERANCE (1e-6)
+
+/* Distance (meters) beyond the region of interest the NARR points are kept
+   for.  It is more than the NARR point spacing (about 32km), so the cells
+   holding the pixels at the edges of the window are kept. */
+#define ROI_POINT_BUFFER (40000.0)
+
+
 #define UTM_SCALE_FACTOR (0.9996)
 #define UTM_EQUATORIAL_RADIUS (6378137.0)
 #define UTM_POLAR_RADIUS (6356752.3142)
@@ -105,6 +134,8 @@ typedef enum
 {
     I_BAND_THERMAL,
     I_BAND_ELEVATION, /* This band and above are all from the XML */
+    I_BAND_EMISSIVITY, /* Optional, only present once the emissivity has
+                          been estimated */
     MAX_INPUT_BANDS
 } Input_Bands_e;
 
@@ -0,0 +1,78 @@
+
+#include <stdio.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "cpu_kernels.h"
+
+
+/* The variant used by the kernels, the scalar code until one is selected */
+static Cpu_Kernels_t selected_kernels = CPU_KERNELS_SCALAR;
+
+static char *kernel_names[CPU_KERNELS_MAX] =
+{
+    "scalar",
+    "AVX2",
+    "AVX-512"
+};
+
+
+/*****************************************************************************
+METHOD:  select_cpu_kernels
+
+PURPOSE: Determines the widest variant of the vector kernels the processor
+         supports, through CPUID, and uses it from then on.  The variant is
+         logged, so the processing can be matched to the hardware.
+
+NOTE: This is to be called once at startup, before any threads use the
+      kernels.
+
+RETURN: Cpu_Kernels_t - the variant selected
+
+*****************************************************************************/
+Cpu_Kernels_t select_cpu_kernels
+(
+    Cpu_Kernels_t limit /* I: widest variant allowed, CPU_KERNELS_MAX for
+                              the widest the processor supports */
+)
+{
+    char FUNC_NAME[] = "select_cpu_kernels";
+    char msg[MAX_STR_LEN];
+
+    Cpu_Kernels_t kernels = CPU_KERNELS_SCALAR;
+
+#if CPU_KERNELS_DISPATCH
+    /* These also check that the operating system saves the registers */
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx512f"))
+        kernels = CPU_KERNELS_AVX512;
+    else if (__builtin_cpu_supports ("avx2"))
+        kernels = CPU_KERNELS_AVX2;
+#endif
+
+    if (kernels > limit)
+        kernels = limit;
+    selected_kernels = kernels;
+
+    snprintf (msg, sizeof (msg), "Using the %s vector kernels",
+              kernel_names[kernels]);
+    LOG_MESSAGE (msg, FUNC_NAME);
+
+    return kernels;
+}
+
+
+/*****************************************************************************
+METHOD:  cpu_kernels
+
+PURPOSE: Provides the variant of the vector kernels to use.
+
+RETURN: Cpu_Kernels_t - the variant selected
+
+*****************************************************************************/
+Cpu_Kernels_t cpu_kernels (void)
+{
+    return selected_kernels;
+}
+
@@ -0,0 +1,49 @@
+
+#ifndef CPU_KERNELS_H
+#define CPU_KERNELS_H
+
+
+/* The variants of the vector kernels, from the narrowest */
+typedef enum
+{
+    CPU_KERNELS_SCALAR, /* Scalar code, for any processor */
+    CPU_KERNELS_AVX2,   /* Eight floats or four doubles at a time */
+    CPU_KERNELS_AVX512, /* Sixteen floats or eight doubles at a time */
+    CPU_KERNELS_MAX
+} Cpu_Kernels_t;
+
+
+/* On x86 the AVX2 and AVX-512 kernels are always built, each for its own
+   instruction set, and the variant is chosen when the application starts.
+   The rest of the code is still built for the baseline processor, so the
+   same binary runs on any of them.  Multiplies and adds must not be fused,
+   so the kernels keep the results of the scalar code.  FMA is left out of
+   the AVX2 target, but AVX-512 includes it, so contraction is turned off
+   for those kernels. */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #include <immintrin.h>
+
+    #define CPU_KERNELS_DISPATCH 1
+    #define AVX2_KERNEL __attribute__((target("avx2")))
+    #if defined(__clang__)
+        #define AVX512_KERNEL __attribute__((target("avx512f")))
+    #else
+        #define AVX512_KERNEL \
+            __attribute__((target("avx512f"), optimize("fp-contract=off")))
+    #endif
+#else
+    #define CPU_KERNELS_DISPATCH 0
+#endif
+
+
+Cpu_Kernels_t select_cpu_kernels
+(
+    Cpu_Kernels_t limit /* I: widest variant allowed, CPU_KERNELS_MAX for
+                              the widest the processor supports */
+);
+
+
+Cpu_Kernels_t cpu_kernels (void);
+
+
+#endif /* CPU_KERNELS_H */
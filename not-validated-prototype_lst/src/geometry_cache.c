@@ -0,0 +1,498 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "input.h"
+#include "lst_types.h"
+#include "geometry_cache.h"
+
+
+/* Identifies the cache files, the version changes with their layout */
+#define GEOMETRY_CACHE_MAGIC "LSTGEOM"
+#define GEOMETRY_CACHE_VERSION 1
+
+
+/*****************************************************************************
+METHOD:  points_checksum
+
+PURPOSE: Determine a checksum of the locations of the grid points, so a
+         cache is not used with a different reanalysis grid.  This is the
+         64 bit FNV-1a hash of the eastings and northings.
+
+RETURN: uint64_t - the checksum
+
+*****************************************************************************/
+uint64_t points_checksum
+(
+    REANALYSIS_POINTS *points /* I: the coordinate points */
+)
+{
+    size_t index;
+    size_t size = points->num_points * sizeof (double);
+    uint64_t hash = 14695981039346656037ULL;
+    unsigned char *bytes;
+
+    bytes = (unsigned char *) points->utm_easting;
+    for (index = 0; index < size; index++)
+        hash = (hash ^ bytes[index]) * 1099511628211ULL;
+
+    bytes = (unsigned char *) points->utm_northing;
+    for (index = 0; index < size; index++)
+        hash = (hash ^ bytes[index]) * 1099511628211ULL;
+
+    return hash;
+}
+
+
+/*****************************************************************************
+METHOD:  free_cell_runs
+
+PURPOSE: Frees the runs of a line.
+
+*****************************************************************************/
+void free_cell_runs
+(
+    CELL_RUNS *runs /* I/O: the runs of the line */
+)
+{
+    free (runs->start);
+    runs->start = NULL;
+    runs->end = NULL;
+    runs->cell = NULL;
+    runs->count = 0;
+}
+
+
+/*****************************************************************************
+METHOD:  allocate_cell_runs
+
+PURPOSE: Allocates the runs of a line.  The starts, ends, and cells share one
+         allocation.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int allocate_cell_runs
+(
+    int count,      /* I: number of runs */
+    CELL_RUNS *runs /* O: the runs of the line */
+)
+{
+    runs->count = 0;
+    runs->start = NULL;
+    runs->end = NULL;
+    runs->cell = NULL;
+
+    if (count == 0)
+        return SUCCESS;
+
+    runs->start = malloc (3 * count * sizeof (int));
+    if (runs->start == NULL)
+        return FAILURE;
+
+    runs->end = runs->start + count;
+    runs->cell = runs->end + count;
+    runs->count = count;
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  read_geometry_cache
+
+PURPOSE: Reads the cell designations of the cache file, when it was written
+         for the same geometry.  Values that could not have been written for
+         that geometry are rejected, so a damaged file is never used.
+
+RETURN: SUCCESS - the designations were read
+        FAILURE - the file does not exist, or is for a different geometry
+
+*****************************************************************************/
+int read_geometry_cache
+(
+    GEOMETRY_CACHE *cache /* I/O: the cache */
+)
+{
+    int line;
+    int run;
+    int node;
+    int32_t count;
+    int32_t value[3];
+
+    bool valid = true;
+
+    GEOMETRY_KEY key;
+
+    FILE *fd;
+
+    /* Use local variables for cleaner code */
+    int lines = cache->key.lines;
+    int samples = cache->key.samples;
+    int num_cols = cache->key.num_cols;
+    int last_cell = (cache->key.num_rows - 1) * num_cols - 2;
+
+    fd = fopen (cache->filename, "rb");
+    if (fd == NULL)
+        return FAILURE;
+
+    if (fread (&key, sizeof (key), 1, fd) != 1
+        || memcmp (&key, &cache->key, sizeof (key)) != 0)
+    {
+        fclose (fd);
+        return FAILURE;
+    }
+
+    for (line = 0; line < lines && valid; line++)
+    {
+        if (fread (&count, sizeof (count), 1, fd) != 1
+            || count < 0 || count > samples
+            || allocate_cell_runs (count, &cache->line_runs[line])
+               != SUCCESS)
+        {
+            valid = false;
+            break;
+        }
+
+        for (run = 0; run < count; run++)
+        {
+            if (fread (value, sizeof (value), 1, fd) != 1
+                || value[0] < 0 || value[0] >= value[1]
+                || (run > 0
+                    && value[0] < cache->line_runs[line].end[run - 1])
+                || value[1] > samples
+                || value[2] < 0 || value[2] > last_cell)
+            {
+                valid = false;
+                break;
+            }
+
+            cache->line_runs[line].start[run] = value[0];
+            cache->line_runs[line].end[run] = value[1];
+            cache->line_runs[line].cell[run] = value[2];
+        }
+    }
+
+    for (node = 0; node < cache->key.lattice_nodes && valid; node++)
+    {
+        if (fread (value, sizeof (int32_t), 1, fd) != 1
+            || value[0] < -1 || value[0] > last_cell)
+        {
+            valid = false;
+            break;
+        }
+
+        cache->node_cells[node] = value[0];
+    }
+
+    fclose (fd);
+
+    if (!valid)
+    {
+        /* Start over with nothing designated */
+        for (line = 0; line < lines; line++)
+            free_cell_runs (&cache->line_runs[line]);
+        for (node = 0; node < cache->key.lattice_nodes; node++)
+            cache->node_cells[node] = -1;
+
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  write_geometry_cache
+
+PURPOSE: Writes the recorded cell designations to the cache file.  They are
+         written to a temporary file first and then renamed, so other
+         processes never read a partially written cache.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int write_geometry_cache
+(
+    GEOMETRY_CACHE *cache /* I: the cache */
+)
+{
+    char FUNC_NAME[] = "write_geometry_cache";
+
+    int line;
+    int run;
+    int node;
+    int32_t count;
+    int32_t value[3];
+
+    bool valid;
+
+    char temp_filename[PATH_MAX + 32];
+
+    FILE *fd;
+
+    snprintf (temp_filename, sizeof (temp_filename), "%s.%ld.tmp",
+              cache->filename, (long) getpid ());
+
+    fd = fopen (temp_filename, "wb");
+    if (fd == NULL)
+    {
+        RETURN_ERROR ("Opening the geometry cache file", FUNC_NAME,
+                      FAILURE);
+    }
+
+    valid = (fwrite (&cache->key, sizeof (cache->key), 1, fd) == 1);
+
+    for (line = 0; line < cache->key.lines && valid; line++)
+    {
+        count = cache->line_runs[line].count;
+        valid = (fwrite (&count, sizeof (count), 1, fd) == 1);
+
+        for (run = 0; run < count && valid; run++)
+        {
+            value[0] = cache->line_runs[line].start[run];
+            value[1] = cache->line_runs[line].end[run];
+            value[2] = cache->line_runs[line].cell[run];
+            valid = (fwrite (value, sizeof (value), 1, fd) == 1);
+        }
+    }
+
+    for (node = 0; node < cache->key.lattice_nodes && valid; node++)
+    {
+        value[0] = cache->node_cells[node];
+        valid = (fwrite (value, sizeof (int32_t), 1, fd) == 1);
+    }
+
+    if (fclose (fd) != 0)
+        valid = false;
+
+    if (!valid || rename (temp_filename, cache->filename) != 0)
+    {
+        remove (temp_filename);
+        RETURN_ERROR ("Writing the geometry cache file", FUNC_NAME,
+                      FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  open_geometry_cache
+
+PURPOSE: Setup the cache of cell designations for the scene.  There is one
+         cache file for each path/row, which is used when it was written for
+         the same geometry, otherwise the designations are recorded while
+         processing to replace it.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int open_geometry_cache
+(
+    char *cache_dir,           /* I: directory holding the cache files */
+    Input_Data_t *input,       /* I: input structure */
+    REANALYSIS_POINTS *points, /* I: the coordinate points */
+    int lattice_step,          /* I: pixels between the lattice nodes, 0
+                                     for none */
+    int lattice_nodes,         /* I: number of lattice nodes */
+    GEOMETRY_CACHE *cache      /* O: the cache */
+)
+{
+    char FUNC_NAME[] = "open_geometry_cache";
+
+    int line;
+    int node;
+
+    GEOMETRY_KEY *key = &cache->key;
+
+    snprintf (cache->filename, sizeof (cache->filename),
+              "%s/lst_geometry_p%03d_r%03d.bin", cache_dir,
+              input->meta.wrs_path, input->meta.wrs_row);
+
+    /* Clear the key completely, so it can be compared as a whole */
+    memset (key, 0, sizeof (*key));
+    memcpy (key->magic, GEOMETRY_CACHE_MAGIC, sizeof (GEOMETRY_CACHE_MAGIC));
+    key->version = GEOMETRY_CACHE_VERSION;
+    key->wrs_path = input->meta.wrs_path;
+    key->wrs_row = input->meta.wrs_row;
+    key->zone = input->meta.zone;
+    key->ul_x = input->meta.ul_map_corner.x;
+    key->ul_y = input->meta.ul_map_corner.y;
+    key->x_pixel_size = input->x_pixel_size;
+    key->y_pixel_size = input->y_pixel_size;
+    key->lines = input->lines;
+    key->samples = input->samples;
+    key->num_rows = points->num_rows;
+    key->num_cols = points->num_cols;
+    key->points_checksum = points_checksum (points);
+    key->lattice_step = lattice_step;
+    key->lattice_nodes = lattice_nodes;
+
+    cache->line_runs = malloc (input->lines * sizeof (CELL_RUNS));
+    if (cache->line_runs == NULL)
+    {
+        RETURN_ERROR ("Allocating geometry cache memory", FUNC_NAME,
+                      FAILURE);
+    }
+    for (line = 0; line < input->lines; line++)
+        allocate_cell_runs (0, &cache->line_runs[line]);
+
+    cache->node_cells = NULL;
+    if (lattice_nodes > 0)
+    {
+        cache->node_cells = malloc (lattice_nodes * sizeof (int));
+        if (cache->node_cells == NULL)
+        {
+            RETURN_ERROR ("Allocating geometry cache memory", FUNC_NAME,
+                          FAILURE);
+        }
+        for (node = 0; node < lattice_nodes; node++)
+            cache->node_cells[node] = -1;
+    }
+
+    cache->hit = (read_geometry_cache (cache) == SUCCESS);
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  cached_sample_cell
+
+PURPOSE: Finds the cached cell of a sample.  The samples of a line are
+         expected in increasing order, so the search continues from the run
+         the previous sample was found in, which should start at 0 for each
+         line.
+
+RETURN: int - lower left vertex of the cell, -1 when the sample is not
+              cached
+
+*****************************************************************************/
+int cached_sample_cell
+(
+    CELL_RUNS *runs, /* I: the runs of the line */
+    int sample,      /* I: the sample, in increasing order along the line */
+    int *run         /* I/O: run the previous sample was found in */
+)
+{
+    while (*run < runs->count && runs->end[*run] <= sample)
+        (*run)++;
+
+    if (*run < runs->count && runs->start[*run] <= sample)
+        return runs->cell[*run];
+
+    return -1;
+}
+
+
+/*****************************************************************************
+METHOD:  record_cell_runs
+
+PURPOSE: Records the cells of the valid samples of a line as the runs of
+         samples which share a cell.  Each line is recorded by one thread
+         only.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int record_cell_runs
+(
+    GEOMETRY_CACHE *cache, /* I/O: the cache */
+    int line,              /* I: the line */
+    Valid_Spans_t *spans,  /* I: valid spans of the strip */
+    int strip_line,        /* I: line of the strip */
+    int *cells             /* I: cell of each valid sample of the line */
+)
+{
+    char FUNC_NAME[] = "record_cell_runs";
+
+    int span;
+    int sample;
+    int count;
+    int pass;
+
+    CELL_RUNS *runs = &cache->line_runs[line];
+
+    free_cell_runs (runs);
+
+    /* Count the runs, then fill them in */
+    count = 0;
+    for (pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1 && allocate_cell_runs (count, runs) != SUCCESS)
+        {
+            RETURN_ERROR ("Allocating geometry cache memory", FUNC_NAME,
+                          FAILURE);
+        }
+
+        count = 0;
+        for (span = spans->line_first_span[strip_line];
+             span < spans->line_first_span[strip_line + 1]; span++)
+        {
+            for (sample = spans->span_start[span];
+                 sample < spans->span_end[span]; sample++)
+            {
+                if (sample == spans->span_start[span]
+                    || cells[sample] != cells[sample - 1])
+                {
+                    if (pass == 1)
+                    {
+                        runs->start[count] = sample;
+                        runs->cell[count] = cells[sample];
+                    }
+                    count++;
+                }
+
+                if (pass == 1)
+                    runs->end[count - 1] = sample + 1;
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  close_geometry_cache
+
+PURPOSE: Writes the recorded designations when requested and frees the
+         cache.  Failing to write the cache is not an error for the
+         processing, it is only reported.
+
+*****************************************************************************/
+void close_geometry_cache
+(
+    GEOMETRY_CACHE *cache, /* I/O: the cache */
+    bool write_cache       /* I: write the recorded designations */
+)
+{
+    char FUNC_NAME[] = "close_geometry_cache";
+
+    int line;
+
+    if (write_cache && write_geometry_cache (cache) != SUCCESS)
+    {
+        WARNING_MESSAGE ("The geometry cache was not updated", FUNC_NAME);
+    }
+
+    for (line = 0; line < cache->key.lines; line++)
+        free_cell_runs (&cache->line_runs[line]);
+    free (cache->line_runs);
+    cache->line_runs = NULL;
+
+    free (cache->node_cells);
+    cache->node_cells = NULL;
+}
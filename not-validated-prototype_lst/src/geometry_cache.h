@@ -0,0 +1,102 @@
+
+#ifndef GEOMETRY_CACHE_H
+#define GEOMETRY_CACHE_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+
+
+#include "input.h"
+#include "lst_types.h"
+
+
+/* Identifies the geometry the cell designations were determined for.  The
+   designations only depend on the scene's location and size and on the
+   reanalysis grid, not on the acquisition. */
+typedef struct
+{
+    char magic[8];          /* GEOMETRY_CACHE_MAGIC */
+    int32_t version;        /* GEOMETRY_CACHE_VERSION */
+    int32_t wrs_path;       /* WRS path and row of the scene */
+    int32_t wrs_row;
+    int32_t zone;           /* UTM zone number */
+    double ul_x;            /* Upper left corner of the scene */
+    double ul_y;
+    double x_pixel_size;
+    double y_pixel_size;
+    int32_t lines;          /* Lines and samples processed */
+    int32_t samples;
+    int32_t num_rows;       /* Size of the reanalysis grid */
+    int32_t num_cols;
+    uint64_t points_checksum; /* Checksum of the grid point locations */
+    int32_t lattice_step;   /* Pixels between the lattice nodes, 0 for
+                               none */
+    int32_t lattice_nodes;  /* Number of lattice nodes */
+} GEOMETRY_KEY;
+
+
+/* The runs of samples of a line which share a cell */
+typedef struct
+{
+    int count;              /* Number of runs */
+    int *start;             /* First sample of each run */
+    int *end;               /* Sample following each run */
+    int *cell;              /* Lower left vertex of each run's cell */
+} CELL_RUNS;
+
+
+/* The cell designations of the valid samples of a scene and of its lattice
+   nodes, so the later acquisitions of the same path/row do not have to
+   search for the cells again */
+typedef struct
+{
+    char filename[PATH_MAX];  /* Cache file */
+    GEOMETRY_KEY key;         /* Geometry of the scene */
+    bool hit;                 /* The designations were read from the cache,
+                                 otherwise they are recorded */
+    CELL_RUNS *line_runs;     /* Runs of each line */
+    int *node_cells;          /* Cell of each lattice node, -1 for nodes
+                                 without one, NULL without a lattice */
+} GEOMETRY_CACHE;
+
+
+int open_geometry_cache
+(
+    char *cache_dir,           /* I: directory holding the cache files */
+    Input_Data_t *input,       /* I: input structure */
+    REANALYSIS_POINTS *points, /* I: the coordinate points */
+    int lattice_step,          /* I: pixels between the lattice nodes, 0
+                                     for none */
+    int lattice_nodes,         /* I: number of lattice nodes */
+    GEOMETRY_CACHE *cache      /* O: the cache */
+);
+
+
+int cached_sample_cell
+(
+    CELL_RUNS *runs, /* I: the runs of the line */
+    int sample,      /* I: the sample, in increasing order along the line */
+    int *run         /* I/O: run the previous sample was found in */
+);
+
+
+int record_cell_runs
+(
+    GEOMETRY_CACHE *cache, /* I/O: the cache */
+    int line,              /* I: the line */
+    Valid_Spans_t *spans,  /* I: valid spans of the strip */
+    int strip_line,        /* I: line of the strip */
+    int *cells             /* I: cell of each valid sample of the line */
+);
+
+
+void close_geometry_cache
+(
+    GEOMETRY_CACHE *cache, /* I/O: the cache */
+    bool write_cache       /* I: write the recorded designations */
+);
+
+
+#endif /* GEOMETRY_CACHE_H */
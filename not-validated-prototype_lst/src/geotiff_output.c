@@ -0,0 +1,802 @@
+
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <zlib.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "input.h"
+#include "geotiff_output.h"
+
+
+/* TIFF field types */
+#define TIFF_ASCII 2
+#define TIFF_SHORT 3
+#define TIFF_LONG 4
+#define TIFF_DOUBLE 12
+#define TIFF_LONG8 16
+
+/* TIFF values used */
+#define TIFF_COMPRESSION_DEFLATE 8
+#define TIFF_PHOTOMETRIC_MIN_IS_BLACK 1
+#define TIFF_PLANAR_CONTIGUOUS 1
+#define TIFF_PREDICTOR_HORIZONTAL 2
+#define TIFF_PREDICTOR_FLOATING_POINT 3
+#define TIFF_SAMPLE_FORMAT_INT 2
+#define TIFF_SAMPLE_FORMAT_FLOAT 3
+
+/* Number of entries in the image file directory */
+#define GEOTIFF_NUM_TAGS 17
+
+/* Number of values in the GeoKeyDirectoryTag */
+#define GEOTIFF_NUM_GEOKEY_VALUES 16
+
+/* Written as the GDAL_NODATA tag */
+#define GEOTIFF_NO_DATA_TEXT "-9999"
+
+/* Bands with more pixel data than this are written as BigTIFFs.  Even when
+   the tiles do not compress, a smaller band stays well within the 32 bit
+   offsets of a classic TIFF, which more readers support. */
+#define GEOTIFF_CLASSIC_MAX_BYTES ((uint64_t) 1 << 31)
+
+
+/* Location of each part of the header, which is ahead of the tiles so the
+   layout follows the cloud optimized GeoTIFF one */
+typedef struct
+{
+    bool bigtiff;               /* The layout of a BigTIFF */
+    uint64_t ifd;               /* Image file directory */
+    uint64_t tile_offsets;      /* TileOffsets values */
+    uint64_t tile_byte_counts;  /* TileByteCounts values */
+    uint64_t pixel_scale;       /* ModelPixelScaleTag values */
+    uint64_t tiepoint;          /* ModelTiepointTag values */
+    uint64_t geokeys;           /* GeoKeyDirectoryTag values */
+    uint64_t no_data;           /* GDAL_NODATA text, held in the directory
+                                   entry of a BigTIFF */
+    uint64_t size;              /* Size of the header */
+} GEOTIFF_LAYOUT;
+
+
+/*****************************************************************************
+METHOD:  geotiff_layout
+
+PURPOSE: Determine the location of each part of the header.  A BigTIFF
+         has a larger header and directory entries, and 64 bit tile
+         offsets.
+
+RETURN: None
+
+*****************************************************************************/
+void geotiff_layout
+(
+    int tile_count,          /* I: number of tiles */
+    bool bigtiff,            /* I: the layout of a BigTIFF */
+    GEOTIFF_LAYOUT *layout   /* O: location of each part of the header */
+)
+{
+    uint64_t offset;
+
+    layout->bigtiff = bigtiff;
+    if (bigtiff)
+    {
+        layout->ifd = 16;
+        offset = layout->ifd + 8 + (20 * GEOTIFF_NUM_TAGS) + 8;
+    }
+    else
+    {
+        layout->ifd = 8;
+        offset = layout->ifd + 2 + (12 * GEOTIFF_NUM_TAGS) + 4;
+    }
+
+    /* Keep the doubles aligned */
+    offset = (offset + 7) & ~7;
+    layout->pixel_scale = offset;
+    offset += 3 * sizeof (double);
+    layout->tiepoint = offset;
+    offset += 6 * sizeof (double);
+
+    layout->tile_offsets = offset;
+    offset += tile_count * (bigtiff ? sizeof (uint64_t) : sizeof (uint32_t));
+    layout->tile_byte_counts = offset;
+    offset += tile_count * sizeof (uint32_t);
+    layout->geokeys = offset;
+    offset += GEOTIFF_NUM_GEOKEY_VALUES * sizeof (uint16_t);
+    layout->no_data = offset;
+    offset += sizeof (GEOTIFF_NO_DATA_TEXT);
+
+    layout->size = (offset + 7) & ~7;
+}
+
+
+/*****************************************************************************
+METHOD:  add_tiff_entry
+
+PURPOSE: Add an entry to the image file directory.  A single SHORT or LONG
+         value is held in the entry, otherwise value is the offset of the
+         values.  The entries of a BigTIFF have 64 bit counts and values.
+
+RETURN: None
+
+*****************************************************************************/
+void add_tiff_entry
+(
+    uint8_t *header,      /* I/O: the header */
+    GEOTIFF_LAYOUT *layout, /* I: location of each part of the header */
+    int *entry,           /* I/O: next entry of the directory */
+    uint16_t tag,         /* I: tag of the entry */
+    uint16_t type,        /* I: type of the values */
+    uint64_t count,       /* I: number of values */
+    uint64_t value        /* I: the value or the offset of the values */
+)
+{
+    uint8_t *location;       /* Start of the entry */
+    uint8_t *value_location; /* Value held in the entry */
+    uint16_t short_value;
+    uint32_t long_value;
+    uint32_t classic_count;
+
+    if (layout->bigtiff)
+    {
+        location = header + layout->ifd + 8 + (20 * (*entry));
+        memcpy (location + 4, &count, sizeof (count));
+        value_location = location + 12;
+        memset (value_location, 0, 8);
+    }
+    else
+    {
+        location = header + layout->ifd + 2 + (12 * (*entry));
+        classic_count = count;
+        memcpy (location + 4, &classic_count, sizeof (classic_count));
+        value_location = location + 8;
+        memset (value_location, 0, 4);
+    }
+    memcpy (location, &tag, sizeof (tag));
+    memcpy (location + 2, &type, sizeof (type));
+
+    if (type == TIFF_SHORT && count == 1)
+    {
+        short_value = value;
+        memcpy (value_location, &short_value, sizeof (short_value));
+    }
+    else if (layout->bigtiff && !(type == TIFF_LONG && count == 1))
+    {
+        memcpy (value_location, &value, sizeof (value));
+    }
+    else
+    {
+        long_value = value;
+        memcpy (value_location, &long_value, sizeof (long_value));
+    }
+
+    (*entry)++;
+}
+
+
+/*****************************************************************************
+METHOD:  write_geotiff_header
+
+PURPOSE: Write the header and image file directory, with the tile offsets
+         and sizes, to the start of the file.  All values are written in the
+         byte order of the machine, which the header identifies.  Large
+         bands are written as BigTIFFs.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int write_geotiff_header
+(
+    GeoTIFF_Output_t *tiff    /* I/O: the GeoTIFF */
+)
+{
+    char FUNC_NAME[] = "write_geotiff_header";
+    char msg[PATH_MAX + MAX_STR_LEN];
+
+    GEOTIFF_LAYOUT layout;
+
+    int entry = 0;
+    int tile_count = tiff->tiles_across * tiff->tiles_down;
+    int tile;
+    uint16_t byte_order = 1;
+    uint16_t magic = 42;
+    uint16_t bigtiff_magic = 43;
+    uint16_t bigtiff_offset_size = 8;
+    uint16_t num_tags = GEOTIFF_NUM_TAGS;
+    uint32_t classic_ifd;
+    uint32_t classic_offset;
+    uint64_t bigtiff_num_tags = GEOTIFF_NUM_TAGS;
+    uint64_t no_data = 0;
+    uint16_t offset_type = tiff->bigtiff ? TIFF_LONG8 : TIFF_LONG;
+    uint16_t geokeys[GEOTIFF_NUM_GEOKEY_VALUES] = {
+        1, 1, 0, 3,        /* GeoKey directory version 1.1, 3 keys */
+        1024, 0, 1, 1,     /* GTModelTypeGeoKey = projected */
+        1025, 0, 1, 1,     /* GTRasterTypeGeoKey = pixel is area */
+        3072, 0, 1, 0      /* ProjectedCSTypeGeoKey = WGS84 / UTM zone */
+    };
+    double pixel_scale[3];
+    double tiepoint[6];
+    uint8_t *header = NULL;
+
+    geotiff_layout (tile_count, tiff->bigtiff, &layout);
+
+    header = calloc (layout.size, 1);
+    if (header == NULL)
+    {
+        RETURN_ERROR ("Allocating GeoTIFF header memory", FUNC_NAME,
+                      FAILURE);
+    }
+
+    /* Identify the byte order of the machine */
+    if (*(uint8_t *) &byte_order == 1)
+        memcpy (header, "II", 2);
+    else
+        memcpy (header, "MM", 2);
+    if (tiff->bigtiff)
+    {
+        memcpy (header + 2, &bigtiff_magic, sizeof (bigtiff_magic));
+        memcpy (header + 4, &bigtiff_offset_size,
+                sizeof (bigtiff_offset_size));
+        memcpy (header + 8, &layout.ifd, sizeof (layout.ifd));
+        memcpy (header + layout.ifd, &bigtiff_num_tags,
+                sizeof (bigtiff_num_tags));
+    }
+    else
+    {
+        classic_ifd = layout.ifd;
+        memcpy (header + 2, &magic, sizeof (magic));
+        memcpy (header + 4, &classic_ifd, sizeof (classic_ifd));
+        memcpy (header + layout.ifd, &num_tags, sizeof (num_tags));
+    }
+
+    /* The entries must be in increasing tag order */
+    add_tiff_entry (header, &layout, &entry, 256, TIFF_LONG, 1,
+                    tiff->samples);
+    add_tiff_entry (header, &layout, &entry, 257, TIFF_LONG, 1,
+                    tiff->lines);
+    add_tiff_entry (header, &layout, &entry, 258, TIFF_SHORT, 1,
+                    tiff->sample_size * 8);
+    add_tiff_entry (header, &layout, &entry, 259, TIFF_SHORT, 1,
+                    TIFF_COMPRESSION_DEFLATE);
+    add_tiff_entry (header, &layout, &entry, 262, TIFF_SHORT, 1,
+                    TIFF_PHOTOMETRIC_MIN_IS_BLACK);
+    add_tiff_entry (header, &layout, &entry, 277, TIFF_SHORT, 1, 1);
+    add_tiff_entry (header, &layout, &entry, 284, TIFF_SHORT, 1,
+                    TIFF_PLANAR_CONTIGUOUS);
+    add_tiff_entry (header, &layout, &entry, 317, TIFF_SHORT, 1,
+                    tiff->predictor);
+    add_tiff_entry (header, &layout, &entry, 322, TIFF_LONG, 1,
+                    GEOTIFF_TILE_SIZE);
+    add_tiff_entry (header, &layout, &entry, 323, TIFF_LONG, 1,
+                    GEOTIFF_TILE_SIZE);
+    if (tile_count == 1)
+    {
+        add_tiff_entry (header, &layout, &entry, 324, offset_type, 1,
+                        tiff->tile_offsets[0]);
+        add_tiff_entry (header, &layout, &entry, 325, TIFF_LONG, 1,
+                        tiff->tile_byte_counts[0]);
+    }
+    else
+    {
+        add_tiff_entry (header, &layout, &entry, 324, offset_type,
+                        tile_count, layout.tile_offsets);
+        add_tiff_entry (header, &layout, &entry, 325, TIFF_LONG,
+                        tile_count, layout.tile_byte_counts);
+    }
+    add_tiff_entry (header, &layout, &entry, 339, TIFF_SHORT, 1,
+                    tiff->sample_format);
+    add_tiff_entry (header, &layout, &entry, 33550, TIFF_DOUBLE, 3,
+                    layout.pixel_scale);
+    add_tiff_entry (header, &layout, &entry, 33922, TIFF_DOUBLE, 6,
+                    layout.tiepoint);
+    add_tiff_entry (header, &layout, &entry, 34735, TIFF_SHORT,
+                    GEOTIFF_NUM_GEOKEY_VALUES, layout.geokeys);
+    if (tiff->bigtiff)
+    {
+        /* The text fits in the entry, so it must be held there */
+        memcpy (&no_data, GEOTIFF_NO_DATA_TEXT,
+                sizeof (GEOTIFF_NO_DATA_TEXT));
+        add_tiff_entry (header, &layout, &entry, 42113, TIFF_ASCII,
+                        sizeof (GEOTIFF_NO_DATA_TEXT), no_data);
+    }
+    else
+    {
+        add_tiff_entry (header, &layout, &entry, 42113, TIFF_ASCII,
+                        sizeof (GEOTIFF_NO_DATA_TEXT), layout.no_data);
+    }
+
+    /* Northern zones are positive, southern zones negative */
+    if (tiff->zone > 0)
+        geokeys[15] = 32600 + tiff->zone;
+    else
+        geokeys[15] = 32700 - tiff->zone;
+
+    pixel_scale[0] = tiff->x_pixel_size;
+    pixel_scale[1] = tiff->y_pixel_size;
+    pixel_scale[2] = 0.0;
+
+    tiepoint[0] = 0.0;
+    tiepoint[1] = 0.0;
+    tiepoint[2] = 0.0;
+    tiepoint[3] = tiff->ul_x;
+    tiepoint[4] = tiff->ul_y;
+    tiepoint[5] = 0.0;
+
+    memcpy (header + layout.pixel_scale, pixel_scale, sizeof (pixel_scale));
+    memcpy (header + layout.tiepoint, tiepoint, sizeof (tiepoint));
+    if (tiff->bigtiff)
+    {
+        memcpy (header + layout.tile_offsets, tiff->tile_offsets,
+                tile_count * sizeof (uint64_t));
+    }
+    else
+    {
+        for (tile = 0; tile < tile_count; tile++)
+        {
+            classic_offset = tiff->tile_offsets[tile];
+            memcpy (header + layout.tile_offsets
+                    + tile * sizeof (classic_offset),
+                    &classic_offset, sizeof (classic_offset));
+        }
+    }
+    memcpy (header + layout.tile_byte_counts, tiff->tile_byte_counts,
+            tile_count * sizeof (uint32_t));
+    memcpy (header + layout.geokeys, geokeys, sizeof (geokeys));
+    if (!tiff->bigtiff)
+    {
+        memcpy (header + layout.no_data, GEOTIFF_NO_DATA_TEXT,
+                sizeof (GEOTIFF_NO_DATA_TEXT));
+    }
+
+    if (fseek (tiff->fd, 0, SEEK_SET) != 0
+        || fwrite (header, 1, layout.size, tiff->fd) != layout.size)
+    {
+        free (header);
+        snprintf (msg, sizeof (msg), "Writing GeoTIFF header to %s",
+                  tiff->filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    free (header);
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  open_geotiff
+
+PURPOSE: Create a GeoTIFF for a band of the scene.  Space for the header is
+         left at the start of the file, it is written once the tiles have
+         been.
+
+RETURN: The GeoTIFF, or NULL when an error occurs
+
+*****************************************************************************/
+GeoTIFF_Output_t *open_geotiff
+(
+    Input_Data_t *input,        /* I: input structure */
+    char *filename,             /* I: name of the GeoTIFF */
+    Espa_data_type_t data_type  /* I: ESPA_FLOAT32 or ESPA_INT16 */
+)
+{
+    char FUNC_NAME[] = "open_geotiff";
+    char msg[PATH_MAX + MAX_STR_LEN];
+
+    GeoTIFF_Output_t *tiff = NULL;
+    GEOTIFF_LAYOUT layout;
+
+    int tile_count;
+
+    tiff = calloc (1, sizeof (GeoTIFF_Output_t));
+    if (tiff == NULL)
+    {
+        RETURN_ERROR ("Allocating GeoTIFF structure", FUNC_NAME, NULL);
+    }
+
+    snprintf (tiff->filename, sizeof (tiff->filename), "%s", filename);
+    tiff->lines = input->lines;
+    tiff->samples = input->samples;
+    tiff->zone = input->meta.zone;
+    tiff->x_pixel_size = input->x_pixel_size;
+    tiff->y_pixel_size = input->y_pixel_size;
+
+    /* The tiepoint is the corner of the pixel, since the raster is tagged
+       pixel is area, so a corner at the pixel center is moved out to it */
+    tiff->ul_x = input->meta.ul_map_corner.x;
+    tiff->ul_y = input->meta.ul_map_corner.y;
+    if (input->meta.center_origin)
+    {
+        tiff->ul_x -= 0.5 * tiff->x_pixel_size;
+        tiff->ul_y += 0.5 * tiff->y_pixel_size;
+    }
+
+    if (data_type == ESPA_FLOAT32)
+    {
+        tiff->sample_size = sizeof (float);
+        tiff->sample_format = TIFF_SAMPLE_FORMAT_FLOAT;
+        tiff->predictor = TIFF_PREDICTOR_FLOATING_POINT;
+    }
+    else if (data_type == ESPA_INT16)
+    {
+        tiff->sample_size = sizeof (int16_t);
+        tiff->sample_format = TIFF_SAMPLE_FORMAT_INT;
+        tiff->predictor = TIFF_PREDICTOR_HORIZONTAL;
+    }
+    else
+    {
+        free (tiff);
+        RETURN_ERROR ("Unsupported GeoTIFF data type", FUNC_NAME, NULL);
+    }
+
+    tiff->tiles_across = (tiff->samples + GEOTIFF_TILE_SIZE - 1)
+                         / GEOTIFF_TILE_SIZE;
+    tiff->tiles_down = (tiff->lines + GEOTIFF_TILE_SIZE - 1)
+                       / GEOTIFF_TILE_SIZE;
+    tile_count = tiff->tiles_across * tiff->tiles_down;
+
+    /* Large bands need the 64 bit offsets of a BigTIFF */
+    tiff->bigtiff = ((uint64_t) tiff->lines * tiff->samples
+                     * tiff->sample_size > GEOTIFF_CLASSIC_MAX_BYTES);
+
+    tiff->tile_offsets = calloc (tile_count, sizeof (uint64_t));
+    tiff->tile_byte_counts = calloc (tile_count, sizeof (uint32_t));
+    tiff->row_buffer = malloc ((size_t) GEOTIFF_TILE_SIZE * tiff->samples
+                               * tiff->sample_size);
+    if (tiff->tile_offsets == NULL || tiff->tile_byte_counts == NULL
+        || tiff->row_buffer == NULL)
+    {
+        free (tiff->tile_offsets);
+        free (tiff->tile_byte_counts);
+        free (tiff->row_buffer);
+        free (tiff);
+        RETURN_ERROR ("Allocating GeoTIFF memory", FUNC_NAME, NULL);
+    }
+
+    /* The tiles follow the header */
+    geotiff_layout (tile_count, tiff->bigtiff, &layout);
+    tiff->data_offset = layout.size;
+
+    tiff->fd = fopen (tiff->filename, "wb");
+    if (tiff->fd == NULL
+        || fseek (tiff->fd, tiff->data_offset, SEEK_SET) != 0)
+    {
+        snprintf (msg, sizeof (msg), "Opening GeoTIFF: %s", tiff->filename);
+        if (tiff->fd != NULL)
+            fclose (tiff->fd);
+        free (tiff->tile_offsets);
+        free (tiff->tile_byte_counts);
+        free (tiff->row_buffer);
+        free (tiff);
+        RETURN_ERROR (msg, FUNC_NAME, NULL);
+    }
+
+    return tiff;
+}
+
+
+/*****************************************************************************
+METHOD:  apply_predictor
+
+PURPOSE: Apply the TIFF predictor to a line of a tile, so that it compresses
+         better.  The floating point predictor places the bytes of the
+         samples in planes, most significant first, then differences the
+         bytes.  The horizontal predictor differences the samples.
+
+RETURN: None
+
+*****************************************************************************/
+void apply_predictor
+(
+    GeoTIFF_Output_t *tiff, /* I: the GeoTIFF */
+    uint8_t *line,          /* I/O: the line of the tile */
+    uint8_t *scratch        /* I: scratch memory for the line */
+)
+{
+    int sample;
+    int byte;
+    int plane;
+    int index;
+    int line_bytes = GEOTIFF_TILE_SIZE * tiff->sample_size;
+    uint16_t byte_order = 1;
+    bool little_endian = (*(uint8_t *) &byte_order == 1);
+    int16_t *values;
+
+    if (tiff->predictor == TIFF_PREDICTOR_FLOATING_POINT)
+    {
+        memcpy (scratch, line, line_bytes);
+        for (sample = 0; sample < GEOTIFF_TILE_SIZE; sample++)
+        {
+            for (plane = 0; plane < tiff->sample_size; plane++)
+            {
+                if (little_endian)
+                    byte = tiff->sample_size - plane - 1;
+                else
+                    byte = plane;
+
+                line[plane * GEOTIFF_TILE_SIZE + sample] =
+                    scratch[sample * tiff->sample_size + byte];
+            }
+        }
+
+        for (index = line_bytes - 1; index > 0; index--)
+            line[index] -= line[index - 1];
+    }
+    else
+    {
+        values = (int16_t *) line;
+        for (sample = GEOTIFF_TILE_SIZE - 1; sample > 0; sample--)
+            values[sample] = (int16_t) (values[sample] - values[sample - 1]);
+    }
+}
+
+
+/*****************************************************************************
+METHOD:  write_geotiff_tile_row
+
+PURPOSE: Compress the buffered row of tiles and write it.  The tiles are
+         compressed in parallel when requested, then written in order.  The
+         lines beyond those buffered, and the samples beyond the edge of the
+         scene, are padded with zeros.
+
+NOTE: The strip I/O thread writes while the pixel loop keeps the cores busy,
+      so it compresses its tiles alone.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int write_geotiff_tile_row
+(
+    GeoTIFF_Output_t *tiff, /* I/O: the GeoTIFF */
+    bool parallel_tiles     /* I: compress the tiles in parallel */
+)
+{
+    char FUNC_NAME[] = "write_geotiff_tile_row";
+    char msg[PATH_MAX + MAX_STR_LEN];
+
+    int tile_column;
+    int tile;
+    int line;
+    int first_sample;
+    int tile_samples;
+
+    bool abort_tiles = false;
+
+    size_t line_bytes = GEOTIFF_TILE_SIZE * tiff->sample_size;
+    size_t tile_bytes = GEOTIFF_TILE_SIZE * line_bytes;
+    uLong bound = compressBound (tile_bytes);
+    uLongf *compressed_sizes = NULL;
+    uint8_t *compressed = NULL;
+    uint8_t *tile_data = NULL;
+    uint8_t *scratch = NULL;
+
+    compressed_sizes = malloc (tiff->tiles_across * sizeof (uLongf));
+    compressed = malloc (tiff->tiles_across * bound);
+    if (compressed_sizes == NULL || compressed == NULL)
+    {
+        free (compressed_sizes);
+        free (compressed);
+        RETURN_ERROR ("Allocating GeoTIFF tile memory", FUNC_NAME, FAILURE);
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel if (parallel_tiles) \
+                         private(tile_column, line, first_sample, \
+                                 tile_samples, tile_data, scratch)
+#endif
+    {
+        tile_data = malloc (tile_bytes);
+        scratch = malloc (line_bytes);
+        if (tile_data == NULL || scratch == NULL)
+        {
+            abort_tiles = true;
+#ifdef _OPENMP
+            #pragma omp flush (abort_tiles)
+#endif
+        }
+
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for (tile_column = 0; tile_column < tiff->tiles_across; tile_column++)
+        {
+#ifdef _OPENMP
+            #pragma omp flush (abort_tiles)
+#endif
+            if (abort_tiles)
+                continue;
+
+            first_sample = tile_column * GEOTIFF_TILE_SIZE;
+            tile_samples = tiff->samples - first_sample;
+            if (tile_samples > GEOTIFF_TILE_SIZE)
+                tile_samples = GEOTIFF_TILE_SIZE;
+
+            memset (tile_data, 0, tile_bytes);
+            for (line = 0; line < tiff->buffered_lines; line++)
+            {
+                memcpy (tile_data + line * line_bytes,
+                        tiff->row_buffer
+                        + ((size_t) line * tiff->samples + first_sample)
+                          * tiff->sample_size,
+                        tile_samples * tiff->sample_size);
+            }
+
+            for (line = 0; line < GEOTIFF_TILE_SIZE; line++)
+            {
+                apply_predictor (tiff, tile_data + line * line_bytes,
+                                 scratch);
+            }
+
+            compressed_sizes[tile_column] = bound;
+            if (compress2 (compressed + tile_column * bound,
+                           &compressed_sizes[tile_column], tile_data,
+                           tile_bytes, GEOTIFF_DEFLATE_LEVEL) != Z_OK)
+            {
+                abort_tiles = true;
+#ifdef _OPENMP
+                #pragma omp flush (abort_tiles)
+#endif
+            }
+        }
+
+        free (tile_data);
+        free (scratch);
+    }
+
+    if (abort_tiles)
+    {
+        free (compressed_sizes);
+        free (compressed);
+        snprintf (msg, sizeof (msg), "Compressing tiles for %s",
+                  tiff->filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    for (tile_column = 0; tile_column < tiff->tiles_across; tile_column++)
+    {
+        /* The offsets of a classic TIFF are limited to 32 bits */
+        if (!tiff->bigtiff
+            && tiff->data_offset + compressed_sizes[tile_column] > UINT32_MAX)
+        {
+            free (compressed_sizes);
+            free (compressed);
+            snprintf (msg, sizeof (msg), "GeoTIFF exceeds 4GB: %s",
+                      tiff->filename);
+            RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+        }
+
+        if (fwrite (compressed + tile_column * bound, 1,
+                    compressed_sizes[tile_column], tiff->fd)
+            != compressed_sizes[tile_column])
+        {
+            free (compressed_sizes);
+            free (compressed);
+            snprintf (msg, sizeof (msg), "Writing tiles to %s",
+                      tiff->filename);
+            RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+        }
+
+        tile = tiff->tile_row * tiff->tiles_across + tile_column;
+        tiff->tile_offsets[tile] = tiff->data_offset;
+        tiff->tile_byte_counts[tile] = compressed_sizes[tile_column];
+        tiff->data_offset += compressed_sizes[tile_column];
+    }
+
+    free (compressed_sizes);
+    free (compressed);
+
+    tiff->tile_row++;
+    tiff->buffered_lines = 0;
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  write_geotiff_lines
+
+PURPOSE: Write the next lines of the band, writing each row of tiles once
+         all of its lines are available.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int write_geotiff_lines
+(
+    GeoTIFF_Output_t *tiff,     /* I/O: the GeoTIFF */
+    void *data,                 /* I: the lines to write */
+    int lines,                  /* I: number of lines to write */
+    bool parallel_tiles         /* I: compress the tiles in parallel */
+)
+{
+    char FUNC_NAME[] = "write_geotiff_lines";
+
+    int lines_to_buffer;
+    size_t line_size = (size_t) tiff->samples * tiff->sample_size;
+    uint8_t *line_data = data;
+
+    while (lines > 0)
+    {
+        lines_to_buffer = GEOTIFF_TILE_SIZE - tiff->buffered_lines;
+        if (lines_to_buffer > lines)
+            lines_to_buffer = lines;
+
+        memcpy (tiff->row_buffer + tiff->buffered_lines * line_size,
+                line_data, lines_to_buffer * line_size);
+        tiff->buffered_lines += lines_to_buffer;
+        line_data += lines_to_buffer * line_size;
+        lines -= lines_to_buffer;
+
+        if (tiff->buffered_lines == GEOTIFF_TILE_SIZE)
+        {
+            if (write_geotiff_tile_row (tiff, parallel_tiles) != SUCCESS)
+            {
+                RETURN_ERROR ("Writing GeoTIFF tiles", FUNC_NAME, FAILURE);
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  close_geotiff
+
+PURPOSE: Write any partial row of tiles at the bottom of the scene and the
+         header, then close the GeoTIFF and free it.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int close_geotiff
+(
+    GeoTIFF_Output_t *tiff      /* I/O: the GeoTIFF, freed */
+)
+{
+    char FUNC_NAME[] = "close_geotiff";
+    char msg[PATH_MAX + MAX_STR_LEN];
+
+    int status = SUCCESS;
+
+    if (tiff->buffered_lines > 0)
+    {
+        if (write_geotiff_tile_row (tiff, true) != SUCCESS)
+            status = FAILURE;
+    }
+
+    if (status == SUCCESS && tiff->tile_row != tiff->tiles_down)
+    {
+        snprintf (msg, sizeof (msg), "Not all lines were written to %s",
+                  tiff->filename);
+        ERROR_MESSAGE (msg, FUNC_NAME);
+        status = FAILURE;
+    }
+
+    if (status == SUCCESS)
+        status = write_geotiff_header (tiff);
+
+    if (fclose (tiff->fd) != 0)
+    {
+        snprintf (msg, sizeof (msg), "Closing file %s", tiff->filename);
+        ERROR_MESSAGE (msg, FUNC_NAME);
+        status = FAILURE;
+    }
+
+    free (tiff->tile_offsets);
+    free (tiff->tile_byte_counts);
+    free (tiff->row_buffer);
+    free (tiff);
+
+    return status;
+}
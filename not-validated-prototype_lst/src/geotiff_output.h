@@ -0,0 +1,75 @@
+
+#ifndef GEOTIFF_OUTPUT_H
+#define GEOTIFF_OUTPUT_H
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+
+
+#include "input.h"
+
+
+/* Width and length of the tiles (pixels) */
+#define GEOTIFF_TILE_SIZE 256
+
+/* zlib compression level used for the tiles */
+#define GEOTIFF_DEFLATE_LEVEL 6
+
+
+/* Structure for a band written as an internally tiled, DEFLATE compressed
+   GeoTIFF.  The lines are buffered until a whole row of tiles is available,
+   then that row of tiles is compressed and written. */
+typedef struct
+{
+    char filename[PATH_MAX];
+    FILE *fd;
+    int lines;
+    int samples;
+    int sample_size;            /* Bytes per sample */
+    int sample_format;          /* TIFF SampleFormat of the samples */
+    int predictor;              /* TIFF Predictor applied to the tiles */
+    int zone;                   /* UTM zone */
+    double ul_x;                /* UTM of the upper left corner */
+    double ul_y;
+    double x_pixel_size;
+    double y_pixel_size;
+    int tiles_across;
+    int tiles_down;
+    bool bigtiff;               /* Written as a BigTIFF, with 64 bit
+                                   offsets */
+    uint64_t *tile_offsets;     /* File offset of each tile */
+    uint32_t *tile_byte_counts; /* Compressed size of each tile */
+    uint64_t data_offset;       /* File offset of the next tile */
+    int tile_row;               /* Next row of tiles to write */
+    int buffered_lines;         /* Lines buffered for the row of tiles */
+    uint8_t *row_buffer;        /* Lines for the row of tiles */
+} GeoTIFF_Output_t;
+
+
+GeoTIFF_Output_t *open_geotiff
+(
+    Input_Data_t *input,        /* I: input structure */
+    char *filename,             /* I: name of the GeoTIFF */
+    Espa_data_type_t data_type  /* I: ESPA_FLOAT32 or ESPA_INT16 */
+);
+
+
+int write_geotiff_lines
+(
+    GeoTIFF_Output_t *tiff,     /* I/O: the GeoTIFF */
+    void *data,                 /* I: the lines to write */
+    int lines,                  /* I: number of lines to write */
+    bool parallel_tiles         /* I: compress the tiles in parallel */
+);
+
+
+int close_geotiff
+(
+    GeoTIFF_Output_t *tiff      /* I/O: the GeoTIFF, freed */
+);
+
+
+#endif /* GEOTIFF_OUTPUT_H */
@@ -1,6 +1,8 @@
 
 #include <string.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <limits.h>
 #include <math.h>
 #include <getopt.h>
 
@@ -8,6 +10,8 @@
 #include "const.h"
 #include "utilities.h"
 #include "input.h"
+#include "scene_buffer.h"
+#include "cpu_kernels.h"
 
 
 /*****************************************************************************
@@ -25,6 +29,17 @@ usage ()
     printf ("usage: scene_based_lst"
             " --xml=input_xml_filename"
             " [--use-tape6]"
+            " [--single-precision]"
+            " [--verify-cells]"
+            " [--strip-lines=lines]"
+            " [--lattice-step=pixels]"
+            " [--geometry-cache=directory]"
+            " [--hugepages=transparent|explicit]"
+            " [--vector-kernels=scalar|avx2|avx512]"
+            " [--lst [--write-intermediate]]"
+            " [--compact-intermediate]"
+            " [--geotiff]"
+            " [--roi-map=ulx,uly,lrx,lry | --roi-pixels=uls,ull,lrs,lrl]"
             " [--verbose]"
             " [--debug]\n");
 
@@ -35,6 +50,44 @@ usage ()
     printf ("where the following parameters are optional:\n");
     printf ("    --use-tape6: use the values from the MODTRAN generated"
             " tape6 file? (default is false)\n");
+    printf ("    --single-precision: interpolate the pixel parameters in"
+            " single precision? (default is false)\n");
+    printf ("    --verify-cells: also search for the cell of every pixel,"
+            " and report how many differ from the cell carried forward"
+            " along the line (default is false)\n");
+    printf ("    --strip-lines: number of lines to read, process, and"
+            " write at a time (default is 0, the whole scene, unless it"
+            " is too large to hold at once)\n");
+    printf ("    --lattice-step: interpolate the parameters horizontally"
+            " on a lattice with this many pixels between the nodes, such"
+            " as 8 to 16, instead of at every pixel, reporting the largest"
+            " deviation found (default is 0, every pixel)\n");
+    printf ("    --geometry-cache: directory to keep the cell designations"
+            " of each path/row in, so later acquisitions with the same"
+            " geometry do not search for the cells again (default is no"
+            " cache)\n");
+    printf ("    --hugepages: back the strip buffers with transparent"
+            " hugepages, or with explicit hugepages reserved through"
+            " /proc/sys/vm/nr_hugepages (default is regular pages)\n");
+    printf ("    --vector-kernels: use at most these vector kernels, even"
+            " when the processor supports wider ones (default is the"
+            " widest the processor supports)\n");
+    printf ("    --lst: generate the land surface temperature band from the"
+            " emissivity band, instead of leaving it to build_lst_data"
+            " (default is false)\n");
+    printf ("    --write-intermediate: with --lst, still write the"
+            " intermediate bands (default is false)\n");
+    printf ("    --compact-intermediate: write the intermediate bands as"
+            " 16 bit integers, with the scale factor recorded in the XML,"
+            " instead of as floats (default is false)\n");
+    printf ("    --geotiff: write the bands as tiled, DEFLATE compressed"
+            " GeoTIFFs instead of raw binary (default is false)\n");
+    printf ("    --roi-map: only process the region of interest with the"
+            " specified upper left and lower right corners, in map"
+            " coordinates (default is the whole scene)\n");
+    printf ("    --roi-pixels: only process the region of interest with the"
+            " specified upper left and lower right corners, as sample,line"
+            " pixel coordinates (default is the whole scene)\n");
     printf ("    --verbose: should intermediate messages be printed?"
             " (default is false)\n");
     printf ("    --debug: should debug output be generated?"
@@ -50,6 +103,43 @@ usage ()
 }
 
 
+/*****************************************************************************
+  NAME:  parse_count
+
+  PURPOSE:  Parses the value of an option which is a count, such as a number
+            of lines.  The whole value must be a decimal integer, from zero
+            to INT_MAX.
+
+  RETURN VALUE: Type = int
+    Value           Description
+    -----           -----------
+    FAILURE         The value is not a count
+    SUCCESS         The count was parsed
+*****************************************************************************/
+static int
+parse_count
+(
+    char *text,     /* I: value of the option */
+    int *count      /* O: the count */
+)
+{
+    char *end;
+    long value;
+
+    errno = 0;
+    value = strtol (text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE
+        || value < 0 || value > INT_MAX)
+    {
+        return FAILURE;
+    }
+
+    *count = (int) value;
+
+    return SUCCESS;
+}
+
+
 /*****************************************************************************
   MODULE:  get_args
 
@@ -74,6 +164,22 @@ int get_args
     char *argv[],       /* I: string of cmd-line args */
     char *xml_filename, /* I: address of input XML metadata filename  */
     bool *use_tape6,    /* O: use the tape6 output */
+    bool *single_precision, /* O: interpolate in single precision */
+    bool *verify_cells, /* O: check the cells carried forward */
+    int *strip_lines,   /* O: number of lines to process at a time */
+    int *lattice_step,  /* O: pixels between the lattice nodes */
+    char *geometry_cache_dir, /* O: directory of the geometry cache, empty
+                                    for none */
+    Scene_Pages_t *scene_pages, /* O: how to back the strip buffers */
+    Cpu_Kernels_t *vector_kernels, /* O: widest vector kernels to use */
+    bool *generate_lst, /* O: generate the land surface temperature */
+    bool *write_intermediate_bands, /* O: write the intermediate bands */
+    bool *compact_intermediate, /* O: write the intermediate bands as scaled
+                                      16 bit integers */
+    bool *geotiff,      /* O: write the bands as GeoTIFFs */
+    Roi_Units_t *roi_units, /* O: units of the region of interest, none
+                                  for the whole scene */
+    double *roi,        /* O: corners of the region of interest */
     bool *verbose,      /* O: verbose flag */
     bool *debug         /* O: debug flag */
 )
@@ -83,17 +189,49 @@ int get_args
     static int verbose_flag = 0;   /* verbose flag */
     static int debug_flag = 0;     /* debug flag */
     static int use_tape6_flag = 0; /* use the results from the tape6 output */
+    static int single_precision_flag = 0; /* interpolate in single
+                                             precision */
+    static int verify_cells_flag = 0; /* check the cells carried forward */
+    static int lst_flag = 0;       /* generate the land surface
+                                      temperature */
+    static int write_intermediate_flag = 0; /* write the intermediate bands
+                                               along with the LST */
+    static int compact_flag = 0;   /* write the intermediate bands as
+                                      scaled 16 bit integers */
+    static int geotiff_flag = 0;   /* write the bands as GeoTIFFs */
+    int roi_length = 0;            /* characters of the region parsed */
     char errmsg[MAX_STR_LEN];      /* error message */
     char FUNC_NAME[] = "get_args"; /* function name */
     static struct option long_options[] = {
         {"verbose", no_argument, &verbose_flag, 1},
         {"debug", no_argument, &debug_flag, 1},
         {"use-tape6", no_argument, &use_tape6_flag, 1},
+        {"single-precision", no_argument, &single_precision_flag, 1},
+        {"verify-cells", no_argument, &verify_cells_flag, 1},
+        {"lst", no_argument, &lst_flag, 1},
+        {"write-intermediate", no_argument, &write_intermediate_flag, 1},
+        {"compact-intermediate", no_argument, &compact_flag, 1},
+        {"geotiff", no_argument, &geotiff_flag, 1},
         {"xml", required_argument, 0, 'i'},
+        {"strip-lines", required_argument, 0, 's'},
+        {"lattice-step", required_argument, 0, 'l'},
+        {"geometry-cache", required_argument, 0, 'g'},
+        {"hugepages", required_argument, 0, 'p'},
+        {"vector-kernels", required_argument, 0, 'k'},
+        {"roi-map", required_argument, 0, 'r'},
+        {"roi-pixels", required_argument, 0, 'x'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
+    /* Default to processing the whole scene at once */
+    *strip_lines = 0;
+    *lattice_step = 0;
+    geometry_cache_dir[0] = '\0';
+    *scene_pages = SCENE_PAGES_DEFAULT;
+    *vector_kernels = CPU_KERNELS_MAX;
+    *roi_units = ROI_UNITS_NONE;
+
     /* Loop through all the cmd-line options */
     opterr = 0; /* turn off getopt_long error msgs as we'll print our own */
     while (1)
@@ -122,6 +260,78 @@ int get_args
                 snprintf(xml_filename, PATH_MAX, "%s", optarg);
                 break;
 
+            case 's':              /* lines per strip */
+                if (parse_count (optarg, strip_lines) != SUCCESS)
+                {
+                    usage ();
+                    RETURN_ERROR ("--strip-lines must be a non-negative"
+                                  " number of lines", FUNC_NAME, FAILURE);
+                }
+                break;
+
+            case 'l':              /* pixels between the lattice nodes */
+                if (parse_count (optarg, lattice_step) != SUCCESS)
+                {
+                    usage ();
+                    RETURN_ERROR ("--lattice-step must be a non-negative"
+                                  " number of pixels", FUNC_NAME, FAILURE);
+                }
+                break;
+
+            case 'g':              /* geometry cache directory */
+                snprintf(geometry_cache_dir, PATH_MAX, "%s", optarg);
+                break;
+
+            case 'p':              /* hugepage backing */
+                if (strcmp (optarg, "transparent") == 0)
+                    *scene_pages = SCENE_PAGES_TRANSPARENT;
+                else if (strcmp (optarg, "explicit") == 0)
+                    *scene_pages = SCENE_PAGES_EXPLICIT;
+                else
+                {
+                    usage ();
+                    RETURN_ERROR ("--hugepages must be transparent or"
+                                  " explicit", FUNC_NAME, FAILURE);
+                }
+                break;
+
+            case 'k':              /* widest vector kernels */
+                if (strcmp (optarg, "scalar") == 0)
+                    *vector_kernels = CPU_KERNELS_SCALAR;
+                else if (strcmp (optarg, "avx2") == 0)
+                    *vector_kernels = CPU_KERNELS_AVX2;
+                else if (strcmp (optarg, "avx512") == 0)
+                    *vector_kernels = CPU_KERNELS_AVX512;
+                else
+                {
+                    usage ();
+                    RETURN_ERROR ("--vector-kernels must be scalar, avx2, or"
+                                  " avx512", FUNC_NAME, FAILURE);
+                }
+                break;
+
+            case 'r':              /* region of interest */
+            case 'x':
+                if (*roi_units != ROI_UNITS_NONE)
+                {
+                    usage ();
+                    RETURN_ERROR ("Only one region of interest may be"
+                                  " specified", FUNC_NAME, FAILURE);
+                }
+
+                if (sscanf (optarg, "%lf,%lf,%lf,%lf%n", &roi[0], &roi[1],
+                            &roi[2], &roi[3], &roi_length) != 4
+                    || optarg[roi_length] != '\0')
+                {
+                    usage ();
+                    RETURN_ERROR ("--roi-map and --roi-pixels must be the"
+                                  " upper left then lower right corner, as"
+                                  " four comma separated numbers",
+                                  FUNC_NAME, FAILURE);
+                }
+                *roi_units = (c == 'r') ? ROI_UNITS_MAP : ROI_UNITS_PIXELS;
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind - 1]);
@@ -145,6 +355,43 @@ int get_args
     else
         *use_tape6 = false;
 
+    /* Set the single_precision flag */
+    if (single_precision_flag)
+        *single_precision = true;
+    else
+        *single_precision = false;
+
+    /* Set the verify_cells flag */
+    if (verify_cells_flag)
+        *verify_cells = true;
+    else
+        *verify_cells = false;
+
+    /* Set the generate_lst flag */
+    if (lst_flag)
+        *generate_lst = true;
+    else
+        *generate_lst = false;
+
+    /* The intermediate bands are needed by build_lst_data unless the LST is
+       generated here */
+    if (!lst_flag || write_intermediate_flag)
+        *write_intermediate_bands = true;
+    else
+        *write_intermediate_bands = false;
+
+    /* Set the compact_intermediate flag */
+    if (compact_flag)
+        *compact_intermediate = true;
+    else
+        *compact_intermediate = false;
+
+    /* Set the geotiff flag */
+    if (geotiff_flag)
+        *geotiff = true;
+    else
+        *geotiff = false;
+
     /* Set the verbose flag */
     if (verbose_flag)
         *verbose = true;
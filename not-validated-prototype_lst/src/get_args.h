@@ -6,12 +6,33 @@
 #include <stdbool.h>
 
 
+#include "input.h"
+#include "scene_buffer.h"
+#include "cpu_kernels.h"
+
+
 int get_args
 (
     int argc,           /* I: number of cmd-line args */
     char *argv[],       /* I: string of cmd-line args */
     char *xml_filename, /* I: address of input XML metadata filename  */
     bool *tape_6,       /* O: use the tape6 output */
+    bool *single_precision, /* O: interpolate in single precision */
+    bool *verify_cells, /* O: check the cells carried forward */
+    int *strip_lines,   /* O: number of lines to process at a time */
+    int *lattice_step,  /* O: pixels between the lattice nodes */
+    char *geometry_cache_dir, /* O: directory of the geometry cache, empty
+                                    for none */
+    Scene_Pages_t *scene_pages, /* O: how to back the strip buffers */
+    Cpu_Kernels_t *vector_kernels, /* O: widest vector kernels to use */
+    bool *generate_lst, /* O: generate the land surface temperature */
+    bool *write_intermediate_bands, /* O: write the intermediate bands */
+    bool *compact_intermediate, /* O: write the intermediate bands as scaled
+                                      16 bit integers */
+    bool *geotiff,      /* O: write the bands as GeoTIFFs */
+    Roi_Units_t *roi_units, /* O: units of the region of interest, none
+                                  for the whole scene */
+    double *roi,        /* O: corners of the region of interest */
     bool *verbose,      /* O: verbose flag */
     bool *debug         /* O: debug flag */
 );
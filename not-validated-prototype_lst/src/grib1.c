@@ -0,0 +1,521 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "grib1.h"
+
+
+/* Sizes of the fixed parts of a record */
+#define GRIB1_IS_LEN 8          /* Indicator section */
+#define GRIB1_BDS_HEADER_LEN 11 /* Binary data section before the data */
+
+/* Unsigned and sign and magnitude integers of a record */
+#define UINT2(a, b) ((int) (((a) << 8) + (b)))
+#define UINT3(a, b, c) ((int) (((a) << 16) + ((b) << 8) + (c)))
+#define INT2(a, b) (((a) & 0x80) ? -UINT2 ((a) & 0x7f, b) : UINT2 (a, b))
+
+
+/*****************************************************************************
+METHOD:  read_grib1_inventory
+
+PURPOSE: Locates the record of each layer in a GRIB file from its wgrib
+         inventory.  Each line of the inventory holds the record number,
+         the position of the record, and the kpds fields, the pressure of
+         the layer being kpds7.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int read_grib1_inventory
+(
+    char *hdr_filename, /* I: wgrib inventory of the GRIB file */
+    int num_layers,     /* I: number of layers to locate */
+    int *layers,        /* I: pressure of each layer in millibars */
+    off_t *offsets      /* O: position of each layer's record */
+)
+{
+    char FUNC_NAME[] = "read_grib1_inventory";
+    char msg[MAX_STR_LEN];
+    char line[MAX_STR_LEN];
+    char *field;
+    char *kpds7;
+    long long position;
+    int pressure;
+    int layer;
+    FILE *fd;
+
+    for (layer = 0; layer < num_layers; layer++)
+        offsets[layer] = -1;
+
+    fd = fopen (hdr_filename, "r");
+    if (fd == NULL)
+    {
+        snprintf (msg, sizeof (msg), "Opening GRIB inventory %s",
+                  hdr_filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    while (fgets (line, sizeof (line), fd) != NULL)
+    {
+        /* Skip the record number to the position */
+        field = strchr (line, ':');
+        kpds7 = strstr (line, ":kpds7=");
+        if (field == NULL || kpds7 == NULL
+            || sscanf (field + 1, "%lld", &position) != 1
+            || sscanf (kpds7 + 7, "%d", &pressure) != 1)
+        {
+            fclose (fd);
+            snprintf (msg, sizeof (msg), "Invalid line in GRIB inventory %s",
+                      hdr_filename);
+            RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+        }
+
+        for (layer = 0; layer < num_layers; layer++)
+        {
+            if (layers[layer] == pressure)
+                offsets[layer] = position;
+        }
+    }
+
+    fclose (fd);
+
+    for (layer = 0; layer < num_layers; layer++)
+    {
+        if (offsets[layer] < 0)
+        {
+            snprintf (msg, sizeof (msg), "GRIB inventory %s does not hold"
+                      " %d millibars", hdr_filename, layers[layer]);
+            RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  read_bytes
+
+PURPOSE: Reads bytes from a position of a file, without moving the file
+         offset, so threads can share the file.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+static int read_bytes
+(
+    int fd,                /* I: open file */
+    off_t offset,          /* I: position to read from */
+    size_t size,           /* I: bytes to read */
+    unsigned char *buffer  /* O: the bytes */
+)
+{
+    ssize_t count;
+
+    while (size > 0)
+    {
+        count = pread (fd, buffer, size, offset);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return FAILURE;
+
+        buffer += count;
+        offset += count;
+        size -= count;
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  read_section
+
+PURPOSE: Reads a section of a record, which starts with its length.  At
+         most max_len bytes of it are read.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+static int read_section
+(
+    int fd,                 /* I: open GRIB file */
+    off_t offset,           /* I: position of the section */
+    int max_len,            /* I: most bytes to read, 0 for all */
+    unsigned char **section, /* O: the bytes read, to be freed */
+    int *section_len        /* O: length of the section */
+)
+{
+    unsigned char length[3];
+    int size;
+
+    *section = NULL;
+    if (read_bytes (fd, offset, sizeof (length), length) != SUCCESS)
+        return FAILURE;
+
+    *section_len = UINT3 (length[0], length[1], length[2]);
+    size = *section_len;
+    if (max_len > 0 && size > max_len)
+        size = max_len;
+    if (size < (int) sizeof (length))
+        return FAILURE;
+
+    *section = malloc (size);
+    if (*section == NULL)
+        return FAILURE;
+
+    if (read_bytes (fd, offset, size, *section) != SUCCESS)
+    {
+        free (*section);
+        *section = NULL;
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+
+/* The sections of a record read, the binary data section only up to its
+   data */
+typedef struct
+{
+    unsigned char *pds;     /* Product definition section */
+    unsigned char *gds;     /* Grid description section */
+    unsigned char *bms;     /* Bit map section, NULL without one */
+    unsigned char *bds;     /* Binary data section */
+    unsigned char *packed;  /* Packed values of the window */
+    size_t *value_indexes;  /* Packed value of each point of the window */
+} GRIB1_RECORD;
+
+
+/*****************************************************************************
+METHOD:  free_grib1_record
+
+PURPOSE: Releases the sections of a record read.
+
+*****************************************************************************/
+static void free_grib1_record
+(
+    GRIB1_RECORD *record /* I: the record */
+)
+{
+    free (record->pds);
+    free (record->gds);
+    free (record->bms);
+    free (record->bds);
+    free (record->packed);
+    free (record->value_indexes);
+}
+
+
+/*****************************************************************************
+METHOD:  int_power
+
+PURPOSE: Raises a value to an integer power by repeated squaring, the same
+         as wgrib, so the scaled values round the same.
+
+RETURN: double - the power
+
+*****************************************************************************/
+static double int_power
+(
+    double x,  /* I: the value */
+    int y      /* I: the power */
+)
+{
+    double value = 1.0;
+
+    if (y < 0)
+    {
+        y = -y;
+        x = 1.0 / x;
+    }
+
+    while (y)
+    {
+        if (y & 1)
+            value *= x;
+        x = x * x;
+        y >>= 1;
+    }
+
+    return value;
+}
+
+
+/*****************************************************************************
+METHOD:  ibm_to_double
+
+PURPOSE: Converts an IBM single precision float of a record.
+
+RETURN: double - the value
+
+*****************************************************************************/
+static double ibm_to_double
+(
+    unsigned char *ibm  /* I: the four bytes of the float */
+)
+{
+    int power;
+    long mantissa;
+    double value;
+
+    mantissa = ((long) ibm[1] << 16) + (ibm[2] << 8) + ibm[3];
+    if (mantissa == 0)
+        return 0.0;
+
+    power = (int) (ibm[0] & 0x7f) - 64;
+    value = ldexp ((double) mantissa, 4 * power - 24);
+
+    return (ibm[0] & 0x80) ? -value : value;
+}
+
+
+/*****************************************************************************
+METHOD:  decode_grib1_window
+
+PURPOSE: Decodes the values of a GRIB edition 1 record within a window of
+         its grid.  Only the packed values of the rows of the window are
+         read from the file.  The values are computed as wgrib computes
+         them, so they match its output to single precision.
+
+NOTE: Only simple packing of grid point data is supported, which is what
+      the NARR data uses.  The rows are in the order of the record, the
+      same as the text output of wgrib.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int decode_grib1_window
+(
+    int fd,          /* I: open GRIB file */
+    off_t offset,    /* I: position of the record */
+    int min_row,     /* I: first row of the window */
+    int max_row,     /* I: last row of the window */
+    int min_col,     /* I: first column of the window */
+    int max_col,     /* I: last column of the window */
+    double *output   /* O: values of the window, in row major order */
+)
+{
+    char FUNC_NAME[] = "decode_grib1_window";
+
+    unsigned char is[GRIB1_IS_LEN];
+    unsigned char *pds;
+    unsigned char *gds;
+    unsigned char *bds;
+    unsigned char *packed = NULL;
+    unsigned char *bitmap = NULL;
+    int pds_len;
+    int gds_len = 0;
+    int bms_len = 0;
+    int bds_len;
+    off_t position;
+    int nx;
+    int ny;
+    int num_bits;
+    double ref;
+    double scale;
+    double decimal;
+    int row;
+    int col;
+    size_t grid_index;
+    size_t value_index;
+    size_t first_value;
+    size_t last_value;
+    size_t *value_indexes;
+    size_t window_points = (size_t) (max_row - min_row + 1)
+                           * (max_col - min_col + 1);
+    size_t first_byte = 0;
+    size_t packed_size;
+    size_t bit;
+    uint64_t bits;
+    int byte;
+
+    GRIB1_RECORD record;
+
+    memset (&record, 0, sizeof (record));
+
+    /* The indicator section holds the edition */
+    if (read_bytes (fd, offset, sizeof (is), is) != SUCCESS
+        || memcmp (is, "GRIB", 4) != 0 || is[7] != 1)
+    {
+        RETURN_ERROR ("Not a GRIB edition 1 record", FUNC_NAME, FAILURE);
+    }
+    position = offset + GRIB1_IS_LEN;
+
+    if (read_section (fd, position, 0, &record.pds, &pds_len) != SUCCESS
+        || pds_len < 28)
+    {
+        free_grib1_record (&record);
+        RETURN_ERROR ("Reading the product definition section", FUNC_NAME,
+                      FAILURE);
+    }
+    position += pds_len;
+    pds = record.pds;
+
+    /* The grid description gives the size of the grid */
+    if (!(pds[7] & 0x80)
+        || read_section (fd, position, 0, &record.gds, &gds_len) != SUCCESS
+        || gds_len < 28 || (record.gds[5] != 0 && record.gds[5] != 3))
+    {
+        free_grib1_record (&record);
+        RETURN_ERROR ("Only records on latitude/longitude or Lambert"
+                      " conformal grids are supported", FUNC_NAME, FAILURE);
+    }
+    position += gds_len;
+    gds = record.gds;
+
+    nx = UINT2 (gds[6], gds[7]);
+    ny = UINT2 (gds[8], gds[9]);
+    if (nx != NARR_COLS || ny != NARR_ROWS || (gds[27] & 0x20))
+    {
+        free_grib1_record (&record);
+        RETURN_ERROR ("The record is not on the NARR grid", FUNC_NAME,
+                      FAILURE);
+    }
+
+    if (min_row < 0 || max_row >= ny || min_row > max_row
+        || min_col < 0 || max_col >= nx || min_col > max_col)
+    {
+        free_grib1_record (&record);
+        RETURN_ERROR ("Invalid window of the GRIB grid", FUNC_NAME, FAILURE);
+    }
+
+    /* A bitmap leaves out the grid points without values */
+    if (pds[7] & 0x40)
+    {
+        if (read_section (fd, position, 0, &record.bms, &bms_len) != SUCCESS
+            || bms_len < 6 || UINT2 (record.bms[4], record.bms[5]) != 0
+            || (size_t) (bms_len - 6) * 8 < (size_t) nx * ny)
+        {
+            free_grib1_record (&record);
+            RETURN_ERROR ("Only records with their own bitmap are"
+                          " supported", FUNC_NAME, FAILURE);
+        }
+        bitmap = record.bms + 6;
+        position += bms_len;
+    }
+
+    if (read_section (fd, position, GRIB1_BDS_HEADER_LEN, &record.bds,
+                      &bds_len) != SUCCESS
+        || bds_len < GRIB1_BDS_HEADER_LEN || (record.bds[3] & 0xd0))
+    {
+        free_grib1_record (&record);
+        RETURN_ERROR ("Only simple packing of grid point data is"
+                      " supported", FUNC_NAME, FAILURE);
+    }
+    position += GRIB1_BDS_HEADER_LEN;
+    bds = record.bds;
+
+    num_bits = bds[10];
+    if (num_bits > 32)
+    {
+        free_grib1_record (&record);
+        RETURN_ERROR ("Unsupported number of bits per value", FUNC_NAME,
+                      FAILURE);
+    }
+
+    decimal = int_power (10.0, -INT2 (pds[26], pds[27]));
+    ref = decimal * ibm_to_double (bds + 6);
+    scale = decimal * ldexp (1.0, INT2 (bds[4], bds[5]));
+
+    /* Locate the packed value of each point of the window */
+    record.value_indexes = malloc (window_points * sizeof (size_t));
+    value_indexes = record.value_indexes;
+    if (value_indexes == NULL)
+    {
+        free_grib1_record (&record);
+        RETURN_ERROR ("Allocating GRIB value memory", FUNC_NAME, FAILURE);
+    }
+
+    value_index = 0;
+    first_value = SIZE_MAX;
+    last_value = 0;
+    for (grid_index = 0; grid_index < (size_t) (max_row + 1) * nx;
+         grid_index++)
+    {
+        row = grid_index / nx;
+        col = grid_index % nx;
+        bit = bitmap == NULL
+              || (bitmap[grid_index >> 3] & (0x80 >> (grid_index & 7)));
+
+        if (row >= min_row && col >= min_col && col <= max_col)
+        {
+            value_indexes[(row - min_row) * (max_col - min_col + 1)
+                          + (col - min_col)] =
+                bit ? value_index : SIZE_MAX;
+            if (bit)
+            {
+                if (value_index < first_value)
+                    first_value = value_index;
+                last_value = value_index;
+            }
+        }
+
+        if (bit)
+            value_index++;
+    }
+
+    /* Read only the packed values of the window's rows */
+    if (first_value != SIZE_MAX && num_bits > 0)
+    {
+        first_byte = (first_value * num_bits) >> 3;
+        packed_size = (((last_value + 1) * num_bits + 7) >> 3) - first_byte;
+        if (GRIB1_BDS_HEADER_LEN + first_byte + packed_size
+            > (size_t) bds_len)
+        {
+            free_grib1_record (&record);
+            RETURN_ERROR ("The binary data section is truncated",
+                          FUNC_NAME, FAILURE);
+        }
+
+        /* Padded so every value can be read as five bytes */
+        record.packed = calloc (packed_size + 8, 1);
+        packed = record.packed;
+        if (packed == NULL || read_bytes (fd, position + first_byte,
+                                          packed_size, packed) != SUCCESS)
+        {
+            free_grib1_record (&record);
+            RETURN_ERROR ("Reading the packed values", FUNC_NAME, FAILURE);
+        }
+    }
+
+    for (grid_index = 0; grid_index < window_points; grid_index++)
+    {
+        value_index = value_indexes[grid_index];
+        if (value_index == SIZE_MAX)
+        {
+            output[grid_index] = GRIB1_UNDEFINED;
+            continue;
+        }
+
+        bits = 0;
+        if (num_bits > 0)
+        {
+            bit = value_index * num_bits - (first_byte << 3);
+            for (byte = 0; byte < 5; byte++)
+                bits = (bits << 8) | packed[(bit >> 3) + byte];
+            bits = (bits >> (40 - (bit & 7) - num_bits))
+                   & ((1ULL << num_bits) - 1);
+        }
+
+        /* Rounded to single precision, as wgrib does */
+        output[grid_index] = (float) (ref + scale * bits);
+    }
+
+    free_grib1_record (&record);
+
+    return SUCCESS;
+}
@@ -0,0 +1,33 @@
+#ifndef GRIB1_H
+#define GRIB1_H
+
+
+#include <sys/types.h>
+
+
+/* Value of the grid points a bitmap leaves out, the same as wgrib */
+#define GRIB1_UNDEFINED 9.999e20
+
+
+int read_grib1_inventory
+(
+    char *hdr_filename, /* I: wgrib inventory of the GRIB file */
+    int num_layers,     /* I: number of layers to locate */
+    int *layers,        /* I: pressure of each layer in millibars */
+    off_t *offsets      /* O: position of each layer's record */
+);
+
+
+int decode_grib1_window
+(
+    int fd,          /* I: open GRIB file */
+    off_t offset,    /* I: position of the record */
+    int min_row,     /* I: first row of the window */
+    int max_row,     /* I: last row of the window */
+    int min_col,     /* I: first column of the window */
+    int max_col,     /* I: last column of the window */
+    double *output   /* O: values of the window, in row major order */
+);
+
+
+#endif /* GRIB1_H */
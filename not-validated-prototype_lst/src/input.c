@@ -1,19 +1,31 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 #include "const.h"
 #include "utilities.h"
+#include "cpu_kernels.h"
 #include "input.h"
 
 
 /*****************************************************************************
   NAME:  open_band
 
-  PURPOSE:  Open the specified file and allocate the memory for the filename.
+  PURPOSE:  Map the specified file for read access and allocate the memory
+            for the filename.  The bands are read from start to end, so the
+            kernel is advised to read ahead.
 
-  RETURN VALUE:  None
+  RETURN VALUE:  Type = int
+      Value    Description
+      -------  ---------------------------------------------------------------
+      SUCCESS  The band was mapped.
+      FAILURE  The band could not be opened or mapped.
 *****************************************************************************/
 int
 open_band
@@ -25,25 +37,94 @@ open_band
 {
     char FUNC_NAME[] = "open_band";
     char msg[256];
+    int fd;
+    struct stat band_stat;
+    void *band_map = NULL;
 
     /* Grab the name from the input */
     input->band_name[band_index] = strdup(filename);
 
     /* Open a file descriptor for the band */
-    input->band_fd[band_index] =
-        fopen(input->band_name[band_index], "rb");
-
-    if (input->band_fd[band_index] == NULL)
+    fd = open(input->band_name[band_index], O_RDONLY);
+    if (fd == -1)
     {
         snprintf(msg, sizeof(msg), "Failed to open (%s)",
                  input->band_name[band_index]);
         RETURN_ERROR(msg, FUNC_NAME, FAILURE);
     }
 
+    if (fstat(fd, &band_stat) != 0 || band_stat.st_size <= 0)
+    {
+        close(fd);
+        snprintf(msg, sizeof(msg), "Failed to determine the size of (%s)",
+                 input->band_name[band_index]);
+        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+    }
+
+    /* The mapping remains valid after the file descriptor is closed */
+    band_map = mmap(NULL, band_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (band_map == MAP_FAILED)
+    {
+        snprintf(msg, sizeof(msg), "Failed to map (%s)",
+                 input->band_name[band_index]);
+        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+    }
+
+    /* Only a hint, so a failure is not an error */
+    madvise(band_map, band_stat.st_size, MADV_SEQUENTIAL);
+
+    input->band_map[band_index] = band_map;
+    input->band_map_size[band_index] = band_stat.st_size;
+    input->band_next_line[band_index] = 0;
+
     return SUCCESS;
 }
 
 
+/*****************************************************************************
+  NAME:  read_band_lines
+
+  PURPOSE:  Provide the next lines of a mapped band and advance past them.
+            Only the samples of the window are used, so successive lines are
+            band_samples pixels apart within the mapping.
+
+  RETURN VALUE:  Type = void *
+      Value    Description
+      -------  ---------------------------------------------------------------
+      pointer  The first pixel of the window for the first line within the
+               mapping.
+      NULL     The band does not hold that many more lines.
+*****************************************************************************/
+void *
+read_band_lines
+(
+    Input_Data_t *input,      /* I/O: input structure */
+    Input_Bands_e band_index, /* I: the band to read */
+    size_t pixel_size,        /* I: size of a pixel of the band */
+    int lines                 /* I: number of lines to read */
+)
+{
+    size_t first_pixel;
+    size_t end_pixel;
+    int line = input->first_line + input->band_next_line[band_index];
+
+    first_pixel = (size_t) line * input->band_samples + input->first_sample;
+    end_pixel = (size_t) (line + lines - 1) * input->band_samples
+                + input->first_sample + input->samples;
+
+    if (input->band_map[band_index] == NULL || lines <= 0
+        || end_pixel * pixel_size > input->band_map_size[band_index])
+    {
+        return NULL;
+    }
+
+    input->band_next_line[band_index] += lines;
+
+    return (char *) input->band_map[band_index] + first_pixel * pixel_size;
+}
+
+
 /*****************************************************************************
 
 Description: 'OpenInput' sets up the 'input' data structure, opens the
@@ -77,7 +158,9 @@ open_input
     for (index = 0; index < MAX_INPUT_BANDS; index++)
     {
         input->band_name[index] = NULL;
-        input->band_fd[index] = NULL;
+        input->band_map[index] = NULL;
+        input->band_map_size[index] = 0;
+        input->band_next_line[index] = 0;
     }
 
     input->lines = 0;
@@ -91,6 +174,12 @@ open_input
         RETURN_ERROR("getting input from header file", FUNC_NAME, NULL);
     }
 
+    /* Process the whole scene unless a window is set */
+    input->band_lines = input->lines;
+    input->band_samples = input->samples;
+    input->first_line = 0;
+    input->first_sample = 0;
+
     return input;
 }
 
@@ -98,8 +187,8 @@ open_input
 /*****************************************************************************
   NAME:  close_input
 
-  PURPOSE:  Close all the input files and free associated memory that resides
-            in the data structure.
+  PURPOSE:  Unmap all the input files and free associated memory that
+            resides in the data structure.
 
   RETURN VALUE:  Type = int
       Value    Description
@@ -119,104 +208,449 @@ close_input (Input_Data_t *input)
     had_issue = false;
     for (index = 0; index < MAX_INPUT_BANDS; index++)
     {
-        if (input->band_fd[index] == NULL &&
-            input->band_name[index] == NULL)
+        /* Optional bands may not have been opened */
+        if (input->band_map[index] != NULL)
         {
-            status = fclose (input->band_fd[index]);
+            status = munmap (input->band_map[index],
+                             input->band_map_size[index]);
             if (status != 0)
             {
                 snprintf (msg, sizeof (msg),
-                          "Failed to close (%s)",
+                          "Failed to unmap (%s)",
                           input->band_name[index]);
                 WARNING_MESSAGE (msg, FUNC_NAME);
 
                 had_issue = true;
             }
+            input->band_map[index] = NULL;
+        }
+
+        free (input->band_name[index]);
+    }
+
+    if (had_issue)
+        return ERROR;
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+  NAME:  decode_thermal_int16_scalar
+
+  PURPOSE:  Convert int16 thermal DNs to radiance, setting the fill to
+            LST_NO_DATA_VALUE.
 
-            free (input->band_name[index]);
+  RETURN VALUE:  None
+*****************************************************************************/
+void
+decode_thermal_int16_scalar
+(
+    int16_t *dn,       /* I: the DNs */
+    int count,         /* I: number of DNs */
+    int fill_value,    /* I: fill value of the DNs */
+    float gain,        /* I: radiance gain */
+    float bias,        /* I: radiance bias */
+    float *radiance    /* O: the radiance */
+)
+{
+    int index;
+
+    for (index = 0; index < count; index++)
+    {
+        if (dn[index] == fill_value)
+            radiance[index] = LST_NO_DATA_VALUE;
+        else
+            radiance[index] = (float)((gain * dn[index]) + bias);
+    }
+}
+
+
+/*****************************************************************************
+  NAME:  decode_thermal_uint8_scalar
+
+  PURPOSE:  Convert uint8 thermal DNs to radiance, applying the adjustment,
+            and setting the fill to LST_NO_DATA_VALUE.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+void
+decode_thermal_uint8_scalar
+(
+    uint8_t *dn,       /* I: the DNs */
+    int count,         /* I: number of DNs */
+    int fill_value,    /* I: fill value of the DNs */
+    float gain,        /* I: radiance gain */
+    float bias,        /* I: radiance bias */
+    float adjustment,  /* I: adjustment added to the radiance */
+    float *radiance    /* O: the radiance */
+)
+{
+    int index;
+
+    for (index = 0; index < count; index++)
+    {
+        if (dn[index] == fill_value)
+        {
+            radiance[index] = LST_NO_DATA_VALUE;
         }
         else
         {
-            fclose (input->band_fd[index]);
-            free (input->band_name[index]);
+            radiance[index] = (float)((gain * dn[index]) + bias);
+            radiance[index] += adjustment;
         }
     }
+}
 
-    if (had_issue)
-        return ERROR;
 
-    return SUCCESS;
+#if CPU_KERNELS_DISPATCH
+/*****************************************************************************
+  NAME:  decode_thermal_int16_avx512
+
+  PURPOSE:  Same as decode_thermal_int16_scalar, sixteen DNs at a time, with
+            the fill blended in by mask.  The operations are the same as the
+            scalar code, so the results are identical.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+AVX512_KERNEL
+void
+decode_thermal_int16_avx512
+(
+    int16_t *dn,       /* I: the DNs */
+    int count,         /* I: number of DNs */
+    int fill_value,    /* I: fill value of the DNs */
+    float gain,        /* I: radiance gain */
+    float bias,        /* I: radiance bias */
+    float *radiance    /* O: the radiance */
+)
+{
+    int index;
+
+    __m512i values;
+    __m512 result;
+
+    const __m512i v_fill = _mm512_set1_epi32 (fill_value);
+    const __m512 v_gain = _mm512_set1_ps (gain);
+    const __m512 v_bias = _mm512_set1_ps (bias);
+    const __m512 v_no_data = _mm512_set1_ps (LST_NO_DATA_VALUE);
+
+    for (index = 0; index + 16 <= count; index += 16)
+    {
+        values = _mm512_cvtepi16_epi32 (
+            _mm256_loadu_si256 ((__m256i *) &dn[index]));
+
+        result = _mm512_add_ps (
+            _mm512_mul_ps (v_gain, _mm512_cvtepi32_ps (values)), v_bias);
+
+        _mm512_storeu_ps (&radiance[index], _mm512_mask_blend_ps (
+            _mm512_cmpeq_epi32_mask (values, v_fill), result, v_no_data));
+    }
+
+    /* Finish the DNs which do not fill a vector */
+    decode_thermal_int16_scalar (&dn[index], count - index, fill_value,
+                                 gain, bias, &radiance[index]);
+}
+
+
+/*****************************************************************************
+  NAME:  decode_thermal_uint8_avx512
+
+  PURPOSE:  Same as decode_thermal_uint8_scalar, sixteen DNs at a time, with
+            the fill blended in by mask.  The operations are the same as the
+            scalar code, so the results are identical.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+AVX512_KERNEL
+void
+decode_thermal_uint8_avx512
+(
+    uint8_t *dn,       /* I: the DNs */
+    int count,         /* I: number of DNs */
+    int fill_value,    /* I: fill value of the DNs */
+    float gain,        /* I: radiance gain */
+    float bias,        /* I: radiance bias */
+    float adjustment,  /* I: adjustment added to the radiance */
+    float *radiance    /* O: the radiance */
+)
+{
+    int index;
+
+    __m512i values;
+    __m512 result;
+
+    const __m512i v_fill = _mm512_set1_epi32 (fill_value);
+    const __m512 v_gain = _mm512_set1_ps (gain);
+    const __m512 v_bias = _mm512_set1_ps (bias);
+    const __m512 v_adjustment = _mm512_set1_ps (adjustment);
+    const __m512 v_no_data = _mm512_set1_ps (LST_NO_DATA_VALUE);
+
+    for (index = 0; index + 16 <= count; index += 16)
+    {
+        values = _mm512_cvtepu8_epi32 (
+            _mm_loadu_si128 ((__m128i *) &dn[index]));
+
+        result = _mm512_add_ps (
+            _mm512_mul_ps (v_gain, _mm512_cvtepi32_ps (values)), v_bias);
+        result = _mm512_add_ps (result, v_adjustment);
+
+        _mm512_storeu_ps (&radiance[index], _mm512_mask_blend_ps (
+            _mm512_cmpeq_epi32_mask (values, v_fill), result, v_no_data));
+    }
+
+    /* Finish the DNs which do not fill a vector */
+    decode_thermal_uint8_scalar (&dn[index], count - index, fill_value,
+                                 gain, bias, adjustment, &radiance[index]);
+}
+#endif
+
+
+#if CPU_KERNELS_DISPATCH
+/*****************************************************************************
+  NAME:  decode_thermal_int16_avx2
+
+  PURPOSE:  Same as decode_thermal_int16_scalar, eight DNs at a time, with
+            the fill blended in by mask.  The operations are the same as the
+            scalar code, so the results are identical.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+AVX2_KERNEL
+void
+decode_thermal_int16_avx2
+(
+    int16_t *dn,       /* I: the DNs */
+    int count,         /* I: number of DNs */
+    int fill_value,    /* I: fill value of the DNs */
+    float gain,        /* I: radiance gain */
+    float bias,        /* I: radiance bias */
+    float *radiance    /* O: the radiance */
+)
+{
+    int index;
+
+    __m256i values;
+    __m256 result;
+
+    const __m256i v_fill = _mm256_set1_epi32 (fill_value);
+    const __m256 v_gain = _mm256_set1_ps (gain);
+    const __m256 v_bias = _mm256_set1_ps (bias);
+    const __m256 v_no_data = _mm256_set1_ps (LST_NO_DATA_VALUE);
+
+    for (index = 0; index + 8 <= count; index += 8)
+    {
+        values = _mm256_cvtepi16_epi32 (
+            _mm_loadu_si128 ((__m128i *) &dn[index]));
+
+        result = _mm256_add_ps (
+            _mm256_mul_ps (v_gain, _mm256_cvtepi32_ps (values)), v_bias);
+
+        _mm256_storeu_ps (&radiance[index], _mm256_blendv_ps (
+            result, v_no_data, _mm256_castsi256_ps (
+                _mm256_cmpeq_epi32 (values, v_fill))));
+    }
+
+    /* Finish the DNs which do not fill a vector */
+    decode_thermal_int16_scalar (&dn[index], count - index, fill_value,
+                                 gain, bias, &radiance[index]);
+}
+
+
+/*****************************************************************************
+  NAME:  decode_thermal_uint8_avx2
+
+  PURPOSE:  Same as decode_thermal_uint8_scalar, eight DNs at a time, with
+            the fill blended in by mask.  The operations are the same as the
+            scalar code, so the results are identical.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+AVX2_KERNEL
+void
+decode_thermal_uint8_avx2
+(
+    uint8_t *dn,       /* I: the DNs */
+    int count,         /* I: number of DNs */
+    int fill_value,    /* I: fill value of the DNs */
+    float gain,        /* I: radiance gain */
+    float bias,        /* I: radiance bias */
+    float adjustment,  /* I: adjustment added to the radiance */
+    float *radiance    /* O: the radiance */
+)
+{
+    int index;
+
+    __m256i values;
+    __m256 result;
+
+    const __m256i v_fill = _mm256_set1_epi32 (fill_value);
+    const __m256 v_gain = _mm256_set1_ps (gain);
+    const __m256 v_bias = _mm256_set1_ps (bias);
+    const __m256 v_adjustment = _mm256_set1_ps (adjustment);
+    const __m256 v_no_data = _mm256_set1_ps (LST_NO_DATA_VALUE);
+
+    for (index = 0; index + 8 <= count; index += 8)
+    {
+        values = _mm256_cvtepu8_epi32 (
+            _mm_loadl_epi64 ((__m128i *) &dn[index]));
+
+        result = _mm256_add_ps (
+            _mm256_mul_ps (v_gain, _mm256_cvtepi32_ps (values)), v_bias);
+        result = _mm256_add_ps (result, v_adjustment);
+
+        _mm256_storeu_ps (&radiance[index], _mm256_blendv_ps (
+            result, v_no_data, _mm256_castsi256_ps (
+                _mm256_cmpeq_epi32 (values, v_fill))));
+    }
+
+    /* Finish the DNs which do not fill a vector */
+    decode_thermal_uint8_scalar (&dn[index], count - index, fill_value,
+                                 gain, bias, adjustment, &radiance[index]);
+}
+#endif
+
+
+/*****************************************************************************
+  NAME:  decode_thermal_int16
+
+  PURPOSE:  Convert int16 thermal DNs to radiance, setting the fill to
+            LST_NO_DATA_VALUE, with the kernel variant selected for the
+            processor.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+void
+decode_thermal_int16
+(
+    int16_t *dn,       /* I: the DNs */
+    int count,         /* I: number of DNs */
+    int fill_value,    /* I: fill value of the DNs */
+    float gain,        /* I: radiance gain */
+    float bias,        /* I: radiance bias */
+    float *radiance    /* O: the radiance */
+)
+{
+    switch (cpu_kernels ())
+    {
+#if CPU_KERNELS_DISPATCH
+        case CPU_KERNELS_AVX512:
+            decode_thermal_int16_avx512 (dn, count, fill_value, gain, bias,
+                                         radiance);
+            break;
+        case CPU_KERNELS_AVX2:
+            decode_thermal_int16_avx2 (dn, count, fill_value, gain, bias,
+                                       radiance);
+            break;
+#endif
+        default:
+            decode_thermal_int16_scalar (dn, count, fill_value, gain, bias,
+                                         radiance);
+            break;
+    }
+}
+
+
+/*****************************************************************************
+  NAME:  decode_thermal_uint8
+
+  PURPOSE:  Convert uint8 thermal DNs to radiance, applying the adjustment,
+            and setting the fill to LST_NO_DATA_VALUE, with the kernel
+            variant selected for the processor.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+void
+decode_thermal_uint8
+(
+    uint8_t *dn,       /* I: the DNs */
+    int count,         /* I: number of DNs */
+    int fill_value,    /* I: fill value of the DNs */
+    float gain,        /* I: radiance gain */
+    float bias,        /* I: radiance bias */
+    float adjustment,  /* I: adjustment added to the radiance */
+    float *radiance    /* O: the radiance */
+)
+{
+    switch (cpu_kernels ())
+    {
+#if CPU_KERNELS_DISPATCH
+        case CPU_KERNELS_AVX512:
+            decode_thermal_uint8_avx512 (dn, count, fill_value, gain, bias,
+                                         adjustment, radiance);
+            break;
+        case CPU_KERNELS_AVX2:
+            decode_thermal_uint8_avx2 (dn, count, fill_value, gain, bias,
+                                       adjustment, radiance);
+            break;
+#endif
+        default:
+            decode_thermal_uint8_scalar (dn, count, fill_value, gain, bias,
+                                         adjustment, radiance);
+            break;
+    }
 }
 
 
 /*****************************************************************************
   NAME: read_input
 
-  PURPOSE: To read the specified input bands into memory for later processing.
+  PURPOSE: To convert the next pixel_count pixels of the thermal band to
+           radiance and to provide the next pixel_count pixels of the
+           elevation band, so a scene can be processed a strip of lines at a
+           time with successive calls.  Both are taken directly from the band
+           mappings, so band_elevation is set to point within the mapping,
+           with its lines band_samples apart, and remains valid until the
+           input is closed.  The thermal DNs are
+           decoded straight from the mapping a line at a time, and the valid
+           spans of each line are found as it is decoded.
 
-  RETURN VALUE:  Type = bool
+  RETURN VALUE:  Type = int
       Value    Description
       -------  ---------------------------------------------------------------
-      true     Success with reading all of the bands into memory.
-      false    Failed to read a band into memory.
+      SUCCESS  The bands were read.
+      FAILURE  Failed to read a band.
 *****************************************************************************/
 int
 read_input
 (
     Input_Data_t *input,
     float *band_thermal,
-    int16_t *band_elevation,
-    int pixel_count
+    Valid_Spans_t *spans,
+    int16_t **band_elevation,
+    size_t pixel_count
 )
 {
     char FUNC_NAME[] = "read_bands_into_memory";
-    int count;
-    int index;
+    int line;
+    int lines;
+    size_t line_loc;
+    size_t band_line_loc;
+    float adjustment = 0.0;
     uint8_t *thermal_uint8 = NULL;
     int16_t *thermal_int16 = NULL;
 
+    /* Only whole lines are read, so the spans can be found for each */
+    lines = pixel_count / input->samples;
+    if ((size_t) lines * input->samples != pixel_count
+        || lines > spans->max_lines)
+    {
+        RETURN_ERROR("Invalid number of pixels to read", FUNC_NAME, FAILURE);
+    }
+
     if (input->meta.instrument == INST_OLI_TIRS
         && input->meta.satellite == SAT_LANDSAT_8)
     {
-        thermal_int16 = malloc(sizeof(int16_t) * pixel_count);
+        thermal_int16 = read_band_lines(input, I_BAND_THERMAL,
+                                        sizeof(int16_t), lines);
         if (thermal_int16 == NULL)
         {
-            RETURN_ERROR("error allocating thermal memory",
-                         FUNC_NAME, FAILURE);
-        }
-
-        count = fread(thermal_int16, sizeof(int16_t), pixel_count,
-                      input->band_fd[I_BAND_THERMAL]);
-        if (count != pixel_count)
-        {
-            free(thermal_int16);
-
             RETURN_ERROR("Failed reading thermal band data",
                          FUNC_NAME, FAILURE);
         }
-
-        /* Copy the data to the output buffer manually while converting to
-           radiance and float */
-        for (index = 0; index < pixel_count; index++)
-        {
-            if (thermal_int16[index] == input->fill_value[I_BAND_THERMAL])
-            {
-                band_thermal[index] = LST_NO_DATA_VALUE;
-            }
-            else
-            {
-                band_thermal[index] =
-                    (float)((input->thermal_rad_gain * thermal_int16[index])
-                            + input->thermal_rad_bias);
-            }
-        }
-
-        free(thermal_int16);
     }
     else
     {
-        float adjustment = 0.0;
-
         /* If L5 data, it needs some adjustment.
            TODO - Whenever CALVAL gets around to fixing the CPF, then
                   we will no longer need to perform this operation
@@ -227,57 +661,467 @@ read_input
             adjustment = 0.044;
         }
 
-        thermal_uint8 = malloc(sizeof(uint8_t) * pixel_count);
+        thermal_uint8 = read_band_lines(input, I_BAND_THERMAL,
+                                        sizeof(uint8_t), lines);
         if (thermal_uint8 == NULL)
         {
-            RETURN_ERROR("error allocating thermal memory",
+            RETURN_ERROR("Failed reading thermal band data",
                          FUNC_NAME, FAILURE);
         }
+    }
 
-        count = fread(thermal_uint8, sizeof(uint8_t), pixel_count,
-                      input->band_fd[I_BAND_THERMAL]);
-        if (count != pixel_count)
-        {
-            free(thermal_uint8);
+    spans->lines = lines;
+    spans->line_first_span[0] = 0;
+    for (line = 0; line < lines; line++)
+    {
+        line_loc = (size_t) line * input->samples;
+        band_line_loc = (size_t) line * input->band_samples;
 
-            RETURN_ERROR("Failed reading thermal band data",
-                         FUNC_NAME, FAILURE);
+        /* Convert the data to radiance and float while copying it to the
+           output buffer */
+        if (thermal_int16 != NULL)
+        {
+            decode_thermal_int16(&thermal_int16[band_line_loc],
+                                 input->samples,
+                                 input->fill_value[I_BAND_THERMAL],
+                                 input->thermal_rad_gain,
+                                 input->thermal_rad_bias,
+                                 &band_thermal[line_loc]);
         }
+        else
+        {
+            /* Adjustment from above for L5 or 0.0 */
+            decode_thermal_uint8(&thermal_uint8[band_line_loc],
+                                 input->samples,
+                                 input->fill_value[I_BAND_THERMAL],
+                                 input->thermal_rad_gain,
+                                 input->thermal_rad_bias, adjustment,
+                                 &band_thermal[line_loc]);
+        }
+
+        /* Find the valid spans while the line is still in cache */
+        find_valid_spans(&band_thermal[line_loc], input->samples, line,
+                         spans);
+    }
+
+    *band_elevation = read_band_lines(input, I_BAND_ELEVATION,
+                                      sizeof(int16_t), lines);
+    if (*band_elevation == NULL)
+    {
+        RETURN_ERROR("Failed reading elevation band data",
+                     FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
 
-        /* Copy the data to the output buffer manually while converting to
-           radiance and float */
-        for (index = 0; index < pixel_count; index++)
+
+/*****************************************************************************
+  NAME: find_elevation_range
+
+  PURPOSE: To find the lowest and highest elevation of the pixels which will
+           be processed, those with a valid thermal DN, directly from the
+           band mappings.  The thermal DNs are only compared to their fill
+           value, not decoded, and the bands are left positioned where they
+           were, so this is done ahead of reading them with read_input.  The
+           range should start out as INT16_MAX to INT16_MIN.
+
+  RETURN VALUE:  Type = int
+      Value    Description
+      -------  ---------------------------------------------------------------
+      SUCCESS  The range was found.
+      FAILURE  A band does not hold the lines of the window.
+*****************************************************************************/
+int
+find_elevation_range
+(
+    Input_Data_t *input,
+    int *min_height,
+    int *max_height
+)
+{
+    char FUNC_NAME[] = "find_elevation_range";
+    int line;
+    int sample;
+    int fill_value = input->fill_value[I_BAND_THERMAL];
+    bool int16_thermal = (input->meta.instrument == INST_OLI_TIRS
+                          && input->meta.satellite == SAT_LANDSAT_8);
+    size_t thermal_size = int16_thermal ? sizeof(int16_t) : sizeof(uint8_t);
+    size_t first_pixel;
+    size_t end_pixel;
+    uint8_t *thermal_uint8;
+    int16_t *thermal_int16;
+    int16_t *elevation;
+
+    first_pixel = (size_t) input->first_line * input->band_samples
+                  + input->first_sample;
+    end_pixel = (size_t) (input->first_line + input->lines - 1)
+                * input->band_samples + input->first_sample + input->samples;
+    if (input->band_map[I_BAND_THERMAL] == NULL
+        || input->band_map[I_BAND_ELEVATION] == NULL
+        || end_pixel * thermal_size > input->band_map_size[I_BAND_THERMAL]
+        || end_pixel * sizeof(int16_t)
+           > input->band_map_size[I_BAND_ELEVATION])
+    {
+        RETURN_ERROR("The thermal and elevation bands do not hold the"
+                     " window", FUNC_NAME, FAILURE);
+    }
+
+    for (line = 0; line < input->lines; line++)
+    {
+        elevation = (int16_t *) input->band_map[I_BAND_ELEVATION]
+                    + first_pixel + (size_t) line * input->band_samples;
+        thermal_uint8 = (uint8_t *) input->band_map[I_BAND_THERMAL]
+                        + first_pixel + (size_t) line * input->band_samples;
+        thermal_int16 = (int16_t *) input->band_map[I_BAND_THERMAL]
+                        + first_pixel + (size_t) line * input->band_samples;
+
+        for (sample = 0; sample < input->samples; sample++)
         {
-            if (thermal_uint8[index] == input->fill_value[I_BAND_THERMAL])
+            if (int16_thermal ? thermal_int16[sample] == fill_value
+                              : thermal_uint8[sample] == fill_value)
             {
-                band_thermal[index] = LST_NO_DATA_VALUE;
+                continue;
             }
-            else
-            {
-                band_thermal[index] =
-                    (float)((input->thermal_rad_gain * thermal_uint8[index])
-                            + input->thermal_rad_bias);
 
-                /* Adjustment from above for L5 or 0.0 */
-                band_thermal[index] += adjustment;
-            }
+            if (elevation[sample] < *min_height)
+                *min_height = elevation[sample];
+            if (elevation[sample] > *max_height)
+                *max_height = elevation[sample];
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+  NAME: set_input_window
+
+  PURPOSE: To restrict the processing to a window of the scene.  The region
+           of interest is given by its upper left and lower right corners,
+           either as map coordinates (easting, northing), or as pixel
+           coordinates (sample, line) from the outer corner of the scene.
+           The window holds every pixel touched by the region, limited to
+           the scene, and its upper left pixel becomes the first pixel
+           processed.
+
+  RETURN VALUE:  Type = int
+      Value    Description
+      -------  ---------------------------------------------------------------
+      SUCCESS  The window was set.
+      FAILURE  The corners are inverted, or the region does not cover any of
+               the scene.
+*****************************************************************************/
+int
+set_input_window
+(
+    Input_Data_t *input,
+    Roi_Units_t roi_units,
+    double *roi
+)
+{
+    char FUNC_NAME[] = "set_input_window";
+    char msg[256];
+    double ul_x = input->meta.ul_map_corner.x;
+    double ul_y = input->meta.ul_map_corner.y;
+    double ul_sample;
+    double ul_line;
+    double lr_sample;
+    double lr_line;
+    int first_line;
+    int first_sample;
+    int end_line;
+    int end_sample;
+
+    if (roi_units == ROI_UNITS_MAP)
+    {
+        /* The northing decreases from the upper left to the lower right */
+        if (roi[2] <= roi[0] || roi[3] >= roi[1])
+        {
+            RETURN_ERROR("The region of interest must be given as the upper"
+                         " left then lower right map coordinates",
+                         FUNC_NAME, FAILURE);
         }
 
-        free(thermal_uint8);
+        /* The pixel coordinates are from the outer corner of the scene */
+        if (input->meta.center_origin)
+        {
+            ul_x -= 0.5 * input->x_pixel_size;
+            ul_y += 0.5 * input->y_pixel_size;
+        }
+
+        ul_sample = (roi[0] - ul_x) / input->x_pixel_size;
+        ul_line = (ul_y - roi[1]) / input->y_pixel_size;
+        lr_sample = (roi[2] - ul_x) / input->x_pixel_size;
+        lr_line = (ul_y - roi[3]) / input->y_pixel_size;
     }
+    else if (roi_units == ROI_UNITS_PIXELS)
+    {
+        if (roi[2] <= roi[0] || roi[3] <= roi[1])
+        {
+            RETURN_ERROR("The region of interest must be given as the upper"
+                         " left then lower right pixel coordinates",
+                         FUNC_NAME, FAILURE);
+        }
 
-    count = fread(band_elevation, sizeof(int16_t), pixel_count,
-                  input->band_fd[I_BAND_ELEVATION]);
-    if (count != pixel_count)
+        ul_sample = roi[0];
+        ul_line = roi[1];
+        lr_sample = roi[2];
+        lr_line = roi[3];
+    }
+    else
     {
-        RETURN_ERROR("Failed reading elevation band data",
+        RETURN_ERROR("Invalid units for the region of interest", FUNC_NAME,
+                     FAILURE);
+    }
+
+    /* Corners falling on the pixel edges do not add a pixel */
+    first_sample = max(0, (int) floor(ul_sample + ROI_PIXEL_TOLERANCE));
+    first_line = max(0, (int) floor(ul_line + ROI_PIXEL_TOLERANCE));
+    end_sample = min(input->band_samples,
+                     (int) ceil(lr_sample - ROI_PIXEL_TOLERANCE));
+    end_line = min(input->band_lines,
+                   (int) ceil(lr_line - ROI_PIXEL_TOLERANCE));
+
+    if (end_sample <= first_sample || end_line <= first_line)
+    {
+        RETURN_ERROR("The region of interest does not cover the scene",
+                     FUNC_NAME, FAILURE);
+    }
+
+    input->first_line = first_line;
+    input->first_sample = first_sample;
+    input->lines = end_line - first_line;
+    input->samples = end_sample - first_sample;
+
+    /* The window corners become the scene corners */
+    input->meta.ul_map_corner.x += first_sample * input->x_pixel_size;
+    input->meta.ul_map_corner.y -= first_line * input->y_pixel_size;
+    input->meta.lr_map_corner.x = input->meta.ul_map_corner.x
+                                  + input->samples * input->x_pixel_size;
+    input->meta.lr_map_corner.y = input->meta.ul_map_corner.y
+                                  - input->lines * input->y_pixel_size;
+
+    snprintf(msg, sizeof(msg),
+             "Processing the window of lines %d to %d, samples %d to %d",
+             first_line, end_line - 1, first_sample, end_sample - 1);
+    LOG_MESSAGE(msg, FUNC_NAME);
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+  NAME: read_emissivity
+
+  PURPOSE: To read the next pixel_count pixels of the emissivity band into
+           memory, setting its fill to LST_NO_DATA_VALUE.
+
+  RETURN VALUE:  Type = int
+      Value    Description
+      -------  ---------------------------------------------------------------
+      SUCCESS  The pixels were read.
+      FAILURE  The band is not available or failed to be read.
+*****************************************************************************/
+int
+read_emissivity
+(
+    Input_Data_t *input,
+    float *band_emissivity,
+    size_t pixel_count
+)
+{
+    char FUNC_NAME[] = "read_emissivity";
+    size_t index;
+    int line;
+    int sample;
+    int lines = pixel_count / input->samples;
+    float *emissivity = NULL;
+
+    if (input->band_map[I_BAND_EMISSIVITY] == NULL)
+    {
+        RETURN_ERROR("The emissivity band is not available",
                      FUNC_NAME, FAILURE);
     }
 
+    emissivity = read_band_lines(input, I_BAND_EMISSIVITY, sizeof(float),
+                                 lines);
+    if (emissivity == NULL
+        || (size_t) lines * input->samples != pixel_count)
+    {
+        RETURN_ERROR("Failed reading emissivity band data",
+                     FUNC_NAME, FAILURE);
+    }
+
+    index = 0;
+    for (line = 0; line < lines; line++)
+    {
+        for (sample = 0; sample < input->samples; sample++, index++)
+        {
+            if (emissivity[sample] == input->fill_value[I_BAND_EMISSIVITY])
+                band_emissivity[index] = LST_NO_DATA_VALUE;
+            else
+                band_emissivity[index] = emissivity[sample];
+        }
+
+        emissivity += input->band_samples;
+    }
+
     return SUCCESS;
 }
 
 
+/*****************************************************************************
+  NAME: allocate_valid_spans
+
+  PURPOSE: To allocate the valid spans for a strip of lines.  A line holds at
+           most one span for every two samples.
+
+  RETURN VALUE:  Type = int
+      Value    Description
+      -------  ---------------------------------------------------------------
+      SUCCESS  The spans were allocated.
+      FAILURE  Failed to allocate the spans.
+*****************************************************************************/
+int
+allocate_valid_spans
+(
+    Valid_Spans_t *spans,
+    int lines,
+    int samples
+)
+{
+    char FUNC_NAME[] = "allocate_valid_spans";
+    size_t max_spans = (size_t) lines * ((samples + 1) / 2);
+
+    spans->max_lines = lines;
+    spans->lines = 0;
+    spans->line_first_span = calloc(lines + 1, sizeof(int));
+    spans->span_start = malloc(max_spans * sizeof(int));
+    spans->span_end = malloc(max_spans * sizeof(int));
+    if (spans->line_first_span == NULL || spans->span_start == NULL
+        || spans->span_end == NULL)
+    {
+        free_valid_spans(spans);
+        RETURN_ERROR("Allocating memory for the valid spans",
+                     FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+  NAME: free_valid_spans
+
+  PURPOSE: To free the valid spans.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+void
+free_valid_spans
+(
+    Valid_Spans_t *spans
+)
+{
+    free(spans->line_first_span);
+    spans->line_first_span = NULL;
+
+    free(spans->span_start);
+    spans->span_start = NULL;
+
+    free(spans->span_end);
+    spans->span_end = NULL;
+
+    spans->max_lines = 0;
+    spans->lines = 0;
+}
+
+
+/*****************************************************************************
+  NAME: find_valid_spans
+
+  PURPOSE: To find the runs of valid thermal pixels in a line, following
+           those of the previous lines of the strip.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+void
+find_valid_spans
+(
+    float *line_thermal,
+    int samples,
+    int line,
+    Valid_Spans_t *spans
+)
+{
+    int sample = 0;
+    int span = spans->line_first_span[line];
+
+    while (sample < samples)
+    {
+        /* Skip FILL */
+        while (sample < samples && line_thermal[sample] == LST_NO_DATA_VALUE)
+            sample++;
+
+        if (sample == samples)
+            break;
+
+        spans->span_start[span] = sample;
+        while (sample < samples && line_thermal[sample] != LST_NO_DATA_VALUE)
+            sample++;
+        spans->span_end[span] = sample;
+
+        span++;
+    }
+
+    spans->line_first_span[line + 1] = span;
+}
+
+
+/*****************************************************************************
+  NAME: fill_invalid_samples
+
+  PURPOSE: To set the samples of a line outside of its valid spans to the
+           specified value.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+void
+fill_invalid_samples
+(
+    Valid_Spans_t *spans,
+    int line,
+    int samples,
+    void *line_values,
+    const void *value,
+    size_t value_size
+)
+{
+    int span;
+    int fill_start = 0;
+    int fill_end;
+    char *values = line_values;
+
+    for (span = spans->line_first_span[line];
+         span <= spans->line_first_span[line + 1]; span++)
+    {
+        /* Fill ahead of each span, and after the last one */
+        if (span < spans->line_first_span[line + 1])
+            fill_end = spans->span_start[span];
+        else
+            fill_end = samples;
+
+        fill_values(values + fill_start * value_size, value, value_size,
+                    fill_end - fill_start);
+
+        if (span < spans->line_first_span[line + 1])
+            fill_start = spans->span_end[span];
+    }
+}
+
+
 #define DATE_STRING_LEN (50)
 #define TIME_STRING_LEN (50)
 #define INVALID_INSTRUMENT_COMBO ("invalid instrument/satellite combination")
@@ -399,6 +1243,8 @@ GetXMLInput (Input_Data_t *input, Espa_internal_meta_t *metadata)
     }
 
     input->meta.zone = global->proj_info.utm_zone;
+    input->meta.wrs_path = global->wrs_path;
+    input->meta.wrs_row = global->wrs_row;
 
     for (index = 0; index < metadata->nbands; index++)
     {
@@ -451,6 +1297,26 @@ GetXMLInput (Input_Data_t *input, Espa_internal_meta_t *metadata)
                     metadata->band[index].fill_value;
             }
         }
+
+        /* The emissivity is only present once it has been estimated */
+        if (strcmp (metadata->band[index].product,
+                    LST_EMISSIVITY_PRODUCT_NAME) == 0)
+        {
+            if (strcmp (metadata->band[index].name,
+                        LST_EMISSIVITY_BAND_NAME) == 0)
+            {
+                if (open_band(metadata->band[index].file_name,
+                              input, I_BAND_EMISSIVITY) != SUCCESS)
+                {
+                    RETURN_ERROR("Error opening emissivity", FUNC_NAME,
+                                 false);
+                }
+
+                /* Grab the fill value for this band */
+                input->fill_value[I_BAND_EMISSIVITY] =
+                    metadata->band[index].fill_value;
+            }
+        }
     }
 
     /* Get the scene ID */
@@ -463,6 +1329,8 @@ GetXMLInput (Input_Data_t *input, Espa_internal_meta_t *metadata)
     input->meta.lr_map_corner.x = metadata->global.proj_info.lr_corner[0];
     input->meta.lr_map_corner.y = metadata->global.proj_info.lr_corner[1];
     input->meta.lr_map_corner.is_fill = true;
+    input->meta.center_origin =
+        (strcmp (metadata->global.proj_info.grid_origin, "CENTER") == 0);
 
     /* Get the geographic coordinates */
     input->meta.ul_geo_corner.lat = metadata->global.ul_corner[0];
@@ -58,6 +58,15 @@ typedef enum
 } Gain_t;
 
 
+/* Units of the corners of the region of interest */
+typedef enum
+{
+    ROI_UNITS_NONE,             /* No region, the whole scene */
+    ROI_UNITS_MAP,              /* Map coordinates, easting and northing */
+    ROI_UNITS_PIXELS            /* Pixel coordinates, sample and line */
+} Roi_Units_t;
+
+
 /* Structure for the metadata */
 typedef struct
 {
@@ -66,6 +75,8 @@ typedef struct
     char *product_id;           /* ProductID */
     Date_t acq_date;            /* Acq. date/time (scene center) */
     int zone;                   /* UTM zone number */
+    int wrs_path;               /* WRS path */
+    int wrs_row;                /* WRS row */
     Map_coord_t ul_map_corner;  /* Map projection coordinates of the upper
                                    left corner of the pixel in the upper left
                                    corner of the image */
@@ -79,6 +90,8 @@ typedef struct
                                    right corner of the pixel in the lower right
                                    corner of the image */
     double bounding_coords[4];  /* Bounding Coordinates */
+    bool center_origin;         /* The map corners are at the center of the
+                                   corner pixels, grid origin CENTER */
 } Input_meta_t;
 
 
@@ -86,13 +99,21 @@ typedef struct
 typedef struct
 {
     Input_meta_t meta;          /* Input metadata */
-    int lines;
-    int samples;
+    int lines;                  /* Lines and samples processed, those of the */
+    int samples;                /*   window when one is set */
+    int band_lines;             /* Lines and samples of the band files */
+    int band_samples;
+    int first_line;             /* First line and sample of the band files */
+    int first_sample;           /*   processed */
     float x_pixel_size;
     float y_pixel_size;
     char reference_band_name[30];
     char *band_name[MAX_INPUT_BANDS];
-    FILE *band_fd[MAX_INPUT_BANDS];
+    void *band_map[MAX_INPUT_BANDS];         /* read-only mapping of each
+                                                band file */
+    size_t band_map_size[MAX_INPUT_BANDS];   /* size of each mapping */
+    int band_next_line[MAX_INPUT_BANDS];     /* next line to read from each
+                                                mapping, within the window */
     float scale_factor[MAX_INPUT_BANDS];
     int fill_value[MAX_INPUT_BANDS];
     float thermal_rad_gain;       /* Thermal radiance gain */
@@ -100,6 +121,20 @@ typedef struct
 } Input_Data_t;
 
 
+/* Structure for the runs of valid (non-fill) thermal pixels in a strip of
+   lines, as [start, end) samples within their line.  The spans of a line are
+   those from line_first_span[line] up to line_first_span[line + 1]. */
+typedef struct
+{
+    int max_lines;              /* Lines the spans are allocated for */
+    int lines;                  /* Lines holding spans */
+    int *line_first_span;       /* First span of each line, with an extra
+                                   entry following the last line */
+    int *span_start;            /* First sample of each span */
+    int *span_end;              /* Sample following each span */
+} Valid_Spans_t;
+
+
 /* Prototypes */
 Input_Data_t *open_input(Espa_internal_meta_t *metadata);
 
@@ -107,8 +142,39 @@ int close_input(Input_Data_t *input);
 
 int read_input(Input_Data_t *input_data,
                float *band_thermal,
-               int16_t *band_elevation,
-               int pixel_count);
+               Valid_Spans_t *spans,
+               int16_t **band_elevation,
+               size_t pixel_count);
+
+int find_elevation_range(Input_Data_t *input,
+                         int *min_height,
+                         int *max_height);
+
+int set_input_window(Input_Data_t *input,
+                     Roi_Units_t roi_units,
+                     double *roi);
+
+int read_emissivity(Input_Data_t *input,
+                    float *band_emissivity,
+                    size_t pixel_count);
+
+int allocate_valid_spans(Valid_Spans_t *spans,
+                         int lines,
+                         int samples);
+
+void free_valid_spans(Valid_Spans_t *spans);
+
+void find_valid_spans(float *line_thermal,
+                      int samples,
+                      int line,
+                      Valid_Spans_t *spans);
+
+void fill_invalid_samples(Valid_Spans_t *spans,
+                          int line,
+                          int samples,
+                          void *line_values,
+                          const void *value,
+                          size_t value_size);
 
 bool GetXMLInput(Input_Data_t *input,
                  Espa_internal_meta_t *metadata);
@@ -3,68 +3,101 @@
 #include "input.h"
 #include "utilities.h"
 #include "intermediate_data.h"
+#include "scene_buffer.h"
+
+
+/* Opens the file of a band, as raw binary or as a GeoTIFF */
+int
+open_intermediate_band(Input_Data_t *input,
+                       bool geotiff,
+                       bool compact,
+                       char *filename,
+                       FILE **fd,
+                       GeoTIFF_Output_t **tiff)
+{
+    char *FUNC_NAME = "open_intermediate_band";
+    char msg[PATH_MAX];
+
+    *fd = NULL;
+    *tiff = NULL;
+
+    if (geotiff)
+    {
+        *tiff = open_geotiff(input, filename,
+                             compact ? ESPA_INT16 : ESPA_FLOAT32);
+        if (*tiff == NULL)
+        {
+            sprintf(msg, "Opening intermediate file: %s", filename);
+            RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        }
+    }
+    else
+    {
+        *fd = fopen(filename, "wb");
+        if (*fd == NULL)
+        {
+            sprintf(msg, "Opening intermediate file: %s", filename);
+            RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        }
+    }
+
+    return SUCCESS;
+}
 
 
 int
 open_intermediate(Input_Data_t *input,
+                  bool geotiff,
+                  bool compact,
                   Intermediate_Data_t *inter)
 {
     char *FUNC_NAME = "open_intermediate";
+    char *extension = geotiff ? "tif" : "img";
+#if OUTPUT_CELL_DESIGNATION_BAND
     char msg[PATH_MAX];
+#endif
 
     /* First figure out and assign the filenames */
     snprintf(inter->thermal_filename,
              sizeof(inter->thermal_filename),
-             "%s_%s.img",
+             "%s_%s.%s",
              input->meta.product_id,
-             LST_THERMAL_RADIANCE_BAND_NAME);
+             LST_THERMAL_RADIANCE_BAND_NAME, extension);
     snprintf(inter->upwelled_filename,
              sizeof(inter->upwelled_filename),
-             "%s_%s.img",
+             "%s_%s.%s",
              input->meta.product_id,
-             LST_UPWELLED_RADIANCE_BAND_NAME);
+             LST_UPWELLED_RADIANCE_BAND_NAME, extension);
     snprintf(inter->downwelled_filename,
              sizeof(inter->downwelled_filename),
-             "%s_%s.img",
+             "%s_%s.%s",
              input->meta.product_id,
-             LST_DOWNWELLED_RADIANCE_BAND_NAME);
+             LST_DOWNWELLED_RADIANCE_BAND_NAME, extension);
     snprintf(inter->transmittance_filename,
              sizeof(inter->transmittance_filename),
-             "%s_%s.img",
+             "%s_%s.%s",
              input->meta.product_id,
-             LST_ATMOS_TRANS_BAND_NAME);
-
-    /* Now open the file descriptors */
-    inter->thermal_fd = fopen(inter->thermal_filename, "wb");
-    if (inter->thermal_fd == NULL)
+             LST_ATMOS_TRANS_BAND_NAME, extension);
+
+    /* Now open the files */
+    if (open_intermediate_band(input, geotiff, compact,
+                               inter->thermal_filename,
+                               &inter->thermal_fd, &inter->thermal_tiff)
+        != SUCCESS
+        || open_intermediate_band(input, geotiff, compact,
+                                  inter->transmittance_filename,
+                                  &inter->transmittance_fd,
+                                  &inter->transmittance_tiff) != SUCCESS
+        || open_intermediate_band(input, geotiff, compact,
+                                  inter->upwelled_filename,
+                                  &inter->upwelled_fd,
+                                  &inter->upwelled_tiff) != SUCCESS
+        || open_intermediate_band(input, geotiff, compact,
+                                  inter->downwelled_filename,
+                                  &inter->downwelled_fd,
+                                  &inter->downwelled_tiff) != SUCCESS)
     {
-        sprintf(msg, "Opening intermediate file: %s",
-                inter->thermal_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
-    }
-
-    inter->transmittance_fd = fopen(inter->transmittance_filename, "wb");
-    if (inter->transmittance_fd == NULL)
-    {
-        sprintf(msg, "Opening intermediate file: %s",
-                inter->transmittance_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
-    }
-
-    inter->upwelled_fd = fopen(inter->upwelled_filename, "wb");
-    if (inter->upwelled_fd == NULL)
-    {
-        sprintf(msg, "Opening intermediate file: %s",
-                inter->upwelled_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
-    }
-
-    inter->downwelled_fd = fopen(inter->downwelled_filename, "wb");
-    if (inter->downwelled_fd == NULL)
-    {
-        sprintf(msg, "Opening intermediate file: %s",
-                inter->downwelled_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        RETURN_ERROR("Opening intermediate files", FUNC_NAME, FAILURE);
     }
 
     /* Initialize the memory items */
@@ -72,6 +105,8 @@ open_intermediate(Input_Data_t *input,
     inter->band_transmittance = NULL;
     inter->band_upwelled = NULL;
     inter->band_downwelled = NULL;
+    inter->compact = compact;
+    inter->band_compact = NULL;
 
 #if OUTPUT_CELL_DESIGNATION_BAND
     snprintf(inter->cell_filename,
@@ -94,52 +129,131 @@ open_intermediate(Input_Data_t *input,
 }
 
 
+/* Encodes the pixels of a band as 16 bit integers with the scale factor
+   and offset, keeping the fill and clamping the values to the range */
+void
+encode_compact_band(float *band,
+                    double scale_factor,
+                    double add_offset,
+                    size_t pixel_count,
+                    int16_t *band_compact)
+{
+    size_t pixel;
+    double value;
+
+    for (pixel = 0; pixel < pixel_count; pixel++)
+    {
+        if (band[pixel] == LST_NO_DATA_VALUE)
+        {
+            band_compact[pixel] = LST_NO_DATA_VALUE;
+            continue;
+        }
+
+        /* A NaN has no integer value, so it is stored as fill.  The fill
+           value is otherwise kept for the fill alone. */
+        value = round((band[pixel] - add_offset) / scale_factor);
+        if (isnan(value))
+            value = LST_NO_DATA_VALUE;
+        else if (value <= LST_NO_DATA_VALUE)
+            value = LST_NO_DATA_VALUE + 1;
+        else if (value > INT16_MAX)
+            value = INT16_MAX;
+        band_compact[pixel] = value;
+    }
+}
+
+
+/* Writes the next pixels of a band, to its raw binary file or GeoTIFF.  With
+   a compact buffer the band is encoded into it, and written from it.  The
+   GeoTIFF tiles are compressed in parallel when parallel_tiles is set. */
 int
-write_intermediate(Intermediate_Data_t *inter,
-                   int pixel_count)
+write_intermediate_band(FILE *fd,
+                        GeoTIFF_Output_t *tiff,
+                        char *filename,
+                        float *band,
+                        int16_t *band_compact,
+                        double scale_factor,
+                        size_t pixel_count,
+                        bool parallel_tiles)
 {
-    char *FUNC_NAME = "close_intermediate";
+    char *FUNC_NAME = "write_intermediate_band";
     char msg[PATH_MAX];
-    int status;
+    size_t status;
+    void *data = band;
+    size_t data_size = sizeof(float);
 
-    status = fwrite(inter->band_thermal,
-                    sizeof(float),
-                    pixel_count,
-                    inter->thermal_fd);
-    if (status != pixel_count)
+    if (band_compact != NULL)
     {
-        sprintf (msg, "Writing to %s", inter->thermal_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        encode_compact_band(band, scale_factor, LST_COMPACT_ADD_OFFSET,
+                            pixel_count, band_compact);
+        data = band_compact;
+        data_size = sizeof(int16_t);
     }
 
-    status = fwrite(inter->band_transmittance,
-                    sizeof(float),
-                    pixel_count,
-                    inter->transmittance_fd);
-    if (status != pixel_count)
+    if (tiff != NULL)
     {
-        sprintf (msg, "Writing to %s", inter->transmittance_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        if (write_geotiff_lines(tiff, data, pixel_count / tiff->samples,
+                                parallel_tiles) != SUCCESS)
+        {
+            sprintf (msg, "Writing to %s", filename);
+            RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        }
     }
-
-    status = fwrite(inter->band_upwelled,
-                    sizeof(float),
-                    pixel_count,
-                    inter->upwelled_fd);
-    if (status != pixel_count)
+    else
     {
-        sprintf (msg, "Writing to %s", inter->upwelled_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        status = fwrite(data, data_size, pixel_count, fd);
+        if (status != pixel_count)
+        {
+            sprintf (msg, "Writing to %s", filename);
+            RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        }
     }
 
-    status = fwrite(inter->band_downwelled,
-                    sizeof(float),
-                    pixel_count,
-                    inter->downwelled_fd);
-    if (status != pixel_count)
+    return SUCCESS;
+}
+
+
+int
+write_intermediate(Intermediate_Data_t *inter,
+                   size_t pixel_count,
+                   bool parallel_tiles)
+{
+    char *FUNC_NAME = "write_intermediate";
+#if OUTPUT_CELL_DESIGNATION_BAND
+    char msg[PATH_MAX];
+    size_t status;
+#endif
+
+    if (write_intermediate_band(inter->thermal_fd, inter->thermal_tiff,
+                                inter->thermal_filename,
+                                inter->band_thermal, inter->band_compact,
+                                LST_COMPACT_RADIANCE_SCALE_FACTOR,
+                                pixel_count, parallel_tiles)
+        != SUCCESS
+        || write_intermediate_band(inter->transmittance_fd,
+                                   inter->transmittance_tiff,
+                                   inter->transmittance_filename,
+                                   inter->band_transmittance,
+                                   inter->band_compact,
+                                   LST_COMPACT_TRANS_SCALE_FACTOR,
+                                   pixel_count, parallel_tiles)
+        != SUCCESS
+        || write_intermediate_band(inter->upwelled_fd, inter->upwelled_tiff,
+                                   inter->upwelled_filename,
+                                   inter->band_upwelled, inter->band_compact,
+                                   LST_COMPACT_RADIANCE_SCALE_FACTOR,
+                                   pixel_count, parallel_tiles)
+        != SUCCESS
+        || write_intermediate_band(inter->downwelled_fd,
+                                   inter->downwelled_tiff,
+                                   inter->downwelled_filename,
+                                   inter->band_downwelled,
+                                   inter->band_compact,
+                                   LST_COMPACT_RADIANCE_SCALE_FACTOR,
+                                   pixel_count, parallel_tiles)
+        != SUCCESS)
     {
-        sprintf (msg, "Writing to %s", inter->downwelled_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        RETURN_ERROR("Writing intermediate files", FUNC_NAME, FAILURE);
     }
 
 #if OUTPUT_CELL_DESIGNATION_BAND
@@ -158,44 +272,60 @@ write_intermediate(Intermediate_Data_t *inter,
 }
 
 
+/* Closes the raw binary file or GeoTIFF of a band */
 int
-close_intermediate(Intermediate_Data_t *inter)
+close_intermediate_band(FILE **fd,
+                        GeoTIFF_Output_t **tiff,
+                        char *filename)
 {
-    char *FUNC_NAME = "close_intermediate";
+    char *FUNC_NAME = "close_intermediate_band";
     char msg[PATH_MAX];
     int status;
 
-    status = fclose(inter->thermal_fd);
-    if (status)
+    if (*tiff != NULL)
     {
-        sprintf(msg, "Closing file %s", inter->thermal_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        status = close_geotiff(*tiff);
+        *tiff = NULL;
     }
-    inter->thermal_fd = NULL;
-
-    status = fclose(inter->transmittance_fd);
-    if (status)
+    else
     {
-        sprintf(msg, "Closing file %s", inter->transmittance_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        status = fclose(*fd);
+        *fd = NULL;
     }
-    inter->transmittance_fd = NULL;
 
-    status = fclose(inter->upwelled_fd);
     if (status)
     {
-        sprintf(msg, "Closing file %s", inter->upwelled_filename);
+        sprintf(msg, "Closing file %s", filename);
         RETURN_ERROR(msg, FUNC_NAME, FAILURE);
     }
-    inter->upwelled_fd = NULL;
 
-    status = fclose(inter->downwelled_fd);
-    if (status)
+    return SUCCESS;
+}
+
+
+int
+close_intermediate(Intermediate_Data_t *inter)
+{
+    char *FUNC_NAME = "close_intermediate";
+#if OUTPUT_CELL_DESIGNATION_BAND
+    char msg[PATH_MAX];
+    int status;
+#endif
+
+    if (close_intermediate_band(&inter->thermal_fd, &inter->thermal_tiff,
+                                inter->thermal_filename) != SUCCESS
+        || close_intermediate_band(&inter->transmittance_fd,
+                                   &inter->transmittance_tiff,
+                                   inter->transmittance_filename) != SUCCESS
+        || close_intermediate_band(&inter->upwelled_fd,
+                                   &inter->upwelled_tiff,
+                                   inter->upwelled_filename) != SUCCESS
+        || close_intermediate_band(&inter->downwelled_fd,
+                                   &inter->downwelled_tiff,
+                                   inter->downwelled_filename) != SUCCESS)
     {
-        sprintf(msg, "Closing file %s", inter->downwelled_filename);
-        RETURN_ERROR(msg, FUNC_NAME, FAILURE);
+        RETURN_ERROR("Closing intermediate files", FUNC_NAME, FAILURE);
     }
-    inter->downwelled_fd = NULL;
 
 #if OUTPUT_CELL_DESIGNATION_BAND
     status = fclose(inter->cell_fd);
@@ -213,12 +343,14 @@ close_intermediate(Intermediate_Data_t *inter)
 
 int
 allocate_intermediate(Intermediate_Data_t *inter,
-                      int pixel_count)
+                      int lines,
+                      int samples)
 {
     char *FUNC_NAME = "allocate_intermediate";
     char msg[PATH_MAX];
 
-    inter->band_thermal = calloc(pixel_count, sizeof(float));
+    inter->band_thermal = allocate_scene_buffer(lines,
+                                                samples * sizeof(float));
     if (inter->band_thermal == NULL)
     {
         sprintf(msg, "Allocating memory for %s",
@@ -226,7 +358,16 @@ allocate_intermediate(Intermediate_Data_t *inter,
         RETURN_ERROR(msg, FUNC_NAME, FAILURE);
     }
 
-    inter->band_transmittance = calloc(pixel_count, sizeof(float));
+    if (allocate_valid_spans(&inter->spans, lines, samples) != SUCCESS)
+    {
+        free_intermediate(inter);
+
+        RETURN_ERROR("Allocating memory for the valid spans",
+                     FUNC_NAME, FAILURE);
+    }
+
+    inter->band_transmittance = allocate_scene_buffer(lines,
+                                                      samples * sizeof(float));
     if (inter->band_transmittance == NULL)
     {
         free_intermediate(inter);
@@ -236,7 +377,8 @@ allocate_intermediate(Intermediate_Data_t *inter,
         RETURN_ERROR(msg, FUNC_NAME, FAILURE);
     }
 
-    inter->band_upwelled = calloc(pixel_count, sizeof(float));
+    inter->band_upwelled = allocate_scene_buffer(lines,
+                                                 samples * sizeof(float));
     if (inter->band_upwelled == NULL)
     {
         free_intermediate(inter);
@@ -246,7 +388,8 @@ allocate_intermediate(Intermediate_Data_t *inter,
         RETURN_ERROR(msg, FUNC_NAME, FAILURE);
     }
 
-    inter->band_downwelled = calloc(pixel_count, sizeof(float));
+    inter->band_downwelled = allocate_scene_buffer(lines,
+                                                   samples * sizeof(float));
     if (inter->band_downwelled == NULL)
     {
         free_intermediate(inter);
@@ -256,8 +399,24 @@ allocate_intermediate(Intermediate_Data_t *inter,
         RETURN_ERROR(msg, FUNC_NAME, FAILURE);
     }
 
+    /* The bands are encoded one at a time when written */
+    inter->band_compact = NULL;
+    if (inter->compact)
+    {
+        inter->band_compact = allocate_scene_buffer(lines,
+                                                    samples * sizeof(int16_t));
+        if (inter->band_compact == NULL)
+        {
+            free_intermediate(inter);
+
+            RETURN_ERROR("Allocating memory for the compact bands",
+                         FUNC_NAME, FAILURE);
+        }
+    }
+
 #if OUTPUT_CELL_DESIGNATION_BAND
-    inter->band_cell = calloc(pixel_count, sizeof(uint8_t));
+    inter->band_cell = allocate_scene_buffer(lines,
+                                             samples * sizeof(uint8_t));
     if (inter->band_cell == NULL)
     {
         free_intermediate(inter);
@@ -275,20 +434,25 @@ allocate_intermediate(Intermediate_Data_t *inter,
 void
 free_intermediate(Intermediate_Data_t *inter)
 {
-    free(inter->band_thermal);
+    free_scene_buffer(inter->band_thermal);
     inter->band_thermal = NULL;
 
-    free(inter->band_transmittance);
+    free_valid_spans(&inter->spans);
+
+    free_scene_buffer(inter->band_transmittance);
     inter->band_transmittance = NULL;
 
-    free(inter->band_upwelled);
+    free_scene_buffer(inter->band_upwelled);
     inter->band_upwelled = NULL;
 
-    free(inter->band_downwelled);
+    free_scene_buffer(inter->band_downwelled);
     inter->band_downwelled = NULL;
 
+    free_scene_buffer(inter->band_compact);
+    inter->band_compact = NULL;
+
 #if OUTPUT_CELL_DESIGNATION_BAND
-    free(inter->band_cell);
+    free_scene_buffer(inter->band_cell);
     inter->band_cell = NULL;
 #endif
 }
@@ -4,6 +4,7 @@
 
 
 #include "input.h"
+#include "geotiff_output.h"
 
 /* This is for compile time debugging logic.
    Set it to 0 to turn it off.
@@ -22,10 +23,17 @@ typedef struct
     FILE *transmittance_fd;
     FILE *upwelled_fd;
     FILE *downwelled_fd;
+    GeoTIFF_Output_t *thermal_tiff;       /* Used instead of the files when */
+    GeoTIFF_Output_t *transmittance_tiff; /* writing GeoTIFFs */
+    GeoTIFF_Output_t *upwelled_tiff;
+    GeoTIFF_Output_t *downwelled_tiff;
     float *band_thermal;
+    Valid_Spans_t spans;        /* Valid spans of the thermal band */
     float *band_transmittance;
     float *band_upwelled;
     float *band_downwelled;
+    bool compact;               /* Written as scaled 16 bit integers */
+    int16_t *band_compact;      /* A band of the strip encoded for writing */
 
 #if OUTPUT_CELL_DESIGNATION_BAND
     char cell_filename[PATH_MAX];
@@ -36,15 +44,19 @@ typedef struct
 
 
 int open_intermediate(Input_Data_t *input,
+                      bool geotiff,
+                      bool compact,
                       Intermediate_Data_t *inter);
 
 int write_intermediate(Intermediate_Data_t *inter,
-                       int pixel_count);
+                       size_t pixel_count,
+                       bool parallel_tiles);
 
 int close_intermediate(Intermediate_Data_t *inter);
 
 int allocate_intermediate(Intermediate_Data_t *inter,
-                          int pixel_count);
+                          int lines,
+                          int samples);
 
 void free_intermediate(Intermediate_Data_t *inter);
 
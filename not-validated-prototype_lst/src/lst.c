@@ -19,6 +19,8 @@
 #include "build_modtran_input.h"
 #include "calculate_point_atmospheric_parameters.h"
 #include "calculate_pixel_atmospheric_parameters.h"
+#include "scene_buffer.h"
+#include "cpu_kernels.h"
 
 
 /******************************************************************************
@@ -45,6 +47,7 @@ main (int argc, char *argv[])
 
     char msg_str[MAX_STR_LEN];
     char xml_filename[PATH_MAX];        /* input XML filename */
+    char geometry_cache_dir[PATH_MAX];  /* geometry cache directory */
     char command[PATH_MAX];
 
     Input_Data_t *input = NULL;          /* input data and meta data */
@@ -53,6 +56,21 @@ main (int argc, char *argv[])
     bool use_tape6;             /* Use the tape6 output */
     bool verbose;               /* verbose flag for printing messages */
     bool debug;                 /* debug flag for debug output */
+    bool single_precision;      /* interpolate the pixels in single
+                                   precision */
+    bool verify_cells;          /* check the cells carried forward */
+    int strip_lines;            /* number of lines to process at a time */
+    int lattice_step;           /* pixels between the lattice nodes */
+    Scene_Pages_t scene_pages;  /* how to back the strip buffers */
+    Cpu_Kernels_t vector_kernels; /* widest vector kernels to use */
+    bool generate_lst;          /* generate the land surface temperature */
+    bool write_intermediate_bands; /* write the intermediate bands */
+    bool compact_intermediate;  /* write the intermediate bands as scaled
+                                   16 bit integers */
+    bool geotiff;               /* write the bands as GeoTIFFs */
+    Roi_Units_t roi_units;      /* units of the region of interest, none
+                                   for the whole scene */
+    double roi[4];              /* corners of the region of interest */
 
     int modtran_run;
 
@@ -72,12 +90,20 @@ main (int argc, char *argv[])
 
     /* Read the command-line arguments, including the name of the input
        Landsat TOA reflectance product and the DEM */
-    if (get_args(argc, argv, xml_filename, &use_tape6, &verbose, &debug)
+    if (get_args(argc, argv, xml_filename, &use_tape6, &single_precision,
+                 &verify_cells, &strip_lines, &lattice_step,
+                 geometry_cache_dir, &scene_pages, &vector_kernels,
+                 &generate_lst, &write_intermediate_bands,
+                 &compact_intermediate, &geotiff, &roi_units, roi,
+                 &verbose, &debug)
         != SUCCESS)
     {
         RETURN_ERROR("calling get_args", FUNC_NAME, EXIT_FAILURE);
     }
 
+    set_scene_buffer_pages(scene_pages);
+    select_cpu_kernels(vector_kernels);
+
     /* Verify the existence of required environment variables */
     /* Grab the environment path to the LST_DATA_DIR */
     tmp_env = getenv("LST_DATA_DIR");
@@ -113,6 +139,14 @@ main (int argc, char *argv[])
         RETURN_ERROR("opening input files", FUNC_NAME, EXIT_FAILURE);
     }
 
+    /* Restrict the processing to the region of interest */
+    if (roi_units != ROI_UNITS_NONE
+        && set_input_window(input, roi_units, roi) != SUCCESS)
+    {
+        RETURN_ERROR("setting the region of interest", FUNC_NAME,
+                     EXIT_FAILURE);
+    }
+
     if (verbose)
     {
         /* Print some info to show how the input metadata works */
@@ -260,7 +294,15 @@ main (int argc, char *argv[])
     /* Generate parameters for each Landsat pixel */
     if (calculate_pixel_atmospheric_parameters (input, &points,
                                                 xml_filename,
-                                                modtran_results, verbose)
+                                                modtran_results, strip_lines,
+                                                lattice_step,
+                                                geometry_cache_dir,
+                                                single_precision,
+                                                verify_cells,
+                                                generate_lst,
+                                                write_intermediate_bands,
+                                                compact_intermediate,
+                                                geotiff, verbose)
         != SUCCESS)
     {
         RETURN_ERROR ("Calculating per/pixel atmospheric parameters\n",
@@ -0,0 +1,667 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "build_points.h"
+#include "build_modtran_input.h"
+#include "narr_cube.h"
+#include "narr_cache.h"
+
+
+/* The lock serializing the processes of a node using the index of the
+   cache, and the suffix of the lock held while decoding each cube */
+#define NARR_CACHE_LOCK "narr_cache.lock"
+#define NARR_ENTRY_LOCK_SUFFIX ".lock"
+
+
+/* A cube of the cache, for choosing those to evict */
+typedef struct
+{
+    char filename[PATH_MAX];
+    struct timespec last_used;
+    off_t size;
+} NARR_CACHE_ENTRY;
+
+
+/*****************************************************************************
+METHOD:  compare_last_used
+
+PURPOSE: Orders the cubes of the cache from the least recently used.
+
+RETURN: int - less than, equal to, or greater than zero
+
+*****************************************************************************/
+static int compare_last_used
+(
+    const void *first,  /* I: the first entry */
+    const void *second  /* I: the second entry */
+)
+{
+    const struct timespec *a = &((const NARR_CACHE_ENTRY *) first)->last_used;
+    const struct timespec *b =
+        &((const NARR_CACHE_ENTRY *) second)->last_used;
+
+    if (a->tv_sec != b->tv_sec)
+        return (a->tv_sec < b->tv_sec) ? -1 : 1;
+    if (a->tv_nsec != b->tv_nsec)
+        return (a->tv_nsec < b->tv_nsec) ? -1 : 1;
+
+    return 0;
+}
+
+
+/*****************************************************************************
+METHOD:  cache_filename
+
+PURPOSE: Determine the cube of the cache holding a timestep.  It is named
+         for the GRIB files linked for the timestep, and the checksum of
+         their paths, sizes, and modification times, and of the parameters
+         the cubes hold, so a cube is never used for different or updated
+         GRIB data.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+static int cache_filename
+(
+    char *cache_dir,    /* I: directory of the node's cache */
+    int timestep,       /* I: 1 before the acquisition, 2 after */
+    char **parameters,  /* I: name of each parameter */
+    char *filename      /* O: the cube of the timestep, PATH_MAX long */
+)
+{
+    char FUNC_NAME[] = "cache_filename";
+    char msg[MAX_STR_LEN];
+    char link[PATH_MAX];
+    char archive[PATH_MAX];
+    char stem[PATH_MAX];
+    char key[NARR_PARAMETERS * (PATH_MAX + 64)];
+    char *name;
+    int parm;
+    int count;
+    size_t key_len;
+    struct stat file_stat;
+
+    key_len = snprintf (key, sizeof (key), "%s %s %s\n",
+                        NARR_HEIGHT_PARAMETER, NARR_RH_PARAMETER,
+                        parameters[2]);
+
+    for (parm = 0; parm < NARR_PARAMETERS; parm++)
+    {
+        snprintf (link, sizeof (link), "NARR_%d.%s.grb", timestep,
+                  parameters[parm]);
+        if (realpath (link, archive) == NULL
+            || stat (archive, &file_stat) != 0)
+        {
+            snprintf (msg, sizeof (msg), "Locating the GRIB data of %s",
+                      link);
+            RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+        }
+
+        key_len += snprintf (key + key_len, sizeof (key) - key_len,
+                             "%s %lld %lld.%09ld\n", archive,
+                             (long long) file_stat.st_size,
+                             (long long) file_stat.st_mtim.tv_sec,
+                             (long) file_stat.st_mtim.tv_nsec);
+
+        /* The cube is named for the first parameter's archive file */
+        if (parm == 0)
+        {
+            name = strrchr (archive, '/');
+            snprintf (stem, sizeof (stem), "%s",
+                      (name == NULL) ? archive : name + 1);
+            name = strrchr (stem, '.');
+            if (name != NULL && strcmp (name, ".grb") == 0)
+                *name = '\0';
+        }
+    }
+
+    count = snprintf (filename, PATH_MAX, "%s/%s.%08x.cube", cache_dir, stem,
+                      checksum_bytes (key, key_len));
+    if (count < 0 || count >= PATH_MAX)
+    {
+        RETURN_ERROR ("Failed initializing the NARR cache filename",
+                      FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  decode_cache_entry
+
+PURPOSE: Decodes the whole grid of each parameter of a timestep from the
+         GRIB data, and writes them as a cube of the cache.  The geometric
+         height and relative humidity are derived, in place of the
+         geopotential height and specific humidity, so the scenes only read
+         them.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+static int decode_cache_entry
+(
+    char *filename,     /* I: the cube of the timestep */
+    int *layers,        /* I: pressure of each layer in millibars */
+    int timestep,       /* I: 1 before the acquisition, 2 after */
+    char **parameters   /* I: name of each parameter */
+)
+{
+    char FUNC_NAME[] = "decode_cache_entry";
+    char *lst_data_dir;
+    char *cube_parameters[NARR_PARAMETERS] = { NARR_HEIGHT_PARAMETER,
+                                               NARR_RH_PARAMETER, NULL };
+
+    size_t plane_size = (size_t) NARR_ROWS * NARR_COLS;
+    size_t num_values = NARR_PARAMETERS * P_LAYER * plane_size;
+    size_t index;
+    int parm;
+    int layer;
+    int status;
+    double *values;
+    double *lat;
+    double *lon;
+    double *planes[NARR_PARAMETERS][P_LAYER];
+    double **outputs[NARR_PARAMETERS];
+    float *cube_values;
+
+    lst_data_dir = getenv ("LST_DATA_DIR");
+    if (lst_data_dir == NULL)
+    {
+        RETURN_ERROR ("LST_DATA_DIR environment variable is not set",
+                      FUNC_NAME, FAILURE);
+    }
+    cube_parameters[2] = parameters[2];
+
+    values = malloc (num_values * sizeof (double));
+    cube_values = malloc (num_values * sizeof (float));
+    lat = malloc (plane_size * sizeof (double));
+    lon = malloc (plane_size * sizeof (double));
+    if (values == NULL || cube_values == NULL || lat == NULL || lon == NULL)
+    {
+        free (values);
+        free (cube_values);
+        free (lat);
+        free (lon);
+        RETURN_ERROR ("Allocating the NARR timestep", FUNC_NAME, FAILURE);
+    }
+
+    for (parm = 0; parm < NARR_PARAMETERS; parm++)
+    {
+        for (layer = 0; layer < P_LAYER; layer++)
+        {
+            planes[parm][layer] = values
+                                  + (parm * P_LAYER + layer) * plane_size;
+        }
+        outputs[parm] = planes[parm];
+    }
+
+    status = read_narr_coordinates (lst_data_dir, lat, lon);
+    if (status == SUCCESS)
+    {
+        status = read_narr_grib_records (layers, timestep, 0, NARR_ROWS - 1,
+                                         0, NARR_COLS - 1, parameters,
+                                         outputs);
+    }
+    if (status == SUCCESS)
+    {
+        status = convert_geopotential_geometric (plane_size, lat,
+                                                 outputs[0], outputs[0]);
+    }
+    if (status == SUCCESS)
+    {
+        status = convert_sh_rh (plane_size, outputs[1], outputs[2], layers,
+                                outputs[1]);
+    }
+    if (status == SUCCESS)
+    {
+        for (index = 0; index < num_values; index++)
+            cube_values[index] = (float) values[index];
+
+        status = write_narr_cube (filename, NARR_PARAMETERS, cube_parameters,
+                                  P_LAYER, layers, cube_values);
+    }
+
+    free (values);
+    free (cube_values);
+    free (lat);
+    free (lon);
+
+    if (status != SUCCESS)
+    {
+        RETURN_ERROR ("Failed decoding the NARR timestep into the cache",
+                      FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  lock_cache_file
+
+PURPOSE: Opens and locks a lock file of the cache.  The lock files of the
+         cubes are removed while locked by the eviction, so the lock is only
+         held once it is on the file still linked under the name.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+static int lock_cache_file
+(
+    char *lock_filename, /* I: the lock file */
+    int *lock_fd         /* O: the locked file */
+)
+{
+    char FUNC_NAME[] = "lock_cache_file";
+    char msg[MAX_STR_LEN];
+    struct stat locked_stat;
+    struct stat file_stat;
+
+    while (1)
+    {
+        *lock_fd = open (lock_filename, O_RDWR | O_CREAT, 0666);
+        if (*lock_fd < 0)
+        {
+            snprintf (msg, sizeof (msg), "Opening %s", lock_filename);
+            RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+        }
+
+        while (flock (*lock_fd, LOCK_EX) != 0)
+        {
+            if (errno != EINTR)
+            {
+                close (*lock_fd);
+                snprintf (msg, sizeof (msg), "Locking %s", lock_filename);
+                RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+            }
+        }
+
+        if (fstat (*lock_fd, &locked_stat) == 0
+            && stat (lock_filename, &file_stat) == 0
+            && locked_stat.st_dev == file_stat.st_dev
+            && locked_stat.st_ino == file_stat.st_ino)
+        {
+            return SUCCESS;
+        }
+
+        /* Removed before it was locked, so try the new one */
+        flock (*lock_fd, LOCK_UN);
+        close (*lock_fd);
+    }
+}
+
+
+/*****************************************************************************
+METHOD:  release_cache_lock
+
+PURPOSE: Releases a lock of the cache.
+
+*****************************************************************************/
+static void release_cache_lock
+(
+    int lock_fd         /* I: the locked file */
+)
+{
+    flock (lock_fd, LOCK_UN);
+    close (lock_fd);
+}
+
+
+/*****************************************************************************
+METHOD:  remove_if_unlocked
+
+PURPOSE: Removes the lock file of a cube, and optionally the cube being
+         decoded, when no process is decoding the cube.
+
+RETURN: None
+
+*****************************************************************************/
+static void remove_if_unlocked
+(
+    char *lock_filename, /* I: the lock file of the cube */
+    char *temp_filename  /* I: the cube being decoded, or NULL */
+)
+{
+    int lock_fd;
+
+    lock_fd = open (lock_filename, O_RDWR);
+    if (lock_fd < 0)
+    {
+        /* Without its lock file no process is decoding it */
+        if (temp_filename != NULL)
+            unlink (temp_filename);
+        return;
+    }
+
+    if (flock (lock_fd, LOCK_EX | LOCK_NB) == 0)
+    {
+        if (temp_filename != NULL)
+            unlink (temp_filename);
+        unlink (lock_filename);
+        flock (lock_fd, LOCK_UN);
+    }
+    close (lock_fd);
+}
+
+
+/*****************************************************************************
+METHOD:  evict_cache_entries
+
+PURPOSE: Removes the least recently used cubes of the cache until it fits
+         within the memory budget, any cube left partially written, and the
+         lock files of the cubes not being decoded.  The cube just used is
+         kept.  Processes which have a removed cube mapped keep using it, its
+         memory is released once they unmap it.
+
+NOTE: Called holding the lock of the cache.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+static int evict_cache_entries
+(
+    char *cache_dir,     /* I: directory of the node's cache */
+    char *keep_filename, /* I: the cube just used */
+    off_t budget         /* I: bytes the cache may hold */
+)
+{
+    char FUNC_NAME[] = "evict_cache_entries";
+    char msg[MAX_STR_LEN];
+    char filename[PATH_MAX];
+    char lock_filename[PATH_MAX];
+
+    DIR *dir;
+    struct dirent *dir_entry;
+    struct stat file_stat;
+    NARR_CACHE_ENTRY *entries = NULL;
+    NARR_CACHE_ENTRY *more_entries;
+    int num_entries = 0;
+    int max_entries = 0;
+    int entry;
+    size_t name_len;
+    size_t suffix_len = strlen (NARR_ENTRY_LOCK_SUFFIX);
+    off_t total = 0;
+
+    dir = opendir (cache_dir);
+    if (dir == NULL)
+    {
+        snprintf (msg, sizeof (msg), "Reading the NARR cache %s", cache_dir);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    while ((dir_entry = readdir (dir)) != NULL)
+    {
+        name_len = strlen (dir_entry->d_name);
+        snprintf (filename, sizeof (filename), "%s/%s", cache_dir,
+                  dir_entry->d_name);
+
+        /* A temporary cube is being decoded while its cube is locked, so
+           one which is not was left by a process which failed */
+        if (name_len > 4
+            && strcmp (dir_entry->d_name + name_len - 4, ".tmp") == 0)
+        {
+            snprintf (lock_filename, sizeof (lock_filename), "%.*s%s",
+                      (int) (strlen (filename) - 4), filename,
+                      NARR_ENTRY_LOCK_SUFFIX);
+            remove_if_unlocked (lock_filename, filename);
+            continue;
+        }
+
+        if (name_len > suffix_len
+            && strcmp (dir_entry->d_name + name_len - suffix_len,
+                       NARR_ENTRY_LOCK_SUFFIX) == 0)
+        {
+            if (strcmp (dir_entry->d_name, NARR_CACHE_LOCK) != 0)
+                remove_if_unlocked (filename, NULL);
+            continue;
+        }
+
+        if (name_len <= 5
+            || strcmp (dir_entry->d_name + name_len - 5, ".cube") != 0
+            || stat (filename, &file_stat) != 0)
+        {
+            continue;
+        }
+
+        if (num_entries == max_entries)
+        {
+            max_entries = (max_entries == 0) ? 32 : max_entries * 2;
+            more_entries = realloc (entries,
+                                    max_entries * sizeof (NARR_CACHE_ENTRY));
+            if (more_entries == NULL)
+            {
+                free (entries);
+                closedir (dir);
+                RETURN_ERROR ("Allocating the NARR cache entries",
+                              FUNC_NAME, FAILURE);
+            }
+            entries = more_entries;
+        }
+
+        snprintf (entries[num_entries].filename, PATH_MAX, "%s", filename);
+        entries[num_entries].last_used = file_stat.st_mtim;
+        entries[num_entries].size = file_stat.st_size;
+        total += file_stat.st_size;
+        num_entries++;
+    }
+    closedir (dir);
+
+    qsort (entries, num_entries, sizeof (NARR_CACHE_ENTRY),
+           compare_last_used);
+
+    for (entry = 0; entry < num_entries && total > budget; entry++)
+    {
+        if (strcmp (entries[entry].filename, keep_filename) == 0)
+            continue;
+
+        if (unlink (entries[entry].filename) == 0)
+        {
+            total -= entries[entry].size;
+        }
+        else
+        {
+            snprintf (msg, sizeof (msg), "Unable to evict %s",
+                      entries[entry].filename);
+            WARNING_MESSAGE (msg, FUNC_NAME);
+        }
+    }
+
+    free (entries);
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  open_cache_entry
+
+PURPOSE: Maps the cube of a timestep when it is in the cache, marking it as
+         the most recently used.  A cube which can not be mapped is removed,
+         so it is decoded again.
+
+NOTE: Called holding the lock of the cache, so the cube is not evicted
+      before it is mapped.
+
+RETURN: true when the cube was mapped
+
+*****************************************************************************/
+static bool open_cache_entry
+(
+    char *filename,     /* I: the cube of the timestep */
+    NARR_CUBE *cube     /* O: the mapped cube of the timestep */
+)
+{
+    char FUNC_NAME[] = "open_cache_entry";
+    char msg[MAX_STR_LEN];
+
+    if (access (filename, F_OK) != 0)
+        return false;
+
+    if (open_narr_cube (filename, cube) == SUCCESS)
+    {
+        utimensat (AT_FDCWD, filename, NULL, 0);
+        return true;
+    }
+
+    snprintf (msg, sizeof (msg), "Replacing the NARR cache entry %s",
+              filename);
+    WARNING_MESSAGE (msg, FUNC_NAME);
+    unlink (filename);
+
+    return false;
+}
+
+
+/*****************************************************************************
+METHOD:  open_cached_narr_timestep
+
+PURPOSE: Maps the cube of a timestep from the node's cache, so the processes
+         of a node share the memory of each timestep and only the first to
+         need it decodes the GRIB data.  The lock of the cache is only held
+         while looking up, mapping, and evicting cubes.  A timestep missing
+         from the cache is decoded holding the lock of its cube alone, so it
+         is decoded once, without stopping the processes using the other
+         timesteps.  A cube is marked as used by its modification time, and
+         the least recently used are evicted once the cache holds more than
+         LST_NARR_CACHE_MB megabytes.
+
+NOTE: The cache is only shared memory when its directory is on a memory
+      file system, such as /dev/shm.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int open_cached_narr_timestep
+(
+    char *cache_dir,    /* I: directory of the node's cache */
+    int *layers,        /* I: pressure of each layer in millibars */
+    int timestep,       /* I: 1 before the acquisition, 2 after */
+    char **parameters,  /* I: name of each parameter */
+    NARR_CUBE *cube     /* O: the mapped cube of the timestep */
+)
+{
+    char FUNC_NAME[] = "open_cached_narr_timestep";
+    char msg[MAX_STR_LEN];
+    char filename[PATH_MAX];
+    char lock_filename[PATH_MAX];
+    char entry_lock_filename[PATH_MAX];
+    char *budget_mb;
+
+    int lock_fd;
+    int entry_lock_fd;
+    int count;
+    bool opened;
+    off_t budget = (off_t) NARR_CACHE_DEFAULT_MB * 1024 * 1024;
+
+    budget_mb = getenv ("LST_NARR_CACHE_MB");
+    if (budget_mb != NULL && atoi (budget_mb) > 0)
+        budget = (off_t) atoi (budget_mb) * 1024 * 1024;
+
+    if (cache_filename (cache_dir, timestep, parameters, filename)
+        != SUCCESS)
+    {
+        RETURN_ERROR ("Failed determining the NARR cache entry", FUNC_NAME,
+                      FAILURE);
+    }
+
+    if (mkdir (cache_dir, 0777) != 0 && errno != EEXIST)
+    {
+        snprintf (msg, sizeof (msg), "Creating the NARR cache %s",
+                  cache_dir);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    snprintf (lock_filename, sizeof (lock_filename), "%s/%s", cache_dir,
+              NARR_CACHE_LOCK);
+    count = snprintf (entry_lock_filename, sizeof (entry_lock_filename),
+                      "%s%s", filename, NARR_ENTRY_LOCK_SUFFIX);
+    if (count < 0 || count >= (int) sizeof (entry_lock_filename))
+    {
+        RETURN_ERROR ("Failed initializing the NARR cache lock filename",
+                      FUNC_NAME, FAILURE);
+    }
+
+    /* Most timesteps are already in the cache */
+    if (lock_cache_file (lock_filename, &lock_fd) != SUCCESS)
+    {
+        RETURN_ERROR ("Failed locking the NARR cache", FUNC_NAME, FAILURE);
+    }
+    opened = open_cache_entry (filename, cube);
+    release_cache_lock (lock_fd);
+    if (opened)
+        return SUCCESS;
+
+    /* The lock of the cube is taken before that of the cache, never the
+       other way, and is held until the decoded cube is in place */
+    if (lock_cache_file (entry_lock_filename, &entry_lock_fd) != SUCCESS)
+    {
+        RETURN_ERROR ("Failed locking the NARR cache entry", FUNC_NAME,
+                      FAILURE);
+    }
+
+    /* Another process may have decoded it while waiting for the lock */
+    if (lock_cache_file (lock_filename, &lock_fd) != SUCCESS)
+    {
+        release_cache_lock (entry_lock_fd);
+        RETURN_ERROR ("Failed locking the NARR cache", FUNC_NAME, FAILURE);
+    }
+    opened = open_cache_entry (filename, cube);
+    release_cache_lock (lock_fd);
+    if (opened)
+    {
+        release_cache_lock (entry_lock_fd);
+        return SUCCESS;
+    }
+
+    if (decode_cache_entry (filename, layers, timestep, parameters)
+        != SUCCESS)
+    {
+        release_cache_lock (entry_lock_fd);
+        RETURN_ERROR ("Failed adding the NARR timestep to the cache",
+                      FUNC_NAME, FAILURE);
+    }
+
+    snprintf (msg, sizeof (msg), "Decoded NARR timestep %d into %s",
+              timestep, filename);
+    LOG_MESSAGE (msg, FUNC_NAME);
+
+    if (lock_cache_file (lock_filename, &lock_fd) != SUCCESS)
+    {
+        release_cache_lock (entry_lock_fd);
+        RETURN_ERROR ("Failed locking the NARR cache", FUNC_NAME, FAILURE);
+    }
+    release_cache_lock (entry_lock_fd);
+
+    if (evict_cache_entries (cache_dir, filename, budget) != SUCCESS)
+    {
+        WARNING_MESSAGE ("Unable to evict from the NARR cache", FUNC_NAME);
+    }
+
+    /* Mapped while holding the lock, so it is not evicted before then */
+    if (open_narr_cube (filename, cube) != SUCCESS)
+    {
+        release_cache_lock (lock_fd);
+        RETURN_ERROR ("Failed opening the NARR cache entry", FUNC_NAME,
+                      FAILURE);
+    }
+
+    release_cache_lock (lock_fd);
+
+    return SUCCESS;
+}
@@ -0,0 +1,22 @@
+#ifndef NARR_CACHE_H
+#define NARR_CACHE_H
+
+
+#include "narr_cube.h"
+
+
+/* Memory the cache may hold when LST_NARR_CACHE_MB is not set */
+#define NARR_CACHE_DEFAULT_MB 1024
+
+
+int open_cached_narr_timestep
+(
+    char *cache_dir,    /* I: directory of the node's cache */
+    int *layers,        /* I: pressure of each layer in millibars */
+    int timestep,       /* I: 1 before the acquisition, 2 after */
+    char **parameters,  /* I: name of each parameter */
+    NARR_CUBE *cube     /* O: the mapped cube of the timestep */
+);
+
+
+#endif /* NARR_CACHE_H */
@@ -0,0 +1,422 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "narr_cube.h"
+
+
+/* Identifies the cube files, the version changes with their layout */
+#define NARR_CUBE_MAGIC "LSTNARR"
+#define NARR_CUBE_VERSION 2
+
+/* Rows of each checksummed chunk of the cubes written here, the same as
+   convert_narr_to_cube.py */
+#define NARR_CUBE_CHUNK_ROWS 8
+
+
+/*****************************************************************************
+METHOD:  open_narr_cube
+
+PURPOSE: Maps a cube of NARR values into memory and verifies its layout, so
+         the values can be used in place without being read or parsed.  The
+         values are verified as they are read.
+
+NOTE: The values are stored little-endian, which is also the order of the
+      processors this runs on.  The file is rejected on any other.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int open_narr_cube
+(
+    char *filename,  /* I: cube file to map */
+    NARR_CUBE *cube  /* O: the mapped cube */
+)
+{
+    char FUNC_NAME[] = "open_narr_cube";
+    char msg[MAX_STR_LEN];
+
+    int fd;
+    struct stat file_stat;
+    size_t checksums_size;
+    size_t values_size;
+    uint16_t byte_order = 1;
+
+    NARR_CUBE_HEADER *header;
+
+    memset (cube, 0, sizeof (*cube));
+    snprintf (cube->filename, sizeof (cube->filename), "%s", filename);
+
+    if (*(uint8_t *) &byte_order != 1)
+    {
+        RETURN_ERROR ("NARR cubes are only supported on little-endian"
+                      " processors", FUNC_NAME, FAILURE);
+    }
+
+    fd = open (filename, O_RDONLY);
+    if (fd < 0)
+    {
+        snprintf (msg, sizeof (msg), "Opening NARR cube %s", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    if (fstat (fd, &file_stat) != 0
+        || file_stat.st_size < (off_t) sizeof (NARR_CUBE_HEADER))
+    {
+        close (fd);
+        snprintf (msg, sizeof (msg), "NARR cube %s is truncated", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+    cube->size = file_stat.st_size;
+
+    /* The mapping stays valid once the descriptor is closed */
+    header = mmap (NULL, cube->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (header == MAP_FAILED)
+    {
+        snprintf (msg, sizeof (msg), "Mapping NARR cube %s", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+    cube->header = header;
+
+    /* Verify the layout before any of the values are used */
+    if (memcmp (header->magic, NARR_CUBE_MAGIC, sizeof (NARR_CUBE_MAGIC)) != 0
+        || header->version != NARR_CUBE_VERSION)
+    {
+        close_narr_cube (cube);
+        snprintf (msg, sizeof (msg), "%s is not a version %d NARR cube",
+                  filename, NARR_CUBE_VERSION);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    if (header->rows != NARR_ROWS || header->cols != NARR_COLS
+        || header->num_parameters > NARR_CUBE_MAX_PARAMETERS
+        || header->num_layers > NARR_CUBE_MAX_LAYERS
+        || header->chunk_rows < 1 || header->chunk_rows > header->rows)
+    {
+        close_narr_cube (cube);
+        snprintf (msg, sizeof (msg), "NARR cube %s has an invalid grid,"
+                  " layer count, or chunk size", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    cube->num_chunks = (header->rows + header->chunk_rows - 1)
+                       / header->chunk_rows;
+    checksums_size = (size_t) header->num_parameters * header->num_layers
+                     * cube->num_chunks * sizeof (uint32_t);
+    values_size = (size_t) header->num_parameters * header->num_layers
+                  * header->rows * header->cols * sizeof (float);
+    if (cube->size != sizeof (NARR_CUBE_HEADER) + checksums_size
+                      + values_size)
+    {
+        close_narr_cube (cube);
+        snprintf (msg, sizeof (msg), "NARR cube %s does not match the size"
+                  " of its header", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    cube->checksums = (uint32_t *) (header + 1);
+    cube->values = (float *) ((char *) cube->checksums + checksums_size);
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  find_narr_cube_parameter
+
+PURPOSE: Determine the position of a parameter within a cube.
+
+RETURN: int - the position, or -1 when the cube does not hold it
+
+*****************************************************************************/
+static int find_narr_cube_parameter
+(
+    NARR_CUBE *cube, /* I: the mapped cube */
+    char *parameter  /* I: name of the parameter */
+)
+{
+    int parm_index;
+
+    for (parm_index = 0; parm_index < cube->header->num_parameters;
+         parm_index++)
+    {
+        if (strncmp (cube->header->parameters[parm_index], parameter,
+                     NARR_CUBE_NAME_LEN) == 0)
+            return parm_index;
+    }
+
+    return -1;
+}
+
+
+/*****************************************************************************
+METHOD:  narr_cube_holds
+
+PURPOSE: Determine if a cube holds a parameter.
+
+RETURN: true when it does
+
+*****************************************************************************/
+bool narr_cube_holds
+(
+    NARR_CUBE *cube, /* I: the mapped cube */
+    char *parameter  /* I: name of the parameter */
+)
+{
+    return find_narr_cube_parameter (cube, parameter) >= 0;
+}
+
+
+/*****************************************************************************
+METHOD:  read_narr_cube_window
+
+PURPOSE: Reads the values of a parameter at a pressure layer within a window
+         of the grid.  Only the chunks holding the rows of the window are
+         touched, and they are verified against their checksums.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int read_narr_cube_window
+(
+    NARR_CUBE *cube, /* I: the mapped cube */
+    char *parameter, /* I: name of the parameter */
+    int layer,       /* I: pressure of the layer in millibars */
+    int min_row,     /* I: first row of the window */
+    int max_row,     /* I: last row of the window */
+    int min_col,     /* I: first column of the window */
+    int max_col,     /* I: last column of the window */
+    double *output   /* O: values of the window, in row major order */
+)
+{
+    char FUNC_NAME[] = "read_narr_cube_window";
+    char msg[MAX_STR_LEN];
+
+    NARR_CUBE_HEADER *header = cube->header;
+    int parm_index;
+    int layer_index;
+    int chunk;
+    int chunk_end;
+    int row;
+    int col;
+    int window_cols = max_col - min_col + 1;
+    float *plane;
+    float *line;
+    uint32_t *plane_checksums;
+
+    if (min_row < 0 || max_row >= header->rows || min_row > max_row
+        || min_col < 0 || max_col >= header->cols || min_col > max_col)
+    {
+        RETURN_ERROR ("Invalid window of the NARR grid", FUNC_NAME, FAILURE);
+    }
+
+    parm_index = find_narr_cube_parameter (cube, parameter);
+
+    for (layer_index = 0; layer_index < header->num_layers; layer_index++)
+    {
+        if (header->layers[layer_index] == layer)
+            break;
+    }
+
+    if (parm_index < 0 || layer_index == header->num_layers)
+    {
+        snprintf (msg, sizeof (msg), "NARR cube %s does not hold %s at %d"
+                  " millibars", cube->filename, parameter, layer);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    plane = cube->values
+            + ((size_t) parm_index * header->num_layers + layer_index)
+              * header->rows * header->cols;
+    plane_checksums = cube->checksums
+                      + ((size_t) parm_index * header->num_layers
+                         + layer_index) * cube->num_chunks;
+
+    /* Verify the chunks holding the window */
+    for (chunk = min_row / header->chunk_rows;
+         chunk <= max_row / header->chunk_rows; chunk++)
+    {
+        row = chunk * header->chunk_rows;
+        chunk_end = row + header->chunk_rows;
+        if (chunk_end > header->rows)
+            chunk_end = header->rows;
+
+        if (checksum_bytes (plane + (size_t) row * header->cols,
+                            (size_t) (chunk_end - row) * header->cols
+                            * sizeof (float)) != plane_checksums[chunk])
+        {
+            snprintf (msg, sizeof (msg), "NARR cube %s fails its checksum",
+                      cube->filename);
+            RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+        }
+    }
+
+    for (row = min_row; row <= max_row; row++)
+    {
+        line = plane + (size_t) row * header->cols;
+        for (col = min_col; col <= max_col; col++)
+        {
+            output[(row - min_row) * window_cols + (col - min_col)] =
+                line[col];
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  write_narr_cube
+
+PURPOSE: Writes a cube holding the values of each parameter at each layer,
+         in the layout convert_narr_to_cube.py writes.  The file is written
+         under a temporary name and renamed, so a partial cube is never
+         found.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int write_narr_cube
+(
+    char *filename,     /* I: cube file to write */
+    int num_parameters, /* I: number of parameters */
+    char **parameters,  /* I: name of each parameter */
+    int num_layers,     /* I: number of layers of each parameter */
+    int *layers,        /* I: pressure of each layer in millibars */
+    float *values       /* I: values of each parameter at each layer, in the
+                              row major order of the grid */
+)
+{
+    char FUNC_NAME[] = "write_narr_cube";
+    char msg[MAX_STR_LEN];
+    char temp_filename[PATH_MAX];
+
+    NARR_CUBE_HEADER header;
+    FILE *fd;
+    int num_chunks = (NARR_ROWS + NARR_CUBE_CHUNK_ROWS - 1)
+                     / NARR_CUBE_CHUNK_ROWS;
+    int plane;
+    int chunk;
+    int rows;
+    int count;
+    size_t plane_size = (size_t) NARR_ROWS * NARR_COLS;
+    size_t num_planes = (size_t) num_parameters * num_layers;
+    uint32_t *checksums;
+
+    if (num_parameters > NARR_CUBE_MAX_PARAMETERS
+        || num_layers > NARR_CUBE_MAX_LAYERS)
+    {
+        RETURN_ERROR ("Too many parameters or layers for a NARR cube",
+                      FUNC_NAME, FAILURE);
+    }
+
+    count = snprintf (temp_filename, sizeof (temp_filename), "%s.tmp",
+                      filename);
+    if (count < 0 || count >= sizeof (temp_filename))
+    {
+        RETURN_ERROR ("Failed initializing the temporary cube filename",
+                      FUNC_NAME, FAILURE);
+    }
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, NARR_CUBE_MAGIC, sizeof (NARR_CUBE_MAGIC));
+    header.version = NARR_CUBE_VERSION;
+    header.rows = NARR_ROWS;
+    header.cols = NARR_COLS;
+    header.num_parameters = num_parameters;
+    header.num_layers = num_layers;
+    header.chunk_rows = NARR_CUBE_CHUNK_ROWS;
+    for (plane = 0; plane < num_parameters; plane++)
+    {
+        strncpy (header.parameters[plane], parameters[plane],
+                 NARR_CUBE_NAME_LEN);
+    }
+    for (plane = 0; plane < num_layers; plane++)
+        header.layers[plane] = layers[plane];
+
+    checksums = malloc (num_planes * num_chunks * sizeof (uint32_t));
+    if (checksums == NULL)
+    {
+        RETURN_ERROR ("Allocating the cube checksums", FUNC_NAME, FAILURE);
+    }
+
+    for (plane = 0; plane < num_planes; plane++)
+    {
+        for (chunk = 0; chunk < num_chunks; chunk++)
+        {
+            rows = NARR_ROWS - chunk * NARR_CUBE_CHUNK_ROWS;
+            if (rows > NARR_CUBE_CHUNK_ROWS)
+                rows = NARR_CUBE_CHUNK_ROWS;
+
+            checksums[plane * num_chunks + chunk] =
+                checksum_bytes (values + plane * plane_size
+                                + (size_t) chunk * NARR_CUBE_CHUNK_ROWS
+                                  * NARR_COLS,
+                                (size_t) rows * NARR_COLS * sizeof (float));
+        }
+    }
+
+    fd = fopen (temp_filename, "wb");
+    if (fd == NULL)
+    {
+        free (checksums);
+        snprintf (msg, sizeof (msg), "Creating NARR cube %s", temp_filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    if (fwrite (&header, sizeof (header), 1, fd) != 1
+        || fwrite (checksums, sizeof (uint32_t), num_planes * num_chunks, fd)
+           != num_planes * num_chunks
+        || fwrite (values, sizeof (float), num_planes * plane_size, fd)
+           != num_planes * plane_size)
+    {
+        fclose (fd);
+        unlink (temp_filename);
+        free (checksums);
+        snprintf (msg, sizeof (msg), "Writing NARR cube %s", temp_filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+    free (checksums);
+
+    if (fclose (fd) != 0 || rename (temp_filename, filename) != 0)
+    {
+        unlink (temp_filename);
+        snprintf (msg, sizeof (msg), "Finishing NARR cube %s", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  close_narr_cube
+
+PURPOSE: Unmaps a cube.
+
+*****************************************************************************/
+void close_narr_cube
+(
+    NARR_CUBE *cube  /* I: the mapped cube */
+)
+{
+    if (cube->header != NULL)
+        munmap (cube->header, cube->size);
+
+    cube->header = NULL;
+    cube->checksums = NULL;
+    cube->values = NULL;
+    cube->size = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef NARR_CUBE_H
+#define NARR_CUBE_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+
+
+/* Limits of the layout of a cube */
+#define NARR_CUBE_MAX_PARAMETERS 4
+#define NARR_CUBE_MAX_LAYERS 32
+#define NARR_CUBE_NAME_LEN 8
+
+
+/* Describes the NARR data of one timestep in a cube file.  The file holds
+   this header, little-endian, then the checksums, then the values of each
+   parameter, layer by layer, as little-endian 32 bit floats in the row major
+   order of the grid.  The rows of each layer are split into chunks of
+   chunk_rows rows, and the checksums are the CRC-32 of each chunk, in the
+   order of the values.  A window of the grid only reads and verifies the
+   chunks holding its rows. */
+typedef struct
+{
+    char magic[8];          /* NARR_CUBE_MAGIC */
+    uint32_t version;       /* NARR_CUBE_VERSION */
+    uint32_t rows;          /* Size of the grid */
+    uint32_t cols;
+    uint32_t num_parameters; /* Number of parameters held */
+    uint32_t num_layers;    /* Number of pressure layers of each */
+    uint32_t chunk_rows;    /* Rows of each checksummed chunk */
+    char parameters[NARR_CUBE_MAX_PARAMETERS][NARR_CUBE_NAME_LEN];
+                            /* Names of the parameters, in file order */
+    int32_t layers[NARR_CUBE_MAX_LAYERS]; /* Pressure of each layer in
+                                             millibars, in file order */
+} NARR_CUBE_HEADER;
+
+
+/* A cube file mapped into memory */
+typedef struct
+{
+    char filename[PATH_MAX];   /* Cube file */
+    NARR_CUBE_HEADER *header;  /* Start of the mapping */
+    uint32_t *checksums;       /* The checksums following the header */
+    float *values;             /* The values following the checksums */
+    int num_chunks;            /* Chunks of each layer */
+    size_t size;               /* Bytes mapped */
+} NARR_CUBE;
+
+
+int open_narr_cube
+(
+    char *filename,  /* I: cube file to map */
+    NARR_CUBE *cube  /* O: the mapped cube */
+);
+
+
+bool narr_cube_holds
+(
+    NARR_CUBE *cube, /* I: the mapped cube */
+    char *parameter  /* I: name of the parameter */
+);
+
+
+int read_narr_cube_window
+(
+    NARR_CUBE *cube, /* I: the mapped cube */
+    char *parameter, /* I: name of the parameter */
+    int layer,       /* I: pressure of the layer in millibars */
+    int min_row,     /* I: first row of the window */
+    int max_row,     /* I: last row of the window */
+    int min_col,     /* I: first column of the window */
+    int max_col,     /* I: last column of the window */
+    double *output   /* O: values of the window, in row major order */
+);
+
+
+int write_narr_cube
+(
+    char *filename,     /* I: cube file to write */
+    int num_parameters, /* I: number of parameters */
+    char **parameters,  /* I: name of each parameter */
+    int num_layers,     /* I: number of layers of each parameter */
+    int *layers,        /* I: pressure of each layer in millibars */
+    float *values       /* I: values of each parameter at each layer, in the
+                              row major order of the grid */
+);
+
+
+void close_narr_cube
+(
+    NARR_CUBE *cube  /* I: the mapped cube */
+);
+
+
+#endif /* NARR_CUBE_H */
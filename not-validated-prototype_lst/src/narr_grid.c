@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "narr_grid.h"
+
+
+/* Identifies the grid files, the version changes with their layout */
+#define NARR_GRID_MAGIC "LSTGRID"
+#define NARR_GRID_VERSION 1
+
+
+/*****************************************************************************
+METHOD:  bucket_of
+
+PURPOSE: Determine the bucket holding a latitude or longitude.  Values
+         beyond the index fall in its first or last bucket, the same as
+         when the index was built.
+
+RETURN: int - the bucket
+
+*****************************************************************************/
+static int bucket_of
+(
+    double value,       /* I: the latitude or longitude */
+    double min_value,   /* I: start of the first bucket */
+    double bucket_size, /* I: degrees of each bucket */
+    int num_buckets     /* I: number of buckets */
+)
+{
+    double bucket = floor ((value - min_value) / bucket_size);
+
+    if (bucket < 0.0)
+        return 0;
+    if (bucket > num_buckets - 1)
+        return num_buckets - 1;
+
+    return (int) bucket;
+}
+
+
+/*****************************************************************************
+METHOD:  open_narr_grid
+
+PURPOSE: Maps the NARR coordinate grid into memory and verifies it, so the
+         coordinates and their index can be used in place without reading
+         and parsing the coordinates text.
+
+NOTE: The grid is stored little-endian, which is also the order of the
+      processors this runs on.  The file is rejected on any other.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int open_narr_grid
+(
+    char *filename,  /* I: grid file to map */
+    NARR_GRID *grid  /* O: the mapped grid */
+)
+{
+    char FUNC_NAME[] = "open_narr_grid";
+    char msg[MAX_STR_LEN];
+
+    int fd;
+    struct stat file_stat;
+    size_t num_points;
+    size_t num_buckets;
+    uint16_t byte_order = 1;
+
+    NARR_GRID_HEADER *header;
+
+    memset (grid, 0, sizeof (*grid));
+
+    if (*(uint8_t *) &byte_order != 1)
+    {
+        RETURN_ERROR ("NARR grids are only supported on little-endian"
+                      " processors", FUNC_NAME, FAILURE);
+    }
+
+    fd = open (filename, O_RDONLY);
+    if (fd < 0)
+    {
+        snprintf (msg, sizeof (msg), "Opening NARR grid %s", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    if (fstat (fd, &file_stat) != 0
+        || file_stat.st_size < (off_t) sizeof (NARR_GRID_HEADER))
+    {
+        close (fd);
+        snprintf (msg, sizeof (msg), "NARR grid %s is truncated", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+    grid->size = file_stat.st_size;
+
+    /* The mapping stays valid once the descriptor is closed */
+    header = mmap (NULL, grid->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (header == MAP_FAILED)
+    {
+        snprintf (msg, sizeof (msg), "Mapping NARR grid %s", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+    grid->header = header;
+
+    /* Verify the layout before any of the coordinates are used */
+    if (memcmp (header->magic, NARR_GRID_MAGIC, sizeof (NARR_GRID_MAGIC)) != 0
+        || header->version != NARR_GRID_VERSION)
+    {
+        close_narr_grid (grid);
+        snprintf (msg, sizeof (msg), "%s is not a version %d NARR grid",
+                  filename, NARR_GRID_VERSION);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    if (header->rows != NARR_ROWS || header->cols != NARR_COLS
+        || header->lat_buckets < 1 || header->lon_buckets < 1
+        || !(header->bucket_size > 0.0))
+    {
+        close_narr_grid (grid);
+        snprintf (msg, sizeof (msg), "NARR grid %s has an invalid grid or"
+                  " index", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    num_points = (size_t) header->rows * header->cols;
+    num_buckets = (size_t) header->lat_buckets * header->lon_buckets;
+    if (grid->size != sizeof (NARR_GRID_HEADER)
+                      + num_points * 2 * sizeof (double)
+                      + (num_buckets + 1) * sizeof (uint32_t)
+                      + num_points * sizeof (uint32_t))
+    {
+        close_narr_grid (grid);
+        snprintf (msg, sizeof (msg), "NARR grid %s does not match the size"
+                  " of its header", filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    if (checksum_bytes (header + 1, grid->size - sizeof (NARR_GRID_HEADER))
+        != header->checksum)
+    {
+        close_narr_grid (grid);
+        snprintf (msg, sizeof (msg), "NARR grid %s fails its checksum",
+                  filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    grid->lat = (double *) (header + 1);
+    grid->lon = grid->lat + num_points;
+    grid->bucket_start = (uint32_t *) (grid->lon + num_points);
+    grid->bucket_points = grid->bucket_start + num_buckets + 1;
+
+    /* The entries must stay within the grid for the lookups */
+    if (grid->bucket_start[0] != 0
+        || grid->bucket_start[num_buckets] != num_points)
+    {
+        close_narr_grid (grid);
+        snprintf (msg, sizeof (msg), "NARR grid %s has an invalid index",
+                  filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  find_narr_grid_window
+
+PURPOSE: Determine the rows and columns of the grid points within the
+         specified bounds, only testing the points of the buckets the bounds
+         cover instead of every point of the grid.
+
+NOTE: The rows and columns are only widened, so they are initialized by the
+      caller, and are left as they are when no point is within the bounds.
+
+*****************************************************************************/
+void find_narr_grid_window
+(
+    NARR_GRID *grid,   /* I: the mapped grid */
+    double north_lat,  /* I: the points are south of this */
+    double south_lat,  /* I: the points are north of this */
+    double east_lon,   /* I: the points are west of this */
+    double west_lon,   /* I: the points are east of this */
+    int *min_row,      /* I/O: rows and columns holding the points */
+    int *max_row,
+    int *min_col,
+    int *max_col
+)
+{
+    NARR_GRID_HEADER *header = grid->header;
+    int first_lat;
+    int last_lat;
+    int first_lon;
+    int last_lon;
+    int lat_bucket;
+    int bucket;
+    int row;
+    int col;
+    uint32_t entry;
+    uint32_t point;
+
+    /* The buckets are monotonic in the coordinates, so every point within
+       the bounds is in a bucket between those of the bounds */
+    first_lat = bucket_of (south_lat, header->min_lat, header->bucket_size,
+                           header->lat_buckets);
+    last_lat = bucket_of (north_lat, header->min_lat, header->bucket_size,
+                          header->lat_buckets);
+    first_lon = bucket_of (west_lon, header->min_lon, header->bucket_size,
+                           header->lon_buckets);
+    last_lon = bucket_of (east_lon, header->min_lon, header->bucket_size,
+                          header->lon_buckets);
+
+    for (lat_bucket = first_lat; lat_bucket <= last_lat; lat_bucket++)
+    {
+        for (bucket = lat_bucket * header->lon_buckets + first_lon;
+             bucket <= lat_bucket * header->lon_buckets + last_lon; bucket++)
+        {
+            for (entry = grid->bucket_start[bucket];
+                 entry < grid->bucket_start[bucket + 1]; entry++)
+            {
+                point = grid->bucket_points[entry];
+
+                if ((north_lat > grid->lat[point])
+                    && (south_lat < grid->lat[point])
+                    && (west_lon < grid->lon[point])
+                    && (east_lon > grid->lon[point]))
+                {
+                    row = point / header->cols;
+                    col = point % header->cols;
+
+                    if (row < *min_row)
+                        *min_row = row;
+                    if (row > *max_row)
+                        *max_row = row;
+                    if (col < *min_col)
+                        *min_col = col;
+                    if (col > *max_col)
+                        *max_col = col;
+                }
+            }
+        }
+    }
+}
+
+
+/*****************************************************************************
+METHOD:  close_narr_grid
+
+PURPOSE: Unmaps a grid.
+
+*****************************************************************************/
+void close_narr_grid
+(
+    NARR_GRID *grid  /* I: the mapped grid */
+)
+{
+    if (grid->header != NULL)
+        munmap (grid->header, grid->size);
+
+    grid->header = NULL;
+    grid->lat = NULL;
+    grid->lon = NULL;
+    grid->bucket_start = NULL;
+    grid->bucket_points = NULL;
+    grid->size = 0;
+}
@@ -0,0 +1,75 @@
+#ifndef NARR_GRID_H
+#define NARR_GRID_H
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* Describes the NARR coordinate grid file.  The file holds this header,
+   little-endian, followed by the latitude and the longitude of each grid
+   point as doubles, in the row major order of the grid, then the bucket
+   index.  The longitudes are already converted as read_narr_coordinates
+   converts them.
+
+   The index divides the latitudes and longitudes into buckets of
+   bucket_size degrees, from min_lat and min_lon.  It holds the first entry
+   of each bucket, latitude bucket major, followed by one more for the end
+   of the last, then the entries, which are the grid point numbers of each
+   bucket in increasing order.  The checksum is the CRC-32 of everything
+   following the header. */
+typedef struct
+{
+    char magic[8];          /* NARR_GRID_MAGIC */
+    uint32_t version;       /* NARR_GRID_VERSION */
+    uint32_t rows;          /* Size of the grid */
+    uint32_t cols;
+    uint32_t lat_buckets;   /* Buckets of the index */
+    uint32_t lon_buckets;
+    uint32_t checksum;      /* CRC-32 of the contents */
+    double bucket_size;     /* Degrees of each bucket */
+    double min_lat;         /* Corner of the first bucket */
+    double min_lon;
+} NARR_GRID_HEADER;
+
+
+/* A coordinate grid file mapped into memory */
+typedef struct
+{
+    NARR_GRID_HEADER *header;  /* Start of the mapping */
+    double *lat;               /* Latitude of each grid point */
+    double *lon;               /* Longitude of each grid point */
+    uint32_t *bucket_start;    /* First entry of each bucket */
+    uint32_t *bucket_points;   /* Grid point of each entry */
+    size_t size;               /* Bytes mapped */
+} NARR_GRID;
+
+
+int open_narr_grid
+(
+    char *filename,  /* I: grid file to map */
+    NARR_GRID *grid  /* O: the mapped grid */
+);
+
+
+void find_narr_grid_window
+(
+    NARR_GRID *grid,   /* I: the mapped grid */
+    double north_lat,  /* I: the points are south of this */
+    double south_lat,  /* I: the points are north of this */
+    double east_lon,   /* I: the points are west of this */
+    double west_lon,   /* I: the points are east of this */
+    int *min_row,      /* I/O: rows and columns holding the points */
+    int *max_row,
+    int *min_col,
+    int *max_col
+);
+
+
+void close_narr_grid
+(
+    NARR_GRID *grid  /* I: the mapped grid */
+);
+
+
+#endif /* NARR_GRID_H */
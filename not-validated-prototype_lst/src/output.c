@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <limits.h>
 #include <time.h>
 
@@ -16,16 +17,17 @@
 
 #include "const.h"
 #include "utilities.h"
-
-
-#define MAX_DATE_LEN 28
+#include "input.h"
+#include "output.h"
 
 
 /******************************************************************************
   NAME:  add_lst_band_product
 
   PURPOSE:  Create a new envi output file including envi header and add the
-            associated information to the XML metadata file.
+            associated information to the XML metadata file.  The band has
+            the size of the window of the scene processed, with the ENVI
+            header placing it within the scene.
 
   RETURN VALUE:  Type = int
       Value    Description
@@ -37,7 +39,7 @@ int
 add_lst_band_product
 (
     char *xml_filename,
-    char *reference_band_name,
+    Input_Data_t *input,
     char *image_filename,
     char *product_name,
     char *band_name,
@@ -45,7 +47,10 @@ add_lst_band_product
     char *long_name,
     char *data_units,
     int min_range,
-    int max_range
+    int max_range,
+    Espa_data_type_t data_type,
+    float scale_factor,
+    float add_offset
 )
 {
     char FUNC_NAME[] = "add_lst_band_product";
@@ -84,8 +89,8 @@ add_lst_band_product
              || (strcmp (in_meta.band[band_index].product, "L1TP") == 0)
              || (strcmp (in_meta.band[band_index].product, "L1GT") == 0)
              || (strcmp (in_meta.band[band_index].product, "L1GS") == 0))
-            && (strcmp (in_meta.band[band_index].name, reference_band_name)
-                == 0))
+            && (strcmp (in_meta.band[band_index].name,
+                        input->reference_band_name) == 0))
         {
             /* this is the index we'll use for output band information */
             src_index = band_index;
@@ -136,8 +141,8 @@ add_lst_band_product
               product_name);
     snprintf (bmeta[0].source, sizeof (bmeta[0].source), "level1");
     snprintf (bmeta[0].category, sizeof (bmeta[0].category), "image");
-    bmeta[0].nlines = in_meta.band[src_index].nlines;
-    bmeta[0].nsamps = in_meta.band[src_index].nsamps;
+    bmeta[0].nlines = input->lines;
+    bmeta[0].nsamps = input->samples;
     bmeta[0].pixel_size[0] = in_meta.band[src_index].pixel_size[0];
     bmeta[0].pixel_size[1] = in_meta.band[src_index].pixel_size[1];
     snprintf (bmeta[0].pixel_units, sizeof (bmeta[0].pixel_units), "meters");
@@ -145,8 +150,10 @@ add_lst_band_product
               "lst_%s", LST_VERSION);
     snprintf (bmeta[0].production_date, sizeof (bmeta[0].production_date),
               "%s", production_date);
-    bmeta[0].data_type = ESPA_FLOAT32;
+    bmeta[0].data_type = data_type;
     bmeta[0].fill_value = LST_NO_DATA_VALUE;
+    bmeta[0].scale_factor = scale_factor;
+    bmeta[0].add_offset = add_offset;
     bmeta[0].valid_range[0] = min_range;
     bmeta[0].valid_range[1] = max_range;
     snprintf (bmeta[0].name, sizeof (bmeta[0].name), "%s", band_name);
@@ -157,26 +164,37 @@ add_lst_band_product
     snprintf (bmeta[0].file_name, sizeof (bmeta[0].file_name), "%s",
               image_filename);
 
-    /* Create the ENVI header file for this band */
-    if (create_envi_struct (&bmeta[0], &in_meta.global, &envi_hdr) != SUCCESS)
+    /* A GeoTIFF carries its own georeferencing, so the ENVI header is only
+       created for the raw binary bands */
+    tmp_char = strrchr (image_filename, '.');
+    if (tmp_char == NULL || strcmp (tmp_char, ".tif") != 0)
     {
-        RETURN_ERROR ("Failed to create ENVI header structure.", FUNC_NAME,
-                      ERROR);
-    }
+        /* Create the ENVI header file for this band, at the corner of the
+           window */
+        in_meta.global.proj_info.ul_corner[0] = input->meta.ul_map_corner.x;
+        in_meta.global.proj_info.ul_corner[1] = input->meta.ul_map_corner.y;
+        if (create_envi_struct (&bmeta[0], &in_meta.global, &envi_hdr)
+            != SUCCESS)
+        {
+            RETURN_ERROR ("Failed to create ENVI header structure.",
+                          FUNC_NAME, ERROR);
+        }
 
-    /* Write the ENVI header */
-    snprintf (envi_file, sizeof(envi_file), "%s", bmeta[0].file_name);
-    tmp_char = strchr (envi_file, '.');
-    if (tmp_char == NULL)
-    {
-        RETURN_ERROR ("Failed creating ENVI header filename", FUNC_NAME,
-                      ERROR);
-    }
+        /* Write the ENVI header */
+        snprintf (envi_file, sizeof(envi_file), "%s", bmeta[0].file_name);
+        tmp_char = strchr (envi_file, '.');
+        if (tmp_char == NULL)
+        {
+            RETURN_ERROR ("Failed creating ENVI header filename", FUNC_NAME,
+                          ERROR);
+        }
 
-    sprintf (tmp_char, ".hdr");
-    if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
-    {
-        RETURN_ERROR ("Failed writing ENVI header file", FUNC_NAME, ERROR);
+        sprintf (tmp_char, ".hdr");
+        if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+        {
+            RETURN_ERROR ("Failed writing ENVI header file", FUNC_NAME,
+                          ERROR);
+        }
     }
 
     /* Append the LST band to the XML file */
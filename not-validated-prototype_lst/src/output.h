@@ -3,19 +3,26 @@
 #define OUTPUT_H
 
 
+#include "espa_metadata.h"
+#include "input.h"
+
+
 int
 add_lst_band_product
 (
     char *xml_filename,
-    char *reference_band_name,
+    Input_Data_t *input,
     char *image_filename,
     char *product_name,
     char *band_name,
     char *short_name,
     char *long_name,
     char *data_units,
-    float min_range,
-    float max_range
+    int min_range,
+    int max_range,
+    Espa_data_type_t data_type,
+    float scale_factor,
+    float add_offset
 );
 
 
@@ -0,0 +1,1628 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "cpu_kernels.h"
+#include "pixel_interpolation.h"
+
+
+/******************************************************************************
+METHOD:  allocate_point_results
+
+PURPOSE: Rearranges the MODTRAN results into a height vector and a plane for
+         each parameter, so the NUM_ELEVATIONS values of a point used during
+         interpolation are contiguous and aligned.
+
+RETURN: SUCCESS
+        FAILURE
+
+******************************************************************************/
+int allocate_point_results
+(
+    double **modtran_results, /* I: results from MODTRAN runs */
+    int num_points,           /* I: number of points */
+    POINT_RESULTS *results    /* O: the rearranged results */
+)
+{
+    char FUNC_NAME[] = "allocate_point_results";
+
+    int parameter;
+    int index;
+    int count = num_points * NUM_ELEVATIONS;
+    void *memory;
+
+    /* The MODTRAN result element for each parameter */
+    const int elements[AHP_NUM_PARAMETERS] =
+    {
+        MGPE_TRANSMISSION,
+        MGPE_UPWELLED_RADIANCE,
+        MGPE_DOWNWELLED_RADIANCE
+    };
+
+    /* A single block holds the heights followed by each parameter plane,
+       with each one starting on an alignment boundary */
+    int stride = ((count * sizeof (double) + PIXEL_ALIGNMENT - 1)
+                  / PIXEL_ALIGNMENT) * PIXEL_ALIGNMENT / sizeof (double);
+
+    if (posix_memalign (&memory, PIXEL_ALIGNMENT,
+                        (AHP_NUM_PARAMETERS + 1) * stride * sizeof (double))
+        != 0)
+    {
+        RETURN_ERROR ("Allocating point results memory", FUNC_NAME, FAILURE);
+    }
+
+    results->height = memory;
+    for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+    {
+        results->parameter[parameter] =
+            results->height + (parameter + 1) * stride;
+    }
+
+    for (index = 0; index < count; index++)
+    {
+        results->height[index] = modtran_results[index][MGPE_HEIGHT];
+
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            results->parameter[parameter][index] =
+                modtran_results[index][elements[parameter]];
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+METHOD:  free_point_results
+
+PURPOSE: Frees the rearranged MODTRAN results.
+
+******************************************************************************/
+void free_point_results
+(
+    POINT_RESULTS *results /* I/O: the rearranged results */
+)
+{
+    int parameter;
+
+    free (results->height);
+    results->height = NULL;
+
+    for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+    {
+        results->parameter[parameter] = NULL;
+    }
+}
+
+
+/******************************************************************************
+METHOD:  interpolate_to_height
+
+PURPOSE: Interpolate to height of current pixel
+
+******************************************************************************/
+void interpolate_to_height
+(
+    POINT_RESULTS *results, /* I: results from MODTRAN runs */
+    int point,              /* I: the point to interpolate for */
+    double interpolate_to,  /* I: current landsat pixel height */
+    double *at_height       /* O: interpolated height for point */
+)
+{
+    int parameter;
+    int elevation;
+    int below = 0;
+    int above = 0;
+
+    double slope;
+    double intercept;
+
+    double above_height;
+    double below_parameter;
+    double above_parameter;
+    double inv_height_diff; /* To remove the multiple divisions */
+
+    /* Use local variables for cleaner code */
+    int first = point * NUM_ELEVATIONS;
+    double *height = &results->height[first];
+
+    /* Find the height to use that is below the interpolate_to height */
+    for (elevation = 0; elevation < NUM_ELEVATIONS; elevation++)
+    {
+        if (height[elevation] < interpolate_to)
+        {
+            below = elevation; /* Last match will always be the one we want */
+        }
+    }
+
+    /* Find the height to use that is equal to or above the interpolate_to
+       height
+
+       It will always be the same or the next height */
+    above = below; /* Start with the same */
+    if (above != (NUM_ELEVATIONS - 1))
+    {
+        /* Not the last height */
+
+        /* Check to make sure that we are not less that the below height,
+           indicating that our interpolate_to height is below the first
+           height */
+        if (! (interpolate_to < height[above]))
+        {
+            /* Use the next height, since it will be equal to or above our
+               interpolate_to height */
+            above++;
+        }
+        /* Else - We are at the first height, so use that for both above and
+                  below */
+    }
+    /* Else - We are at the last height, so use that for both above and
+              below */
+
+    if (above == below)
+    {
+        /* Use the below parameters since the same */
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            at_height[parameter] =
+                results->parameter[parameter][first + below];
+        }
+    }
+    else
+    {
+        /* Interpolate between the heights for each parameter */
+        above_height = height[above];
+        inv_height_diff = 1.0 / (above_height - height[below]);
+
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            below_parameter = results->parameter[parameter][first + below];
+            above_parameter = results->parameter[parameter][first + above];
+
+            slope = (above_parameter - below_parameter) * inv_height_diff;
+
+            intercept = above_parameter - slope * above_height;
+
+            at_height[parameter] = slope * interpolate_to + intercept;
+        }
+    }
+}
+
+
+/******************************************************************************
+METHOD:  allocate_height_tables
+
+PURPOSE: Allocates the table pointers for each point, for the elevation range
+         of the scene.  The tables themselves are built the first time a
+         point is used.
+
+RETURN: SUCCESS
+        FAILURE
+
+******************************************************************************/
+int allocate_height_tables
+(
+    int num_points,           /* I: number of points */
+    int min_height,           /* I: lowest elevation of the scene */
+    int max_height,           /* I: highest elevation of the scene */
+    HEIGHT_TABLES *heights    /* O: the height tables */
+)
+{
+    char FUNC_NAME[] = "allocate_height_tables";
+
+    /* All fill, so provide an empty range */
+    if (max_height < min_height)
+    {
+        min_height = 0;
+        max_height = -1;
+    }
+
+    heights->min_height = min_height;
+    heights->num_heights = max_height - min_height + 1;
+
+    heights->tables = calloc (num_points, sizeof (double *));
+    if (heights->tables == NULL)
+    {
+        RETURN_ERROR ("Allocating height tables memory", FUNC_NAME, FAILURE);
+    }
+
+    heights->float_tables = calloc (num_points, sizeof (float *));
+    if (heights->float_tables == NULL)
+    {
+        RETURN_ERROR ("Allocating float height tables memory", FUNC_NAME,
+                      FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+METHOD:  free_height_tables
+
+PURPOSE: Frees the tables built for each point and the table pointers.
+
+******************************************************************************/
+void free_height_tables
+(
+    int num_points,        /* I: number of points */
+    HEIGHT_TABLES *heights /* I/O: the height tables */
+)
+{
+    int point;
+
+    if (heights->tables != NULL)
+    {
+        for (point = 0; point < num_points; point++)
+        {
+            free (heights->tables[point]);
+        }
+    }
+
+    if (heights->float_tables != NULL)
+    {
+        for (point = 0; point < num_points; point++)
+        {
+            free (heights->float_tables[point]);
+        }
+    }
+
+    free (heights->tables);
+    heights->tables = NULL;
+
+    free (heights->float_tables);
+    heights->float_tables = NULL;
+}
+
+
+/******************************************************************************
+METHOD:  height_table
+
+PURPOSE: Provides the table of the three atmospheric parameters for a point
+         interpolated to each elevation of the scene.  The table is built the
+         first time it is needed, using interpolate_to_height for every whole
+         meter of the scene's elevation range, so the values are the same as
+         calling interpolate_to_height for each pixel.
+
+RETURN: Pointer to the table, or NULL if memory could not be allocated for
+        the table.
+
+******************************************************************************/
+double *height_table
+(
+    POINT_RESULTS *results, /* I: results from MODTRAN runs */
+    int point,              /* I: the point to provide the table for */
+    HEIGHT_TABLES *heights  /* I/O: the height tables */
+)
+{
+    int height;
+    double *table;
+    void *memory;
+
+#ifdef _OPENMP
+    #pragma omp atomic read seq_cst
+#endif
+    table = heights->tables[point];
+
+    if (table == NULL)
+    {
+        /* Only one thread builds a table, the others wait for it */
+#ifdef _OPENMP
+        #pragma omp critical (height_tables)
+#endif
+        {
+            table = heights->tables[point];
+            if (table == NULL
+                && posix_memalign (&memory, PIXEL_ALIGNMENT,
+                                   heights->num_heights * AHP_NUM_PARAMETERS
+                                   * sizeof (double))
+                   == 0)
+            {
+                table = memory;
+                for (height = 0; height < heights->num_heights; height++)
+                {
+                    /* convert height from m to km
+                       -- Same as 1.0 / 1000.0 */
+                    interpolate_to_height (
+                        results, point,
+                        (double) (heights->min_height + height) * 0.001,
+                        &table[height * AHP_NUM_PARAMETERS]);
+                }
+
+#ifdef _OPENMP
+                #pragma omp atomic write seq_cst
+#endif
+                heights->tables[point] = table;
+            }
+        }
+    }
+
+    return table;
+}
+
+
+/******************************************************************************
+METHOD:  height_table_float
+
+PURPOSE: Provides a single precision copy of the table from height_table.
+         The copy is made the first time it is needed.
+
+RETURN: Pointer to the table, or NULL if memory could not be allocated for
+        the table.
+
+******************************************************************************/
+float *height_table_float
+(
+    POINT_RESULTS *results, /* I: results from MODTRAN runs */
+    int point,              /* I: the point to provide the table for */
+    HEIGHT_TABLES *heights  /* I/O: the height tables */
+)
+{
+    int index;
+    double *table;
+    float *float_table;
+    void *memory;
+
+#ifdef _OPENMP
+    #pragma omp atomic read seq_cst
+#endif
+    float_table = heights->float_tables[point];
+
+    if (float_table == NULL)
+    {
+        table = height_table (results, point, heights);
+        if (table == NULL)
+            return NULL;
+
+        /* Only one thread makes a copy, the others wait for it */
+#ifdef _OPENMP
+        #pragma omp critical (float_height_tables)
+#endif
+        {
+            float_table = heights->float_tables[point];
+            if (float_table == NULL
+                && posix_memalign (&memory, PIXEL_ALIGNMENT,
+                                   heights->num_heights * AHP_NUM_PARAMETERS
+                                   * sizeof (float))
+                   == 0)
+            {
+                float_table = memory;
+                for (index = 0;
+                     index < heights->num_heights * AHP_NUM_PARAMETERS;
+                     index++)
+                {
+                    float_table[index] = table[index];
+                }
+
+#ifdef _OPENMP
+                #pragma omp atomic write seq_cst
+#endif
+                heights->float_tables[point] = float_table;
+            }
+        }
+    }
+
+    return float_table;
+}
+
+
+/******************************************************************************
+METHOD:  interpolate_run_scalar
+
+PURPOSE: Interpolate the parameters to the location of each sample of a run,
+         one sample at a time, using shepard's method.
+
+******************************************************************************/
+void interpolate_run_scalar
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    int sample;
+    int vertex;
+    int parameter;
+    int height_loc;
+
+    double easting;
+    double inv_h[NUM_CELL_POINTS];
+    double w[NUM_CELL_POINTS];
+    double total;
+    double parameters[AHP_NUM_PARAMETERS];
+
+    for (sample = start_sample; sample < end_sample; sample++)
+    {
+        easting = ul_easting + (sample * x_pixel_size);
+        height_loc = (elevation[sample] - min_height) * AHP_NUM_PARAMETERS;
+
+        /* shepard's method */
+        total = 0.0;
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            inv_h[vertex] = 1.0 / sqrt (((cell->easting[vertex] - easting)
+                                         * (cell->easting[vertex] - easting))
+                                        +
+                                        ((cell->northing[vertex] - northing)
+                                         * (cell->northing[vertex]
+                                            - northing)));
+
+            total += inv_h[vertex];
+        }
+
+        /* Determine the weights for each vertex */
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            w[vertex] = inv_h[vertex] / total;
+        }
+
+        /* For each parameter apply each vertex's weighted value */
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            parameters[parameter] = 0.0;
+            for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+            {
+                parameters[parameter] +=
+                    (w[vertex] * cell->table[vertex][height_loc + parameter]);
+            }
+        }
+
+        /* convert radiances to W*m^(-2)*sr(-1) */
+        upwelled[sample] = parameters[AHP_UPWELLED_RADIANCE] * 10000.0;
+        downwelled[sample] = parameters[AHP_DOWNWELLED_RADIANCE] * 10000.0;
+        transmittance[sample] = parameters[AHP_TRANSMISSION];
+    }
+}
+
+
+#if CPU_KERNELS_DISPATCH
+/******************************************************************************
+METHOD:  interpolate_run_avx512
+
+PURPOSE: Same as interpolate_run_scalar, eight samples at a time.  The
+         operations are performed in the same order as the scalar code, with
+         exact square roots and divisions, so the results are identical.
+
+******************************************************************************/
+AVX512_KERNEL
+void interpolate_run_avx512
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    int sample;
+    int vertex;
+    int parameter;
+
+    __m256i height_loc;
+    __m512d easting;
+    __m512d dx;
+    __m512d dy;
+    __m512d inv_h[NUM_CELL_POINTS];
+    __m512d w[NUM_CELL_POINTS];
+    __m512d total;
+    __m512d parameters[AHP_NUM_PARAMETERS];
+
+    const __m256i lanes = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i v_min_height = _mm256_set1_epi32 (min_height);
+    const __m256i v_num_parameters = _mm256_set1_epi32 (AHP_NUM_PARAMETERS);
+    const __m256 v_x_pixel_size = _mm256_set1_ps (x_pixel_size);
+    const __m512d v_ul_easting = _mm512_set1_pd (ul_easting);
+    const __m512d v_northing = _mm512_set1_pd (northing);
+    const __m512d v_one = _mm512_set1_pd (1.0);
+    const __m512d v_radiance_scale = _mm512_set1_pd (10000.0);
+
+    for (sample = start_sample; sample + 8 <= end_sample; sample += 8)
+    {
+        /* The sample times the pixel size is a single precision product,
+           the same as in the scalar code */
+        easting = _mm512_add_pd (v_ul_easting, _mm512_cvtps_pd (
+            _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_add_epi32 (
+                _mm256_set1_epi32 (sample), lanes)), v_x_pixel_size)));
+
+        height_loc = _mm256_mullo_epi32 (_mm256_sub_epi32 (
+            _mm256_cvtepi16_epi32 (_mm_loadu_si128 (
+                (__m128i *) &elevation[sample])), v_min_height),
+            v_num_parameters);
+
+        /* shepard's method */
+        total = _mm512_setzero_pd ();
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            dx = _mm512_sub_pd (_mm512_set1_pd (cell->easting[vertex]),
+                                easting);
+            dy = _mm512_sub_pd (_mm512_set1_pd (cell->northing[vertex]),
+                                v_northing);
+            inv_h[vertex] = _mm512_div_pd (v_one, _mm512_sqrt_pd (
+                _mm512_add_pd (_mm512_mul_pd (dx, dx),
+                               _mm512_mul_pd (dy, dy))));
+
+            total = _mm512_add_pd (total, inv_h[vertex]);
+        }
+
+        /* Determine the weights for each vertex */
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            w[vertex] = _mm512_div_pd (inv_h[vertex], total);
+        }
+
+        /* For each parameter apply each vertex's weighted value, gathering
+           the value for each sample's elevation from the tables */
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            parameters[parameter] = _mm512_setzero_pd ();
+            for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+            {
+                parameters[parameter] = _mm512_add_pd (parameters[parameter],
+                    _mm512_mul_pd (w[vertex], _mm512_i32gather_pd (
+                        height_loc, &cell->table[vertex][parameter],
+                        sizeof (double))));
+            }
+        }
+
+        /* convert radiances to W*m^(-2)*sr(-1) */
+        _mm256_storeu_ps (&upwelled[sample], _mm512_cvtpd_ps (
+            _mm512_mul_pd (parameters[AHP_UPWELLED_RADIANCE],
+                           v_radiance_scale)));
+        _mm256_storeu_ps (&downwelled[sample], _mm512_cvtpd_ps (
+            _mm512_mul_pd (parameters[AHP_DOWNWELLED_RADIANCE],
+                           v_radiance_scale)));
+        _mm256_storeu_ps (&transmittance[sample],
+                          _mm512_cvtpd_ps (parameters[AHP_TRANSMISSION]));
+    }
+
+    /* Finish the samples which do not fill a vector */
+    interpolate_run_scalar (cell, min_height, ul_easting, x_pixel_size,
+                            northing, sample, end_sample, elevation,
+                            transmittance, upwelled, downwelled);
+}
+#endif
+
+
+#if CPU_KERNELS_DISPATCH
+/******************************************************************************
+METHOD:  interpolate_run_avx2
+
+PURPOSE: Same as interpolate_run_scalar, four samples at a time.  The
+         operations are performed in the same order as the scalar code, with
+         exact square roots and divisions, so the results are identical.
+
+******************************************************************************/
+AVX2_KERNEL
+void interpolate_run_avx2
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    int sample;
+    int vertex;
+    int parameter;
+
+    __m128i height_loc;
+    __m256d easting;
+    __m256d dx;
+    __m256d dy;
+    __m256d inv_h[NUM_CELL_POINTS];
+    __m256d w[NUM_CELL_POINTS];
+    __m256d total;
+    __m256d parameters[AHP_NUM_PARAMETERS];
+
+    const __m128i lanes = _mm_setr_epi32 (0, 1, 2, 3);
+    const __m128i v_min_height = _mm_set1_epi32 (min_height);
+    const __m128i v_num_parameters = _mm_set1_epi32 (AHP_NUM_PARAMETERS);
+    const __m128 v_x_pixel_size = _mm_set1_ps (x_pixel_size);
+    const __m256d v_ul_easting = _mm256_set1_pd (ul_easting);
+    const __m256d v_northing = _mm256_set1_pd (northing);
+    const __m256d v_one = _mm256_set1_pd (1.0);
+    const __m256d v_radiance_scale = _mm256_set1_pd (10000.0);
+
+    for (sample = start_sample; sample + 4 <= end_sample; sample += 4)
+    {
+        /* The sample times the pixel size is a single precision product,
+           the same as in the scalar code */
+        easting = _mm256_add_pd (v_ul_easting, _mm256_cvtps_pd (
+            _mm_mul_ps (_mm_cvtepi32_ps (_mm_add_epi32 (
+                _mm_set1_epi32 (sample), lanes)), v_x_pixel_size)));
+
+        height_loc = _mm_mullo_epi32 (_mm_sub_epi32 (
+            _mm_cvtepi16_epi32 (_mm_loadl_epi64 (
+                (__m128i *) &elevation[sample])), v_min_height),
+            v_num_parameters);
+
+        /* shepard's method */
+        total = _mm256_setzero_pd ();
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            dx = _mm256_sub_pd (_mm256_set1_pd (cell->easting[vertex]),
+                                easting);
+            dy = _mm256_sub_pd (_mm256_set1_pd (cell->northing[vertex]),
+                                v_northing);
+            inv_h[vertex] = _mm256_div_pd (v_one, _mm256_sqrt_pd (
+                _mm256_add_pd (_mm256_mul_pd (dx, dx),
+                               _mm256_mul_pd (dy, dy))));
+
+            total = _mm256_add_pd (total, inv_h[vertex]);
+        }
+
+        /* Determine the weights for each vertex */
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            w[vertex] = _mm256_div_pd (inv_h[vertex], total);
+        }
+
+        /* For each parameter apply each vertex's weighted value, gathering
+           the value for each sample's elevation from the tables */
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            parameters[parameter] = _mm256_setzero_pd ();
+            for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+            {
+                parameters[parameter] = _mm256_add_pd (parameters[parameter],
+                    _mm256_mul_pd (w[vertex], _mm256_i32gather_pd (
+                        &cell->table[vertex][parameter], height_loc,
+                        sizeof (double))));
+            }
+        }
+
+        /* convert radiances to W*m^(-2)*sr(-1) */
+        _mm_storeu_ps (&upwelled[sample], _mm256_cvtpd_ps (
+            _mm256_mul_pd (parameters[AHP_UPWELLED_RADIANCE],
+                           v_radiance_scale)));
+        _mm_storeu_ps (&downwelled[sample], _mm256_cvtpd_ps (
+            _mm256_mul_pd (parameters[AHP_DOWNWELLED_RADIANCE],
+                           v_radiance_scale)));
+        _mm_storeu_ps (&transmittance[sample],
+                       _mm256_cvtpd_ps (parameters[AHP_TRANSMISSION]));
+    }
+
+    /* Finish the samples which do not fill a vector */
+    interpolate_run_scalar (cell, min_height, ul_easting, x_pixel_size,
+                            northing, sample, end_sample, elevation,
+                            transmittance, upwelled, downwelled);
+}
+#endif
+
+
+/******************************************************************************
+METHOD:  interpolate_run
+
+PURPOSE: Interpolate the parameters to the location of each sample of a run
+         of valid samples which share the same cell.  The kernel variant
+         selected for the processor is used.
+
+******************************************************************************/
+void interpolate_run
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    switch (cpu_kernels ())
+    {
+#if CPU_KERNELS_DISPATCH
+        case CPU_KERNELS_AVX512:
+            interpolate_run_avx512 (cell, min_height, ul_easting, x_pixel_size,
+                                    northing, start_sample, end_sample,
+                                    elevation, transmittance, upwelled,
+                                    downwelled);
+            break;
+        case CPU_KERNELS_AVX2:
+            interpolate_run_avx2 (cell, min_height, ul_easting, x_pixel_size,
+                                  northing, start_sample, end_sample,
+                                  elevation, transmittance, upwelled,
+                                  downwelled);
+            break;
+#endif
+        default:
+            interpolate_run_scalar (cell, min_height, ul_easting, x_pixel_size,
+                                    northing, start_sample, end_sample,
+                                    elevation, transmittance, upwelled,
+                                    downwelled);
+            break;
+    }
+}
+
+
+/******************************************************************************
+METHOD:  interpolate_run_float_scalar
+
+PURPOSE: Same as interpolate_run_scalar, in single precision.  The locations
+         are made relative to the first sample of the line, so the distances
+         do not lose precision to the size of the UTM coordinates.
+
+******************************************************************************/
+void interpolate_run_float_scalar
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    int sample;
+    int vertex;
+    int parameter;
+    int height_loc;
+
+    float offset;
+    float dx;
+    float vertex_dx[NUM_CELL_POINTS];
+    float vertex_dy[NUM_CELL_POINTS];
+    float inv_h[NUM_CELL_POINTS];
+    float w[NUM_CELL_POINTS];
+    float total;
+    float parameters[AHP_NUM_PARAMETERS];
+
+    for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+    {
+        vertex_dx[vertex] = cell->easting[vertex] - ul_easting;
+        vertex_dy[vertex] = cell->northing[vertex] - northing;
+    }
+
+    for (sample = start_sample; sample < end_sample; sample++)
+    {
+        offset = sample * x_pixel_size;
+        height_loc = (elevation[sample] - min_height) * AHP_NUM_PARAMETERS;
+
+        /* shepard's method */
+        total = 0.0f;
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            dx = vertex_dx[vertex] - offset;
+            inv_h[vertex] = 1.0f / sqrtf ((dx * dx)
+                                          + (vertex_dy[vertex]
+                                             * vertex_dy[vertex]));
+
+            total += inv_h[vertex];
+        }
+
+        /* Determine the weights for each vertex */
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            w[vertex] = inv_h[vertex] / total;
+        }
+
+        /* For each parameter apply each vertex's weighted value */
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            parameters[parameter] = 0.0f;
+            for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+            {
+                parameters[parameter] +=
+                    (w[vertex]
+                     * cell->float_table[vertex][height_loc + parameter]);
+            }
+        }
+
+        /* convert radiances to W*m^(-2)*sr(-1) */
+        upwelled[sample] = parameters[AHP_UPWELLED_RADIANCE] * 10000.0f;
+        downwelled[sample] = parameters[AHP_DOWNWELLED_RADIANCE] * 10000.0f;
+        transmittance[sample] = parameters[AHP_TRANSMISSION];
+    }
+}
+
+
+#if CPU_KERNELS_DISPATCH
+/******************************************************************************
+METHOD:  interpolate_run_float_avx512
+
+PURPOSE: Same as interpolate_run_float_scalar, sixteen samples at a time.
+         The inverse distances come from the reciprocal square root estimate
+         refined with a Newton-Raphson step.
+
+******************************************************************************/
+AVX512_KERNEL
+void interpolate_run_float_avx512
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    int sample;
+    int vertex;
+    int parameter;
+
+    float vertex_dx[NUM_CELL_POINTS];
+    float vertex_dy[NUM_CELL_POINTS];
+
+    __m512i height_loc;
+    __m512 offset;
+    __m512 dx;
+    __m512 distance_sq;
+    __m512 estimate;
+    __m512 inv_h[NUM_CELL_POINTS];
+    __m512 total;
+    __m512 inv_total;
+    __m512 parameters[AHP_NUM_PARAMETERS];
+
+    const __m512i lanes = _mm512_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7,
+                                             8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i v_min_height = _mm512_set1_epi32 (min_height);
+    const __m512i v_num_parameters = _mm512_set1_epi32 (AHP_NUM_PARAMETERS);
+    const __m512 v_x_pixel_size = _mm512_set1_ps (x_pixel_size);
+    const __m512 v_one = _mm512_set1_ps (1.0f);
+    const __m512 v_half = _mm512_set1_ps (0.5f);
+    const __m512 v_three_halves = _mm512_set1_ps (1.5f);
+    const __m512 v_radiance_scale = _mm512_set1_ps (10000.0f);
+
+    for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+    {
+        vertex_dx[vertex] = cell->easting[vertex] - ul_easting;
+        vertex_dy[vertex] = cell->northing[vertex] - northing;
+    }
+
+    for (sample = start_sample; sample + 16 <= end_sample; sample += 16)
+    {
+        offset = _mm512_mul_ps (_mm512_cvtepi32_ps (_mm512_add_epi32 (
+            _mm512_set1_epi32 (sample), lanes)), v_x_pixel_size);
+
+        height_loc = _mm512_mullo_epi32 (_mm512_sub_epi32 (
+            _mm512_cvtepi16_epi32 (_mm256_loadu_si256 (
+                (__m256i *) &elevation[sample])), v_min_height),
+            v_num_parameters);
+
+        /* shepard's method */
+        total = _mm512_setzero_ps ();
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            dx = _mm512_sub_ps (_mm512_set1_ps (vertex_dx[vertex]), offset);
+            distance_sq = _mm512_add_ps (_mm512_mul_ps (dx, dx),
+                _mm512_set1_ps (vertex_dy[vertex] * vertex_dy[vertex]));
+
+            estimate = _mm512_rsqrt14_ps (distance_sq);
+            inv_h[vertex] = _mm512_mul_ps (estimate, _mm512_sub_ps (
+                v_three_halves, _mm512_mul_ps (_mm512_mul_ps (
+                    v_half, distance_sq), _mm512_mul_ps (estimate,
+                                                         estimate))));
+
+            total = _mm512_add_ps (total, inv_h[vertex]);
+        }
+
+        /* For each parameter apply each vertex's weighted value, gathering
+           the value for each sample's elevation from the tables */
+        inv_total = _mm512_div_ps (v_one, total);
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            parameters[parameter] = _mm512_setzero_ps ();
+            for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+            {
+                parameters[parameter] = _mm512_add_ps (parameters[parameter],
+                    _mm512_mul_ps (_mm512_mul_ps (inv_h[vertex], inv_total),
+                        _mm512_i32gather_ps (height_loc,
+                            &cell->float_table[vertex][parameter],
+                            sizeof (float))));
+            }
+        }
+
+        /* convert radiances to W*m^(-2)*sr(-1) */
+        _mm512_storeu_ps (&upwelled[sample],
+            _mm512_mul_ps (parameters[AHP_UPWELLED_RADIANCE],
+                           v_radiance_scale));
+        _mm512_storeu_ps (&downwelled[sample],
+            _mm512_mul_ps (parameters[AHP_DOWNWELLED_RADIANCE],
+                           v_radiance_scale));
+        _mm512_storeu_ps (&transmittance[sample],
+                          parameters[AHP_TRANSMISSION]);
+    }
+
+    /* Finish the samples which do not fill a vector */
+    interpolate_run_float_scalar (cell, min_height, ul_easting, x_pixel_size,
+                                  northing, sample, end_sample, elevation,
+                                  transmittance, upwelled, downwelled);
+}
+#endif
+
+
+#if CPU_KERNELS_DISPATCH
+/******************************************************************************
+METHOD:  interpolate_run_float_avx2
+
+PURPOSE: Same as interpolate_run_float_scalar, eight samples at a time.  The
+         inverse distances come from the reciprocal square root estimate
+         refined with a Newton-Raphson step.
+
+******************************************************************************/
+AVX2_KERNEL
+void interpolate_run_float_avx2
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    int sample;
+    int vertex;
+    int parameter;
+
+    float vertex_dx[NUM_CELL_POINTS];
+    float vertex_dy[NUM_CELL_POINTS];
+
+    __m256i height_loc;
+    __m256 offset;
+    __m256 dx;
+    __m256 distance_sq;
+    __m256 estimate;
+    __m256 inv_h[NUM_CELL_POINTS];
+    __m256 total;
+    __m256 inv_total;
+    __m256 parameters[AHP_NUM_PARAMETERS];
+
+    const __m256i lanes = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i v_min_height = _mm256_set1_epi32 (min_height);
+    const __m256i v_num_parameters = _mm256_set1_epi32 (AHP_NUM_PARAMETERS);
+    const __m256 v_x_pixel_size = _mm256_set1_ps (x_pixel_size);
+    const __m256 v_one = _mm256_set1_ps (1.0f);
+    const __m256 v_half = _mm256_set1_ps (0.5f);
+    const __m256 v_three_halves = _mm256_set1_ps (1.5f);
+    const __m256 v_radiance_scale = _mm256_set1_ps (10000.0f);
+
+    for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+    {
+        vertex_dx[vertex] = cell->easting[vertex] - ul_easting;
+        vertex_dy[vertex] = cell->northing[vertex] - northing;
+    }
+
+    for (sample = start_sample; sample + 8 <= end_sample; sample += 8)
+    {
+        offset = _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_add_epi32 (
+            _mm256_set1_epi32 (sample), lanes)), v_x_pixel_size);
+
+        height_loc = _mm256_mullo_epi32 (_mm256_sub_epi32 (
+            _mm256_cvtepi16_epi32 (_mm_loadu_si128 (
+                (__m128i *) &elevation[sample])), v_min_height),
+            v_num_parameters);
+
+        /* shepard's method */
+        total = _mm256_setzero_ps ();
+        for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+        {
+            dx = _mm256_sub_ps (_mm256_set1_ps (vertex_dx[vertex]), offset);
+            distance_sq = _mm256_add_ps (_mm256_mul_ps (dx, dx),
+                _mm256_set1_ps (vertex_dy[vertex] * vertex_dy[vertex]));
+
+            estimate = _mm256_rsqrt_ps (distance_sq);
+            inv_h[vertex] = _mm256_mul_ps (estimate, _mm256_sub_ps (
+                v_three_halves, _mm256_mul_ps (_mm256_mul_ps (
+                    v_half, distance_sq), _mm256_mul_ps (estimate,
+                                                         estimate))));
+
+            total = _mm256_add_ps (total, inv_h[vertex]);
+        }
+
+        /* For each parameter apply each vertex's weighted value, gathering
+           the value for each sample's elevation from the tables */
+        inv_total = _mm256_div_ps (v_one, total);
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            parameters[parameter] = _mm256_setzero_ps ();
+            for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+            {
+                parameters[parameter] = _mm256_add_ps (parameters[parameter],
+                    _mm256_mul_ps (_mm256_mul_ps (inv_h[vertex], inv_total),
+                        _mm256_i32gather_ps (
+                            &cell->float_table[vertex][parameter],
+                            height_loc, sizeof (float))));
+            }
+        }
+
+        /* convert radiances to W*m^(-2)*sr(-1) */
+        _mm256_storeu_ps (&upwelled[sample],
+            _mm256_mul_ps (parameters[AHP_UPWELLED_RADIANCE],
+                           v_radiance_scale));
+        _mm256_storeu_ps (&downwelled[sample],
+            _mm256_mul_ps (parameters[AHP_DOWNWELLED_RADIANCE],
+                           v_radiance_scale));
+        _mm256_storeu_ps (&transmittance[sample],
+                          parameters[AHP_TRANSMISSION]);
+    }
+
+    /* Finish the samples which do not fill a vector */
+    interpolate_run_float_scalar (cell, min_height, ul_easting, x_pixel_size,
+                                  northing, sample, end_sample, elevation,
+                                  transmittance, upwelled, downwelled);
+}
+#endif
+
+
+/******************************************************************************
+METHOD:  interpolate_run_float
+
+PURPOSE: Same as interpolate_run, computed in single precision from the
+         single precision height tables.  The kernel variant selected for
+         the processor is used.
+
+******************************************************************************/
+void interpolate_run_float
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    switch (cpu_kernels ())
+    {
+#if CPU_KERNELS_DISPATCH
+        case CPU_KERNELS_AVX512:
+            interpolate_run_float_avx512 (cell, min_height, ul_easting,
+                                          x_pixel_size, northing, start_sample,
+                                          end_sample, elevation, transmittance,
+                                          upwelled, downwelled);
+            break;
+        case CPU_KERNELS_AVX2:
+            interpolate_run_float_avx2 (cell, min_height, ul_easting,
+                                        x_pixel_size, northing, start_sample,
+                                        end_sample, elevation, transmittance,
+                                        upwelled, downwelled);
+            break;
+#endif
+        default:
+            interpolate_run_float_scalar (cell, min_height, ul_easting,
+                                          x_pixel_size, northing, start_sample,
+                                          end_sample, elevation, transmittance,
+                                          upwelled, downwelled);
+            break;
+    }
+}
+
+
+/******************************************************************************
+METHOD:  shepard_point_weights
+
+PURPOSE: Determine the weight of each vertex of a cell for a location using
+         shepard's method, the same weights interpolate_run uses for a
+         sample at that location.
+
+******************************************************************************/
+void shepard_point_weights
+(
+    int *cell_vertices,       /* I: the point at each vertex of the cell */
+    double *vertex_easting,   /* I: UTM easting of each vertex */
+    double *vertex_northing,  /* I: UTM northing of each vertex */
+    double easting,           /* I: easting of the location */
+    double northing,          /* I: northing of the location */
+    POINT_WEIGHTS *weights    /* O: the weight of each vertex */
+)
+{
+    int vertex;
+
+    double inv_h[NUM_CELL_POINTS];
+    double total;
+
+    /* shepard's method */
+    total = 0.0;
+    for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+    {
+        inv_h[vertex] = 1.0 / sqrt (((vertex_easting[vertex] - easting)
+                                     * (vertex_easting[vertex] - easting))
+                                    +
+                                    ((vertex_northing[vertex] - northing)
+                                     * (vertex_northing[vertex] - northing)));
+
+        total += inv_h[vertex];
+    }
+
+    /* Determine the weights for each vertex */
+    weights->count = NUM_CELL_POINTS;
+    for (vertex = 0; vertex < NUM_CELL_POINTS; vertex++)
+    {
+        weights->point[vertex] = cell_vertices[vertex];
+        weights->weight[vertex] = inv_h[vertex] / total;
+    }
+}
+
+
+/******************************************************************************
+METHOD:  find_weight_point
+
+PURPOSE: Find a point within a set of weights.
+
+RETURN: type = int
+    Value  Description
+    -----  -------------------------------------------------------------------
+    index  The index of the point within the weights, -1 if not used.
+******************************************************************************/
+int find_weight_point
+(
+    int *points,              /* I: the points used */
+    int count,                /* I: number of points used */
+    int point                 /* I: the point to find */
+)
+{
+    int index;
+
+    for (index = 0; index < count; index++)
+    {
+        if (points[index] == point)
+            return index;
+    }
+
+    return -1;
+}
+
+
+/******************************************************************************
+METHOD:  blend_point_weights
+
+PURPOSE: Linearly interpolate between two sets of weights, with a fraction of
+         0.0 providing the first and 1.0 the second.  A point only used by
+         one of them has no weight in the other.
+
+******************************************************************************/
+void blend_point_weights
+(
+    POINT_WEIGHTS *first,     /* I: the weights at a fraction of 0.0 */
+    POINT_WEIGHTS *second,    /* I: the weights at a fraction of 1.0 */
+    double fraction,          /* I: how far to go towards the second */
+    POINT_WEIGHTS *blended    /* O: the interpolated weights */
+)
+{
+    int index;
+    int other;
+    double second_weight;
+
+    if (fraction == 0.0)
+    {
+        *blended = *first;
+        return;
+    }
+
+    blended->count = 0;
+    for (index = 0; index < first->count; index++)
+    {
+        other = find_weight_point (second->point, second->count,
+                                   first->point[index]);
+        second_weight = (other < 0) ? 0.0 : second->weight[other];
+
+        blended->point[blended->count] = first->point[index];
+        blended->weight[blended->count] = first->weight[index]
+            + fraction * (second_weight - first->weight[index]);
+        blended->count++;
+    }
+
+    for (index = 0; index < second->count; index++)
+    {
+        if (find_weight_point (first->point, first->count,
+                               second->point[index]) < 0)
+        {
+            blended->point[blended->count] = second->point[index];
+            blended->weight[blended->count] =
+                fraction * second->weight[index];
+            blended->count++;
+        }
+    }
+}
+
+
+/******************************************************************************
+METHOD:  merge_lattice_interval
+
+PURPOSE: Combine the points used by the two lattice nodes either side of a
+         run of samples, with the weight of each point at each node.
+
+******************************************************************************/
+void merge_lattice_interval
+(
+    POINT_WEIGHTS *first,       /* I: the weights at the first node */
+    POINT_WEIGHTS *second,      /* I: the weights at the second node */
+    LATTICE_INTERVAL *interval  /* O: the points of both nodes, without the
+                                      height tables */
+)
+{
+    int index;
+    int other;
+
+    interval->count = 0;
+    for (index = 0; index < first->count; index++)
+    {
+        other = find_weight_point (second->point, second->count,
+                                   first->point[index]);
+
+        interval->point[interval->count] = first->point[index];
+        interval->weight[interval->count] = first->weight[index];
+        interval->next_weight[interval->count] =
+            (other < 0) ? 0.0 : second->weight[other];
+        interval->count++;
+    }
+
+    for (index = 0; index < second->count; index++)
+    {
+        if (find_weight_point (first->point, first->count,
+                               second->point[index]) < 0)
+        {
+            interval->point[interval->count] = second->point[index];
+            interval->weight[interval->count] = 0.0;
+            interval->next_weight[interval->count] = second->weight[index];
+            interval->count++;
+        }
+    }
+}
+
+
+/******************************************************************************
+METHOD:  interpolate_lattice_run_scalar
+
+PURPOSE: Interpolate the parameters to each sample of a run between two
+         lattice nodes, one sample at a time.  The weight of each point is
+         linearly interpolated between the nodes, and applied to the point's
+         parameters at the sample's own elevation.
+
+******************************************************************************/
+void interpolate_lattice_run_scalar
+(
+    LATTICE_INTERVAL *interval, /* I: the points around the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    int node_sample,        /* I: sample of the first node */
+    int node_span,          /* I: samples from the first node to the second,
+                                  0 when they are the same node */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    int sample;
+    int index;
+    int parameter;
+    int height_loc;
+
+    double fraction;
+    double w;
+    double parameters[AHP_NUM_PARAMETERS];
+
+    for (sample = start_sample; sample < end_sample; sample++)
+    {
+        fraction = 0.0;
+        if (node_span > 0)
+            fraction = (double) (sample - node_sample) / node_span;
+
+        height_loc = (elevation[sample] - min_height) * AHP_NUM_PARAMETERS;
+
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            parameters[parameter] = 0.0;
+        }
+
+        /* Apply each point's weight at the sample to its values at the
+           sample's elevation */
+        for (index = 0; index < interval->count; index++)
+        {
+            w = interval->weight[index] + fraction
+                * (interval->next_weight[index] - interval->weight[index]);
+
+            for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+            {
+                parameters[parameter] +=
+                    (w * interval->table[index][height_loc + parameter]);
+            }
+        }
+
+        /* convert radiances to W*m^(-2)*sr(-1) */
+        upwelled[sample] = parameters[AHP_UPWELLED_RADIANCE] * 10000.0;
+        downwelled[sample] = parameters[AHP_DOWNWELLED_RADIANCE] * 10000.0;
+        transmittance[sample] = parameters[AHP_TRANSMISSION];
+    }
+}
+
+
+#if CPU_KERNELS_DISPATCH
+/******************************************************************************
+METHOD:  interpolate_lattice_run_avx512
+
+PURPOSE: Same as interpolate_lattice_run_scalar, eight samples at a time.  The
+         operations are performed in the same order as the scalar code, so
+         the results are identical.
+
+******************************************************************************/
+AVX512_KERNEL
+void interpolate_lattice_run_avx512
+(
+    LATTICE_INTERVAL *interval, /* I: the points around the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    int node_sample,        /* I: sample of the first node */
+    int node_span,          /* I: samples from the first node to the second,
+                                  0 when they are the same node */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    int sample;
+    int index;
+    int parameter;
+
+    __m256i height_loc;
+    __m512d fraction;
+    __m512d w;
+    __m512d parameters[AHP_NUM_PARAMETERS];
+
+    const __m256i lanes = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i v_min_height = _mm256_set1_epi32 (min_height);
+    const __m256i v_num_parameters = _mm256_set1_epi32 (AHP_NUM_PARAMETERS);
+    const __m512d v_node_span = _mm512_set1_pd ((double) node_span);
+    const __m512d v_radiance_scale = _mm512_set1_pd (10000.0);
+
+    for (sample = start_sample; sample + 8 <= end_sample; sample += 8)
+    {
+        fraction = _mm512_setzero_pd ();
+        if (node_span > 0)
+        {
+            fraction = _mm512_div_pd (_mm512_cvtepi32_pd (_mm256_add_epi32 (
+                _mm256_set1_epi32 (sample - node_sample), lanes)),
+                v_node_span);
+        }
+
+        height_loc = _mm256_mullo_epi32 (_mm256_sub_epi32 (
+            _mm256_cvtepi16_epi32 (_mm_loadu_si128 (
+                (__m128i *) &elevation[sample])), v_min_height),
+            v_num_parameters);
+
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            parameters[parameter] = _mm512_setzero_pd ();
+        }
+
+        /* Apply each point's weight at the samples to its values at the
+           samples' elevations, gathered from its table */
+        for (index = 0; index < interval->count; index++)
+        {
+            w = _mm512_add_pd (_mm512_set1_pd (interval->weight[index]),
+                _mm512_mul_pd (fraction, _mm512_set1_pd (
+                    interval->next_weight[index]
+                    - interval->weight[index])));
+
+            for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+            {
+                parameters[parameter] = _mm512_add_pd (parameters[parameter],
+                    _mm512_mul_pd (w, _mm512_i32gather_pd (
+                        height_loc, &interval->table[index][parameter],
+                        sizeof (double))));
+            }
+        }
+
+        /* convert radiances to W*m^(-2)*sr(-1) */
+        _mm256_storeu_ps (&upwelled[sample], _mm512_cvtpd_ps (
+            _mm512_mul_pd (parameters[AHP_UPWELLED_RADIANCE],
+                           v_radiance_scale)));
+        _mm256_storeu_ps (&downwelled[sample], _mm512_cvtpd_ps (
+            _mm512_mul_pd (parameters[AHP_DOWNWELLED_RADIANCE],
+                           v_radiance_scale)));
+        _mm256_storeu_ps (&transmittance[sample],
+                          _mm512_cvtpd_ps (parameters[AHP_TRANSMISSION]));
+    }
+
+    /* Finish the samples which do not fill a vector */
+    interpolate_lattice_run_scalar (interval, min_height, node_sample,
+                                    node_span, sample, end_sample, elevation,
+                                    transmittance, upwelled, downwelled);
+}
+#endif
+
+
+#if CPU_KERNELS_DISPATCH
+/******************************************************************************
+METHOD:  interpolate_lattice_run_avx2
+
+PURPOSE: Same as interpolate_lattice_run_scalar, four samples at a time.  The
+         operations are performed in the same order as the scalar code, so
+         the results are identical.
+
+******************************************************************************/
+AVX2_KERNEL
+void interpolate_lattice_run_avx2
+(
+    LATTICE_INTERVAL *interval, /* I: the points around the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    int node_sample,        /* I: sample of the first node */
+    int node_span,          /* I: samples from the first node to the second,
+                                  0 when they are the same node */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    int sample;
+    int index;
+    int parameter;
+
+    __m128i height_loc;
+    __m256d fraction;
+    __m256d w;
+    __m256d parameters[AHP_NUM_PARAMETERS];
+
+    const __m128i lanes = _mm_setr_epi32 (0, 1, 2, 3);
+    const __m128i v_min_height = _mm_set1_epi32 (min_height);
+    const __m128i v_num_parameters = _mm_set1_epi32 (AHP_NUM_PARAMETERS);
+    const __m256d v_node_span = _mm256_set1_pd ((double) node_span);
+    const __m256d v_radiance_scale = _mm256_set1_pd (10000.0);
+
+    for (sample = start_sample; sample + 4 <= end_sample; sample += 4)
+    {
+        fraction = _mm256_setzero_pd ();
+        if (node_span > 0)
+        {
+            fraction = _mm256_div_pd (_mm256_cvtepi32_pd (_mm_add_epi32 (
+                _mm_set1_epi32 (sample - node_sample), lanes)),
+                v_node_span);
+        }
+
+        height_loc = _mm_mullo_epi32 (_mm_sub_epi32 (
+            _mm_cvtepi16_epi32 (_mm_loadl_epi64 (
+                (__m128i *) &elevation[sample])), v_min_height),
+            v_num_parameters);
+
+        for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+        {
+            parameters[parameter] = _mm256_setzero_pd ();
+        }
+
+        /* Apply each point's weight at the samples to its values at the
+           samples' elevations, gathered from its table */
+        for (index = 0; index < interval->count; index++)
+        {
+            w = _mm256_add_pd (_mm256_set1_pd (interval->weight[index]),
+                _mm256_mul_pd (fraction, _mm256_set1_pd (
+                    interval->next_weight[index]
+                    - interval->weight[index])));
+
+            for (parameter = 0; parameter < AHP_NUM_PARAMETERS; parameter++)
+            {
+                parameters[parameter] = _mm256_add_pd (parameters[parameter],
+                    _mm256_mul_pd (w, _mm256_i32gather_pd (
+                        &interval->table[index][parameter], height_loc,
+                        sizeof (double))));
+            }
+        }
+
+        /* convert radiances to W*m^(-2)*sr(-1) */
+        _mm_storeu_ps (&upwelled[sample], _mm256_cvtpd_ps (
+            _mm256_mul_pd (parameters[AHP_UPWELLED_RADIANCE],
+                           v_radiance_scale)));
+        _mm_storeu_ps (&downwelled[sample], _mm256_cvtpd_ps (
+            _mm256_mul_pd (parameters[AHP_DOWNWELLED_RADIANCE],
+                           v_radiance_scale)));
+        _mm_storeu_ps (&transmittance[sample],
+                       _mm256_cvtpd_ps (parameters[AHP_TRANSMISSION]));
+    }
+
+    /* Finish the samples which do not fill a vector */
+    interpolate_lattice_run_scalar (interval, min_height, node_sample,
+                                    node_span, sample, end_sample, elevation,
+                                    transmittance, upwelled, downwelled);
+}
+#endif
+
+
+/******************************************************************************
+METHOD:  interpolate_lattice_run
+
+PURPOSE: Interpolate the parameters to each sample of a run between two
+         lattice nodes.  The weight of each point is linearly interpolated
+         between the nodes, and applied to the point's parameters at the
+         sample's own elevation.  The kernel variant selected for the
+         processor is used.
+
+******************************************************************************/
+void interpolate_lattice_run
+(
+    LATTICE_INTERVAL *interval, /* I: the points around the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    int node_sample,        /* I: sample of the first node */
+    int node_span,          /* I: samples from the first node to the second,
+                                  0 when they are the same node */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+)
+{
+    switch (cpu_kernels ())
+    {
+#if CPU_KERNELS_DISPATCH
+        case CPU_KERNELS_AVX512:
+            interpolate_lattice_run_avx512 (interval, min_height, node_sample,
+                                            node_span, start_sample,
+                                            end_sample, elevation,
+                                            transmittance, upwelled,
+                                            downwelled);
+            break;
+        case CPU_KERNELS_AVX2:
+            interpolate_lattice_run_avx2 (interval, min_height, node_sample,
+                                          node_span, start_sample, end_sample,
+                                          elevation, transmittance, upwelled,
+                                          downwelled);
+            break;
+#endif
+        default:
+            interpolate_lattice_run_scalar (interval, min_height, node_sample,
+                                            node_span, start_sample,
+                                            end_sample, elevation,
+                                            transmittance, upwelled,
+                                            downwelled);
+            break;
+    }
+}
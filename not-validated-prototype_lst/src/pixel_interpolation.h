@@ -0,0 +1,233 @@
+#ifndef PIXEL_INTERPOLATION_H
+#define PIXEL_INTERPOLATION_H
+
+
+#include <stdint.h>
+
+
+#include "const.h"
+#include "input.h"
+
+
+/* Alignment used for the arrays the interpolation kernels read */
+#define PIXEL_ALIGNMENT 64
+
+
+/* Defines index locations in the vertices array for the current cell to be
+   used for interpolation of the pixel */
+typedef enum
+{
+    LL_POINT,
+    UL_POINT,
+    UR_POINT,
+    LR_POINT,
+    NUM_CELL_POINTS
+} CELL_POINTS;
+
+
+/* Defines index locations for the parameters in the at_height array */
+typedef enum
+{
+    AHP_TRANSMISSION,
+    AHP_UPWELLED_RADIANCE,
+    AHP_DOWNWELLED_RADIANCE,
+    AHP_NUM_PARAMETERS
+} AT_HEIGHT_PARAMETERS;
+
+
+/* The MODTRAN results rearranged so that the NUM_ELEVATIONS heights of a
+   point, and each of its parameters, are contiguous */
+typedef struct
+{
+    double *height;                        /* Heights for each point */
+    double *parameter[AHP_NUM_PARAMETERS]; /* Parameters for each point */
+} POINT_RESULTS;
+
+
+/* Holds the atmospheric parameters interpolated to each whole meter of
+   elevation found in the scene, for each point used by the scene's pixels.
+   The three parameters for an elevation are next to each other, since a
+   pixel always uses all three. */
+typedef struct
+{
+    int min_height;  /* Lowest elevation in the scene (meters) */
+    int num_heights; /* Number of whole meter elevations in the scene */
+    double **tables; /* One table per point, NULL until the point is first
+                        used */
+    float **float_tables; /* Single precision copies of the tables, NULL
+                             until the point is first used in single
+                             precision */
+} HEIGHT_TABLES;
+
+
+/* The vertices of the cell shared by a run of samples along a line */
+typedef struct
+{
+    double easting[NUM_CELL_POINTS];  /* UTM easting of each vertex */
+    double northing[NUM_CELL_POINTS]; /* UTM northing of each vertex */
+    double *table[NUM_CELL_POINTS];   /* Height table of each vertex */
+    float *float_table[NUM_CELL_POINTS]; /* Single precision height table of
+                                            each vertex */
+} RUN_CELL;
+
+
+/* Largest number of points a location between the lattice nodes is
+   interpolated from, the cell vertices of the four nodes around it */
+#define MAX_LATTICE_POINTS (4 * NUM_CELL_POINTS)
+
+
+/* The points, and their weights, which interpolate the parameters to a
+   location */
+typedef struct
+{
+    int count;                           /* Number of points used */
+    int point[MAX_LATTICE_POINTS];       /* Index of each point */
+    double weight[MAX_LATTICE_POINTS];   /* Weight of each point */
+} POINT_WEIGHTS;
+
+
+/* The points used by the samples between two lattice nodes along a line,
+   with their weights at each of the two nodes */
+typedef struct
+{
+    int count;                           /* Number of points used */
+    int point[MAX_LATTICE_POINTS];       /* Index of each point */
+    double *table[MAX_LATTICE_POINTS];   /* Height table of each point */
+    double weight[MAX_LATTICE_POINTS];   /* Weight at the first node */
+    double next_weight[MAX_LATTICE_POINTS]; /* Weight at the second node */
+} LATTICE_INTERVAL;
+
+
+int allocate_point_results
+(
+    double **modtran_results, /* I: results from MODTRAN runs */
+    int num_points,           /* I: number of points */
+    POINT_RESULTS *results    /* O: the rearranged results */
+);
+
+
+void free_point_results
+(
+    POINT_RESULTS *results /* I/O: the rearranged results */
+);
+
+
+void interpolate_to_height
+(
+    POINT_RESULTS *results, /* I: results from MODTRAN runs */
+    int point,              /* I: the point to interpolate for */
+    double interpolate_to,  /* I: current landsat pixel height */
+    double *at_height       /* O: interpolated height for point */
+);
+
+
+int allocate_height_tables
+(
+    int num_points,           /* I: number of points */
+    int min_height,           /* I: lowest elevation of the scene */
+    int max_height,           /* I: highest elevation of the scene */
+    HEIGHT_TABLES *heights    /* O: the height tables */
+);
+
+
+void free_height_tables
+(
+    int num_points,        /* I: number of points */
+    HEIGHT_TABLES *heights /* I/O: the height tables */
+);
+
+
+double *height_table
+(
+    POINT_RESULTS *results, /* I: results from MODTRAN runs */
+    int point,              /* I: the point to provide the table for */
+    HEIGHT_TABLES *heights  /* I/O: the height tables */
+);
+
+
+float *height_table_float
+(
+    POINT_RESULTS *results, /* I: results from MODTRAN runs */
+    int point,              /* I: the point to provide the table for */
+    HEIGHT_TABLES *heights  /* I/O: the height tables */
+);
+
+
+void interpolate_run
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+);
+
+
+void interpolate_run_float
+(
+    RUN_CELL *cell,         /* I: the cell shared by the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    double ul_easting,      /* I: easting of the first sample of the line */
+    float x_pixel_size,     /* I: easting change for each sample */
+    double northing,        /* I: northing of the line */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+);
+
+
+void shepard_point_weights
+(
+    int *cell_vertices,       /* I: the point at each vertex of the cell */
+    double *vertex_easting,   /* I: UTM easting of each vertex */
+    double *vertex_northing,  /* I: UTM northing of each vertex */
+    double easting,           /* I: easting of the location */
+    double northing,          /* I: northing of the location */
+    POINT_WEIGHTS *weights    /* O: the weight of each vertex */
+);
+
+
+void blend_point_weights
+(
+    POINT_WEIGHTS *first,     /* I: the weights at a fraction of 0.0 */
+    POINT_WEIGHTS *second,    /* I: the weights at a fraction of 1.0 */
+    double fraction,          /* I: how far to go towards the second */
+    POINT_WEIGHTS *blended    /* O: the interpolated weights */
+);
+
+
+void merge_lattice_interval
+(
+    POINT_WEIGHTS *first,       /* I: the weights at the first node */
+    POINT_WEIGHTS *second,      /* I: the weights at the second node */
+    LATTICE_INTERVAL *interval  /* O: the points of both nodes, without the
+                                      height tables */
+);
+
+
+void interpolate_lattice_run
+(
+    LATTICE_INTERVAL *interval, /* I: the points around the samples */
+    int min_height,         /* I: elevation of the first table entry */
+    int node_sample,        /* I: sample of the first node */
+    int node_span,          /* I: samples from the first node to the second,
+                                  0 when they are the same node */
+    int start_sample,       /* I: first sample of the run */
+    int end_sample,         /* I: sample after the last sample of the run */
+    int16_t *elevation,     /* I: elevation for the line in meters */
+    float *transmittance,   /* O: transmittance for the line */
+    float *upwelled,        /* O: upwelled radiance for the line */
+    float *downwelled       /* O: downwelled radiance for the line */
+);
+
+
+#endif /* PIXEL_INTERPOLATION_H */
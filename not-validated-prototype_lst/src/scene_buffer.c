@@ -0,0 +1,155 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "scene_buffer.h"
+
+
+/* Size of the explicit hugepages, the lengths of their mappings must be a
+   multiple of it */
+#define HUGEPAGE_SIZE ((size_t) 2 * 1024 * 1024)
+
+/* The size of each mapping is kept ahead of the buffer, in a header the size
+   of a cache line so the buffer stays aligned */
+#define SCENE_BUFFER_HEADER_SIZE ((size_t) 64)
+
+
+/* How the pages of the buffers allocated from now on are backed */
+static Scene_Pages_t scene_pages = SCENE_PAGES_DEFAULT;
+
+
+/*****************************************************************************
+METHOD:  set_scene_buffer_pages
+
+PURPOSE: Sets how the pages of the scene sized buffers allocated from now on
+         are backed.
+
+RETURN: None
+
+*****************************************************************************/
+void set_scene_buffer_pages
+(
+    Scene_Pages_t pages /* I: how to back the pages of the buffers */
+)
+{
+    scene_pages = pages;
+}
+
+
+/*****************************************************************************
+METHOD:  allocate_scene_buffer
+
+PURPOSE: Allocates a zeroed buffer of lines for the pixel processing.  The
+         pages are first touched in parallel, so the memory of each line is
+         placed on the NUMA node of the thread that touched it.  Otherwise
+         the pages of a buffer would all be placed on the node of whichever
+         single thread first reads into it.
+
+NOTE: The lines are touched round robin, a line at a time, the same
+      schedule(static, 1) the pixel processing hands them out with, so each
+      line is placed on the node of the thread which later processes it.
+      The team must be the same size for both, which it is unless the
+      number of threads changes in between.  With hugepages a page holds
+      many lines, so they are only placed as finely as the pages allow.
+
+NOTE: Explicit hugepages need to be reserved by the administrator, through
+      /proc/sys/vm/nr_hugepages.  When the reserve runs out the regular
+      pages are used from then on.
+
+NOTE: The pages are mapped directly, instead of through calloc, so the
+      hugepage backing can be requested for them and they are not touched
+      before the parallel first touch.
+
+RETURN: void * - the buffer, NULL when it could not be allocated
+
+*****************************************************************************/
+void *allocate_scene_buffer
+(
+    int lines,       /* I: number of lines in the buffer */
+    size_t line_size /* I: size of a line in bytes */
+)
+{
+    char FUNC_NAME[] = "allocate_scene_buffer";
+
+    int line;
+
+    size_t size = SCENE_BUFFER_HEADER_SIZE + (size_t) lines * line_size;
+
+    char *mapping = MAP_FAILED;
+    char *buffer;
+
+#ifdef MAP_HUGETLB
+    if (scene_pages == SCENE_PAGES_EXPLICIT)
+    {
+        size = (size + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE * HUGEPAGE_SIZE;
+        mapping = mmap (NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            /* Only report it once */
+            WARNING_MESSAGE ("No explicit hugepages are available, using"
+                             " regular pages", FUNC_NAME);
+            scene_pages = SCENE_PAGES_DEFAULT;
+        }
+    }
+#endif
+
+    if (mapping == MAP_FAILED)
+    {
+        mapping = mmap (NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+            return NULL;
+
+#ifdef MADV_HUGEPAGE
+        if (scene_pages == SCENE_PAGES_TRANSPARENT)
+        {
+            /* Only a request, the kernel may still use regular pages */
+            madvise (mapping, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    *(size_t *) mapping = size;
+    buffer = mapping + SCENE_BUFFER_HEADER_SIZE;
+
+    /* The pages are already zero, writing the zeros places them */
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static, 1)
+#endif
+    for (line = 0; line < lines; line++)
+    {
+        memset (buffer + (size_t) line * line_size, 0, line_size);
+    }
+
+    return buffer;
+}
+
+
+/*****************************************************************************
+METHOD:  free_scene_buffer
+
+PURPOSE: Frees a buffer from allocate_scene_buffer.
+
+RETURN: None
+
+*****************************************************************************/
+void free_scene_buffer
+(
+    void *buffer /* I: buffer to free, may be NULL */
+)
+{
+    char *mapping;
+
+    if (buffer == NULL)
+        return;
+
+    mapping = (char *) buffer - SCENE_BUFFER_HEADER_SIZE;
+    munmap (mapping, *(size_t *) mapping);
+}
@@ -0,0 +1,39 @@
+
+#ifndef SCENE_BUFFER_H
+#define SCENE_BUFFER_H
+
+
+#include <stddef.h>
+
+
+/* How the pages of the scene sized buffers are backed */
+typedef enum
+{
+    SCENE_PAGES_DEFAULT,     /* Regular pages */
+    SCENE_PAGES_TRANSPARENT, /* Transparent hugepages are requested */
+    SCENE_PAGES_EXPLICIT,    /* Hugepages from the reserved pool, regular
+                                pages when none are available */
+    SCENE_PAGES_MAX
+} Scene_Pages_t;
+
+
+void set_scene_buffer_pages
+(
+    Scene_Pages_t pages /* I: how to back the pages of the buffers */
+);
+
+
+void *allocate_scene_buffer
+(
+    int lines,       /* I: number of lines in the buffer */
+    size_t line_size /* I: size of a line in bytes */
+);
+
+
+void free_scene_buffer
+(
+    void *buffer /* I: buffer to free, may be NULL */
+);
+
+
+#endif /* SCENE_BUFFER_H */
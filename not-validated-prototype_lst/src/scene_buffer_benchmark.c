@@ -0,0 +1,260 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+
+#include "const.h"
+#include "utilities.h"
+#include "scene_buffer.h"
+
+
+/* The bands of a strip used by the benchmark, the thermal band is read and
+   the three parameter bands are written, as in the pixel processing */
+#define BENCHMARK_BANDS 4
+
+/* Ways of allocating the bands which are compared */
+typedef enum
+{
+    BENCHMARK_CALLOC,
+    BENCHMARK_SCENE_BUFFER,
+    BENCHMARK_TRANSPARENT,
+    BENCHMARK_EXPLICIT,
+    BENCHMARK_NUM_ALLOCATIONS
+} BENCHMARK_ALLOCATION;
+
+static char *allocation_names[BENCHMARK_NUM_ALLOCATIONS] =
+{
+    "calloc",
+    "first-touch",
+    "transparent",
+    "explicit"
+};
+
+
+/*****************************************************************************
+METHOD:  usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN: None
+
+*****************************************************************************/
+void usage ()
+{
+    printf ("Benchmark of the strip buffer allocation\n");
+    printf ("\n");
+    printf ("usage: scene_buffer_benchmark"
+            " [lines [samples [max_threads [repeats]]]]\n");
+    printf ("\n");
+    printf ("Processes a strip of lines, allocated each way, with 1, 2, 4,"
+            " ... threads up to max_threads, and prints the seconds taken."
+            "  The thermal band is read by one thread, as the strip reads"
+            " do, which first touches it when allocated by calloc.\n");
+    printf ("(defaults are 8000 lines, 8000 samples, the OpenMP maximum"
+            " threads, and 10 repeats)\n");
+}
+
+
+/*****************************************************************************
+METHOD:  seconds_since
+
+PURPOSE: Determine the time passed since the specified start.
+
+RETURN: double - the seconds passed
+
+*****************************************************************************/
+double seconds_since
+(
+    struct timespec *start /* I: the start time */
+)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec)
+           + (now.tv_nsec - start->tv_nsec) * 1.0e-9;
+}
+
+
+/*****************************************************************************
+METHOD:  process_strip
+
+PURPOSE: Processes the lines of a strip the way the pixel processing
+         distributes them, reading the thermal band and writing the
+         parameter bands.
+
+RETURN: None
+
+*****************************************************************************/
+void process_strip
+(
+    float **bands, /* I/O: the bands of the strip */
+    int lines,     /* I: number of lines */
+    int samples    /* I: number of samples in a line */
+)
+{
+    int line;
+    int sample;
+
+#ifdef _OPENMP
+    #pragma omp parallel for private(sample) schedule(static, 1)
+#endif
+    for (line = 0; line < lines; line++)
+    {
+        float *thermal = &bands[0][(size_t) line * samples];
+        float *transmittance = &bands[1][(size_t) line * samples];
+        float *upwelled = &bands[2][(size_t) line * samples];
+        float *downwelled = &bands[3][(size_t) line * samples];
+
+        for (sample = 0; sample < samples; sample++)
+        {
+            transmittance[sample] = 0.9f * thermal[sample];
+            upwelled[sample] = 0.1f * thermal[sample] + 0.5f;
+            downwelled[sample] = 0.2f * thermal[sample] + 1.0f;
+        }
+    }
+}
+
+
+/*****************************************************************************
+METHOD:  scene_buffer_benchmark
+
+PURPOSE: Times the processing of a strip with the bands allocated each way,
+         for a range of thread counts.
+
+RETURN VALUE:
+    Type = int
+    Value           Description
+    -----           -----------
+    EXIT_FAILURE    An error was encountered
+    EXIT_SUCCESS    The benchmark completed
+
+*****************************************************************************/
+int main (int argc, char *argv[])
+{
+    char FUNC_NAME[] = "scene_buffer_benchmark";
+
+    int lines = 8000;
+    int samples = 8000;
+    int max_threads = 1;
+    int repeats = 10;
+    int threads;
+    int allocation;
+    int band;
+    int repeat;
+
+    double seconds[BENCHMARK_NUM_ALLOCATIONS];
+
+    float *bands[BENCHMARK_BANDS];
+
+    struct timespec start;
+
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads ();
+#endif
+
+    if (argc > 1 && strcmp (argv[1], "--help") == 0)
+    {
+        usage ();
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1)
+        lines = atoi (argv[1]);
+    if (argc > 2)
+        samples = atoi (argv[2]);
+    if (argc > 3)
+        max_threads = atoi (argv[3]);
+    if (argc > 4)
+        repeats = atoi (argv[4]);
+    if (lines <= 0 || samples <= 0 || max_threads <= 0 || repeats <= 0)
+    {
+        usage ();
+        RETURN_ERROR ("The arguments must be positive", FUNC_NAME,
+                      EXIT_FAILURE);
+    }
+
+    printf ("%d lines, %d samples, %d repeats, seconds per strip\n",
+            lines, samples, repeats);
+    printf ("threads");
+    for (allocation = 0; allocation < BENCHMARK_NUM_ALLOCATIONS;
+         allocation++)
+    {
+        printf (" %12s", allocation_names[allocation]);
+    }
+    printf ("\n");
+
+    for (threads = 1; threads <= max_threads; threads *= 2)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads (threads);
+#endif
+
+        for (allocation = 0; allocation < BENCHMARK_NUM_ALLOCATIONS;
+             allocation++)
+        {
+            if (allocation == BENCHMARK_TRANSPARENT)
+                set_scene_buffer_pages (SCENE_PAGES_TRANSPARENT);
+            else if (allocation == BENCHMARK_EXPLICIT)
+                set_scene_buffer_pages (SCENE_PAGES_EXPLICIT);
+            else
+                set_scene_buffer_pages (SCENE_PAGES_DEFAULT);
+
+            for (band = 0; band < BENCHMARK_BANDS; band++)
+            {
+                if (allocation == BENCHMARK_CALLOC)
+                {
+                    bands[band] = calloc ((size_t) lines * samples,
+                                          sizeof (float));
+                }
+                else
+                {
+                    bands[band] = allocate_scene_buffer (
+                                      lines, samples * sizeof (float));
+                }
+                if (bands[band] == NULL)
+                {
+                    RETURN_ERROR ("Allocating the bands", FUNC_NAME,
+                                  EXIT_FAILURE);
+                }
+            }
+
+            /* The thermal band is read by a single thread, which first
+               touches the calloc pages */
+            memset (bands[0], 0, (size_t) lines * samples * sizeof (float));
+
+            /* Once to settle, then timed */
+            process_strip (bands, lines, samples);
+            clock_gettime (CLOCK_MONOTONIC, &start);
+            for (repeat = 0; repeat < repeats; repeat++)
+                process_strip (bands, lines, samples);
+            seconds[allocation] = seconds_since (&start) / repeats;
+
+            for (band = 0; band < BENCHMARK_BANDS; band++)
+            {
+                if (allocation == BENCHMARK_CALLOC)
+                    free (bands[band]);
+                else
+                    free_scene_buffer (bands[band]);
+            }
+        }
+
+        /* Printed once the row is done, so warnings do not break it up */
+        printf ("%7d", threads);
+        for (allocation = 0; allocation < BENCHMARK_NUM_ALLOCATIONS;
+             allocation++)
+        {
+            printf (" %12.4f", seconds[allocation]);
+        }
+        printf ("\n");
+        fflush (stdout);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,291 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "input.h"
+#include "intermediate_data.h"
+#include "surface_temperature.h"
+#include "strip_io.h"
+
+
+/*****************************************************************************
+METHOD:  elapsed_seconds
+
+PURPOSE: Determine the time passed since the specified start.
+
+RETURN: double - the seconds passed
+
+*****************************************************************************/
+double elapsed_seconds
+(
+    struct timespec *start /* I: the start time */
+)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec)
+           + (now.tv_nsec - start->tv_nsec) * 1.0e-9;
+}
+
+
+/*****************************************************************************
+METHOD:  initialize_strip_io
+
+PURPOSE: Setup the strip reads and writes, with nothing to read or write.
+
+RETURN: None
+
+*****************************************************************************/
+void initialize_strip_io
+(
+    Input_Data_t *input,           /* I: input structure */
+    bool generate_lst,             /* I: read the emissivity, write the
+                                         LST */
+    bool write_intermediate_bands, /* I: write the intermediate bands */
+    STRIP_IO *strip_io             /* O: the strip reads and writes */
+)
+{
+    strip_io->input = input;
+    strip_io->generate_lst = generate_lst;
+    strip_io->write_intermediate_bands = write_intermediate_bands;
+
+    strip_io->write_inter = NULL;
+    strip_io->write_lst = NULL;
+    strip_io->write_pixel_count = 0;
+
+    strip_io->read_inter = NULL;
+    strip_io->read_lst = NULL;
+    strip_io->read_elevation = NULL;
+    strip_io->read_pixel_count = 0;
+
+    strip_io->status = SUCCESS;
+    strip_io->background = false;
+    strip_io->started = false;
+
+    strip_io->read_seconds = 0.0;
+    strip_io->write_seconds = 0.0;
+    strip_io->wait_seconds = 0.0;
+}
+
+
+/*****************************************************************************
+METHOD:  write_strip
+
+PURPOSE: Write the strip to the intermediate and land surface temperature
+         files.  The GeoTIFF tiles are only compressed in parallel when the
+         pixels are not being processed alongside.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int write_strip
+(
+    STRIP_IO *strip_io /* I/O: the strip reads and writes */
+)
+{
+    char FUNC_NAME[] = "write_strip";
+
+    if (strip_io->write_intermediate_bands)
+    {
+        /* Write out the strip to the temporary intermediate output files */
+        if (write_intermediate (strip_io->write_inter,
+                                strip_io->write_pixel_count,
+                                !strip_io->background) != SUCCESS)
+        {
+            RETURN_ERROR ("Writing to intermediate data files", FUNC_NAME,
+                          FAILURE);
+        }
+    }
+
+    if (strip_io->generate_lst)
+    {
+        /* Write out the strip to the land surface temperature file */
+        if (write_surface_temperature (strip_io->write_lst,
+                                       strip_io->write_pixel_count,
+                                       !strip_io->background) != SUCCESS)
+        {
+            RETURN_ERROR ("Writing to land surface temperature file",
+                          FUNC_NAME, FAILURE);
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  read_strip
+
+PURPOSE: Read the next strip of the input bands.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int read_strip
+(
+    STRIP_IO *strip_io /* I/O: the strip reads and writes */
+)
+{
+    char FUNC_NAME[] = "read_strip";
+
+    /* Read thermal and elevation data into memory */
+    if (read_input (strip_io->input, strip_io->read_inter->band_thermal,
+                    &strip_io->read_inter->spans, strip_io->read_elevation,
+                    strip_io->read_pixel_count)
+        != SUCCESS)
+    {
+        RETURN_ERROR ("Reading thermal and elevation bands", FUNC_NAME,
+                      FAILURE);
+    }
+
+    if (strip_io->generate_lst)
+    {
+        /* Read the emissivity data into memory */
+        if (read_emissivity (strip_io->input,
+                             strip_io->read_lst->band_emissivity,
+                             strip_io->read_pixel_count) != SUCCESS)
+        {
+            RETURN_ERROR ("Reading emissivity band", FUNC_NAME, FAILURE);
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  strip_io_thread
+
+PURPOSE: Write the strip to write, then read the strip to read.  They are
+         performed in that order, since the strip read may use the buffers
+         of the strip written.
+
+RETURN: NULL, the result is left in the status of the strip reads and writes
+
+*****************************************************************************/
+void *strip_io_thread
+(
+    void *data /* I/O: the strip reads and writes */
+)
+{
+    STRIP_IO *strip_io = data;
+    struct timespec start;
+
+    strip_io->status = SUCCESS;
+
+    if (strip_io->write_inter != NULL)
+    {
+        clock_gettime (CLOCK_MONOTONIC, &start);
+        strip_io->status = write_strip (strip_io);
+        strip_io->write_seconds += elapsed_seconds (&start);
+    }
+
+    if (strip_io->status == SUCCESS && strip_io->read_inter != NULL)
+    {
+        clock_gettime (CLOCK_MONOTONIC, &start);
+        strip_io->status = read_strip (strip_io);
+        strip_io->read_seconds += elapsed_seconds (&start);
+    }
+
+    return NULL;
+}
+
+
+/*****************************************************************************
+METHOD:  perform_strip_io
+
+PURPOSE: Perform the strip reads and writes, waiting for them.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int perform_strip_io
+(
+    STRIP_IO *strip_io /* I/O: the strip reads and writes */
+)
+{
+    struct timespec start;
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    strip_io->background = false;
+    strip_io_thread (strip_io);
+    strip_io->wait_seconds += elapsed_seconds (&start);
+
+    return strip_io->status;
+}
+
+
+/*****************************************************************************
+METHOD:  start_strip_io
+
+PURPOSE: Start performing the strip reads and writes in the background.  The
+         buffers involved must not be used until wait_strip_io returns.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int start_strip_io
+(
+    STRIP_IO *strip_io /* I/O: the strip reads and writes */
+)
+{
+    char FUNC_NAME[] = "start_strip_io";
+
+    if (strip_io->write_inter == NULL && strip_io->read_inter == NULL)
+        return SUCCESS;
+
+    strip_io->background = true;
+    if (pthread_create (&strip_io->thread, NULL, strip_io_thread, strip_io)
+        != 0)
+    {
+        RETURN_ERROR ("Creating the strip I/O thread", FUNC_NAME, FAILURE);
+    }
+    strip_io->started = true;
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  wait_strip_io
+
+PURPOSE: Wait for the strip reads and writes started in the background to
+         complete.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int wait_strip_io
+(
+    STRIP_IO *strip_io /* I/O: the strip reads and writes */
+)
+{
+    char FUNC_NAME[] = "wait_strip_io";
+    struct timespec start;
+
+    if (!strip_io->started)
+        return SUCCESS;
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    if (pthread_join (strip_io->thread, NULL) != 0)
+    {
+        RETURN_ERROR ("Joining the strip I/O thread", FUNC_NAME, FAILURE);
+    }
+    strip_io->wait_seconds += elapsed_seconds (&start);
+    strip_io->started = false;
+
+    return strip_io->status;
+}
@@ -0,0 +1,75 @@
+
+#ifndef STRIP_IO_H
+#define STRIP_IO_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+
+#include "input.h"
+#include "intermediate_data.h"
+#include "surface_temperature.h"
+
+
+/* The reading and writing of the strips of the pixel stage.  The writing of
+   the previous strip and the reading of the next one can be performed in the
+   background, while the current strip is processed. */
+typedef struct
+{
+    Input_Data_t *input;           /* Input bands to read from */
+    bool generate_lst;             /* Read the emissivity, write the LST */
+    bool write_intermediate_bands; /* Write the intermediate bands */
+
+    Intermediate_Data_t *write_inter; /* Strip to write, NULL for none */
+    Surface_Temperature_t *write_lst; /* LST of the strip to write */
+    size_t write_pixel_count;         /* Number of pixels to write */
+
+    Intermediate_Data_t *read_inter;  /* Buffers to read into, NULL for
+                                         none */
+    Surface_Temperature_t *read_lst;  /* Emissivity buffer to read into */
+    int16_t **read_elevation;         /* Elevation of the strip read */
+    size_t read_pixel_count;          /* Number of pixels to read */
+
+    int status;           /* Result of the last reads and writes */
+    bool background;      /* Performed while the pixels are processed */
+    bool started;         /* Reads and writes in the background */
+    pthread_t thread;     /* Thread performing them */
+
+    double read_seconds;  /* Time spent reading */
+    double write_seconds; /* Time spent writing */
+    double wait_seconds;  /* Time processing waited on the reads and
+                             writes */
+} STRIP_IO;
+
+
+void initialize_strip_io
+(
+    Input_Data_t *input,           /* I: input structure */
+    bool generate_lst,             /* I: read the emissivity, write the
+                                         LST */
+    bool write_intermediate_bands, /* I: write the intermediate bands */
+    STRIP_IO *strip_io             /* O: the strip reads and writes */
+);
+
+
+int perform_strip_io
+(
+    STRIP_IO *strip_io /* I/O: the strip reads and writes */
+);
+
+
+int start_strip_io
+(
+    STRIP_IO *strip_io /* I/O: the strip reads and writes */
+);
+
+
+int wait_strip_io
+(
+    STRIP_IO *strip_io /* I/O: the strip reads and writes */
+);
+
+
+#endif /* STRIP_IO_H */
@@ -0,0 +1,511 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+
+
+#include "const.h"
+#include "utilities.h"
+#include "input.h"
+#include "intermediate_data.h"
+#include "geotiff_output.h"
+#include "surface_temperature.h"
+#include "scene_buffer.h"
+
+
+/* Initial number of entries allocated for the brightness temperature LUT */
+#define LUT_ALLOCATION_COUNT 32768
+
+
+/*****************************************************************************
+METHOD:  read_brightness_temperature_lut
+
+PURPOSE: Read the brightness temperature LUT for the satellite.  Each line
+         of the LUT holds a temperature and the radiance for it, in
+         increasing order.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int read_brightness_temperature_lut
+(
+    Input_Data_t *input,        /* I: input structure */
+    char *lst_data_dir,         /* I: location of the LST data files */
+    Surface_Temperature_t *lst  /* O: the surface temperature data */
+)
+{
+    char FUNC_NAME[] = "read_brightness_temperature_lut";
+
+    char lut_filename[PATH_MAX];
+    char msg[PATH_MAX + MAX_STR_LEN];
+    char *lut_name = NULL;
+
+    int allocated;
+    double temperature;
+    double radiance;
+    double *new_memory = NULL;
+
+    FILE *lut_fd = NULL;
+
+    /* Determine the LUT for the satellite */
+    switch (input->meta.satellite)
+    {
+        case SAT_LANDSAT_4:
+            lut_name = "L4_Brightness_Temperature_LUT.txt";
+            break;
+        case SAT_LANDSAT_5:
+            lut_name = "L5_Brightness_Temperature_LUT.txt";
+            break;
+        case SAT_LANDSAT_7:
+            lut_name = "L7_Brightness_Temperature_LUT.txt";
+            break;
+        case SAT_LANDSAT_8:
+            lut_name = "L8_Brightness_Temperature_LUT.txt";
+            break;
+        default:
+            RETURN_ERROR ("No brightness temperature LUT for the satellite",
+                          FUNC_NAME, FAILURE);
+    }
+
+    snprintf (lut_filename, sizeof (lut_filename), "%s/%s",
+              lst_data_dir, lut_name);
+
+    lut_fd = fopen (lut_filename, "r");
+    if (lut_fd == NULL)
+    {
+        snprintf (msg, sizeof (msg), "Opening brightness temperature LUT: %s",
+                  lut_filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    lst->lut_count = 0;
+    allocated = 0;
+    while (fscanf (lut_fd, "%lf %lf", &temperature, &radiance) == 2)
+    {
+        if (lst->lut_count == allocated)
+        {
+            allocated += LUT_ALLOCATION_COUNT;
+
+            new_memory = realloc (lst->lut_temperature,
+                                  allocated * sizeof (double));
+            if (new_memory == NULL)
+            {
+                fclose (lut_fd);
+                RETURN_ERROR ("Allocating brightness temperature LUT memory",
+                              FUNC_NAME, FAILURE);
+            }
+            lst->lut_temperature = new_memory;
+
+            new_memory = realloc (lst->lut_radiance,
+                                  allocated * sizeof (double));
+            if (new_memory == NULL)
+            {
+                fclose (lut_fd);
+                RETURN_ERROR ("Allocating brightness temperature LUT memory",
+                              FUNC_NAME, FAILURE);
+            }
+            lst->lut_radiance = new_memory;
+        }
+
+        lst->lut_temperature[lst->lut_count] = temperature;
+        lst->lut_radiance[lst->lut_count] = radiance;
+        lst->lut_count++;
+    }
+
+    fclose (lut_fd);
+
+    if (lst->lut_count < 2)
+    {
+        snprintf (msg, sizeof (msg), "Invalid brightness temperature LUT: %s",
+                  lut_filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  open_surface_temperature
+
+PURPOSE: Open the land surface temperature output file, raw binary or
+         GeoTIFF, and read the brightness temperature LUT used to generate
+         it.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int open_surface_temperature
+(
+    Input_Data_t *input,        /* I: input structure */
+    char *lst_data_dir,         /* I: location of the LST data files */
+    bool geotiff,               /* I: write a GeoTIFF */
+    Surface_Temperature_t *lst  /* O: the surface temperature data */
+)
+{
+    char FUNC_NAME[] = "open_surface_temperature";
+    char msg[PATH_MAX + MAX_STR_LEN];
+
+    /* Initialize the memory items */
+    lst->band_emissivity = NULL;
+    lst->band_lst = NULL;
+    lst->lut_count = 0;
+    lst->lut_temperature = NULL;
+    lst->lut_radiance = NULL;
+
+    if (read_brightness_temperature_lut (input, lst_data_dir, lst)
+        != SUCCESS)
+    {
+        RETURN_ERROR ("Reading brightness temperature LUT", FUNC_NAME,
+                      FAILURE);
+    }
+
+    snprintf (lst->lst_filename, sizeof (lst->lst_filename), "%s_lst.%s",
+              input->meta.product_id, geotiff ? "tif" : "img");
+
+    lst->lst_fd = NULL;
+    lst->lst_tiff = NULL;
+    if (geotiff)
+        lst->lst_tiff = open_geotiff (input, lst->lst_filename, ESPA_INT16);
+    else
+        lst->lst_fd = fopen (lst->lst_filename, "wb");
+
+    if (lst->lst_fd == NULL && lst->lst_tiff == NULL)
+    {
+        snprintf (msg, sizeof (msg), "Opening output file: %s",
+                  lst->lst_filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  write_surface_temperature
+
+PURPOSE: Write the next pixel_count pixels of the land surface temperature.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int write_surface_temperature
+(
+    Surface_Temperature_t *lst, /* I: the surface temperature data */
+    size_t pixel_count,         /* I: number of pixels to write */
+    bool parallel_tiles         /* I: compress the GeoTIFF tiles in
+                                      parallel */
+)
+{
+    char FUNC_NAME[] = "write_surface_temperature";
+    char msg[PATH_MAX + MAX_STR_LEN];
+    size_t status;
+
+    if (lst->lst_tiff != NULL)
+    {
+        if (write_geotiff_lines (lst->lst_tiff, lst->band_lst,
+                                 pixel_count / lst->lst_tiff->samples,
+                                 parallel_tiles) != SUCCESS)
+        {
+            snprintf (msg, sizeof (msg), "Writing to %s", lst->lst_filename);
+            RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+        }
+
+        return SUCCESS;
+    }
+
+    status = fwrite (lst->band_lst, sizeof (int16_t), pixel_count,
+                     lst->lst_fd);
+    if (status != pixel_count)
+    {
+        snprintf (msg, sizeof (msg), "Writing to %s", lst->lst_filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  close_surface_temperature
+
+PURPOSE: Close the land surface temperature output file and release the
+         brightness temperature LUT.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int close_surface_temperature
+(
+    Surface_Temperature_t *lst  /* I/O: the surface temperature data */
+)
+{
+    char FUNC_NAME[] = "close_surface_temperature";
+    char msg[PATH_MAX + MAX_STR_LEN];
+    int status;
+
+    free (lst->lut_temperature);
+    lst->lut_temperature = NULL;
+
+    free (lst->lut_radiance);
+    lst->lut_radiance = NULL;
+
+    lst->lut_count = 0;
+
+    if (lst->lst_tiff != NULL)
+        status = close_geotiff (lst->lst_tiff);
+    else
+        status = fclose (lst->lst_fd);
+    lst->lst_fd = NULL;
+    lst->lst_tiff = NULL;
+    if (status)
+    {
+        snprintf (msg, sizeof (msg), "Closing file %s", lst->lst_filename);
+        RETURN_ERROR (msg, FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  allocate_surface_temperature
+
+PURPOSE: Allocate the emissivity input and land surface temperature output
+         for a strip of lines.
+
+RETURN: SUCCESS
+        FAILURE
+
+*****************************************************************************/
+int allocate_surface_temperature
+(
+    Surface_Temperature_t *lst, /* I/O: the surface temperature data */
+    int lines,                  /* I: number of lines to hold */
+    int samples                 /* I: number of samples in a line */
+)
+{
+    char FUNC_NAME[] = "allocate_surface_temperature";
+
+    lst->band_emissivity = allocate_scene_buffer (lines,
+                                                  samples * sizeof (float));
+    if (lst->band_emissivity == NULL)
+    {
+        RETURN_ERROR ("Allocating memory for the emissivity", FUNC_NAME,
+                      FAILURE);
+    }
+
+    lst->band_lst = allocate_scene_buffer (lines,
+                                           samples * sizeof (int16_t));
+    if (lst->band_lst == NULL)
+    {
+        free_surface_temperature (lst);
+
+        RETURN_ERROR ("Allocating memory for the land surface temperature",
+                      FUNC_NAME, FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+
+/*****************************************************************************
+METHOD:  free_surface_temperature
+
+PURPOSE: Free the emissivity input and land surface temperature output.
+
+RETURN: None
+
+*****************************************************************************/
+void free_surface_temperature
+(
+    Surface_Temperature_t *lst  /* I/O: the surface temperature data */
+)
+{
+    free_scene_buffer (lst->band_emissivity);
+    lst->band_emissivity = NULL;
+
+    free_scene_buffer (lst->band_lst);
+    lst->band_lst = NULL;
+}
+
+
+/*****************************************************************************
+METHOD:  brightness_temperature
+
+PURPOSE: Look up the temperature for a radiance in the brightness
+         temperature LUT, interpolating linearly between entries.  Radiances
+         outside of the LUT are given the temperature at that end of it.
+
+RETURN: double - the temperature (kelvin)
+
+*****************************************************************************/
+double brightness_temperature
+(
+    Surface_Temperature_t *lst, /* I: the surface temperature data */
+    double radiance             /* I: radiance to look up */
+)
+{
+    int low;
+    int high;
+    int middle;
+
+    double *lut_radiance = lst->lut_radiance;
+    double *lut_temperature = lst->lut_temperature;
+
+    low = 0;
+    high = lst->lut_count - 1;
+
+    if (radiance <= lut_radiance[low])
+        return lut_temperature[low];
+    if (radiance >= lut_radiance[high])
+        return lut_temperature[high];
+
+    /* Find the entries surrounding the radiance */
+    while (high - low > 1)
+    {
+        middle = (low + high) / 2;
+        if (radiance < lut_radiance[middle])
+            high = middle;
+        else
+            low = middle;
+    }
+
+    return (lut_temperature[high] - lut_temperature[low])
+           / (lut_radiance[high] - lut_radiance[low])
+           * (radiance - lut_radiance[low])
+           + lut_temperature[low];
+}
+
+
+/*****************************************************************************
+METHOD:  calculate_surface_temperature
+
+PURPOSE: Generate the scaled land surface temperature for a span of pixels
+         from the thermal radiance, the atmospheric parameters, and the
+         emissivity.
+
+NOTE: This is the same calculation the build_lst_data script performs on the
+      intermediate bands, including performing it in single precision up to
+      the LUT.  A pixel which is fill in any of the inputs is fill in the
+      output, as is a pixel whose radiance can not be determined.
+
+RETURN: None
+
+*****************************************************************************/
+void calculate_surface_temperature
+(
+    Surface_Temperature_t *lst,  /* I/O: emissivity input and LST output */
+    Intermediate_Data_t *inter,  /* I: thermal radiance and atmospheric
+                                       parameters */
+    size_t pixel_loc,            /* I: first pixel to calculate */
+    int pixel_count              /* I: number of pixels to calculate */
+)
+{
+    size_t pixel;
+
+    float thermal;
+    float transmittance;
+    float upwelled;
+    float downwelled;
+    float emissivity;
+    float surface_radiance;
+    float radiance;
+    float radiance_emitted;
+
+    double temperature;
+
+    for (pixel = pixel_loc; pixel < pixel_loc + pixel_count; pixel++)
+    {
+        thermal = inter->band_thermal[pixel];
+        transmittance = inter->band_transmittance[pixel];
+        upwelled = inter->band_upwelled[pixel];
+        downwelled = inter->band_downwelled[pixel];
+        emissivity = lst->band_emissivity[pixel];
+
+        if (thermal == LST_NO_DATA_VALUE
+            || transmittance == LST_NO_DATA_VALUE
+            || upwelled == LST_NO_DATA_VALUE
+            || downwelled == LST_NO_DATA_VALUE
+            || emissivity == LST_NO_DATA_VALUE)
+        {
+            lst->band_lst[pixel] = LST_NO_DATA_VALUE;
+            continue;
+        }
+
+        /* Surface radiance */
+        surface_radiance = (thermal - upwelled) / transmittance;
+
+        /* Estimate Earth-emitted radiance by subtracting off the reflected
+           downwelling component */
+        radiance = surface_radiance - (1.0f - emissivity) * downwelled;
+
+        /* Account for surface emissivity to get Plank emitted radiance */
+        radiance_emitted = radiance / emissivity;
+
+        if (isnan (radiance_emitted))
+        {
+            lst->band_lst[pixel] = LST_NO_DATA_VALUE;
+            continue;
+        }
+
+        /* Use the brightness temperature LUT to get skin temperature, then
+           scale it to the int16 output */
+        temperature = brightness_temperature (lst, radiance_emitted)
+                      * LST_MULT_FACTOR;
+
+        if (temperature < INT16_MIN)
+            temperature = INT16_MIN;
+        else if (temperature > INT16_MAX)
+            temperature = INT16_MAX;
+
+        lst->band_lst[pixel] = (int16_t) round (temperature);
+    }
+}
+
+
+/*****************************************************************************
+METHOD:  calculate_line_surface_temperature
+
+PURPOSE: Generate the scaled land surface temperature for a line of a strip,
+         calculating only the valid spans of the thermal band and setting
+         the rest of the line to fill.
+
+RETURN: None
+
+*****************************************************************************/
+void calculate_line_surface_temperature
+(
+    Surface_Temperature_t *lst,  /* I/O: emissivity input and LST output */
+    Intermediate_Data_t *inter,  /* I: thermal radiance, its valid spans, and
+                                       atmospheric parameters */
+    int strip_line,              /* I: line of the strip to calculate */
+    int samples                  /* I: number of samples in a line */
+)
+{
+    int span;
+
+    int16_t no_data = LST_NO_DATA_VALUE;
+
+    /* Use local variables for cleaner code */
+    Valid_Spans_t *spans = &inter->spans;
+    size_t pixel_line_loc = (size_t) strip_line * samples;
+
+    fill_invalid_samples (spans, strip_line, samples,
+                          &lst->band_lst[pixel_line_loc], &no_data,
+                          sizeof (int16_t));
+
+    for (span = spans->line_first_span[strip_line];
+         span < spans->line_first_span[strip_line + 1]; span++)
+    {
+        calculate_surface_temperature (
+            lst, inter, pixel_line_loc + spans->span_start[span],
+            spans->span_end[span] - spans->span_start[span]);
+    }
+}
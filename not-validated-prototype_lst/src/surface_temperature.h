@@ -0,0 +1,90 @@
+
+#ifndef SURFACE_TEMPERATURE_H
+#define SURFACE_TEMPERATURE_H
+
+
+#include <stdint.h>
+
+
+#include "input.h"
+#include "intermediate_data.h"
+#include "geotiff_output.h"
+
+
+/* Structure for the land surface temperature generated alongside the
+   intermediate data */
+typedef struct
+{
+    char lst_filename[PATH_MAX];
+    FILE *lst_fd;
+    GeoTIFF_Output_t *lst_tiff; /* Used instead of the file when writing a
+                                   GeoTIFF */
+    float *band_emissivity;
+    int16_t *band_lst;
+
+    /* Brightness temperature LUT, ordered by increasing radiance */
+    int lut_count;
+    double *lut_temperature;
+    double *lut_radiance;
+} Surface_Temperature_t;
+
+
+int open_surface_temperature
+(
+    Input_Data_t *input,        /* I: input structure */
+    char *lst_data_dir,         /* I: location of the LST data files */
+    bool geotiff,               /* I: write a GeoTIFF */
+    Surface_Temperature_t *lst  /* O: the surface temperature data */
+);
+
+
+int write_surface_temperature
+(
+    Surface_Temperature_t *lst, /* I: the surface temperature data */
+    size_t pixel_count,         /* I: number of pixels to write */
+    bool parallel_tiles         /* I: compress the GeoTIFF tiles in
+                                      parallel */
+);
+
+
+int close_surface_temperature
+(
+    Surface_Temperature_t *lst  /* I/O: the surface temperature data */
+);
+
+
+int allocate_surface_temperature
+(
+    Surface_Temperature_t *lst, /* I/O: the surface temperature data */
+    int lines,                  /* I: number of lines to hold */
+    int samples                 /* I: number of samples in a line */
+);
+
+
+void free_surface_temperature
+(
+    Surface_Temperature_t *lst  /* I/O: the surface temperature data */
+);
+
+
+void calculate_surface_temperature
+(
+    Surface_Temperature_t *lst,  /* I/O: emissivity input and LST output */
+    Intermediate_Data_t *inter,  /* I: thermal radiance and atmospheric
+                                       parameters */
+    size_t pixel_loc,            /* I: first pixel to calculate */
+    int pixel_count              /* I: number of pixels to calculate */
+);
+
+
+void calculate_line_surface_temperature
+(
+    Surface_Temperature_t *lst,  /* I/O: emissivity input and LST output */
+    Intermediate_Data_t *inter,  /* I: thermal radiance, its valid spans, and
+                                       atmospheric parameters */
+    int strip_line,              /* I: line of the strip to calculate */
+    int samples                  /* I: number of samples in a line */
+);
+
+
+#endif /* SURFACE_TEMPERATURE_H */
@@ -1,11 +1,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <libgen.h>
+#include <zlib.h>
 
 
 #include "utilities.h"
@@ -55,3 +57,69 @@ void write_message
 
     fflush(fd);
 }
+
+
+/*****************************************************************************
+  NAME:  fill_values
+
+  PURPOSE:  Sets count values of value_size bytes to the specified value.
+            The value is copied once, then the filled portion is copied over
+            the rest, doubling each time, so the bulk of the filling is done
+            by memcpy with the widest stores available.
+
+  RETURN VALUE:  None
+*****************************************************************************/
+void fill_values
+(
+    void *values,        /* O: the values to set */
+    const void *value,   /* I: the value to set them to */
+    size_t value_size,   /* I: size of a value */
+    int count            /* I: number of values to set */
+)
+{
+    size_t filled;
+    size_t size = value_size * count;
+    char *bytes = values;
+
+    if (count <= 0)
+        return;
+
+    memcpy (bytes, value, value_size);
+    for (filled = value_size; filled < size; filled *= 2)
+    {
+        if (filled > size - filled)
+            memcpy (bytes + filled, bytes, size - filled);
+        else
+            memcpy (bytes + filled, bytes, filled);
+    }
+}
+
+
+/*****************************************************************************
+  NAME:  checksum_bytes
+
+  PURPOSE:  Determines the CRC-32 of a block of bytes, the same as zlib's
+            crc32, in pieces since zlib takes the length as an unsigned int.
+
+  RETURN VALUE:  The checksum
+*****************************************************************************/
+uint32_t checksum_bytes
+(
+    const void *bytes,   /* I: the bytes to check */
+    size_t size          /* I: number of bytes */
+)
+{
+    uLong crc = crc32 (0L, Z_NULL, 0);
+    const unsigned char *next = bytes;
+    size_t piece;
+
+    while (size > 0)
+    {
+        piece = (size > (1 << 30)) ? (1 << 30) : size;
+        crc = crc32 (crc, next, (uInt) piece);
+        next += piece;
+        size -= piece;
+    }
+
+    return (uint32_t) crc;
+}
@@ -4,6 +4,8 @@
 
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
 
 
 /* Define logging routines */
@@ -40,6 +42,22 @@ void write_message
 );
 
 
+void fill_values
+(
+    void *values,        /* O: the values to set */
+    const void *value,   /* I: the value to set them to */
+    size_t value_size,   /* I: size of a value */
+    int count            /* I: number of values to set */
+);
+
+
+uint32_t checksum_bytes
+(
+    const void *bytes,   /* I: the bytes to check */
+    size_t size          /* I: number of bytes */
+);
+
+
 /* Re-define minimum and maximum to our versions */
 #ifdef min
     #undef min
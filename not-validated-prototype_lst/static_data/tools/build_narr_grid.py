@@ -0,0 +1,118 @@
+
+# A simple tool to build the binary NARR coordinate grid and its bucket index
+# from the NARR coordinates text, the layout must match narr_grid.h
+
+import sys
+import math
+import zlib
+import struct
+from argparse import ArgumentParser
+
+
+NARR_GRID_MAGIC = b'LSTGRID'
+NARR_GRID_VERSION = 1
+NARR_GRID_HEADER_FORMAT = '<8s6I3d'
+
+NARR_ROWS = 277
+NARR_COLS = 349
+
+# Degrees of each bucket of the index
+BUCKET_SIZE = 1.0
+
+
+def bucket_of(value, min_value, num_buckets):
+    """Determine the bucket of a coordinate, as narr_grid.c does"""
+
+    bucket = math.floor((value - min_value) / BUCKET_SIZE)
+
+    return int(min(max(bucket, 0), num_buckets - 1))
+
+
+def read_coordinates(filename):
+    """Read the coordinates, converting the longitudes as
+       read_narr_coordinates does"""
+
+    lat = []
+    lon = []
+    with open(filename, 'r') as in_fd:
+        for line in in_fd:
+            fields = line.split()
+            if len(fields) < 4:
+                continue
+
+            grid_lat = float(fields[2])
+            grid_lon = float(fields[3])
+
+            lat.append(grid_lat)
+            if grid_lon > 180.0:
+                lon.append(360.0 - grid_lon)
+            else:
+                lon.append(-grid_lon)
+
+    if len(lat) != NARR_ROWS * NARR_COLS:
+        raise Exception('{0} does not contain NARR_ROWS * NARR_COLS'
+                        ' coordinates'.format(filename))
+
+    return (lat, lon)
+
+
+if __name__ == '__main__':
+    """Build the grid from the coordinates"""
+
+    description = 'Build the binary NARR coordinate grid'
+    parser = ArgumentParser(description=description)
+
+    parser.add_argument('--input',
+                        action='store',
+                        dest='input',
+                        required=True,
+                        help='The filename for the input')
+
+    parser.add_argument('--output',
+                        action='store',
+                        dest='output',
+                        required=True,
+                        help='The filename for the output')
+
+    args = parser.parse_args()
+
+    (lat, lon) = read_coordinates(args.input)
+
+    min_lat = math.floor(min(lat))
+    min_lon = math.floor(min(lon))
+    lat_buckets = int(math.floor((max(lat) - min_lat) / BUCKET_SIZE)) + 1
+    lon_buckets = int(math.floor((max(lon) - min_lon) / BUCKET_SIZE)) + 1
+
+    # The points of each bucket, latitude bucket major, in increasing order
+    buckets = [[] for bucket in range(lat_buckets * lon_buckets)]
+    for point in range(len(lat)):
+        bucket = (bucket_of(lat[point], min_lat, lat_buckets) * lon_buckets
+                  + bucket_of(lon[point], min_lon, lon_buckets))
+        buckets[bucket].append(point)
+
+    bucket_start = [0]
+    bucket_points = []
+    for bucket in buckets:
+        bucket_points.extend(bucket)
+        bucket_start.append(len(bucket_points))
+
+    contents = b''.join([struct.pack('<{0}d'.format(len(lat)), *lat),
+                         struct.pack('<{0}d'.format(len(lon)), *lon),
+                         struct.pack('<{0}I'.format(len(bucket_start)),
+                                     *bucket_start),
+                         struct.pack('<{0}I'.format(len(bucket_points)),
+                                     *bucket_points)])
+
+    header = struct.pack(NARR_GRID_HEADER_FORMAT,
+                         NARR_GRID_MAGIC,
+                         NARR_GRID_VERSION,
+                         NARR_ROWS, NARR_COLS,
+                         lat_buckets, lon_buckets,
+                         zlib.crc32(contents) & 0xffffffff,
+                         BUCKET_SIZE, min_lat, min_lon)
+
+    with open(args.output, 'wb') as out_fd:
+        out_fd.write(header)
+        out_fd.write(contents)
+
+    sys.exit(0)